@@ -0,0 +1,433 @@
+#include "batch.hpp"
+#include "fileCheck.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include <vcg/complex/algorithms/create/platonic.h>
+#endif
+
+namespace batch{
+
+static bool is_directory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static unsigned long long file_size(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (unsigned long long) st.st_size : 0;
+}
+
+std::vector<std::string> list_inputs(const std::string& path) {
+    std::vector<std::string> inputs;
+
+    if (is_directory(path)) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == NULL)
+            throw std::runtime_error("cannot open directory " + path);
+        while (struct dirent* entry = readdir(dir)) {
+            const std::string filepath = path + "/" + entry->d_name;
+            const auto extension = util::extension_lower(filepath);
+            if ((extension == "stl" || extension == "obj" || extension == "ply") && !is_directory(filepath))
+                inputs.push_back(filepath);
+        }
+        closedir(dir);
+        std::sort(inputs.begin(), inputs.end());
+        return inputs;
+    }
+
+    std::ifstream manifest(path);
+    if (!manifest)
+        throw std::runtime_error("cannot open manifest " + path);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        line.erase(0, line.find_first_not_of(" \t"));
+        if (!line.empty() && line[0] != '#')
+            inputs.push_back(line);
+    }
+    return inputs;
+}
+
+unsigned long long available_memory() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    unsigned long long kb;
+    while (meminfo >> key >> kb) {
+        if (key == "MemAvailable:")
+            return kb * 1024;
+        meminfo.ignore(256, '\n');
+    }
+#ifdef _SC_AVPHYS_PAGES
+    return (unsigned long long) sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+#else
+    return 1ull << 30;
+#endif
+}
+
+unsigned long long estimate_peak_bytes(const std::string& filepath) {
+    // a binary stl peaks at about 350 bytes per face through load, check, repair and
+    // check again, the rest is headroom for the scratch of unlucky meshes
+    const unsigned long long bytes_per_face = 600;
+
+    const auto size = file_size(filepath);
+    const auto extension = util::extension_lower(filepath);
+
+    // average size of a face in the file
+    unsigned long long file_bytes_per_face = 50;
+    if (extension == "stl" && (size < 84 || (size - 84) % 50 != 0))
+        file_bytes_per_face = 250; // ascii facet
+    else if (extension == "obj")
+        file_bytes_per_face = 40;  // a face line and half a vertex line
+    else if (extension == "ply")
+        file_bytes_per_face = 20;  // binary, a face and half a vertex
+
+    return std::max(size / file_bytes_per_face, 1ull) * bytes_per_face;
+}
+
+void run_pool(
+        const std::vector<job_t>& jobs,
+        unsigned int n_workers,
+        unsigned long long memory_budget,
+        std::function<void(const job_t&, unsigned int)> fn
+) {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t next = 0;
+    unsigned int running = 0;
+    unsigned long long in_use = 0;
+
+    auto worker = [&](unsigned int id) {
+        for (;;) {
+            size_t job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [&]() {
+                    return next == jobs.size() || running == 0 ||
+                           in_use + jobs[next].estimated_bytes <= memory_budget;
+                });
+                if (next == jobs.size())
+                    return;
+                job = next++;
+                in_use += jobs[job].estimated_bytes;
+                ++running;
+            }
+
+            fn(jobs[job], id);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                in_use -= jobs[job].estimated_bytes;
+                --running;
+            }
+            done.notify_all();
+        }
+    };
+
+    n_workers = std::max(1u, std::min<unsigned int>(n_workers, jobs.size()));
+    std::vector<std::thread> threads;
+    for (unsigned int id = 1; id < n_workers; ++id)
+        threads.emplace_back(worker, id);
+    worker(0);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// stream buffer put in place of the one of std::cout while the workers run. What a thread
+// prints while it has a capture string goes there, the rest goes to the replaced buffer
+class captureBuf_t : public std::streambuf {
+public:
+    explicit captureBuf_t(std::streambuf* out) : out(out) {}
+
+    // the output of the calling thread goes to *capture, nullptr ends the capture
+    static void capture_to(std::string* capture) { captured = capture; }
+
+    // writes text to the replaced buffer in one piece
+    void emit(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out->sputn(text.data(), text.size());
+        out->pubsync();
+    }
+
+protected:
+    int overflow(int c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+        const char ch = traits_type::to_char_type(c);
+        return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (captured) {
+            captured->append(s, n);
+            return n;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        return out->sputn(s, n);
+    }
+
+    int sync() override {
+        if (captured)
+            return 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        return out->pubsync();
+    }
+
+private:
+    std::streambuf* out;
+    std::mutex mutex;
+    static thread_local std::string* captured;
+};
+
+thread_local std::string* captureBuf_t::captured = nullptr;
+
+static std::string repaired_path_of(const job_t& job, const std::string& repaired_dir) {
+    std::string name = job.filepath.substr(job.filepath.find_last_of('/') + 1);
+    name = name.substr(0, name.find_last_of('.'));
+    // the index keeps files with the same name in different directories apart
+    return repaired_dir + "/" + std::to_string(job.index) + "_" + name + ".stl";
+}
+
+int batch_main(
+        const std::string input,
+        const std::string repaired_dir,
+        const std::string report_path,
+        unsigned int n_workers
+) {
+    const auto inputs = list_inputs(input);
+
+    if (n_workers == 0)
+        n_workers = std::max(1u, std::thread::hardware_concurrency());
+    n_workers = std::max(1u, std::min<unsigned int>(n_workers, inputs.size()));
+
+    // leave a fifth of the free memory to the rest of the system
+    const auto memory_budget = available_memory() / 5 * 4;
+
+    std::vector<job_t> jobs;
+    for (size_t i = 0; i < inputs.size(); ++i)
+        jobs.push_back(job_t{i, inputs[i], estimate_peak_bytes(inputs[i])});
+
+    std::ofstream report(report_path);
+    if (!report) {
+        printf("cannot write the batch report %s\n", report_path.c_str());
+        return (int) inputs.size();
+    }
+    printf("batch of %zu files on %u workers, memory budget %llu MB\n",
+           inputs.size(), n_workers, memory_budget >> 20);
+
+    std::mutex report_mutex;
+    std::atomic<int> n_failed(0);
+
+    // the meshes are on the heap unless pooling is asked for: then the meshes of a worker come
+    // from its arena, the blocks a job released serve the next one, and an idle worker keeps
+    // at most its share of a quarter of the budget
+    std::vector<std::unique_ptr<util::arena_t>> arenas;
+    if (util::pooling_requested())
+        for (unsigned int i = 0; i < n_workers; ++i)
+            arenas.emplace_back(new util::arena_t(true, memory_budget / 4 / n_workers));
+
+    // what check_repair() prints about a file is written in one piece once the file is done,
+    // the lines of the files checked at the same time do not interleave
+    std::cout.flush();
+    captureBuf_t capture(std::cout.rdbuf());
+    std::streambuf* const cout_buf = std::cout.rdbuf(&capture);
+
+    run_pool(jobs, n_workers, memory_budget, [&](const job_t& job, unsigned int worker) {
+        std::string output;
+        captureBuf_t::capture_to(&output);
+#ifdef _OPENMP
+        // the cores are shared between the workers
+        omp_set_num_threads(std::max(1, omp_get_num_procs() / (int) n_workers));
+#endif
+        const auto repaired_path = repaired_path_of(job, repaired_dir);
+        auto t1 = std::chrono::high_resolution_clock::now();
+
+        json_t line, check_report;
+        util::stageTimes_t times;
+        bool ok = false;
+        util::arena_t* const arena = arenas.empty() ? nullptr : arenas[worker].get();
+        const util::arenaStats_t before = arena ? arena->stats() : util::arenaStats_t();
+        try {
+            util::arenaScope_t scope(arena);
+            ok = check_repair(job.filepath, repaired_path, check_report, &times);
+            if (!ok)
+                line["error"] = "cannot load the mesh";
+        } catch (const std::exception& e) {
+            line["error"] = e.what();
+        } catch (...) {
+            line["error"] = "unknown error";
+        }
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        times.push_back(std::make_pair("total", std::chrono::duration<double, std::milli>(t2 - t1).count()));
+
+        const util::arenaStats_t after = arena ? arena->stats() : util::arenaStats_t();
+        if (arena)
+            arena->reset();
+
+        json_t timings = json_t::object();
+        for (auto& t : times)
+            timings[t.first] = t.second;
+
+        line["index"] = job.index;
+        line["file"] = job.filepath;
+        line["ok"] = ok;
+        line["worker"] = worker;
+        line["estimated_bytes"] = job.estimated_bytes;
+        line["timings_ms"] = timings;
+        if (arena)
+            line["arena"] = {
+                {"allocations", after.allocations - before.allocations},
+                {"system_allocations", after.system_allocations - before.system_allocations},
+                {"peak_bytes", after.peak_bytes}
+            };
+        line["report"] = check_report;
+        if (check_report.count("repair_version"))
+            line["repaired_path"] = repaired_path;
+
+        if (!ok)
+            ++n_failed;
+
+        captureBuf_t::capture_to(nullptr);
+        capture.emit(output);
+
+        std::lock_guard<std::mutex> lock(report_mutex);
+        report << line.dump() << "\n";
+        report.flush();
+    });
+
+    std::cout.rdbuf(cout_buf);
+    return n_failed;
+}
+
+#ifdef FILECHECK_TEST
+TEST_CASE( "test batch pool memory budget", "[util]" ) {
+    std::vector<job_t> jobs;
+    for (size_t i = 0; i < 40; ++i)
+        jobs.push_back(job_t{i, std::to_string(i), (i % 7 == 0) ? 250ull : 30ull});
+
+    std::mutex mutex;
+    unsigned long long in_use = 0, peak = 0;
+    std::vector<int> runs(jobs.size(), 0);
+    bool large_alone = true;
+    unsigned int max_worker = 0;
+
+    // the 250 jobs are larger than the whole budget, they have to run alone
+    run_pool(jobs, 4, 100, [&](const job_t& job, unsigned int worker) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_use += job.estimated_bytes;
+            if (job.estimated_bytes <= 100)
+                peak = std::max(peak, in_use);
+            else if (in_use != job.estimated_bytes)
+                large_alone = false;
+            ++runs[job.index];
+            max_worker = std::max(max_worker, worker);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lock(mutex);
+        in_use -= job.estimated_bytes;
+    });
+
+    // catch assertions are not thread safe, they are checked once the pool is done
+    REQUIRE( peak <= 100 );
+    REQUIRE( large_alone );
+    REQUIRE( max_worker < 4 );
+    for (auto r : runs)
+        REQUIRE( r == 1 );
+}
+
+TEST_CASE( "test batch output of a file in one piece", "[util]" ) {
+    std::vector<job_t> jobs;
+    for (size_t i = 0; i < 16; ++i)
+        jobs.push_back(job_t{i, std::to_string(i), 1});
+
+    std::stringbuf printed;
+    captureBuf_t capture(&printed);
+    std::ostream out(&capture);
+    run_pool(jobs, 4, 100, [&](const job_t& job, unsigned int) {
+        std::string output;
+        captureBuf_t::capture_to(&output);
+        out << "begin " << job.index << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        out << "end " << job.index << std::endl;
+        captureBuf_t::capture_to(nullptr);
+        capture.emit(output);
+    });
+    out << "done" << std::endl;
+
+    std::istringstream lines(printed.str());
+    std::string begin, end;
+    size_t n = 0;
+    while (std::getline(lines, begin) && begin != "done") {
+        REQUIRE( std::getline(lines, end) );
+        REQUIRE( begin.substr(0, 6) == "begin " );
+        REQUIRE( end == "end " + begin.substr(6) );
+        ++n;
+    }
+    REQUIRE( n == jobs.size() );
+    REQUIRE( begin == "done" );
+}
+
+TEST_CASE( "test batch manifest", "[util]" ) {
+    const std::string dir = "./unittest/unittest_out";
+    const std::string manifest_path = dir + "/manifest.txt";
+    const std::string report_path = dir + "/batch.jsonl";
+
+    MyMesh sphere;
+    vcg::tri::Sphere(sphere, 3);
+    exportMesh(sphere, dir + "/batch_good.stl");
+    for (size_t i = 0; i < sphere.face.size(); i += 37)
+        vcg::tri::Allocator<MyMesh>::DeleteFace(sphere, sphere.face[i]);
+    exportMesh(sphere, dir + "/batch_holes.stl");
+
+    std::ofstream manifest(manifest_path);
+    manifest << "# meshes\n" << dir << "/batch_good.stl\n\n"
+             << dir << "/batch_holes.stl \n" << dir << "/batch_missing.stl\n";
+    manifest.close();
+
+    REQUIRE( list_inputs(manifest_path).size() == 3 );
+    REQUIRE( batch_main(manifest_path, dir, report_path, 2) == 1 );
+
+    std::ifstream report(report_path);
+    std::vector<json_t> lines;
+    for (std::string line; std::getline(report, line);)
+        lines.push_back(json_t::parse(line));
+    REQUIRE( lines.size() == 3 );
+
+    std::sort(lines.begin(), lines.end(), [](const json_t& a, const json_t& b) {
+        return a["index"].get<size_t>() < b["index"].get<size_t>();
+    });
+    REQUIRE( lines[0]["ok"] == true );
+    REQUIRE( lines[0]["report"]["is_good_mesh"] == true );
+    REQUIRE( lines[0]["timings_ms"].count("check.metrics") == 1 );
+    // unpooled by default, the meshes are on the heap
+    REQUIRE( lines[0].count("arena") == 0 );
+    REQUIRE( lines[0].count("repaired_path") == 0 );
+    REQUIRE( lines[1]["ok"] == true );
+    REQUIRE( lines[1]["report"]["is_good_mesh"] == false );
+    REQUIRE( lines[1]["timings_ms"].count("repair") == 1 );
+    REQUIRE( util::exists(lines[1]["repaired_path"].get<std::string>()) );
+    REQUIRE( lines[2]["ok"] == false );
+
+    std::remove(lines[1]["repaired_path"].get<std::string>().c_str());
+    for (auto name : {"/batch_good.stl", "/batch_holes.stl", "/manifest.txt", "/batch.jsonl"})
+        std::remove((dir + name).c_str());
+}
+#endif
+
+}
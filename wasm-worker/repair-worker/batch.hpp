@@ -0,0 +1,50 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// Batch mode of the filecheck binary: many files checked and repaired by one
+// process, one json line per file in the report.
+namespace batch{
+
+struct job_t {
+    size_t index;
+    std::string filepath;
+    unsigned long long estimated_bytes;
+};
+
+// meshes (stl, obj, ply) of a directory sorted by name, or the paths of a
+// manifest file, one per line. Empty lines and lines starting with # are skipped
+std::vector<std::string> list_inputs(const std::string& path);
+
+// memory the batch may use: MemAvailable on linux, the free physical pages elsewhere
+unsigned long long available_memory();
+
+// guess of the peak memory of check and repair of a mesh file from its size and format
+unsigned long long estimate_peak_bytes(const std::string& filepath);
+
+// Runs fn(job, worker) for every job on at most n_workers threads. Jobs start in
+// order, each one when its estimate fits in what is left of memory_budget, so big
+// meshes run with fewer neighbours. A job larger than the whole budget runs alone.
+void run_pool(
+    const std::vector<job_t>& jobs,
+    unsigned int n_workers,
+    unsigned long long memory_budget,
+    std::function<void(const job_t&, unsigned int)> fn
+);
+
+// checks and repairs every input into repaired_dir, writes one json line per file
+// to report_path as soon as it is done. n_workers 0 means one per core.
+// returns the number of files that could not be processed
+int batch_main(
+    const std::string input,
+    const std::string repaired_dir,
+    const std::string report_path,
+    unsigned int n_workers = 0
+);
+
+}
+
+#endif
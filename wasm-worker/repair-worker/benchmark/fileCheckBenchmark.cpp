@@ -0,0 +1,921 @@
+#include "fileCheck.hpp"
+#include "meshGenerator.hpp"
+#include "indexedMesh.hpp"
+#include "kernels.hpp"
+
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/intersection.h>
+#include <vcg/space/index/bvh.h>
+#include <vcg/space/index/aabb_binary_tree/aabb_binary_tree.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+#include <vcg/complex/algorithms/pointcloud_normal.h>
+#include <vcg/complex/algorithms/point_sampling.h>
+#include <random>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef std::chrono::high_resolution_clock clock_t_;
+
+static double elapsed_ms(clock_t_::time_point t1, clock_t_::time_point t2) {
+    return std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+// sphere with ~1% of the faces removed the way RemoveNonManifoldFace() does it
+static void make_damaged_sphere(MyMesh& mesh, int subdiv) {
+    vcg::tri::Sphere(mesh, subdiv);
+    vcg::tri::UpdateTopology<MyMesh>::FaceFace(mesh);
+
+    for (size_t i = 0; i < mesh.face.size(); i += 97) {
+        MyFace& f = mesh.face[i];
+        if (f.IsD()) continue;
+        for (int j = 0; j < 3; ++j)
+            if (!vcg::face::IsBorder(f, j))
+                vcg::face::FFDetach(f, j);
+        vcg::tri::Allocator<MyMesh>::DeleteFace(mesh, f);
+    }
+}
+
+static void bench_compact(int subdiv) {
+    MyMesh reloaded, compacted;
+    make_damaged_sphere(reloaded, subdiv);
+    make_damaged_sphere(compacted, subdiv);
+
+    auto t1 = clock_t_::now();
+    reloadMesh(reloaded);
+    auto t2 = clock_t_::now();
+    compactMesh(compacted);
+    auto t3 = clock_t_::now();
+
+    const bool same = reloaded.FN() == compacted.FN() && reloaded.VN() == compacted.VN() &&
+                      Clean_t::CountHoles(reloaded) == Clean_t::CountHoles(compacted);
+
+    printf("compact faces %9d reloadMesh %10.2f ms compactMesh %10.2f ms speedup %6.2fx %s\n",
+           compacted.FN(), elapsed_ms(t1, t2), elapsed_ms(t2, t3),
+           elapsed_ms(t1, t2) / std::max(elapsed_ms(t2, t3), 1e-3),
+           same ? "same" : "MISMATCH");
+}
+
+// two overlapping spheres, 10 * 4^subdiv faces in total, scaled so that
+// their faces stay larger than the GoodFace() threshold
+static void make_overlapping_spheres(MyMesh& mesh, int subdiv) {
+    MyMesh other;
+    vcg::tri::Sphere(mesh, subdiv - 1);
+    vcg::tri::Sphere(other, subdiv - 1);
+    vcg::tri::UpdatePosition<MyMesh>::Translate(other, MyMesh::CoordType(0.5, 0, 0));
+    vcg::tri::Append<MyMesh, MyMesh>::Mesh(mesh, other);
+    vcg::tri::UpdatePosition<MyMesh>::Scale(mesh, float(1 << subdiv));
+}
+
+static int num_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+static void bench_self_intersections(int subdiv) {
+    MyMesh mesh;
+    make_overlapping_spheres(mesh, subdiv);
+
+    std::vector<MyFace*> serial, parallel;
+    auto t1 = clock_t_::now();
+    Clean_t::SelfIntersections(mesh, serial);
+    auto t2 = clock_t_::now();
+    Clean_t::SelfIntersectionsParallel(mesh, parallel);
+    auto t3 = clock_t_::now();
+
+    printf("selfintersect faces %9d threads %3d SelfIntersections %10.2f ms SelfIntersectionsParallel %10.2f ms speedup %6.2fx %s\n",
+           mesh.FN(), num_threads(), elapsed_ms(t1, t2), elapsed_ms(t2, t3),
+           elapsed_ms(t1, t2) / std::max(elapsed_ms(t2, t3), 1e-3),
+           serial.size() == parallel.size() ? "same" : "MISMATCH");
+}
+
+// unwelded triangle soup, every vertex repeated about six times as in a stl
+static void make_triangle_soup(MyMesh& soup, int subdiv) {
+    MyMesh sphere;
+    vcg::tri::Sphere(sphere, subdiv);
+    vcg::tri::Allocator<MyMesh>::AddFaces(soup, sphere.face.size());
+    auto vi = vcg::tri::Allocator<MyMesh>::AddVertices(soup, sphere.face.size() * 3);
+    for (size_t i = 0; i < sphere.face.size(); ++i) {
+        for (int k = 0; k < 3; ++k, ++vi) {
+            vi->P() = sphere.face[i].P(k);
+            soup.face[i].V(k) = &*vi;
+        }
+    }
+}
+
+static void bench_weld(int subdiv) {
+    MyMesh sorted, hashed;
+    make_triangle_soup(sorted, subdiv);
+    make_triangle_soup(hashed, subdiv);
+
+    auto t1 = clock_t_::now();
+    const int sortedDeleted = Clean_t::RemoveDuplicateVertexSorted(sorted, false);
+    auto t2 = clock_t_::now();
+    const int hashedDeleted = Clean_t::RemoveDuplicateVertex(hashed, false);
+    auto t3 = clock_t_::now();
+
+    printf("weld faces %9d RemoveDuplicateVertexSorted %10.2f ms RemoveDuplicateVertex %10.2f ms speedup %6.2fx %s\n",
+           hashed.FN(), elapsed_ms(t1, t2), elapsed_ms(t2, t3),
+           elapsed_ms(t1, t2) / std::max(elapsed_ms(t2, t3), 1e-3),
+           sortedDeleted == hashedDeleted ? "same" : "MISMATCH");
+}
+
+// the former binary stl reader: one fread per field of every facet
+static int read_stl_per_facet(MyMesh& mesh, const char* filename) {
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) return 1;
+    int facenum = 0;
+    fseek(fp, 80, SEEK_SET);
+    if (fread(&facenum, sizeof(int), 1, fp) != 1) { fclose(fp); return 1; }
+    auto fi = vcg::tri::Allocator<MyMesh>::AddFaces(mesh, facenum);
+    auto vi = vcg::tri::Allocator<MyMesh>::AddVertices(mesh, facenum * 3);
+    for (int i = 0; i < facenum; ++i, ++fi) {
+        unsigned short attr;
+        vcg::Point3f norm, tri[3];
+        size_t ok = fread(&norm, sizeof(vcg::Point3f), 1, fp);
+        ok += fread(&tri, sizeof(vcg::Point3f), 3, fp);
+        ok += fread(&attr, sizeof(unsigned short), 1, fp);
+        if (ok != 5) { fclose(fp); return 1; }
+        for (int k = 0; k < 3; ++k, ++vi) {
+            vi->P().Import(tri[k]);
+            fi->V(k) = &*vi;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static void bench_stl_import(int subdiv) {
+    const std::string path = "./benchmark/benchmark_out/import.stl";
+    {
+        MyMesh sphere;
+        vcg::tri::Sphere(sphere, subdiv);
+        vcg::tri::io::ExporterSTL<MyMesh>::Save(sphere, path.c_str(), true);
+    }
+
+    MyMesh mapped;
+    int mask = 0;
+    int sequentialFN;
+    clock_t_::time_point t1, t2;
+    {   // released before the second import so both start from the same heap
+        MyMesh sequential;
+        t1 = clock_t_::now();
+        read_stl_per_facet(sequential, path.c_str());
+        t2 = clock_t_::now();
+        sequentialFN = sequential.FN();
+    }
+    auto t3 = clock_t_::now();
+    vcg::tri::io::ImporterSTL<MyMesh>::Open(mapped, path.c_str(), mask);
+    auto t4 = clock_t_::now();
+    const double mb = (84. + 50. * mapped.FN()) / (1 << 20);
+
+    printf("stl faces %9d threads %3d fread %10.2f ms ImporterSTL %10.2f ms (%8.1f MB/s) speedup %6.2fx %s\n",
+           mapped.FN(), num_threads(), elapsed_ms(t1, t2), elapsed_ms(t3, t4),
+           mb / std::max(elapsed_ms(t3, t4), 1e-3) * 1000.,
+           elapsed_ms(t1, t2) / std::max(elapsed_ms(t3, t4), 1e-3),
+           sequentialFN == mapped.FN() ? "same" : "MISMATCH");
+    std::remove(path.c_str());
+}
+
+// resets the peak resident memory of the process, linux only
+static void reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+}
+
+// peak resident memory since reset_peak_rss(), or since the start where it cannot be reset
+static unsigned long long peak_rss() {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);)
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::stoull(line.substr(6)) * 1024;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (unsigned long long) usage.ru_maxrss * 1024;
+}
+
+// one json line per mesh: the time and throughput of every stage of
+// check_repair() from a binary stl on disk, and the peak memory it took
+static void bench_scaling_run(std::ofstream& report, const std::string& name,
+                              unsigned long long n_triangles, const generator::defects_t& defects) {
+    const std::string path = "./benchmark/benchmark_out/scaling.stl";
+    const std::string repaired_path = "./benchmark/benchmark_out/scaling_repaired.stl";
+
+    util::stageTimes_t times;
+    {
+        MyMesh mesh;
+        auto t1 = clock_t_::now();
+        generator::make_torus(mesh, n_triangles, defects);
+        auto t2 = clock_t_::now();
+        exportMesh(mesh, path);
+        auto t3 = clock_t_::now();
+        n_triangles = mesh.FN();
+        times.push_back(std::make_pair("generate", elapsed_ms(t1, t2)));
+        times.push_back(std::make_pair("export", elapsed_ms(t2, t3)));
+    }
+
+    reset_peak_rss();
+    json_t check_report;
+    auto t1 = clock_t_::now();
+    check_repair(path, repaired_path, check_report, &times);
+    auto t2 = clock_t_::now();
+    times.push_back(std::make_pair("check_repair", elapsed_ms(t1, t2)));
+    const auto peak = peak_rss();
+
+    json_t stages = json_t::object();
+    for (auto& t : times) {
+        stages[t.first]["ms"] = t.second;
+        stages[t.first]["triangles_per_s"] = n_triangles / std::max(t.second, 1e-3) * 1000.;
+    }
+
+    json_t line;
+    line["mesh"] = name;
+    line["triangles"] = n_triangles;
+    line["threads"] = num_threads();
+    line["defects"] = {
+        {"holes", defects.holes},
+        {"flipped_patches", defects.flipped_patches},
+        {"duplicates", defects.duplicates},
+        {"self_intersections", defects.self_intersections},
+        {"non_manifold_edges", defects.non_manifold_edges},
+    };
+    line["file_bytes"] = 84 + 50 * n_triangles;
+    line["peak_rss_bytes"] = peak;
+    line["is_good_mesh"] = check_report.value("is_good_mesh", false);
+    line["stages"] = stages;
+    report << line.dump() << "\n";
+    report.flush();
+
+    printf("scaling %-9s faces %9llu check_repair %10.2f ms %12.0f faces/s peak rss %8llu MB\n",
+           name.c_str(), n_triangles, elapsed_ms(t1, t2),
+           n_triangles / std::max(elapsed_ms(t1, t2), 1e-3) * 1000., peak >> 20);
+
+    std::remove(path.c_str());
+    std::remove(repaired_path.c_str());
+}
+
+// the scaling curve from 10k up to max_triangles, a clean torus and one with
+// every kind of defect at each size
+static void bench_scaling(unsigned long long max_triangles, const std::string& report_path) {
+    std::ofstream report(report_path);
+
+    generator::defects_t defects;
+    defects.holes = 4;
+    defects.flipped_patches = 2;
+    defects.duplicates = 8;
+    defects.self_intersections = 2;
+    defects.non_manifold_edges = 2;
+
+    for (unsigned long long n : {10000ull, 30000ull, 100000ull, 300000ull, 1000000ull,
+                                 3000000ull, 10000000ull, 30000000ull, 50000000ull}) {
+        if (n > max_triangles)
+            break;
+        bench_scaling_run(report, "clean", n, generator::defects_t());
+        bench_scaling_run(report, "defective", n, defects);
+    }
+    printf("scaling report written to %s\n", report_path.c_str());
+}
+
+// the PEdge std::sort FaceFace() used to do against the counting sort it does now,
+// every link of a manifold or border edge must be the same
+static void bench_face_face(unsigned long long max_triangles) {
+    typedef vcg::tri::UpdateTopology<MyMesh> topology_t;
+    generator::defects_t defects;
+    defects.holes = 4;
+    defects.non_manifold_edges = 4;
+
+    for (unsigned long long n = 100000; n <= max_triangles; n *= 10) {
+        MyMesh mesh;
+        generator::make_torus(mesh, n, defects);
+
+        auto t1 = clock_t_::now();
+        {
+            std::vector<topology_t::PEdge> e;
+            topology_t::FillEdgeVector(mesh, e);
+            std::sort(e.begin(), e.end());
+            topology_t::FaceFaceFromSortedEdges(e);
+        }
+        auto t2 = clock_t_::now();
+        std::vector<std::pair<MyFace*, char>> sorted;
+        for (auto& f : mesh.face)
+            for (int j = 0; j < 3; ++j)
+                sorted.push_back(std::make_pair(f.FFp(j), (char) f.FFi(j)));
+
+        auto t3 = clock_t_::now();
+        topology_t::FaceFace(mesh);
+        auto t4 = clock_t_::now();
+
+        size_t k = 0, n_diff = 0;
+        for (auto& f : mesh.face)
+            for (int j = 0; j < 3; ++j, ++k)
+                if (vcg::face::IsManifold(f, j) && sorted[k] != std::make_pair(f.FFp(j), (char) f.FFi(j)))
+                    ++n_diff;
+
+        printf("faceface faces %9d threads %3d std::sort %10.2f ms counting %10.2f ms speedup %6.2fx %s\n",
+               mesh.FN(), num_threads(), elapsed_ms(t1, t2), elapsed_ms(t3, t4),
+               elapsed_ms(t1, t2) / std::max(elapsed_ms(t3, t4), 1e-3),
+               n_diff == 0 ? "same" : "MISMATCH");
+    }
+}
+
+// the links of a GridStaticPtr over the faces, sorted with std::sort and with the counting sort
+static void bench_grid(unsigned long long max_triangles) {
+    typedef vcg::GridStaticPtr<MyFace, MyMesh::ScalarType> grid_t;
+
+    for (unsigned long long n = 100000; n <= max_triangles; n *= 10) {
+        MyMesh mesh;
+        generator::make_torus(mesh, n, generator::defects_t());
+        vcg::tri::UpdateBounding<MyMesh>::Box(mesh);
+        vcg::Box3f bbox = mesh.bbox;
+        bbox.Offset(bbox.Diag() / mesh.FN());
+        vcg::Point3i siz;
+        vcg::BestDim((long long) mesh.FN(), bbox.Dim(), siz);
+
+        grid_t sorted, counted;
+        auto t1 = clock_t_::now();
+        sorted.SetSorted(mesh.face.begin(), mesh.face.end(), bbox, siz);
+        auto t2 = clock_t_::now();
+        counted.Set(mesh.face.begin(), mesh.face.end(), bbox, siz);
+        auto t3 = clock_t_::now();
+
+        // the same faces in every cell
+        bool same = sorted.links.size() == counted.links.size();
+        std::vector<MyFace*> a, b;
+        for (size_t c = 0; same && c + 1 < sorted.grid.size(); ++c) {
+            a.clear();
+            b.clear();
+            for (grid_t::Cell l = sorted.grid[c]; l != sorted.grid[c + 1]; ++l)
+                a.push_back(l->Elem());
+            for (grid_t::Cell l = counted.grid[c]; l != counted.grid[c + 1]; ++l)
+                b.push_back(l->Elem());
+            std::sort(a.begin(), a.end());
+            same = a == b;
+        }
+
+        printf("grid faces %9d threads %3d links %10zu std::sort %10.2f ms counting %10.2f ms speedup %6.2fx %s\n",
+               mesh.FN(), num_threads(), counted.links.size(), elapsed_ms(t1, t2), elapsed_ms(t2, t3),
+               elapsed_ms(t1, t2) / std::max(elapsed_ms(t2, t3), 1e-3), same ? "same" : "MISMATCH");
+    }
+}
+
+// loadMesh() and file_check() against the compact mesh on the same binary stl,
+// the peak memory is the point: the results must not change
+static void bench_indexed(unsigned long long max_triangles) {
+    const std::string path = "./benchmark/benchmark_out/indexed.stl";
+    generator::defects_t defects;
+    defects.holes = 4;
+    defects.flipped_patches = 2;
+    defects.duplicates = 8;
+    defects.self_intersections = 2;
+
+    for (unsigned long long n = 100000; n <= max_triangles; n *= 10) {
+        {
+            MyMesh mesh;
+            generator::make_torus(mesh, n, defects);
+            exportMesh(mesh, path);
+        }
+
+        json_t full, compact;
+        reset_peak_rss();
+        auto t1 = clock_t_::now();
+        {
+            MyMesh mesh;
+            loadMesh(mesh, path);
+            file_check(mesh).output_report(full);
+        }
+        auto t2 = clock_t_::now();
+        const auto full_peak = peak_rss();
+
+        reset_peak_rss();
+        auto t3 = clock_t_::now();
+        {
+            indexed::indexedMesh_t mesh;
+            indexed::load_indexed_mesh(mesh, path);
+            indexed::indexed_check(mesh).output_report(compact);
+        }
+        auto t4 = clock_t_::now();
+        const auto compact_peak = peak_rss();
+
+        printf("indexed faces %9llu MyMesh %10.2f ms peak %6llu MB indexed %10.2f ms peak %6llu MB %s\n",
+               n, elapsed_ms(t1, t2), full_peak >> 20, elapsed_ms(t3, t4), compact_peak >> 20,
+               full == compact ? "same" : "MISMATCH");
+    }
+    std::remove(path.c_str());
+}
+
+// every version of the geometry kernels on the compact arrays of a torus,
+// the plane test against the next 64 faces of each face, near ones on the torus
+static void bench_kernels(unsigned long long max_triangles) {
+    for (unsigned long long n = 100000; n <= max_triangles; n *= 10) {
+        indexed::indexedMesh_t m;
+        {
+            MyMesh mesh;
+            generator::make_torus(mesh, n, generator::defects_t());
+            indexed::from_mesh(m, mesh);
+        }
+        kernels::triangles_t t;
+        for (int k = 0; k < 3; ++k) {
+            t.coord[k] = m.coord[k].data();
+            t.corner[k] = m.corner[k].data();
+        }
+        t.n = m.FN();
+        const float* const coord[3] = {m.coord[0].data(), m.coord[1].data(), m.coord[2].data()};
+        std::vector<uint32_t> faces(64);
+        std::vector<unsigned char> keep(faces.size());
+
+        double area0 = 0;
+        for (int isa = kernels::isa_scalar; isa <= kernels::best_isa(); ++isa) {
+            const kernels::isa_t i = kernels::isa_t(isa);
+            auto t1 = clock_t_::now();
+            const double area = kernels::area(t, i);
+            auto t2 = clock_t_::now();
+            const double volume = kernels::signed_volume(t, i);
+            auto t3 = clock_t_::now();
+            float min[3], max[3];
+            kernels::bbox(coord, m.VN(), min, max, i);
+            auto t4 = clock_t_::now();
+            size_t n_cleared = 0;
+            for (uint32_t a = 0; a < t.n; ++a) {
+                for (size_t k = 0; k < faces.size(); ++k)
+                    faces[k] = uint32_t((a + 1 + k) % t.n);
+                std::fill(keep.begin(), keep.end(), 1);
+                kernels::plane_separated(t, a, faces.data(), faces.size(), keep.data(), i);
+                n_cleared += std::count(keep.begin(), keep.end(), 0);
+            }
+            auto t5 = clock_t_::now();
+            if (isa == kernels::isa_scalar)
+                area0 = area;
+
+            printf("kernels faces %9llu %-6s area %8.2f ms volume %8.2f ms bbox %8.2f ms plane %9.2f ms separated %5.1f%% %s\n",
+                   (unsigned long long) t.n, kernels::isa_name(i), elapsed_ms(t1, t2), elapsed_ms(t2, t3),
+                   elapsed_ms(t3, t4), elapsed_ms(t4, t5), 100. * n_cleared / (t.n * faces.size()),
+                   std::fabs(area - area0) <= 1e-9 * area0 && volume > 0 ? "same" : "MISMATCH");
+        }
+    }
+}
+
+// every pair of good faces whose boxes overlap, the candidates the broadphase hands over to
+// TestGoodFaceFaceIntersection(), tested with the float test and with the exact one
+static void bench_tritri(int subdiv) {
+    MyMesh mesh;
+    make_overlapping_spheres(mesh, subdiv);
+
+    const long long fn = (long long) mesh.face.size();
+    std::vector<char> good(fn);
+    vcg::Box3f bbox;
+    for (long long i = 0; i < fn; ++i) {
+        good[i] = Clean_t::GoodFace(&mesh.face[i]);
+        bbox.Add(mesh.face[i].cP(0));
+        bbox.Add(mesh.face[i].cP(1));
+        bbox.Add(mesh.face[i].cP(2));
+    }
+    auto box = [&](size_t i) {
+        vcg::Box3f b;
+        mesh.face[i].GetBBox(b);
+        return b;
+    };
+    util::faceGrid_t grid;
+    grid.build(bbox, fn, box, good);
+    const std::vector<util::facePair_t> pairs = util::self_pairs(grid, fn, box, good, [](uint32_t, uint32_t) { return true; });
+
+    std::vector<char> legacy(pairs.size()), robust(pairs.size());
+    auto t1 = clock_t_::now();
+    for (size_t k = 0; k < pairs.size(); ++k)
+        legacy[k] = Clean_t::TestGoodFaceFaceIntersectionFloat(&mesh.face[pairs[k].first], &mesh.face[pairs[k].second]);
+    auto t2 = clock_t_::now();
+    for (size_t k = 0; k < pairs.size(); ++k)
+        robust[k] = Clean_t::TestGoodFaceFaceIntersection(&mesh.face[pairs[k].first], &mesh.face[pairs[k].second]);
+    auto t3 = clock_t_::now();
+
+    size_t n_legacy = 0, n_robust = 0, n_differ = 0;
+    for (size_t k = 0; k < pairs.size(); ++k) {
+        n_legacy += legacy[k];
+        n_robust += robust[k];
+        n_differ += legacy[k] != robust[k];
+    }
+    printf("tritri faces %9lld candidates %10zu float %8.2f Mpairs/s exact %8.2f Mpairs/s speedup %6.2fx hits %zu %zu differ %zu\n",
+           fn, pairs.size(), pairs.size() / std::max(elapsed_ms(t1, t2), 1e-3) / 1e3,
+           pairs.size() / std::max(elapsed_ms(t2, t3), 1e-3) / 1e3,
+           elapsed_ms(t1, t2) / std::max(elapsed_ms(t2, t3), 1e-3), n_legacy, n_robust, n_differ);
+}
+
+// the bvh against the grid and the aabb tree on a torus: build, closest points to random
+// points near the surface, nearest hits of random rays and the self intersection broadphase.
+// The distances, the hits and the faces intersecting must not change
+static void bench_bvh(unsigned long long max_triangles) {
+    typedef vcg::GridStaticPtr<MyFace, MyMesh::ScalarType> grid_t;
+    typedef vcg::AABBBinaryTreeIndex<MyFace, MyMesh::ScalarType, vcg::EmptyClass> tree_t;
+    typedef vcg::BVHIndex<MyFace, MyMesh::ScalarType> bvh_t;
+    const int n_queries = 100000;
+
+    for (unsigned long long n = 100000; n <= max_triangles; n *= 10) {
+        generator::defects_t defects;
+        defects.self_intersections = 8;
+        MyMesh mesh;
+        generator::make_torus(mesh, n, defects);
+        vcg::tri::UpdateBounding<MyMesh>::Box(mesh);
+        // the distance to a face is measured with its normal
+        vcg::tri::UpdateNormal<MyMesh>::PerFaceNormalized(mesh);
+
+        grid_t grid;
+        tree_t tree;
+        bvh_t bvh;
+        auto t1 = clock_t_::now();
+        grid.Set(mesh.face.begin(), mesh.face.end());
+        auto t2 = clock_t_::now();
+        tree.Set(mesh.face.begin(), mesh.face.end());
+        auto t3 = clock_t_::now();
+        bvh.Set(mesh.face.begin(), mesh.face.end());
+        auto t4 = clock_t_::now();
+        printf("bvh faces %9d threads %3d build grid %10.2f ms aabb %10.2f ms bvh %10.2f ms nodes %zu\n",
+               mesh.FN(), num_threads(), elapsed_ms(t1, t2), elapsed_ms(t2, t3), elapsed_ms(t3, t4), bvh.NodeCount());
+
+        std::mt19937 rng(42);
+        vcg::Box3f box = mesh.bbox;
+        box.Offset(box.Diag() * 0.1f);
+        std::uniform_real_distribution<float> ux(box.min[0], box.max[0]), uy(box.min[1], box.max[1]), uz(box.min[2], box.max[2]);
+        std::normal_distribution<float> dir;
+        std::uniform_int_distribution<int> uf(0, mesh.FN() - 1);
+        std::uniform_real_distribution<float> ub(0, 1), near(-0.02f * box.Diag(), 0.02f * box.Diag());
+        std::vector<vcg::Point3f> points(n_queries);
+        std::vector<vcg::Ray3f> rays(n_queries);
+        for (int q = 0; q < n_queries; ++q) {
+            // around the surface, as the samples of a distance between meshes
+            const MyFace& f = mesh.face[uf(rng)];
+            float b1 = ub(rng), b2 = ub(rng);
+            if (b1 + b2 > 1) {
+                b1 = 1 - b1;
+                b2 = 1 - b2;
+            }
+            points[q] = f.cP(0) * (1 - b1 - b2) + f.cP(1) * b1 + f.cP(2) * b2 + vcg::Point3f(near(rng), near(rng), near(rng));
+            rays[q] = vcg::Ray3f(vcg::Point3f(ux(rng), uy(rng), uz(rng)), vcg::Point3f(dir(rng), dir(rng), dir(rng)));
+        }
+        const float max_dist = box.Diag();
+
+        std::vector<float> closest[3];
+        auto closest_run = [&](int k, std::function<MyFace*(const vcg::Point3f&, float&, vcg::Point3f&)> query) {
+            closest[k].resize(n_queries);
+            auto s = clock_t_::now();
+            for (int q = 0; q < n_queries; ++q) {
+                vcg::Point3f p;
+                query(points[q], closest[k][q], p);
+            }
+            return elapsed_ms(s, clock_t_::now());
+        };
+        const double c_grid = closest_run(0, [&](const vcg::Point3f& p, float& d, vcg::Point3f& c) {
+            return vcg::tri::GetClosestFaceBase(mesh, grid, p, max_dist, d, c); });
+        const double c_tree = closest_run(1, [&](const vcg::Point3f& p, float& d, vcg::Point3f& c) {
+            return vcg::tri::GetClosestFaceBase(mesh, tree, p, max_dist, d, c); });
+        const double c_bvh = closest_run(2, [&](const vcg::Point3f& p, float& d, vcg::Point3f& c) {
+            return vcg::tri::GetClosestFaceBase(mesh, bvh, p, max_dist, d, c); });
+        // the faces around an edge or a vertex give the same distance up to their rounding
+        bool same_closest = true;
+        for (int q = 0; q < n_queries; ++q)
+            for (int k = 0; k < 2; ++k)
+                same_closest = same_closest && std::abs(closest[k][q] - closest[2][q]) <= 1e-6f * max_dist;
+        printf("bvh faces %9d closest %d grid %10.2f ms aabb %10.2f ms bvh %10.2f ms speedup %6.2fx %6.2fx %s\n",
+               mesh.FN(), n_queries, c_grid, c_tree, c_bvh, c_grid / std::max(c_bvh, 1e-3), c_tree / std::max(c_bvh, 1e-3),
+               same_closest ? "same" : "MISMATCH");
+
+        std::vector<float> hits[3];
+        auto ray_run = [&](int k, std::function<MyFace*(const vcg::Ray3f&, float&)> query) {
+            hits[k].resize(n_queries);
+            auto s = clock_t_::now();
+            for (int q = 0; q < n_queries; ++q) {
+                float t;
+                hits[k][q] = query(rays[q], t) ? t : -1;
+            }
+            return elapsed_ms(s, clock_t_::now());
+        };
+        const double r_grid = ray_run(0, [&](const vcg::Ray3f& r, float& t) { return vcg::tri::DoRay(mesh, grid, r, max_dist, t); });
+        const double r_tree = ray_run(1, [&](const vcg::Ray3f& r, float& t) { return vcg::tri::DoRay(mesh, tree, r, max_dist, t); });
+        const double r_bvh = ray_run(2, [&](const vcg::Ray3f& r, float& t) { return vcg::tri::DoRay(mesh, bvh, r, max_dist, t); });
+        // the grid walks the cells from where the ray enters its box and misses some nearer hits
+        // of the rays starting outside, the trees agree with each other
+        int grid_differ = 0;
+        for (int q = 0; q < n_queries; ++q)
+            grid_differ += hits[0][q] != hits[2][q];
+        printf("bvh faces %9d rays %d grid %10.2f ms aabb %10.2f ms bvh %10.2f ms speedup %6.2fx %6.2fx grid differs on %d %s\n",
+               mesh.FN(), n_queries, r_grid, r_tree, r_bvh, r_grid / std::max(r_bvh, 1e-3), r_tree / std::max(r_bvh, 1e-3),
+               grid_differ, hits[1] == hits[2] ? "same" : "MISMATCH");
+
+        std::vector<MyFace*> by_grid, by_bvh;
+        auto t5 = clock_t_::now();
+        Clean_t::SelfIntersectionsParallel(mesh, by_grid);
+        auto t6 = clock_t_::now();
+        Clean_t::SelfIntersectionsParallel(mesh, by_bvh, bvh);
+        auto t7 = clock_t_::now();
+        printf("bvh faces %9d selfintersect grid %10.2f ms bvh %10.2f ms (+%.2f ms build) speedup %6.2fx faces %zu %s\n",
+               mesh.FN(), elapsed_ms(t5, t6), elapsed_ms(t6, t7), elapsed_ms(t3, t4),
+               elapsed_ms(t5, t6) / std::max(elapsed_ms(t6, t7) + elapsed_ms(t3, t4), 1e-3), by_bvh.size(),
+               by_grid == by_bvh ? "same" : "MISMATCH");
+    }
+}
+
+// the kd-tree on the vertices of a torus: built on one thread and on all, then the 16 nearest
+// and the neighbours within a radius of every vertex one query at a time and in a batch.
+// The trees and the neighbours must not change
+static void bench_knn(unsigned long long max_points) {
+    typedef vcg::KdTree<float> tree_t;
+    const int k = 16;
+
+    for (unsigned long long n = 100000; n <= max_points; n *= 10) {
+        MyMesh mesh;
+        generator::make_torus(mesh, 2 * n, generator::defects_t());
+        vcg::VertexConstDataWrapper<MyMesh> points(mesh);
+        const int vn = (int) mesh.vert.size();
+
+        const int threads = num_threads();
+        auto t1 = clock_t_::now();
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        tree_t serial(points);
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        auto t2 = clock_t_::now();
+        tree_t tree(points);
+        auto t3 = clock_t_::now();
+        printf("knn points %9d threads %3d build serial %10.2f ms parallel %10.2f ms nodes %zu %zu levels %u %u\n",
+               vn, threads, elapsed_ms(t1, t2), elapsed_ms(t2, t3), serial._getNodes().size(), tree._getNodes().size(),
+               serial._getNumLevel(), tree._getNumLevel());
+
+        // one query at a time as the algorithms do, the heap sorted to compare
+        std::vector<unsigned int> one_indices(size_t(vn) * k);
+        std::vector<float> one_dists(size_t(vn) * k);
+        auto t4 = clock_t_::now();
+        tree_t::PriorityQueue queue;
+        for (int i = 0; i < vn; ++i) {
+            tree.doQueryK(mesh.vert[i].cP(), k, queue);
+            queue.sort();
+            for (int e = 0; e < queue.getNofElements(); ++e) {
+                one_indices[size_t(i) * k + e] = queue.getIndex(e);
+                one_dists[size_t(i) * k + e] = queue.getWeight(e);
+            }
+        }
+        auto t5 = clock_t_::now();
+        std::vector<size_t> offsets;
+        std::vector<unsigned int> indices;
+        std::vector<float> dists;
+        tree.doQueryKBatch(points, k, offsets, indices, dists);
+        auto t6 = clock_t_::now();
+        printf("knn points %9d k %d doQueryK %10.2f ms doQueryKBatch %10.2f ms speedup %6.2fx %s\n",
+               vn, k, elapsed_ms(t4, t5), elapsed_ms(t5, t6), elapsed_ms(t4, t5) / std::max(elapsed_ms(t5, t6), 1e-3),
+               indices == one_indices && dists == one_dists ? "same" : "MISMATCH");
+
+        // the same queries in random order, as from a point cloud with no spatial order
+        std::vector<vcg::Point3f> shuffled(vn);
+        for (int i = 0; i < vn; ++i)
+            shuffled[i] = mesh.vert[i].cP();
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+        auto t12 = clock_t_::now();
+        for (int i = 0; i < vn; ++i) {
+            tree.doQueryK(shuffled[i], k, queue);
+            queue.sort();
+            for (int e = 0; e < queue.getNofElements(); ++e) {
+                one_indices[size_t(i) * k + e] = queue.getIndex(e);
+                one_dists[size_t(i) * k + e] = queue.getWeight(e);
+            }
+        }
+        auto t13 = clock_t_::now();
+        tree.doQueryKBatch(vcg::VectorConstDataWrapper<std::vector<vcg::Point3f> >(shuffled), k, offsets, indices, dists);
+        auto t14 = clock_t_::now();
+        printf("knn points %9d k %d shuffled doQueryK %10.2f ms doQueryKBatch %10.2f ms speedup %6.2fx %s\n",
+               vn, k, elapsed_ms(t12, t13), elapsed_ms(t13, t14), elapsed_ms(t12, t13) / std::max(elapsed_ms(t13, t14), 1e-3),
+               indices == one_indices && dists == one_dists ? "same" : "MISMATCH");
+
+        // about as many neighbours within the radius
+        float radius = 0;
+        for (int i = 0; i < vn; i += 97)
+            radius = std::max(radius, std::sqrt(one_dists[size_t(i) * k + k - 1]));
+        std::vector<size_t> one_offsets(1, 0);
+        one_indices.clear();
+        one_dists.clear();
+        auto t7 = clock_t_::now();
+        for (int i = 0; i < vn; ++i) {
+            tree.doQueryDist(mesh.vert[i].cP(), radius, one_indices, one_dists);
+            one_offsets.push_back(one_indices.size());
+        }
+        auto t8 = clock_t_::now();
+        tree.doQueryDistBatch(points, radius, offsets, indices, dists);
+        auto t9 = clock_t_::now();
+        printf("knn points %9d radius neighbours %zu doQueryDist %10.2f ms doQueryDistBatch %10.2f ms speedup %6.2fx %s\n",
+               vn, indices.size(), elapsed_ms(t7, t8), elapsed_ms(t8, t9), elapsed_ms(t7, t8) / std::max(elapsed_ms(t8, t9), 1e-3),
+               offsets == one_offsets && indices == one_indices && dists == one_dists ? "same" : "MISMATCH");
+
+        auto t10 = clock_t_::now();
+        vcg::tri::PointCloudNormal<MyMesh>::ComputeUndirectedNormal(mesh, 10, radius * 4, tree);
+        auto t11 = clock_t_::now();
+        printf("knn points %9d ComputeUndirectedNormal %10.2f ms\n", vn, elapsed_ms(t10, t11));
+    }
+}
+
+// distance of a damaged torus from the clean one, as of an original mesh from its repair, with the
+// same montecarlo samples: one query at a time on the grid, then on the bvh with one and all threads
+static void bench_hausdorff(unsigned long long max_triangles) {
+    typedef vcg::tri::HausdorffSampler<MyMesh> serial_t;
+    typedef vcg::tri::ParallelHausdorffSampler<MyMesh> parallel_t;
+    typedef vcg::tri::SurfaceSampling<MyMesh, serial_t> serial_sampling_t;
+    typedef vcg::tri::SurfaceSampling<MyMesh, parallel_t> parallel_sampling_t;
+    const unsigned int seed = 42;
+
+    for (unsigned long long n = 100000; n <= max_triangles; n *= 10) {
+        MyMesh original, repaired;
+        generator::defects_t defects;
+        defects.holes = 16;
+        defects.self_intersections = 64;
+        generator::make_torus(original, n, defects);
+        generator::make_torus(repaired, n);
+        vcg::tri::UpdateBounding<MyMesh>::Box(repaired);
+        vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalized(original);
+        const int samples = int(n) * 4;
+
+        auto t1 = clock_t_::now();
+        serial_t serial(&repaired);
+        serial.dist_upper_bound = repaired.bbox.Diag();
+        serial_sampling_t::SamplingRandomGenerator().initialize(seed);
+        serial_sampling_t::Montecarlo(original, serial, samples);
+        auto t2 = clock_t_::now();
+        parallel_t one(&repaired);
+        one.threads = 1;
+        one.dist_upper_bound = repaired.bbox.Diag();
+        parallel_sampling_t::SamplingRandomGenerator().initialize(seed);
+        parallel_sampling_t::Montecarlo(original, one, samples);
+        one.Compute();
+        auto t3 = clock_t_::now();
+        parallel_t all(&repaired);
+        all.threads = num_threads();
+        all.dist_upper_bound = repaired.bbox.Diag();
+        parallel_sampling_t::SamplingRandomGenerator().initialize(seed);
+        parallel_sampling_t::Montecarlo(original, all, samples);
+        all.Compute();
+        auto t4 = clock_t_::now();
+
+        // the thread count must not change anything. The grid may pick another of the faces at
+        // the same distance from a sample, measured with other rounding, so its sums are only close
+        bool same = one.stats.n == all.stats.n && one.stats.max_dist == all.stats.max_dist &&
+                    one.stats.min_dist == all.stats.min_dist && one.stats.sum_dist == all.stats.sum_dist &&
+                    one.stats.sqr_sum_dist == all.stats.sqr_sum_dist;
+        bool close = int(one.stats.n) == serial.n_total_samples && one.getMaxDist() == serial.getMaxDist() &&
+                     std::fabs(one.getMeanDist() - serial.getMeanDist()) <= 1e-6 * serial.getMaxDist() &&
+                     std::fabs(one.getRMSDist() - serial.getRMSDist()) <= 1e-6 * serial.getMaxDist();
+        for (int b = 0; b < one.hist.BinNum() + 2; ++b) {
+            same = same && one.hist.BinCountInd(b) == all.hist.BinCountInd(b);
+            close = close && one.hist.BinCountInd(b) == serial.hist.BinCountInd(b);
+        }
+        printf("hausdorff faces %9d samples %9d max %.6g mean %.6g rms %.6g\n", original.FN(), int(one.stats.n),
+               one.getMaxDist(), one.getMeanDist(), one.getRMSDist());
+        printf("hausdorff faces %9d threads %3d grid %10.2f ms bvh 1 thread %10.2f ms bvh %10.2f ms speedup %6.2fx %6.2fx %s %s\n",
+               original.FN(), all.threads, elapsed_ms(t1, t2), elapsed_ms(t2, t3), elapsed_ms(t3, t4),
+               elapsed_ms(t1, t2) / std::max(elapsed_ms(t2, t3), 1e-3), elapsed_ms(t1, t2) / std::max(elapsed_ms(t3, t4), 1e-3),
+               same ? "same" : "MISMATCH", close ? "close" : "FAR");
+    }
+}
+
+// resident memory of the process now, linux only
+static unsigned long long current_rss() {
+    std::ifstream statm("/proc/self/statm");
+    unsigned long long pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * (unsigned long long) sysconf(_SC_PAGESIZE);
+}
+
+// check_repair() of n_jobs meshes of mixed sizes the way a batch worker runs them, with every
+// allocation of the mesh containers and of the scratch vectors going to malloc, then from a
+// pooled arena reset between the jobs
+static void bench_arena(unsigned long long n_jobs, unsigned long long max_triangles) {
+    generator::defects_t defects;
+    defects.holes = 4;
+    defects.flipped_patches = 2;
+    defects.duplicates = 8;
+
+    std::vector<std::string> paths;
+    for (unsigned long long n = max_triangles / 8; n <= max_triangles; n *= 2) {
+        MyMesh mesh;
+        generator::make_torus(mesh, n, defects);
+        paths.push_back("./benchmark/benchmark_out/arena_" + std::to_string(paths.size()) + ".stl");
+        exportMesh(mesh, paths.back());
+    }
+    const std::string repaired_path = "./benchmark/benchmark_out/arena_repaired.stl";
+
+    for (bool pooled : {false, true}) {
+        util::arena_t arena(pooled, 128ull << 20);
+        reset_peak_rss();
+        auto t1 = clock_t_::now();
+        unsigned long long max_peak_bytes = 0;
+        for (unsigned long long j = 0; j < n_jobs; ++j) {
+            json_t report;
+            {
+                util::arenaScope_t scope(&arena);
+                check_repair(paths[(j * 7) % paths.size()], repaired_path, report);
+            }
+            max_peak_bytes = std::max(max_peak_bytes, arena.stats().peak_bytes);
+            arena.reset();
+        }
+        auto t2 = clock_t_::now();
+        const util::arenaStats_t s = arena.stats();
+        printf("arena %-8s jobs %4llu time %9.2f ms allocations %8llu from malloc %8llu job peak %6llu MB cached %6llu MB rss %6llu MB peak rss %6llu MB\n",
+               pooled ? "pooled" : "unpooled", n_jobs, elapsed_ms(t1, t2), s.allocations, s.system_allocations,
+               max_peak_bytes >> 20, s.bytes_cached >> 20, current_rss() >> 20, peak_rss() >> 20);
+    }
+
+    for (auto& path : paths)
+        std::remove(path.c_str());
+    std::remove(repaired_path.c_str());
+}
+
+int main(int argc, char* argv[]) {
+    std::string what = "all";
+    if (argc >= 2)
+        what = argv[1];
+
+    // scaling [max triangles] [report.jsonl], up to 50M triangles
+    if (what == "scaling") {
+        bench_scaling(argc >= 3 ? std::atoll(argv[2]) : 1000000,
+                      argc >= 4 ? argv[3] : "./benchmark/benchmark_out/scaling.jsonl");
+        return 0;
+    }
+
+    // faceface [max triangles], the edge sort of the topology
+    if (what == "faceface") {
+        bench_face_face(argc >= 3 ? std::atoll(argv[2]) : 10000000);
+        return 0;
+    }
+
+    // grid [max triangles], the build of GridStaticPtr
+    if (what == "grid") {
+        bench_grid(argc >= 3 ? std::atoll(argv[2]) : 10000000);
+        return 0;
+    }
+
+    // indexed [max triangles], MyMesh against the compact mesh
+    if (what == "indexed") {
+        bench_indexed(argc >= 3 ? std::atoll(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // kernels [max triangles], the scalar and the simd versions of the geometry kernels
+    if (what == "kernels") {
+        bench_kernels(argc >= 3 ? std::atoll(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // tritri [max subdiv], the narrow phase of the self intersections on the broadphase candidates
+    if (what == "tritri") {
+        const int max_subdiv = argc >= 3 ? std::atoi(argv[2]) : 8;
+        for (int subdiv = 5; subdiv <= max_subdiv; ++subdiv)
+            bench_tritri(subdiv);
+        return 0;
+    }
+
+    // bvh [max triangles], the bvh against the grid and the aabb tree
+    if (what == "bvh") {
+        bench_bvh(argc >= 3 ? std::atoll(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // knn [max points], the kd-tree queries one at a time and in batches
+    if (what == "knn") {
+        bench_knn(argc >= 3 ? std::atoll(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // hausdorff [max triangles], the sampled distance of two meshes, serial and parallel
+    if (what == "hausdorff") {
+        bench_hausdorff(argc >= 3 ? std::atoll(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // arena [jobs] [max triangles], check_repair() of a stream of meshes with and without the pool
+    if (what == "arena") {
+        bench_arena(argc >= 3 ? std::atoll(argv[2]) : 32, argc >= 4 ? std::atoll(argv[3]) : 1000000);
+        return 0;
+    }
+
+    int max_subdiv = 7; // 20 * 4^7 = 327680 faces
+    if (argc >= 3)
+        max_subdiv = std::atoi(argv[2]);
+
+    // self intersections from 10 * 4^7 ~ 160k, the first size above 100k, up to 10 * 4^11 ~ 20M faces
+    for (int subdiv = 4; subdiv <= max_subdiv; ++subdiv) {
+        if (what == "all" || what == "compact")
+            bench_compact(subdiv);
+        if (what == "all" || what == "weld")
+            bench_weld(subdiv);
+        if (what == "all" || what == "stl")
+            bench_stl_import(subdiv);
+        if (subdiv >= 7 && (what == "all" || what == "selfintersect"))
+            bench_self_intersections(subdiv);
+    }
+    if (what == "all")
+        bench_scaling(1000000, "./benchmark/benchmark_out/scaling.jsonl");
+
+    return 0;
+}
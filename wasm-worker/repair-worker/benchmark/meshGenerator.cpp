@@ -0,0 +1,180 @@
+#include "meshGenerator.hpp"
+
+#include <cmath>
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#endif
+
+namespace generator{
+
+typedef MyMesh::CoordType coord_t;
+
+// n rings around the axis of m vertices each, cell (i, j) is the quad from ring i
+// to ring i+1 and from vertex j to vertex j+1, split in two faces
+struct grid_t {
+    size_t n, m;
+    size_t vertex(size_t i, size_t j) const { return (i % n) * m + (j % m); }
+    size_t face(size_t i, size_t j) const { return 2 * vertex(i, j); }
+};
+
+void make_torus(MyMesh& mesh, unsigned long long n_triangles, const defects_t& defects) {
+    mesh.Clear();
+
+    // a ring four times longer than the tube keeps the cells about square
+    grid_t g;
+    g.m = std::max<size_t>(8, (size_t) std::sqrt(n_triangles / 8.));
+    g.n = std::max<size_t>(8, (size_t) (n_triangles / (2 * g.m)));
+
+    // every defect gets its own band of rings, the next one starts a few rings later
+    const size_t band = defects.total() ? g.n / defects.total() : g.n;
+    if (band < 5)
+        throw std::invalid_argument("too many defects for " + std::to_string(n_triangles) + " triangles");
+
+    // edges about one unit long keep the faces well above the GoodFace() area threshold
+    const double R = g.n / (2 * M_PI), r = g.m / (2 * M_PI);
+    auto position = [&](double i, double j) {
+        const double u = 2 * M_PI * i / g.n, v = 2 * M_PI * j / g.m;
+        return coord_t((R + r * cos(v)) * cos(u), (R + r * cos(v)) * sin(u), r * sin(v));
+    };
+    auto normal = [&](double i, double j) {
+        const double u = 2 * M_PI * i / g.n, v = 2 * M_PI * j / g.m;
+        return coord_t(cos(v) * cos(u), cos(v) * sin(u), sin(v));
+    };
+
+    const size_t n_vert = g.n * g.m + 4 * defects.self_intersections + defects.non_manifold_edges;
+    const size_t n_face = 2 * g.n * g.m + defects.duplicates + 4 * defects.self_intersections + defects.non_manifold_edges;
+    vcg::tri::Allocator<MyMesh>::AddVertices(mesh, n_vert);
+    vcg::tri::Allocator<MyMesh>::AddFaces(mesh, n_face);
+
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < (long long) g.n; ++i) {
+        for (size_t j = 0; j < g.m; ++j) {
+            mesh.vert[g.vertex(i, j)].P() = position(i, j);
+
+            MyVertex* a = &mesh.vert[g.vertex(i, j)];
+            MyVertex* b = &mesh.vert[g.vertex(i + 1, j)];
+            MyVertex* c = &mesh.vert[g.vertex(i + 1, j + 1)];
+            MyVertex* d = &mesh.vert[g.vertex(i, j + 1)];
+            MyFace& f0 = mesh.face[g.face(i, j)];
+            MyFace& f1 = mesh.face[g.face(i, j) + 1];
+            f0.V(0) = a; f0.V(1) = b; f0.V(2) = c;
+            f1.V(0) = a; f1.V(1) = c; f1.V(2) = d;
+        }
+    }
+
+    size_t next_vert = g.n * g.m, next_face = 2 * g.n * g.m;
+    auto add_vertex = [&](const coord_t& p) {
+        mesh.vert[next_vert].P() = p;
+        return &mesh.vert[next_vert++];
+    };
+    auto add_face = [&](MyVertex* a, MyVertex* b, MyVertex* c) {
+        MyFace& f = mesh.face[next_face++];
+        f.V(0) = a; f.V(1) = b; f.V(2) = c;
+    };
+
+    // defects start at ring 1 and vertex 1, away from the seams of the grid
+    size_t slot = 0;
+    for (unsigned int k = 0; k < defects.holes; ++k, ++slot) {
+        const size_t i0 = slot * band + 1;
+        for (size_t i = i0; i < i0 + 2; ++i)
+            for (size_t j = 1; j < 3; ++j) {
+                vcg::tri::Allocator<MyMesh>::DeleteFace(mesh, mesh.face[g.face(i, j)]);
+                vcg::tri::Allocator<MyMesh>::DeleteFace(mesh, mesh.face[g.face(i, j) + 1]);
+            }
+        vcg::tri::Allocator<MyMesh>::DeleteVertex(mesh, mesh.vert[g.vertex(i0 + 1, 2)]);
+    }
+    for (unsigned int k = 0; k < defects.flipped_patches; ++k, ++slot) {
+        const size_t i0 = slot * band + 1;
+        for (size_t i = i0; i < i0 + 3; ++i)
+            for (size_t j = 1; j < 4; ++j)
+                for (size_t f = g.face(i, j); f < g.face(i, j) + 2; ++f)
+                    std::swap(mesh.face[f].V(1), mesh.face[f].V(2));
+    }
+    for (unsigned int k = 0; k < defects.duplicates; ++k, ++slot) {
+        MyFace& f = mesh.face[g.face(slot * band + 1, 1)];
+        add_face(f.V(0), f.V(1), f.V(2));
+    }
+    for (unsigned int k = 0; k < defects.self_intersections; ++k, ++slot) {
+        // centered on the middle of a cell, half of it below the surface
+        const double i = slot * band + 1.5, j = 1.5;
+        const coord_t p = position(i, j), nz = normal(i, j);
+        const coord_t tu = (position(i + 0.5, j) - position(i - 0.5, j)).Normalize();
+        const coord_t tv = nz ^ tu;
+        MyVertex* apex = add_vertex(p + nz * 0.6f);
+        MyVertex* base[3];
+        for (int t = 0; t < 3; ++t) {
+            const float angle = float(2 * M_PI * t / 3);
+            base[t] = add_vertex(p - nz * 0.6f + (tu * cos(angle) + tv * sin(angle)) * 0.5f);
+        }
+        add_face(base[0], base[2], base[1]);
+        for (int t = 0; t < 3; ++t)
+            add_face(base[t], base[(t + 1) % 3], apex);
+    }
+    for (unsigned int k = 0; k < defects.non_manifold_edges; ++k, ++slot) {
+        const size_t i0 = slot * band + 1;
+        MyVertex* a = &mesh.vert[g.vertex(i0, 1)];
+        MyVertex* b = &mesh.vert[g.vertex(i0 + 1, 1)];
+        add_face(a, b, add_vertex((a->P() + b->P()) * 0.5f + normal(i0 + 0.5, 1) * 0.8f));
+    }
+
+    assert(next_vert == mesh.vert.size() && next_face == mesh.face.size());
+    if (defects.holes)
+        vcg::tri::Allocator<MyMesh>::CompactEveryVector(mesh);
+}
+
+#ifdef FILECHECK_TEST
+TEST_CASE( "test generated torus", "[util]" ) {
+    MyMesh mesh;
+    make_torus(mesh, 10000);
+    REQUIRE( std::abs(mesh.FN() - 10000) < 300 );
+    auto r = file_check(mesh);
+    REQUIRE( r.is_good_mesh == true );
+    REQUIRE( r.n_shells == 1 );
+    REQUIRE( r.n_intersecting_faces == 0 );
+}
+
+TEST_CASE( "test generated torus defects", "[util]" ) {
+    defects_t holes;
+    holes.holes = 3;
+    MyMesh mesh;
+    make_torus(mesh, 10000, holes);
+    auto r = file_check(mesh);
+    REQUIRE( r.n_holes == 3 );
+    REQUIRE( r.is_coherently_oriented == true );
+
+    defects_t flipped;
+    flipped.flipped_patches = 2;
+    make_torus(mesh, 10000, flipped);
+    r = file_check(mesh);
+    REQUIRE( r.is_watertight == true );
+    REQUIRE( r.is_coherently_oriented == false );
+
+    defects_t duplicates;
+    duplicates.duplicates = 4;
+    make_torus(mesh, 10000, duplicates);
+    r = file_check(mesh);
+    REQUIRE( r.n_duplicate_faces == 4 );
+    REQUIRE( r.is_good_mesh == true );
+
+    defects_t intersections;
+    intersections.self_intersections = 2;
+    make_torus(mesh, 10000, intersections);
+    r = file_check(mesh);
+    REQUIRE( r.n_shells == 3 );
+    REQUIRE( r.n_intersecting_faces > 0 );
+    REQUIRE( r.is_watertight == true );
+
+    defects_t fins;
+    fins.non_manifold_edges = 5;
+    make_torus(mesh, 10000, fins);
+    r = file_check(mesh);
+    REQUIRE( r.n_non_manifold_edges == 5 );
+
+    defects_t crowded;
+    crowded.holes = 100;
+    REQUIRE_THROWS_AS( make_torus(mesh, 10000, crowded), std::invalid_argument );
+}
+#endif
+
+}
@@ -0,0 +1,28 @@
+#ifndef MESH_GENERATOR_HPP
+#define MESH_GENERATOR_HPP
+
+#include "fileCheck.hpp"
+
+// Procedural meshes for the benchmarks: a closed, coherently oriented torus of
+// any size with a controlled number of defects, each at its own place.
+namespace generator{
+
+struct defects_t {
+    unsigned int holes = 0;               // 2x2 grid cells removed, one boundary loop each
+    unsigned int flipped_patches = 0;     // 3x3 grid cells with the opposite orientation
+    unsigned int duplicates = 0;          // faces added a second time
+    unsigned int self_intersections = 0;  // small closed tetrahedra through the surface
+    unsigned int non_manifold_edges = 0;  // fins on an edge, three faces on it
+
+    unsigned int total() const {
+        return holes + flipped_patches + duplicates + self_intersections + non_manifold_edges;
+    }
+};
+
+// builds about n_triangles faces with welded vertices, the way loadMesh() leaves them.
+// throws std::invalid_argument when the torus is too small to keep the defects apart
+void make_torus(MyMesh& mesh, unsigned long long n_triangles, const defects_t& defects = defects_t());
+
+}
+
+#endif
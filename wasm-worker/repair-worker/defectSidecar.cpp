@@ -0,0 +1,192 @@
+#include "defectSidecar.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include "benchmark/meshGenerator.hpp"
+#endif
+
+namespace sidecar{
+
+static const char sidecar_magic[4] = {'F', 'C', 'D', 'S'};
+static const size_t header_words = 8;
+
+void collect_defects(MyMesh & m, const std::vector<util::facePair_t>& pairs, defectGeometry_t& d) {
+    d.n_faces = (uint32_t) m.face.size();
+
+    d.intersecting_faces.clear();
+    d.intersecting_faces.reserve(2 * pairs.size());
+    for (auto& p : pairs) {
+        d.intersecting_faces.push_back(p.first);
+        d.intersecting_faces.push_back(p.second);
+    }
+    std::sort(d.intersecting_faces.begin(), d.intersecting_faces.end());
+    d.intersecting_faces.erase(
+        std::unique(d.intersecting_faces.begin(), d.intersecting_faces.end()), d.intersecting_faces.end());
+
+    // the edges NumNonManifoldEdges() counts, from the first face of their ring
+    d.non_manifold_edges.clear();
+    for (auto fi = m.face.begin(); fi != m.face.end(); ++fi) if (!fi->IsD()) {
+        for (int i = 0; i < 3; ++i) {
+            if (vcg::face::IsManifold(*fi, i))
+                continue;
+            bool isFirst = true;
+            vcg::face::Pos<MyFace> nmf(&*fi, i);
+            do {
+                if (nmf.F() < &*fi) {
+                    isFirst = false;
+                    break;
+                }
+                nmf.NextF();
+            } while (nmf.F() != &*fi);
+            if (isFirst) {
+                const uint32_t f = (uint32_t) vcg::tri::Index(m, &*fi);
+                d.non_manifold_edges.push_back(3 * f + i);
+                d.non_manifold_edges.push_back(3 * f + (i + 1) % 3);
+            }
+        }
+    }
+
+    // the loops CountHoles() walks, a face is visited once
+    d.loop_offsets.assign(1, 0);
+    d.loop_corners.clear();
+    if (!d.non_manifold_edges.empty())
+        return;
+    CountHoles(m, nullptr, nullptr, &d.loop_corners, &d.loop_offsets);
+}
+
+static bool write_words(FILE* file, const std::vector<uint32_t>& words) {
+    return words.empty() || fwrite(words.data(), sizeof(uint32_t), words.size(), file) == words.size();
+}
+
+bool write_defects(const std::string path, const defectGeometry_t& d) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    uint32_t header[header_words] = {
+        0, sidecar_version, d.n_faces,
+        (uint32_t) d.intersecting_faces.size(),
+        (uint32_t) d.non_manifold_edges.size() / 2,
+        (uint32_t) d.loop_offsets.size() - 1,
+        (uint32_t) d.loop_corners.size(),
+        0
+    };
+    memcpy(&header[0], sidecar_magic, 4);
+
+    // the arrays go out as they are, on the little endian hosts we build for
+    bool ok = fwrite(header, sizeof(uint32_t), header_words, file) == header_words
+        && write_words(file, d.intersecting_faces)
+        && write_words(file, d.non_manifold_edges)
+        && write_words(file, d.loop_offsets)
+        && write_words(file, d.loop_corners);
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+static void read_words(FILE* file, std::vector<uint32_t>& words, size_t n) {
+    words.resize(n);
+    if (n > 0 && fread(words.data(), sizeof(uint32_t), n, file) != n)
+        throw std::runtime_error("truncated defect sidecar");
+}
+
+defectGeometry_t read_defects(const std::string path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        throw std::runtime_error("cannot open " + path);
+
+    defectGeometry_t d;
+    uint32_t header[header_words];
+    try {
+        if (fread(header, sizeof(uint32_t), header_words, file) != header_words
+                || memcmp(&header[0], sidecar_magic, 4) != 0 || header[1] != sidecar_version)
+            throw std::runtime_error("not a defect sidecar " + path);
+        d.n_faces = header[2];
+        read_words(file, d.intersecting_faces, header[3]);
+        read_words(file, d.non_manifold_edges, 2 * (size_t) header[4]);
+        read_words(file, d.loop_offsets, (size_t) header[5] + 1);
+        read_words(file, d.loop_corners, header[6]);
+    } catch (...) {
+        fclose(file);
+        throw;
+    }
+    fclose(file);
+    return d;
+}
+
+#ifdef FILECHECK_TEST
+static vcg::Point3f corner(MyMesh& m, uint32_t c) {
+    return m.face[c / 3].cP(c % 3);
+}
+
+TEST_CASE( "test defect sidecar", "[file_check]" ) {
+    const std::string path = "./unittest/unittest_out/defects.bin";
+
+    generator::defects_t defects;
+    defects.holes = 3;
+    defects.self_intersections = 2;
+    MyMesh mesh;
+    generator::make_torus(mesh, 20000, defects);
+
+    checkState_t state;
+    checkResult_t r = file_check(mesh, true, nullptr, &state);
+    defectGeometry_t d;
+    collect_defects(mesh, state.intersecting, d);
+    REQUIRE( write_defects(path, d) );
+
+    defectGeometry_t back = read_defects(path);
+    REQUIRE( back.n_faces == mesh.face.size() );
+    REQUIRE( back.intersecting_faces == d.intersecting_faces );
+    REQUIRE( back.loop_offsets == d.loop_offsets );
+    REQUIRE( back.loop_corners == d.loop_corners );
+    REQUIRE( back.non_manifold_edges.empty() );
+
+    FILE* file = fopen(path.c_str(), "rb");
+    fseek(file, 0, SEEK_END);
+    REQUIRE( (size_t) ftell(file) == 4 * (header_words + d.intersecting_faces.size() + d.loop_offsets.size() + d.loop_corners.size()) );
+    fclose(file);
+
+    REQUIRE( !d.intersecting_faces.empty() );
+    for (auto f : d.intersecting_faces)
+        REQUIRE( f < mesh.face.size() );
+    REQUIRE( back.loop_offsets.size() - 1 == r.n_holes );
+
+    // consecutive corners of a loop are the ends of a border edge of the face of the second one,
+    // a 2x2 hole has 8 of them
+    for (size_t k = 0; k + 1 < d.loop_offsets.size(); ++k) {
+        REQUIRE( d.loop_offsets[k + 1] - d.loop_offsets[k] == 8 );
+        for (uint32_t c = d.loop_offsets[k]; c < d.loop_offsets[k + 1]; ++c) {
+            const uint32_t next = c + 1 < d.loop_offsets[k + 1] ? c + 1 : d.loop_offsets[k];
+            const MyFace& f = mesh.face[d.loop_corners[next] / 3];
+            bool edge = false;
+            for (int z = 0; z < 3; ++z)
+                edge = edge || (vcg::face::IsBorder(f, z) && f.cP(z) == corner(mesh, d.loop_corners[c])
+                    && f.cP((z + 1) % 3) == corner(mesh, d.loop_corners[next]))
+                    || (vcg::face::IsBorder(f, z) && f.cP((z + 1) % 3) == corner(mesh, d.loop_corners[c])
+                    && f.cP(z) == corner(mesh, d.loop_corners[next]));
+            REQUIRE( edge );
+        }
+    }
+
+    // the non manifold edges, then no loops
+    generator::defects_t fins;
+    fins.non_manifold_edges = 2;
+    MyMesh finned;
+    generator::make_torus(finned, 20000, fins);
+    r = file_check(finned, true, nullptr, &state);
+    collect_defects(finned, state.intersecting, d);
+    REQUIRE( d.non_manifold_edges.size() == 2 * r.n_non_manifold_edges );
+    REQUIRE( d.loop_offsets.size() == 1 );
+    for (size_t k = 0; k < d.non_manifold_edges.size(); k += 2) {
+        const uint32_t a = d.non_manifold_edges[k], b = d.non_manifold_edges[k + 1];
+        REQUIRE( a / 3 == b / 3 );
+        REQUIRE( !vcg::face::IsManifold(finned.face[a / 3], a % 3) );
+    }
+
+    REQUIRE_THROWS_AS( read_defects("./unittest/unittest_out/missing.bin"), std::runtime_error );
+}
+#endif
+
+}
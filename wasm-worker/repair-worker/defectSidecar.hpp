@@ -0,0 +1,51 @@
+#ifndef DEFECT_SIDECAR_HPP
+#define DEFECT_SIDECAR_HPP
+
+#include "fileCheck.hpp"
+
+#include <cstdint>
+
+// Where the defects of a checked mesh are, for a viewer to highlight them.
+//
+// Faces are referred to by their index in the file, the index they have in mesh.face
+// from loadMesh() to the end of file_check(). A vertex is referred to as a corner,
+// 3 * face + z for the vertex z of the face, that is its place in the vertex buffer
+// of an unindexed triangle list and in the index buffer of an indexed one.
+//
+// The sidecar file is little endian uint32 only, so every array can be viewed
+// in place as a Uint32Array:
+//
+//   header              8 words: 'F' 'C' 'D' 'S', version, number of faces,
+//                       I intersecting faces, E non manifold edges,
+//                       L hole loops, C corners of the loops, 0
+//   intersecting faces  I face indices, ascending
+//   non manifold edges  2 E corners, the two ends of each edge once
+//   loop offsets        L + 1 offsets into the loop corners
+//   loop corners        C corners, loop k is [offset k, offset k + 1), in walking order
+//
+// The loops are the ones num_holes counts, none when the mesh has non manifold edges.
+namespace sidecar{
+
+static const uint32_t sidecar_version = 1;
+
+struct defectGeometry_t {
+    uint32_t n_faces = 0;
+    std::vector<uint32_t> intersecting_faces;
+    std::vector<uint32_t> non_manifold_edges;
+    std::vector<uint32_t> loop_offsets;
+    std::vector<uint32_t> loop_corners;
+};
+
+// the defects of a mesh file_check() has just checked, it needs the face face adjacency.
+// pairs are the intersecting pairs of IntersectingFacePairs()
+void collect_defects(MyMesh & m, const std::vector<util::facePair_t>& pairs, defectGeometry_t& d);
+
+// writes the arrays as they are, returns false when the file cannot be written
+bool write_defects(const std::string path, const defectGeometry_t& d);
+
+// reads a sidecar back, throws std::runtime_error when it is not one
+defectGeometry_t read_defects(const std::string path);
+
+}
+
+#endif
@@ -1,4 +1,10 @@
 #include "fileCheck.hpp"
+#include "batch.hpp"
+#include "streamCheck.hpp"
+#include "indexedMesh.hpp"
+#include "resultCache.hpp"
+#include "defectSidecar.hpp"
+#include "server.hpp"
 
 void Boundary(MyMesh & mesh, checkResult_t& r) {
     vcg::tri::UpdateBounding<MyMesh>::Box(mesh);
@@ -31,27 +37,37 @@ unsigned int NumDuplicateFaces(MyMesh & mesh) { // change mesh in-place
     return beforeNumFaces - afterNumFaces;
 }
 
-unsigned int NumIntersectingFaces(MyMesh & mesh) { // change mesh in-place
-
-    std::vector<MyFace *> IntersectingFaces;
-    Clean_t::SelfIntersections(mesh, IntersectingFaces);
+static vcg::Box3f FaceBox(const MyFace& f) {
+    vcg::Box3f b;
+    f.GetBBox(b);
+    return b;
+}
 
-    return IntersectingFaces.size();
+// same pairs as SelfIntersectionsParallel(), the grid is kept by index so it survives a compaction
+std::vector<util::facePair_t> IntersectingFacePairs(
+        MyMesh & mesh, util::faceGrid_t& grid, util::budget_t* budget, bool* cut
+) {
+    const long long fn = (long long) mesh.face.size();
+    std::vector<char> good(fn, 0);
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < fn; ++i)
+        good[i] = !mesh.face[i].IsD() && Clean_t::GoodFace(&mesh.face[i]);
+
+    vcg::Box3f bbox;
+    for (long long i = 0; i < fn; ++i)
+        if (good[i])
+            bbox.Add(FaceBox(mesh.face[i]));
+
+    auto box = [&](size_t i) { return FaceBox(mesh.face[i]); };
+    grid.build(bbox, fn, box, good);
+    return util::self_pairs(grid, fn, box, good, [&](uint32_t i, uint32_t j) {
+        return Clean_t::TestGoodFaceFaceIntersection(&mesh.face[i], &mesh.face[j]);
+    }, budget, cut);
+}
 
-    // FILE * fp;
-    // int counter = 1;
-    // fp = fopen("./intersecting.obj", "w+");
-    // for (auto const& face: IntersectingFaces) {
-        // auto v0 = face->cV(0)->cP();
-        // auto v1 = face->cV(1)->cP();
-        // auto v2 = face->cV(2)->cP();
-        // fprintf(fp, "v %f %f %f \n", v0[0], v0[1], v0[2]);
-        // fprintf(fp, "v %f %f %f \n", v1[0], v1[1], v1[2]);
-        // fprintf(fp, "v %f %f %f \n", v2[0], v2[1], v2[2]);
-        // fprintf(fp, "f %i %i %i \n", counter, counter+1, counter+2);
-        // // fprintf(fp, "\n");
-        // counter += 3;
-    // }
+unsigned int NumIntersectingFaces(MyMesh & mesh) {
+    util::faceGrid_t grid;
+    return util::count_intersecting_faces(IntersectingFacePairs(mesh, grid));
 }
 
 bool IsWaterTight(MyMesh & mesh) {
@@ -63,9 +79,54 @@ bool IsCoherentlyOrientedMesh(MyMesh & mesh) {
     return Clean_t::IsCoherentlyOrientedMesh(mesh);
 }
 
+// the faces and vertices of a MyMesh as util::mesh_metrics() reads them
+class metricsView_t {
+
+    public:
+
+    explicit metricsView_t(MyMesh & mesh) : mesh(mesh) {}
+
+    size_t FN() const { return mesh.face.size(); }
+    bool live(size_t f) const { return !mesh.face[f].IsD(); }
+    bool compact() const { return mesh.fn == (int) mesh.face.size(); }
+    void corners(size_t f, vcg::Point3d p[3]) const {
+        for (int z = 0; z < 3; ++z)
+            p[z].Import(mesh.face[f].cP(z));
+    }
+
+    size_t VN() const { return mesh.vert.size(); }
+    void bound(size_t begin, size_t end, vcg::Box3f& box) const {
+        for (size_t v = begin; v < end; ++v)
+            if (!mesh.vert[v].IsD())
+                box.Add(mesh.vert[v].cP());
+    }
+
+    private:
+
+    MyMesh & mesh;
+};
+
+util::meshMetrics_t Metrics(MyMesh & mesh, bool withInertia, bool concurrent) {
+    util::meshMetrics_t metrics = util::mesh_metrics(metricsView_t(mesh), withInertia, concurrent);
+    mesh.bbox = metrics.bbox;
+    return metrics;
+}
+
+void SetMetrics(const util::meshMetrics_t& metrics, checkResult_t& r) {
+    r.xmin = metrics.bbox.min.X(); r.xmax = metrics.bbox.max.X();
+    r.ymin = metrics.bbox.min.Y(); r.ymax = metrics.bbox.max.Y();
+    r.zmin = metrics.bbox.min.Z(); r.zmax = metrics.bbox.max.Z();
+    r.area = metrics.area;
+    r.volume = metrics.volume;
+    for (int k = 0; k < 3; ++k)
+        r.centroid[k] = metrics.centroid[k];
+    for (int k = 0; k < 6; ++k)
+        r.inertia[k] = metrics.inertia[k];
+}
+
+// summed in double from the origin, Inertia would compute every second order moment for it
 float Volume(MyMesh & mesh) {
-    vcg::tri::Inertia<MyMesh> Ib(mesh);
-    return Ib.Mass();
+    return Metrics(mesh, false).volume;
 }
 
 bool IsPositiveVolume(MyMesh & mesh) {
@@ -73,19 +134,66 @@ bool IsPositiveVolume(MyMesh & mesh) {
 }
 
 float Area(MyMesh & mesh) {
-    float area = 0;
-    for(auto fi = mesh.face.begin(); fi!=mesh.face.end();++fi)
-        if(!fi->IsD())
-            area += DoubleArea(*fi)/2;
-    return area;
+    return Metrics(mesh, false).area;
 }
 
+// same traversal as Clean::ConnectedComponents() but the visited mark is kept
+// aside instead of in the face flags, so it can run next to the other stages
 unsigned int NumShell(MyMesh & mesh) {
-    return Clean_t::CountConnectedComponents(mesh);
+    std::vector<char> visited(mesh.face.size(), 0);
+    std::stack<MyFace*> sf;
+    unsigned int numShell = 0;
+
+    for (size_t i = 0; i < mesh.face.size(); ++i) {
+        if (mesh.face[i].IsD() || visited[i])
+            continue;
+        visited[i] = 1;
+        sf.push(&mesh.face[i]);
+        ++numShell;
+        while (!sf.empty()) {
+            MyFace* fpt = sf.top();
+            sf.pop();
+            for (int j = 0; j < 3; ++j) {
+                if (vcg::face::IsBorder(*fpt, j))
+                    continue;
+                MyFace* l = fpt->FFp(j);
+                char& v = visited[vcg::tri::Index(mesh, l)];
+                if (!v) {
+                    v = 1;
+                    sf.push(l);
+                }
+            }
+        }
+    }
+    return numShell;
+}
+
+// same count as Clean::CountNonManifoldEdgeFF() without allocating user bits:
+// each ring of faces around a non manifold edge is counted from its first face
+unsigned int NumNonManifoldEdges(MyMesh & mesh) {
+    unsigned int edgeCnt = 0;
+    for (auto fi = mesh.face.begin(); fi != mesh.face.end(); ++fi) if (!fi->IsD()) {
+        for (int i = 0; i < 3; ++i) {
+            if (vcg::face::IsManifold(*fi, i))
+                continue;
+            bool isFirst = true;
+            vcg::face::Pos<MyFace> nmf(&*fi, i);
+            do {
+                if (nmf.F() < &*fi) {
+                    isFirst = false;
+                    break;
+                }
+                nmf.NextF();
+            } while (nmf.F() != &*fi);
+            if (isFirst)
+                ++edgeCnt;
+        }
+    }
+    return edgeCnt;
 }
 
 bool IsGoodMesh(checkResult_t r) {
-    assert(r.version == 4);
+    assert(r.version == 6);
 
     bool isWaterTight = r.is_watertight;
     bool isCoherentlyOriented = r.is_coherently_oriented;
@@ -99,53 +207,42 @@ bool IsGoodMesh(checkResult_t r) {
 }
 
 
-// std::vector<std::vector<vcg::Point3<float>>> CountHoles(MyMesh & m)
-int CountHoles(MyMesh & m)
+// same count as Clean::CountHoles(), the visited mark is kept aside instead of in the face flags
+int CountHoles(MyMesh & m, util::budget_t* budget, bool* cut,
+    std::vector<uint32_t>* loop_corners, std::vector<uint32_t>* loop_offsets)
 {
-    vcg::tri::UpdateFlags<MyMesh>::FaceClearV(m);
-    // std::vector<std::vector<vcg::Point3<float>>> vpss;
+    // the offsets index the corners, they are only given together
+    assert((loop_corners == nullptr) == (loop_offsets == nullptr));
+    std::vector<char> visited(m.face.size(), 0);
 
     int loopNum=0;
+    if (cut) *cut = false;
     for(auto fi=m.face.begin(); fi!=m.face.end();++fi) if(!fi->IsD())
     {
+        if (budget && budget->poll(fi - m.face.begin()))
+        {
+            if (cut) *cut = true;
+            break;
+        }
         for(int j=0;j<3;++j)
         {
-            if(!fi->IsV() && vcg::face::IsBorder(*fi,j))
+            if(!visited[vcg::tri::Index(m, &*fi)] && vcg::face::IsBorder(*fi,j))
             {
                 vcg::face::Pos<MyFace> startPos(&*fi,j);
                 vcg::face::Pos<MyFace> curPos=startPos;
-
-                std::vector<vcg::Point3<float>> vps;
-
                 do
                 {
-                    auto curFace = curPos.F();
+                    if (loop_corners) loop_corners->push_back(3 * (uint32_t) vcg::tri::Index(m, curPos.F()) + curPos.VInd());
                     curPos.NextB();
-                    curPos.F()->SetV();
-                    /*
-                    auto face = curPos.F();
-                    auto edgeIndex = curPos.E();
-                    if (edgeIndex == 0) {
-                        vps.push_back(face->cV(0)->cP());
-                        vps.push_back(face->cV(1)->cP());
-                    } else if (edgeIndex == 1) {
-                        vps.push_back(face->cV(1)->cP());
-                        vps.push_back(face->cV(2)->cP());
-                    } else {
-                        assert(edgeIndex == 2);
-                        vps.push_back(face->cV(2)->cP());
-                        vps.push_back(face->cV(0)->cP());
-                    }
-                    */
+                    visited[vcg::tri::Index(m, curPos.F())] = 1;
                 }
                 while(curPos!=startPos);
-                // vpss.push_back(vps);
+                if (loop_offsets) loop_offsets->push_back((uint32_t) loop_corners->size());
                 ++loopNum;
             }
         }
     }
     return loopNum;
-    // return vpss;
 }
 
 // TODO: vpss is a hack, this is not a VCG way
@@ -187,6 +284,8 @@ int repair_hole(MyMesh & mesh, int holeSize = 100) {
     // auto hole_count = vcg::tri::Hole<MyMesh>::EarCuttingFill<vcg::tri::SelfIntersectionEar<MyMesh> >(mesh,holeSize,false,callback);
     // auto hole_count = vcg::tri::Hole<MyMesh>::EarCuttingFill<vcg::tri::SelfIntersectionEar<MyMesh> >(mesh,holeSize,false,callback);
     vcg::tri::UpdateBounding<MyMesh>::Box(mesh);
+    // the ears read the vertex normals to tell reflex corners, nothing else sets them
+    vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFace(mesh);
     const float maxDimLimit = 0.01 * max(max(mesh.bbox.DimX(), mesh.bbox.DimY()), mesh.bbox.DimZ());
     auto hole_count = vcg::tri::Hole<MyMesh>::EarCuttingIntersectionFill<vcg::tri::SelfIntersectionEar<MyMesh>>(mesh,holeSize,maxDimLimit,false,callback);
 
@@ -208,7 +307,7 @@ bool loadMesh(MyMesh & mesh, const std::string filepath) {
     if (extension == "stl") {
         if(vcg::tri::io::ImporterSTL<MyMesh>::Open(mesh, filepath.c_str(),  a))
         {
-            printf("Error reading file  %s\n", filepath.c_str());
+            std::cout << "Error reading file  " << filepath << "\n";
             return false;
         }
     } else if (extension == "obj") {
@@ -219,9 +318,9 @@ bool loadMesh(MyMesh & mesh, const std::string filepath) {
         auto error_critical = ImporterOBJ::ErrorCritical(error_code);
 
         if (error_code!=0 && !error_critical) { // even error code critical error
-            printf("Reading file  %s with Non Critical Error %s\n", filepath.c_str(), error_message);
+            std::cout << "Reading file  " << filepath << " with Non Critical Error " << error_message << "\n";
         } else if (error_critical) { // odd error code critical error
-            printf("Error reading file  %s with Critical Error %s\n", filepath.c_str(), error_message);
+            std::cout << "Error reading file  " << filepath << " with Critical Error " << error_message << "\n";
             return false;
         }
     } else if (extension == "ply") {
@@ -269,45 +368,181 @@ bool reloadMesh(MyMesh& mesh) {
     return true;
 }
 
-checkResult_t file_check(MyMesh & m) {
-    auto t1 = std::chrono::high_resolution_clock::now();
-    checkResult_t r;
+// true if the FF link of edge j of f is missing, dangling or joins an edge with different vertices
+static bool IsStaleFF(MyFace& f, int j) {
+    MyFace* g = f.FFp(j);
+    if (g == 0 || g->IsD())
+        return true;
+    if (g == &f)
+        return f.FFi(j) != j;
 
-    r.version = 4; // set version number
+    const int i = f.FFi(j);
+    return !((g->V0(i) == f.V0(j) && g->V1(i) == f.V1(j)) ||
+             (g->V0(i) == f.V1(j) && g->V1(i) == f.V0(j)));
+}
 
-    r.n_degen_faces = NumDegenratedFaces(m);
-    r.n_duplicate_faces = NumDuplicateFaces(m);
+// in-memory equivalent of reloadMesh(), no temporary file is written.
+// vertices are welded as loadMesh() does, FF adjacency is rebuilt only around
+// the faces whose topology went stale, then deleted elements are compacted
+// away keeping the order the ply round-trip would give
+bool compactMesh(MyMesh& mesh) {
+    // mark every live vertex, the ones the welding deletes keep the mark
+    for (auto vi = mesh.vert.begin(); vi != mesh.vert.end(); ++vi) {
+        if (vi->IsD()) vi->ClearV();
+        else vi->SetV();
+    }
 
-    r.n_faces = m.FN();
-    r.n_vertices = m.VN();
+    Clean_t::RemoveDuplicateVertex(mesh, false);
 
-    Boundary(m, r);
-    r.area = Area(m);
-    r.volume = Volume(m);
+    std::vector<MyMesh::CoordType> weldedPos;
+    for (auto vi = mesh.vert.begin(); vi != mesh.vert.end(); ++vi) {
+        if (vi->IsD() && vi->IsV()) weldedPos.push_back(vi->cP());
+        vi->ClearV();
+    }
 
-    vcg::tri::UpdateTopology<MyMesh>::FaceFace(m); // require for isWaterTight
+    // faces referring to a welded vertex now point to the survivor at the same position.
+    // A weld can join an edge of such a face to an edge of another face whose links look
+    // fine, so every corner of a face around a survivor is marked, not only the survivor
+    std::vector<MyFace*> stale;
+    if (!weldedPos.empty()) {
+        std::sort(weldedPos.begin(), weldedPos.end());
+        for (auto vi = mesh.vert.begin(); vi != mesh.vert.end(); ++vi)
+            if (!vi->IsD() && std::binary_search(weldedPos.begin(), weldedPos.end(), vi->cP()))
+                vi->SetV();
+        for (auto fi = mesh.face.begin(); fi != mesh.face.end(); ++fi)
+            if (!fi->IsD() && (fi->V(0)->IsV() || fi->V(1)->IsV() || fi->V(2)->IsV()))
+                stale.push_back(&*fi);
+    }
 
-    r.is_watertight = IsWaterTight(m);
+    for (auto fi = mesh.face.begin(); fi != mesh.face.end(); ++fi) if (!fi->IsD()) {
+        for (int j = 0; j < 3; ++j) {
+            if (IsStaleFF(*fi, j)) {
+                stale.push_back(&*fi);
+                break;
+            }
+        }
+    }
+    for (MyFace* f : stale) {
+        f->V(0)->SetV(); f->V(1)->SetV(); f->V(2)->SetV();
+    }
 
-    r.is_coherently_oriented = IsCoherentlyOrientedMesh(m);
+    vcg::tri::UpdateTopology<MyMesh>::FaceFaceAroundVisitedVertex(mesh);
+    vcg::tri::UpdateFlags<MyMesh>::VertexClearV(mesh);
 
-    r.is_positive_volume = IsPositiveVolume(m);
+    // FFDetach() only flags one side of the edge, a linear pass is cheaper than tracking it
+    vcg::tri::UpdateFlags<MyMesh>::FaceBorderFromFF(mesh);
 
-    r.n_intersecting_faces = NumIntersectingFaces(m);
+    vcg::tri::Allocator<MyMesh>::CompactEveryVector(mesh);
+    return true;
+}
 
-    r.n_shells = NumShell(m);
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point t1) {
+    auto t2 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
 
-    // non manifold edges in a mesh, e.g. the edges where there are more than 2 incident faces
-    r.n_non_manifold_edges = Clean_t::CountNonManifoldEdgeFF(m);
+checkResult_t file_check(
+        MyMesh & m, bool concurrent, util::stageTimes_t* times, checkState_t* state, util::budget_t* budget
+) {
+    if (budget && state)
+        throw std::invalid_argument("a budgeted check cannot fill a check state");
 
-    if (r.n_non_manifold_edges == 0) {
-        auto numHoles = Clean_t::CountHoles(m);
-        r.n_holes = numHoles;
-    } else {
-        r.n_holes = -1; // -1 indicates it cannot be runned
-    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    checkResult_t r;
+
+    r.version = 6; // set version number
+    r.budgeted = budget != nullptr;
+
+    // the expensive stages check the budget first, a skipped field keeps its zero value
+    std::mutex partial_mutex;
+    auto partial = [&](const char* field) {
+        std::lock_guard<std::mutex> lock(partial_mutex);
+        r.partial.push_back(field);
+    };
+    auto skip = [&](const char* field) {
+        if (!budget || !budget->expired())
+            return false;
+        partial(field);
+        return true;
+    };
+
+    // the first stages edit the mesh, everything after them only reads it
+    util::stageGraph_t graph;
+    auto degen = graph.add("degenerated_faces", [&]() { r.n_degen_faces = NumDegenratedFaces(m); });
+    auto dedup = graph.add("duplicated_faces", [&]() {
+        r.n_duplicate_faces = NumDuplicateFaces(m);
+        r.n_faces = m.FN();
+        r.n_vertices = m.VN();
+    }, {degen});
+
+    // bounds, area, volume, centroid and inertia in one sweep
+    auto metrics = graph.add("metrics", [&]() { SetMetrics(Metrics(m, true, concurrent), r); }, {dedup});
+    auto watertight = graph.add("watertight", [&]() {
+        r.is_watertight = skip("is_watertight") ? false : IsWaterTight(m);
+    }, {dedup});
+    // once the budget is gone there is no adjacency, the stages after it are skipped too
+    auto ff = graph.add("face_face", [&]() {
+        if (!budget || !budget->expired())
+            vcg::tri::UpdateTopology<MyMesh>::FaceFace(m); // require for IsCoherentlyOrientedMesh
+    }, {dedup});
+
+    // needs no topology, it starts with the face face construction
+    graph.add("intersecting_faces", [&]() {
+        if (skip("num_intersecting_faces")) {
+            r.n_intersecting_faces = 0;
+        } else if (budget) {
+            util::faceGrid_t grid;
+            bool cut = false;
+            r.n_intersecting_faces = util::count_intersecting_faces(IntersectingFacePairs(m, grid, budget, &cut));
+            if (cut)
+                partial("num_intersecting_faces");
+        } else if (state) {
+            state->n_faces = m.face.size();
+            state->intersecting = IntersectingFacePairs(m, state->grid);
+            r.n_intersecting_faces = util::count_intersecting_faces(state->intersecting);
+        } else {
+            r.n_intersecting_faces = NumIntersectingFaces(m);
+        }
+    }, {dedup});
 
-    r.is_good_mesh = IsGoodMesh(r);
+    auto oriented = graph.add("coherently_oriented", [&]() {
+        r.is_coherently_oriented = skip("is_coherently_oriented") ? false : IsCoherentlyOrientedMesh(m);
+    }, {ff});
+    graph.add("shells", [&]() { r.n_shells = skip("num_shells") ? 0 : NumShell(m); }, {ff});
+
+    // non manifold edges in a mesh, e.g. the edges where there are more than 2 incident faces
+    auto nonManifold = graph.add("non_manifold_edges", [&]() {
+        r.n_non_manifold_edges = skip("num_non_manifold_edges") ? 0 : NumNonManifoldEdges(m);
+    }, {ff});
+    graph.add("holes", [&]() {
+        if (skip("num_holes")) {
+            r.n_holes = 0;
+        } else if (r.n_non_manifold_edges == 0) {
+            bool cut = false;
+            r.n_holes = CountHoles(m, budget, &cut);
+            if (cut)
+                partial("num_holes");
+        } else {
+            r.n_holes = -1; // -1 indicates it cannot be runned
+        }
+    }, {nonManifold});
+
+    graph.add("good_mesh", [&]() {
+        r.is_positive_volume = r.volume > 0.;
+        r.is_good_mesh = IsGoodMesh(r);
+    }, {metrics, watertight, oriented});
+
+    graph.run(concurrent);
+    if (times)
+        graph.times(*times, "check.");
+
+    // is_good_mesh is read from the fields it is made of
+    for (auto field : {"is_watertight", "is_coherently_oriented"})
+        if (std::count(r.partial.begin(), r.partial.end(), field)) {
+            r.partial.push_back("is_good_mesh");
+            break;
+        }
+    std::sort(r.partial.begin(), r.partial.end());
 
     auto t2 = std::chrono::high_resolution_clock::now();
     std::cout << "file_check() took "
@@ -316,6 +551,199 @@ checkResult_t file_check(MyMesh & m) {
     return r;
 }
 
+// per face attribute of the faces file_repair_then_check() tracks: the index the face had
+// when it was checked, -1 for the faces the repair created
+static const char* checkIndexAttribute = "check_index";
+
+// faces from first on were created by the repair
+static void MarkCreatedFaces(MyMesh& mesh, size_t first) {
+    auto origin = vcg::tri::Allocator<MyMesh>::FindPerFaceAttribute<int>(mesh, checkIndexAttribute);
+    if (!vcg::tri::Allocator<MyMesh>::IsValidHandle(mesh, origin))
+        return;
+    for (size_t i = first; i < mesh.face.size(); ++i)
+        origin[i] = -1;
+}
+
+// where the faces of the checked mesh are now (-1 once removed) and which ones
+// the repair created. false when file_check() would still remove faces from the repaired
+// mesh, that is when a created face is degenerated or duplicates another face
+static bool RepairedFaces(
+        MyMesh& m, const checkState_t& state, std::vector<int>& moved, std::vector<uint32_t>& created
+    ) {
+    auto origin = vcg::tri::Allocator<MyMesh>::FindPerFaceAttribute<int>(m, checkIndexAttribute);
+    if (!vcg::tri::Allocator<MyMesh>::IsValidHandle(m, origin))
+        return false;
+
+    moved.assign(state.n_faces, -1);
+    created.clear();
+    for (size_t i = 0; i < m.face.size(); ++i) if (!m.face[i].IsD()) {
+        const int o = origin[i];
+        if (o >= 0 && size_t(o) < state.n_faces)
+            moved[o] = int(i);
+        else
+            created.push_back(i);
+    }
+
+    typedef std::array<MyVertex*, 3> corners_t;
+    auto corners = [](MyFace& f) {
+        corners_t c = {{f.V(0), f.V(1), f.V(2)}};
+        std::sort(c.begin(), c.end());
+        return c;
+    };
+    std::vector<corners_t> createdCorners;
+    createdCorners.reserve(created.size());
+    for (auto i : created) {
+        const corners_t c = corners(m.face[i]);
+        if (c[0] == c[1] || c[1] == c[2])
+            return false;
+        createdCorners.push_back(c);
+    }
+    if (createdCorners.empty())
+        return true;
+
+    std::sort(createdCorners.begin(), createdCorners.end());
+    if (std::adjacent_find(createdCorners.begin(), createdCorners.end()) != createdCorners.end())
+        return false;
+    size_t n = 0;
+    for (auto fi = m.face.begin(); fi != m.face.end(); ++fi)
+        if (!fi->IsD() && std::binary_search(createdCorners.begin(), createdCorners.end(), corners(*fi)))
+            ++n;
+    return n == createdCorners.size();
+}
+
+// the pairs of the kept faces stand, the repair does not move vertices and a flip only
+// reorders the corners. The created faces are tested against the kept ones through the grid
+// of the check, then against each other. A pair is tested lower index first, as the check does
+static std::vector<util::facePair_t> RecheckIntersectingPairs(
+        MyMesh& m, const checkState_t& state, const std::vector<int>& moved, const std::vector<uint32_t>& created
+    ) {
+    auto ordered = [](int i, int j) {
+        return std::make_pair(uint32_t(std::min(i, j)), uint32_t(std::max(i, j)));
+    };
+    auto intersect = [&](const util::facePair_t& p) {
+        return Clean_t::TestGoodFaceFaceIntersection(&m.face[p.first], &m.face[p.second]);
+    };
+
+    std::vector<util::facePair_t> pairs;
+    for (auto& p : state.intersecting)
+        if (moved[p.first] >= 0 && moved[p.second] >= 0)
+            pairs.push_back(ordered(moved[p.first], moved[p.second]));
+
+    const long long cn = (long long) created.size();
+    std::vector<char> good(cn);
+    for (long long k = 0; k < cn; ++k)
+        good[k] = Clean_t::GoodFace(&m.face[created[k]]);
+
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> inBox;
+        std::vector<util::facePair_t> localPairs;
+
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (long long k = 0; k < cn; ++k) if (good[k]) {
+            const vcg::Box3f b0 = FaceBox(m.face[created[k]]);
+            inBox.clear();
+            state.grid.query(b0, inBox);
+            std::sort(inBox.begin(), inBox.end());
+            auto last = std::unique(inBox.begin(), inBox.end());
+            for (auto o = inBox.begin(); o != last; ++o) {
+                const int j = moved[*o];
+                if (j < 0 || !FaceBox(m.face[j]).Collide(b0))
+                    continue;
+                const util::facePair_t p = ordered(created[k], j);
+                if (intersect(p))
+                    localPairs.push_back(p);
+            }
+        }
+
+        #pragma omp critical
+        pairs.insert(pairs.end(), localPairs.begin(), localPairs.end());
+    }
+
+    if (cn > 0) {
+        vcg::Box3f bbox;
+        for (long long k = 0; k < cn; ++k)
+            if (good[k])
+                bbox.Add(FaceBox(m.face[created[k]]));
+        auto box = [&](size_t k) { return FaceBox(m.face[created[k]]); };
+        util::faceGrid_t grid;
+        grid.build(bbox, cn, box, good);
+        auto createdPairs = util::self_pairs(grid, cn, box, good, [&](uint32_t i, uint32_t j) {
+            return intersect(ordered(created[i], created[j]));
+        });
+        for (auto& p : createdPairs)
+            pairs.push_back(ordered(created[p.first], created[p.second]));
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+static bool HasBorder(MyMesh& m) {
+    for (auto fi = m.face.begin(); fi != m.face.end(); ++fi) if (!fi->IsD())
+        for (int j = 0; j < 3; ++j)
+            if (vcg::face::IsBorder(*fi, j))
+                return true;
+    return false;
+}
+
+checkResult_t file_recheck(MyMesh & m, const checkState_t& state, bool concurrent, util::stageTimes_t* times) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::vector<int> moved;
+    std::vector<uint32_t> created;
+    if (!RepairedFaces(m, state, moved, created))
+        return file_check(m, concurrent, times);
+    if (times)
+        times->push_back(std::make_pair("check.repaired_faces", elapsed_ms(t1)));
+
+    checkResult_t r;
+
+    r.version = 6;
+    r.n_degen_faces = 0; // RepairedFaces() found nothing to remove
+    r.n_duplicate_faces = 0;
+    r.n_faces = m.FN();
+    r.n_vertices = m.VN();
+
+    util::stageGraph_t graph;
+    auto metrics = graph.add("metrics", [&]() { SetMetrics(Metrics(m, true, concurrent), r); });
+    auto ff = graph.add("face_face", [&]() { vcg::tri::UpdateTopology<MyMesh>::FaceFace(m); });
+
+    graph.add("intersecting_faces", [&]() {
+        r.n_intersecting_faces = util::count_intersecting_faces(RecheckIntersectingPairs(m, state, moved, created));
+    });
+
+    auto oriented = graph.add("coherently_oriented", [&]() { r.is_coherently_oriented = IsCoherentlyOrientedMesh(m); }, {ff});
+    graph.add("shells", [&]() { r.n_shells = NumShell(m); }, {ff});
+
+    auto nonManifold = graph.add("non_manifold_edges", [&]() { r.n_non_manifold_edges = NumNonManifoldEdges(m); }, {ff});
+    graph.add("holes", [&]() {
+        if (r.n_non_manifold_edges == 0) {
+            r.n_holes = CountHoles(m);
+        } else {
+            r.n_holes = -1; // -1 indicates it cannot be runned
+        }
+    }, {nonManifold});
+
+    // what IsWaterTight() finds sorting the edges, read from the adjacency
+    auto watertight = graph.add("watertight", [&]() {
+        r.is_watertight = r.n_non_manifold_edges == 0 && !HasBorder(m);
+    }, {nonManifold});
+
+    graph.add("good_mesh", [&]() {
+        r.is_positive_volume = r.volume > 0.;
+        r.is_good_mesh = IsGoodMesh(r);
+    }, {metrics, watertight, oriented});
+
+    graph.run(concurrent);
+    if (times)
+        graph.times(*times, "check.");
+
+    std::cout << "file_recheck() took " << int(elapsed_ms(t1)) << " milliseconds, "
+        << created.size() << " faces created by the repair\n";
+    return r;
+}
+
 // repairResult_t repair_check(MyMesh& m) {
     // return (repairResult_t) file_check(m);
 // }
@@ -347,7 +775,7 @@ repairRecord_t file_repair(
     auto t1 = std::chrono::high_resolution_clock::now();
     repairRecord_t r;
 
-    assert(check_r.version == 4); // version number needs to be 1
+    assert(check_r.version == 6); // version number needs to be 1
 
     bool isWaterTight = check_r.is_watertight;
     const int numNonManifoldEdge = check_r.n_non_manifold_edges;
@@ -356,8 +784,7 @@ repairRecord_t file_repair(
     if (!isWaterTight and numNonManifoldEdge > 0) {
         r.n_non_manif_f_removed = Clean_t::RemoveNonManifoldFace(mesh);
 
-        // reload mesh
-        reloadMesh(mesh);
+        compactMesh(mesh);
         // exportMesh(mesh, repaired_path); // ply
         // MyMesh repaired_mesh;
         // loadMesh(mesh, repaired_path);
@@ -370,13 +797,14 @@ repairRecord_t file_repair(
     }
 
     if (!isWaterTight) {
+        const size_t numFacesBefore = mesh.face.size();
         int numHoles = repair_hole(mesh); // new repair hole
+        MarkCreatedFaces(mesh, numFacesBefore);
         if (numHoles > 0) {
             r.n_hole_filled = numHoles;
             Clean_t::RemoveDuplicateVertex(mesh, true);
 
-            // reload mesh
-            reloadMesh(mesh);
+            compactMesh(mesh);
             // exportMesh(mesh, repaired_path); // ply
             // MyMesh repaired_mesh;
             // loadMesh(mesh, repaired_path);
@@ -407,14 +835,14 @@ repairRecord_t file_repair(
         << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
         << " milliseconds\n";
 
-    reloadMesh(mesh); // mesh becomes the repaired mesh
+    compactMesh(mesh); // mesh becomes the repaired mesh
     exportMesh(mesh, repaired_path);
 
     return r;
 }
 
 bool IsGoodRepair(checkResult_t results, repairResult_t repair_results) {
-    assert(results.version == 4); // correct version
+    assert(results.version == 6); // correct version
     if (not repair_results.is_good_mesh) // if it is not good mesh
         return false;
     if (results.n_shells != repair_results.n_shells) // require same number of shells
@@ -425,13 +853,29 @@ bool IsGoodRepair(checkResult_t results, repairResult_t repair_results) {
 }
 
 repairResult_t file_repair_then_check(
-        MyMesh & mesh, checkResult_t results, const std::string repaired_path
+        MyMesh & mesh, checkResult_t results, const std::string repaired_path,
+        util::stageTimes_t* times, const checkState_t* state
     ) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (state) {
+        auto origin = vcg::tri::Allocator<MyMesh>::GetPerFaceAttribute<int>(mesh, checkIndexAttribute);
+        for (size_t i = 0; i < mesh.face.size(); ++i)
+            origin[i] = int(i);
+    }
     auto repair_record = file_repair(mesh, results, repaired_path);
+    if (times)
+        times->push_back(std::make_pair("repair", elapsed_ms(t1)));
 
-    assert(repair_record.r_version == 1);
+    assert(repair_record.r_version == 2);
 
-    repairResult_t repair_results(file_check(mesh), repair_record);
+    util::stageTimes_t check_times;
+    util::stageTimes_t* t = times ? &check_times : nullptr;
+    repairResult_t repair_results(state ? file_recheck(mesh, *state, true, t) : file_check(mesh, true, t), repair_record);
+    if (state)
+        vcg::tri::Allocator<MyMesh>::DeletePerFaceAttribute(mesh, checkIndexAttribute);
+    if (times)
+        for (auto& t : check_times)
+            times->push_back(std::make_pair("r_" + t.first, t.second));
 
     repair_results.is_good_repair = IsGoodRepair(results, repair_results);
 
@@ -451,26 +895,81 @@ void file_check(const std::string filepath) {
     file_check(mesh);
 }
 
-int check_repair_main(
+bool check_repair(
         const std::string filepath,
         const std::string repaired_path,
-        const std::string report_path
+        json_t& json,
+        util::stageTimes_t* times,
+        const std::string defects_path
 ) {
     MyMesh mesh;
+    auto t1 = std::chrono::high_resolution_clock::now();
     bool successfulLoadMesh = loadMesh(mesh, filepath);
+    if (times)
+        times->push_back(std::make_pair("load", elapsed_ms(t1)));
 
     if (not successfulLoadMesh) {
-        return 1;
+        return false;
     }
-    auto results = file_check(mesh);
-
-    json_t json;
+    checkState_t state;
+    auto results = file_check(mesh, true, times, &state);
     results.output_report(json);
 
+    if (not defects_path.empty()) {
+        t1 = std::chrono::high_resolution_clock::now();
+        sidecar::defectGeometry_t defects;
+        sidecar::collect_defects(mesh, state.intersecting, defects);
+        if (not sidecar::write_defects(defects_path, defects))
+            std::cout << "Error writing defects to " << defects_path << "\n";
+        if (times)
+            times->push_back(std::make_pair("defects", elapsed_ms(t1)));
+    }
+
     if (not results.is_good_mesh) {
-        repairResult_t repair_results = file_repair_then_check(mesh, results, repaired_path);
+        repairResult_t repair_results = file_repair_then_check(mesh, results, repaired_path, times, &state);
         repair_results.output_report(json);
     }
+    return true;
+}
+
+int budget_check_main(
+        const std::string filepath,
+        const std::string report_path,
+        double max_ms,
+        unsigned long long max_intersections
+) {
+    util::budget_t budget(max_ms, max_intersections);
+    MyMesh mesh;
+    if (not loadMesh(mesh, filepath)) {
+        return 1;
+    }
+
+    json_t json;
+    file_check(mesh, true, nullptr, nullptr, &budget).output_report(json);
+
+    std::ofstream file(report_path);
+    file << json;
+    file.close();
+    return 0;
+}
+
+int check_repair_main(
+        const std::string filepath,
+        const std::string repaired_path,
+        const std::string report_path,
+        cache::resultCache_t* cache,
+        const std::string defects_path
+) {
+    json_t json;
+    if (cache) {
+        const auto hits = cache->hits();
+        if (not cache::cached_check_repair(*cache, filepath, repaired_path, json)) {
+            return 1;
+        }
+        cache->output_report(json, cache->hits() > hits);
+    } else if (not check_repair(filepath, repaired_path, json, nullptr, defects_path)) {
+        return 1;
+    }
 
     std::ofstream file(report_path);
     file << json;
@@ -487,9 +986,58 @@ extern "C" {
 }
 
 // TODO: write test for this function
-#ifndef FILECHECK_TEST
+#if !defined(FILECHECK_TEST) && !defined(FILECHECK_BENCH)
 int main( int argc, char *argv[] )
 {
+    // filecheck --batch directory|manifest [repaired dir] [report.jsonl] [workers]
+    if (argc >= 3 && std::string(argv[1]) == "--batch") {
+        const std::string repaired_dir = argc >= 4 ? argv[3] : "./out";
+        const std::string report_path = argc >= 5 ? argv[4] : "./out/batch_report.jsonl";
+        const unsigned int n_workers = argc >= 6 ? std::atoi(argv[5]) : 0; // 0 one per core
+        return batch::batch_main(argv[2], repaired_dir, report_path, n_workers) == 0 ? 0 : 1;
+    }
+
+    // filecheck --serve socket|- [workers] [queue], requests on a unix socket or on stdin
+    if (argc >= 3 && std::string(argv[1]) == "--serve") {
+        const unsigned int n_workers = argc >= 4 ? std::atoi(argv[3]) : 0; // 0 one per core
+        const size_t queue_capacity = argc >= 5 ? std::atoll(argv[4]) : 0;  // 0 twice the workers
+        return server::server_main(argv[2], n_workers, queue_capacity);
+    }
+
+    // filecheck --stream path/to/stl [report.json] [memory MB], no repair
+    if (argc >= 3 && std::string(argv[1]) == "--stream") {
+        const std::string report_path = argc >= 4 ? argv[3] : "./out/stream_report.json";
+        const unsigned long long memory_mb = argc >= 5 ? std::atoll(argv[4]) : 256;
+        return stream::stream_check_main(argv[2], report_path, memory_mb << 20);
+    }
+
+    // filecheck --indexed path/to/mesh [report.json], the compact mesh for big files, no repair
+    if (argc >= 3 && std::string(argv[1]) == "--indexed") {
+        const std::string report_path = argc >= 4 ? argv[3] : "./out/indexed_report.json";
+        return indexed::indexed_check_main(argv[2], report_path);
+    }
+
+    // filecheck --budget path/to/mesh [report.json] [ms] [max intersections], no repair
+    if (argc >= 3 && std::string(argv[1]) == "--budget") {
+        const std::string report_path = argc >= 4 ? argv[3] : "./out/budget_report.json";
+        const double max_ms = argc >= 5 ? std::atof(argv[4]) : 60000;
+        const unsigned long long max_intersections = argc >= 6 ? std::atoll(argv[5]) : 0;
+        return budget_check_main(argv[2], report_path, max_ms, max_intersections);
+    }
+
+    // filecheck --cached cache_dir path/to/mesh [repaired] [report.json] [cache MB]
+    if (argc >= 4 && std::string(argv[1]) == "--cached") {
+        const std::string repaired_path = argc >= 5 ? argv[4] : "./out/repaired.stl";
+        const std::string report_path = argc >= 6 ? argv[5] : "./out/cached_report.json";
+        const unsigned long long cache_mb = argc >= 7 ? std::atoll(argv[6]) : 1024;
+        if (std::string(argv[3]) == repaired_path) {
+            printf("DANGER! export filepath is the same with original filepath!\n");
+            return 1;
+        }
+        cache::resultCache_t cache(argv[2], cache_mb << 20);
+        return check_repair_main(argv[3], repaired_path, report_path, &cache);
+    }
+
     std::string filepath = "./unittest/meshes/perfect.stl";
     if (argc < 2) {
         printf("path to stl file not provided use default %s\n", filepath.c_str());
@@ -521,6 +1069,12 @@ int main( int argc, char *argv[] )
         printf("report path is not given, writing to stdout\n");
     }
 
-    return check_repair_main(filepath, repaired_path, report_path);
+    // the defects of the mesh as it was loaded, for a viewer
+    std::string defects_path;
+    if (argc >= 5) {
+        defects_path = argv[4];
+    }
+
+    return check_repair_main(filepath, repaired_path, report_path, nullptr, defects_path);
 }
 #endif
@@ -17,7 +17,6 @@
 #include <wrap/io_trimesh/import_ply.h>
 #include <wrap/io_trimesh/export_ply.h>
 
-#include <vcg/complex/algorithms/inertia.h>
 #include <vcg/complex/algorithms/hole.h>
 
 #include <iostream>
@@ -30,6 +29,11 @@
 #include <stdexcept>
 
 #include "util.hpp"
+#include "stage.hpp"
+#include "faceGrid.hpp"
+#include "budget.hpp"
+#include "metrics.hpp"
+#include "arena.hpp"
 #include "json.hpp"
 using json_t=nlohmann::json;
 
@@ -54,16 +58,22 @@ class MyFace    : public vcg::Face< MyUsedTypes,
 class MyEdge: public vcg::Edge< MyUsedTypes,
     vcg::edge::VertexRef > {};
 
-class MyMesh    : public vcg::tri::TriMesh< std::vector<MyVertex>, std::vector<MyFace> , std::vector<MyEdge> > {};
+// the containers and the scratch of the algorithms on them come from the arena current when the
+// mesh is built, see util::arenaScope_t, or from the heap
+class MyMesh    : public vcg::tri::TriMesh< util::arenaVector_t<MyVertex>, util::arenaVector_t<MyFace> , util::arenaVector_t<MyEdge> > {};
 
 typedef vcg::tri::Clean<MyMesh> Clean_t;
 
 
 bool loadMesh(MyMesh & mesh, const std::string filepath);
 bool exportMesh(MyMesh & mesh, const std::string exportPath);
+bool reloadMesh(MyMesh & mesh);
+bool compactMesh(MyMesh & mesh);
 
 float Volume(MyMesh & mesh);
 float Area(MyMesh & mesh);
+// area, volume, centroid, bounds and inertia of the live faces in one sweep, mesh.bbox is updated
+util::meshMetrics_t Metrics(MyMesh & mesh, bool withInertia = true, bool concurrent = true);
 
 unsigned int NumDegenratedFaces(MyMesh & mesh);
 unsigned int NumDuplicateFaces(MyMesh & mesh);
@@ -73,13 +83,14 @@ bool IsWaterTight(MyMesh & mesh);
 bool IsCoherentlyOrientedMesh(MyMesh & mesh);
 bool IsPositiveVolume(MyMesh & mesh);
 unsigned int NumShell(MyMesh & mesh);
+unsigned int NumNonManifoldEdges(MyMesh & mesh);
 bool IsGoodMesh(int* results);
 
 class checkResult_t {
 
     public:
 
-    unsigned int version = 4; // 0 version number
+    unsigned int version = 6; // 0 version number
     unsigned int n_faces; // 1 face number
     unsigned int n_vertices; // 2 vertices number
     unsigned int n_degen_faces; // 3 number of degenerated faces
@@ -98,11 +109,18 @@ class checkResult_t {
     float ymin; float ymax;
     float zmin; float zmax;
     float area; float volume;
+    // from the same sweep as the area and the volume, see util::meshMetrics_t
+    float centroid[3] = {0, 0, 0};
+    float inertia[6] = {0, 0, 0, 0, 0, 0}; // xx yy zz xy xz yz about the centroid
 
     std::string prefix;
 
+    // a budgeted check reports which fields it left partial, by their report name
+    bool budgeted = false;
+    std::vector<std::string> partial;
+
     void output_report(json_t& json) {
-        assert(version == 4);
+        assert(version == 6);
         json[prefix + "num_version"]=                    version;
         json[prefix + "num_face"]=                       n_faces;
         json[prefix + "num_vertices"]=                   n_vertices;
@@ -124,6 +142,19 @@ class checkResult_t {
         json[prefix + "max_z"]=                          zmax;
         json[prefix + "area"]=                           area;
         json[prefix + "volume"]=                         volume;
+        json[prefix + "centroid_x"]=                     centroid[0];
+        json[prefix + "centroid_y"]=                     centroid[1];
+        json[prefix + "centroid_z"]=                     centroid[2];
+        json[prefix + "inertia_xx"]=                     inertia[0];
+        json[prefix + "inertia_yy"]=                     inertia[1];
+        json[prefix + "inertia_zz"]=                     inertia[2];
+        json[prefix + "inertia_xy"]=                     inertia[3];
+        json[prefix + "inertia_xz"]=                     inertia[4];
+        json[prefix + "inertia_yz"]=                     inertia[5];
+        if (budgeted) {
+            json[prefix + "is_exact"]=                   partial.empty();
+            json[prefix + "partial_fields"]=             partial;
+        }
     }
 
     unsigned int getNFaces() {
@@ -136,7 +167,7 @@ class repairRecord_t {
 
     public:
 
-    unsigned int r_version = 1; // 0 repair version
+    unsigned int r_version = 2; // 0 repair version
     bool does_fix_coherently_oriented; // 1 fix CoherentlyOriented
     bool does_fix_positive_volume; // 2 fix not Positive Volume
     unsigned int n_non_manif_f_removed = 0; // 4 remove non manifold faces
@@ -144,7 +175,7 @@ class repairRecord_t {
     bool is_good_repair = false; // 6 is good repair
 
     void output_report(json_t& json) {
-        assert(r_version == 1);
+        assert(r_version == 2);
         json["repair_version"]           = r_version;
         json["does_make_coherent_orient"]= does_fix_coherently_oriented;
         json["does_flip_normal_outside"] = does_fix_positive_volume;
@@ -176,6 +207,8 @@ class repairResult_t: public checkResult_t, public repairRecord_t {
             ymin = r.ymin; ymax = r.ymax;
             zmin = r.zmin; zmax = r.zmax;
             area = r.area; volume = r.volume;
+            std::copy(r.centroid, r.centroid + 3, centroid);
+            std::copy(r.inertia, r.inertia + 6, inertia);
 
             // ----------------------- report result --------------------------
             r_version = rr.r_version;
@@ -192,9 +225,47 @@ class repairResult_t: public checkResult_t, public repairRecord_t {
     }
 };
 
+// what file_check() keeps for file_recheck(), faces by their index in m.face at check time
+class checkState_t {
+
+    public:
+
+    size_t n_faces = 0;                          // m.face.size() when checked
+    util::faceGrid_t grid;                       // the boxes of the faces the intersection test keeps
+    std::vector<util::facePair_t> intersecting;  // the intersecting pairs, sorted
+};
+
 void Boundary(MyMesh & mesh, checkResult_t& boundary);
+// the metrics of a mesh into its check result: bounds, area, volume, centroid and inertia
+void SetMetrics(const util::meshMetrics_t& metrics, checkResult_t& r);
+bool IsGoodMesh(checkResult_t r);
+
+// the intersecting pairs of live faces by index in mesh.face, grid gets the broadphase.
+// with a budget, cut is set when the search stopped early, see util::self_pairs()
+std::vector<util::facePair_t> IntersectingFacePairs(
+    MyMesh & mesh, util::faceGrid_t& grid, util::budget_t* budget = nullptr, bool* cut = nullptr
+);
+
+// independent read only stages run concurrently unless concurrent is false,
+// the result is the same either way. times, when given, gets the time of every stage.
+// state, when given, keeps what file_recheck() needs after a repair.
+// With a budget the cheap stages run in full, the expensive ones are skipped once it has
+// expired or stop part way, the fields they leave partial are listed in the result.
+// A budgeted check cannot fill a state, file_recheck() needs every pair: both together
+// throw std::invalid_argument
+checkResult_t file_check(
+    MyMesh & m, bool concurrent = true, util::stageTimes_t* times = nullptr, checkState_t* state = nullptr,
+    util::budget_t* budget = nullptr
+);
 
-checkResult_t file_check(MyMesh & m);
+// same result as file_check() on a mesh file_repair() repaired after the check that filled state.
+// Only the faces the repair created are tested for intersections, the pairs of the faces it kept
+// are carried over, and watertight is read from the adjacency instead of sorting the edges.
+// Falls back to file_check() when the repair left degenerated or duplicated faces behind
+// or the mesh was not tracked by file_repair_then_check()
+checkResult_t file_recheck(
+    MyMesh & m, const checkState_t& state, bool concurrent = true, util::stageTimes_t* times = nullptr
+);
 
 extern "C" {
     void file_check(const std::string filepath, int* results);
@@ -205,7 +276,11 @@ bool DoesFlipNormalOutside(MyMesh & mesh,
 bool DoesMakeCoherentlyOriented(MyMesh & mesh,
     bool isWaterTight, bool isCoherentlyOriented);
 // std::vector<std::vector<vcg::Point3<float>>> CountHoles(MyMesh & m);
-int CountHoles(MyMesh & m);
+// with a budget, cut is set when it expired before every border was walked, the count is then a lower bound
+// loop_corners gets the corners (3 * face + vertex) of every loop in order, loop_offsets the end of each loop in it,
+// they are given together or not at all
+int CountHoles(MyMesh & m, util::budget_t* budget = nullptr, bool* cut = nullptr,
+    std::vector<uint32_t>* loop_corners = nullptr, std::vector<uint32_t>* loop_offsets = nullptr);
 int repair_hole(
     MyMesh & mesh, std::vector<std::vector<vcg::Point3<float>>> vpss
 );
@@ -214,14 +289,42 @@ repairRecord_t file_repair(
     MyMesh & mesh, const checkResult_t check_r, const std::string repaired_path
 );
 
+// with state, the repaired faces are tracked and the repaired mesh goes through file_recheck()
 repairResult_t file_repair_then_check(
-    MyMesh & mesh, const checkResult_t check_r, const std::string repaired_path
+    MyMesh & mesh, const checkResult_t check_r, const std::string repaired_path,
+    util::stageTimes_t* times = nullptr, const checkState_t* state = nullptr
+);
+
+// loads, checks and, if it is not a good mesh, repairs one file into json.
+// with defects_path, the defects found by the check are written there, see defectSidecar.hpp.
+// returns false when the file cannot be loaded
+bool check_repair(
+    const std::string filepath,
+    const std::string repaired_path,
+    json_t& json,
+    util::stageTimes_t* times = nullptr,
+    const std::string defects_path = ""
 );
 
+// loads and checks one file within a budget and writes the check report, no repair.
+// max_ms and max_intersections as in util::budget_t
+int budget_check_main(
+    const std::string filepath,
+    const std::string report_path,
+    double max_ms,
+    unsigned long long max_intersections
+);
+
+namespace cache { class resultCache_t; }
+
+// check_repair() into report_path, answered from cache when one is given.
+// defects_path is only written without a cache
 int check_repair_main(
     const std::string filepath,
     const std::string repaired_path,
-    const std::string report_path
+    const std::string report_path,
+    cache::resultCache_t* cache = nullptr,
+    const std::string defects_path = ""
 );
 
 #endif
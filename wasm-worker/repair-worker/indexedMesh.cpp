@@ -0,0 +1,656 @@
+#include "indexedMesh.hpp"
+
+#include <cstring>
+#include <limits>
+#include <stack>
+
+#include "faceGrid.hpp"
+#include "kernels.hpp"
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include "benchmark/meshGenerator.hpp"
+#endif
+
+namespace indexed{
+
+static const uint32_t no_index = std::numeric_limits<uint32_t>::max();
+
+size_t indexedMesh_t::bytes() const {
+    size_t n = ff.capacity() * sizeof(uint32_t);
+    for (int k = 0; k < 3; ++k)
+        n += coord[k].capacity() * sizeof(float) + corner[k].capacity() * sizeof(uint32_t);
+    return n;
+}
+
+void indexedMesh_t::clear() {
+    for (int k = 0; k < 3; ++k) {
+        std::vector<float>().swap(coord[k]);
+        std::vector<uint32_t>().swap(corner[k]);
+    }
+    std::vector<uint32_t>().swap(ff);
+}
+
+// open addressing table from a position to its vertex, the same identity
+// Clean::RemoveDuplicateVertex() welds on: operator== on the coordinates
+class weldHash_t {
+
+    public:
+
+    explicit weldHash_t(const indexedMesh_t& m, size_t n_expected) : m(m), n_used(0) {
+        size_t cap = 16;
+        while (cap < 2 * n_expected)
+            cap <<= 1;
+        slot.assign(cap, no_index);
+    }
+
+    // the vertex at p, added to m when it is the first one there
+    uint32_t weld(indexedMesh_t& mesh, const float* p) {
+        uint32_t& s = find(p);
+        if (s != no_index)
+            return s;
+        if (mesh.VN() >= no_index)
+            throw std::runtime_error("more than 2^32 - 1 vertices");
+        s = (uint32_t) mesh.VN();
+        for (int k = 0; k < 3; ++k)
+            mesh.coord[k].push_back(p[k]);
+        if (2 * ++n_used > slot.size())
+            grow();
+        return mesh.VN() - 1;
+    }
+
+    private:
+
+    uint32_t& find(const float* p) {
+        size_t h = hash(p) & (slot.size() - 1);
+        while (slot[h] != no_index && !same(slot[h], p))
+            h = (h + 1) & (slot.size() - 1);
+        return slot[h];
+    }
+
+    bool same(uint32_t v, const float* p) const {
+        return m.coord[0][v] == p[0] && m.coord[1][v] == p[1] && m.coord[2][v] == p[2];
+    }
+
+    void grow() {
+        slot.assign(2 * slot.size(), no_index);
+        for (uint32_t v = 0; v < m.VN(); ++v) {
+            const float p[3] = {m.coord[0][v], m.coord[1][v], m.coord[2][v]};
+            find(p) = v;
+        }
+    }
+
+    static size_t hash(const float* p) {
+        // adding zero turns -0 into +0, they are equal for operator==
+        unsigned long long h = 0;
+        for (int k = 0; k < 3; ++k) {
+            const float c = p[k] + 0.f;
+            uint32_t bits;
+            memcpy(&bits, &c, sizeof(bits));
+            h = (h ^ bits) * 0x9E3779B97F4A7C15ull;
+        }
+        h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return size_t(h);
+    }
+
+    const indexedMesh_t& m;
+    std::vector<uint32_t> slot;
+    size_t n_used;
+};
+
+typedef vcg::tri::io::ImporterSTL<MyMesh> ImporterSTL;
+
+// the facets are welded in file order so the vertices come out in the order
+// the welding of loadMesh() keeps its survivors: first appearance
+static bool load_binary_stl(indexedMesh_t& m, const ImporterSTL::STLFile& file) {
+    const int facenum = file.FaceNum();
+    if (facenum < 0 || size_t(facenum) > (file.Size() - ImporterSTL::STL_LABEL_SIZE - sizeof(int)) / ImporterSTL::STL_FACET_SIZE)
+        return false;
+
+    for (int k = 0; k < 3; ++k)
+        m.corner[k].resize(facenum);
+    // a closed mesh has about half as many vertices as faces
+    weldHash_t hash(m, facenum / 2);
+    for (int i = 0; i < facenum; ++i) {
+        float coord[9];
+        memcpy(coord, file.Facet(i) + sizeof(vcg::Point3f), sizeof(coord));
+        for (int k = 0; k < 3; ++k)
+            m.corner[k][i] = hash.weld(m, coord + 3 * k);
+    }
+    for (int k = 0; k < 3; ++k)
+        m.coord[k].shrink_to_fit();
+    return true;
+}
+
+bool load_indexed_mesh(indexedMesh_t& m, const std::string filepath) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    m.clear();
+
+    if (util::extension_lower(filepath) == "stl") {
+        ImporterSTL::STLFile file(filepath.c_str());
+        if (!file.IsOpen()) {
+            printf("Error reading file  %s\n", filepath.c_str());
+            return false;
+        }
+        if (ImporterSTL::IsSTLBinary(file)) {
+            if (!load_binary_stl(m, file)) {
+                printf("Error reading file  %s\n", filepath.c_str());
+                m.clear();
+                return false;
+            }
+            auto t2 = std::chrono::high_resolution_clock::now();
+            std::cout << "load_indexed_mesh() took "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+                << " milliseconds\n";
+            return true;
+        }
+    }
+
+    // ascii stl, obj and ply are small enough to go through a MyMesh
+    MyMesh mesh;
+    if (!loadMesh(mesh, filepath))
+        return false;
+    from_mesh(m, mesh);
+    return true;
+}
+
+void from_mesh(indexedMesh_t& m, const MyMesh& mesh) {
+    m.clear();
+    for (int k = 0; k < 3; ++k) {
+        m.coord[k].reserve(mesh.VN());
+        m.corner[k].reserve(mesh.FN());
+    }
+    std::vector<uint32_t> index(mesh.vert.size(), no_index);
+    for (size_t i = 0; i < mesh.vert.size(); ++i) if (!mesh.vert[i].IsD()) {
+        index[i] = (uint32_t) m.VN();
+        for (int k = 0; k < 3; ++k)
+            m.coord[k].push_back(mesh.vert[i].cP()[k]);
+    }
+    for (auto fi = mesh.face.begin(); fi != mesh.face.end(); ++fi) if (!fi->IsD()) {
+        for (int k = 0; k < 3; ++k)
+            m.corner[k].push_back(index[fi->cV(k) - &mesh.vert[0]]);
+    }
+}
+
+// keeps the faces with keep[f] set, in the same order
+static void compact_faces(indexedMesh_t& m, const std::vector<char>& keep) {
+    for (int k = 0; k < 3; ++k) {
+        size_t n = 0;
+        for (size_t f = 0; f < keep.size(); ++f)
+            if (keep[f])
+                m.corner[k][n++] = m.corner[k][f];
+        m.corner[k].resize(n);
+    }
+    std::vector<uint32_t>().swap(m.ff);
+}
+
+unsigned int remove_degenerated_faces(indexedMesh_t& m) {
+    std::vector<char> keep(m.FN());
+    unsigned int n = 0;
+    for (size_t f = 0; f < m.FN(); ++f) {
+        keep[f] = m.V(f, 0) != m.V(f, 1) && m.V(f, 0) != m.V(f, 2) && m.V(f, 1) != m.V(f, 2);
+        n += !keep[f];
+    }
+    if (n)
+        compact_faces(m, keep);
+    return n;
+}
+
+// Clean::SortedTriple with an index in place of the face pointer, same order.
+// std::sort is not stable: the same sequence through the same comparisons
+// drops the same face of every pair, the one that decides the orientation left
+struct sortedTriple_t {
+    uint32_t v[3];
+    uint32_t f;
+
+    sortedTriple_t(uint32_t v0, uint32_t v1, uint32_t v2, uint32_t f) : f(f) {
+        v[0] = v0; v[1] = v1; v[2] = v2;
+        std::sort(v, v + 3);
+    }
+    bool operator<(const sortedTriple_t& p) const {
+        return (v[2] != p.v[2]) ? (v[2] < p.v[2]) :
+               (v[1] != p.v[1]) ? (v[1] < p.v[1]) :
+               (v[0] < p.v[0]);
+    }
+    bool operator==(const sortedTriple_t& s) const {
+        return v[0] == s.v[0] && v[1] == s.v[1] && v[2] == s.v[2];
+    }
+};
+
+unsigned int remove_duplicated_faces(indexedMesh_t& m) {
+    std::vector<sortedTriple_t> fvec;
+    fvec.reserve(m.FN());
+    for (size_t f = 0; f < m.FN(); ++f)
+        fvec.push_back(sortedTriple_t(m.V(f, 0), m.V(f, 1), m.V(f, 2), (uint32_t) f));
+    std::sort(fvec.begin(), fvec.end());
+
+    std::vector<char> keep(m.FN(), 1);
+    unsigned int n = 0;
+    for (size_t i = 0; i + 1 < fvec.size(); ++i) {
+        if (fvec[i] == fvec[i + 1]) {
+            keep[fvec[i].f] = 0;
+            ++n;
+        }
+    }
+    std::vector<sortedTriple_t>().swap(fvec);
+    if (n)
+        compact_faces(m, keep);
+    return n;
+}
+
+// the bucketing of UpdateTopology::FaceFaceFromHalfEdges(): the half edges by their smaller
+// vertex, each bucket sorted on the larger vertex and the half edge, the faces around
+// an edge come out in face order as FaceFace() links them
+void face_face(indexedMesh_t& m) {
+    const long long fn = (long long) m.FN(), vn = (long long) m.VN();
+    std::vector<uint32_t> start(vn + 1, 0);
+    for (long long f = 0; f < fn; ++f)
+        for (int z = 0; z < 3; ++z)
+            ++start[std::min(m.V(f, z), m.V(f, (z + 1) % 3)) + 1];
+    for (long long v = 0; v < vn; ++v)
+        start[v + 1] += start[v];
+
+    std::vector<uint64_t> he(3 * fn);
+    {
+        std::vector<uint32_t> next(start.begin(), start.end() - 1);
+        for (long long f = 0; f < fn; ++f)
+            for (int z = 0; z < 3; ++z) {
+                const uint32_t a = m.V(f, z), b = m.V(f, (z + 1) % 3);
+                he[next[std::min(a, b)]++] = (uint64_t(std::max(a, b)) << 32) | uint64_t(3 * f + z);
+            }
+    }
+
+    // the faces on an edge are linked in a ring
+    m.ff.resize(3 * fn);
+    #pragma omp parallel for schedule(dynamic, 4096)
+    for (long long v = 0; v < vn; ++v) {
+        uint64_t *first = he.data() + start[v], *last = he.data() + start[v + 1];
+        std::sort(first, last);
+        for (uint64_t* ps = first; ps < last;) {
+            uint64_t* pe = ps + 1;
+            while (pe < last && (*pe >> 32) == (*ps >> 32))
+                ++pe;
+            for (uint64_t* q = ps; q < pe; ++q)
+                m.ff[uint32_t(*q)] = uint32_t(q + 1 < pe ? q[1] : *ps);
+            ps = pe;
+        }
+    }
+}
+
+static vcg::Box3f bounds(const indexedMesh_t& m) {
+    vcg::Box3f bbox;
+    bbox.SetNull();
+    if (m.VN() > 0) {
+        const float* const coord[3] = {m.coord[0].data(), m.coord[1].data(), m.coord[2].data()};
+        kernels::bbox(coord, m.VN(), &bbox.min[0], &bbox.max[0]);
+    }
+    return bbox;
+}
+
+// the coordinate arrays and corners as the kernels take them
+static kernels::triangles_t triangles(const indexedMesh_t& m) {
+    kernels::triangles_t t;
+    for (int k = 0; k < 3; ++k) {
+        t.coord[k] = m.coord[k].data();
+        t.corner[k] = m.corner[k].data();
+    }
+    t.n = m.FN();
+    return t;
+}
+
+// the faces and vertices as util::mesh_metrics() reads them, the bounds come from the kernels
+class metricsView_t {
+
+    public:
+
+    explicit metricsView_t(const indexedMesh_t& m) : m(m) {}
+
+    size_t FN() const { return m.FN(); }
+    bool live(size_t) const { return true; }
+    bool compact() const { return true; }
+    void corners(size_t f, vcg::Point3d p[3]) const {
+        for (int z = 0; z < 3; ++z)
+            p[z].Import(m.P(m.V(f, z)));
+    }
+
+    size_t VN() const { return m.VN(); }
+    void bound(size_t begin, size_t end, vcg::Box3f& box) const {
+        const float* const coord[3] = {m.coord[0].data() + begin, m.coord[1].data() + begin, m.coord[2].data() + begin};
+        vcg::Box3f b;
+        kernels::bbox(coord, end - begin, &b.min[0], &b.max[0]);
+        box.Add(b);
+    }
+
+    private:
+
+    const indexedMesh_t& m;
+};
+
+// ring walks and orientation test of face::CheckOrientation(), IsManifold() and Pos on half edges
+static bool is_coherently_oriented(const indexedMesh_t& m) {
+    for (size_t f = 0; f < m.FN(); ++f) {
+        for (int z = 0; z < 3; ++z) {
+            const uint32_t h = 3 * f + z;
+            if (m.is_border(h))
+                continue;
+            const uint32_t g = m.ff[h] / 3, gi = m.ff[h] % 3;
+            if (m.V(f, z) != m.V(g, (gi + 1) % 3))
+                return false;
+        }
+    }
+    return true;
+}
+
+static unsigned int num_shells(const indexedMesh_t& m) {
+    std::vector<char> visited(m.FN(), 0);
+    std::stack<uint32_t> sf;
+    unsigned int numShell = 0;
+    for (size_t i = 0; i < m.FN(); ++i) {
+        if (visited[i])
+            continue;
+        visited[i] = 1;
+        sf.push((uint32_t) i);
+        ++numShell;
+        while (!sf.empty()) {
+            const uint32_t f = sf.top();
+            sf.pop();
+            for (int j = 0; j < 3; ++j) {
+                const uint32_t l = m.ff[3 * f + j] / 3;
+                if (!visited[l]) {
+                    visited[l] = 1;
+                    sf.push(l);
+                }
+            }
+        }
+    }
+    return numShell;
+}
+
+// each ring of faces around a non manifold edge counted from its first face, as NumNonManifoldEdges()
+static unsigned int num_non_manifold_edges(const indexedMesh_t& m) {
+    unsigned int edgeCnt = 0;
+    for (size_t f = 0; f < m.FN(); ++f) {
+        for (int i = 0; i < 3; ++i) {
+            const uint32_t h = 3 * f + i;
+            if (m.is_border(h) || m.ff[m.ff[h]] == h)
+                continue;
+            bool isFirst = true;
+            uint32_t nmf = h;
+            do {
+                if (nmf / 3 < f) {
+                    isFirst = false;
+                    break;
+                }
+                nmf = m.ff[nmf];
+            } while (nmf / 3 != f);
+            if (isFirst)
+                ++edgeCnt;
+        }
+    }
+    return edgeCnt;
+}
+
+static bool has_border(const indexedMesh_t& m) {
+    for (uint32_t h = 0; h < m.ff.size(); ++h)
+        if (m.is_border(h))
+            return true;
+    return false;
+}
+
+// face::Pos on the half edges, only what NextB() needs
+struct pos_t {
+    const indexedMesh_t& m;
+    uint32_t f;
+    int z;
+    uint32_t v;
+
+    pos_t(const indexedMesh_t& m, uint32_t f, int z) : m(m), f(f), z(z), v(m.V(f, z)) {}
+
+    bool operator!=(const pos_t& p) const { return f != p.f || z != p.z || v != p.v; }
+    bool is_border() const { return m.is_border(3 * f + z); }
+
+    void flip_e() { z = m.V(f, (z + 1) % 3) == v ? (z + 1) % 3 : (z + 2) % 3; }
+    void flip_f() { const uint32_t h = m.ff[3 * f + z]; f = h / 3; z = h % 3; }
+    void flip_v() { v = m.V(f, (z + 1) % 3) == v ? m.V(f, z) : m.V(f, (z + 1) % 3); }
+    void next_b() {
+        do {
+            flip_e();
+            flip_f();
+        } while (!is_border());
+        flip_v();
+    }
+};
+
+// same count as CountHoles(), only meaningful without non manifold edges
+static int count_holes(const indexedMesh_t& m) {
+    std::vector<char> visited(m.FN(), 0);
+    int loopNum = 0;
+    for (uint32_t f = 0; f < m.FN(); ++f) {
+        for (int j = 0; j < 3; ++j) {
+            if (!visited[f] && m.is_border(3 * f + j)) {
+                const pos_t startPos(m, f, j);
+                pos_t curPos = startPos;
+                do {
+                    curPos.next_b();
+                    visited[curPos.f] = 1;
+                } while (curPos != startPos);
+                ++loopNum;
+            }
+        }
+    }
+    return loopNum;
+}
+
+// Clean::GoodFace() on face f
+static bool good_face(const indexedMesh_t& m, uint32_t f) {
+    return Clean_t::GoodTriangle(m.P(m.V(f, 0)), m.P(m.V(f, 1)), m.P(m.V(f, 2)));
+}
+
+// Clean::TestGoodFaceFaceIntersection() on indices, vertices are shared when their indices are
+static bool good_faces_intersect(const indexedMesh_t& m, uint32_t f0, uint32_t f1) {
+    int sv = 0, i0 = 0, i1 = 0;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            if (m.V(f0, i) == m.V(f1, j)) {
+                ++sv;
+                i0 = i;
+                i1 = j;
+            }
+    const vcg::Point3f p[3] = {m.P(m.V(f0, 0)), m.P(m.V(f0, 1)), m.P(m.V(f0, 2))};
+    const vcg::Point3f q[3] = {m.P(m.V(f1, 0)), m.P(m.V(f1, 1)), m.P(m.V(f1, 2))};
+    return Clean_t::TestGoodTriangleTriangleIntersection(p, q, sv, i0, i1);
+}
+
+// same count as SelfIntersectionsParallel(), the good faces go in a util::faceGrid_t
+static unsigned int num_intersecting_faces(const indexedMesh_t& m) {
+    const long long fn = (long long) m.FN();
+    if (fn == 0)
+        return 0;
+
+    std::vector<char> good(fn);
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < fn; ++i)
+        good[i] = good_face(m, i);
+    const vcg::Box3f bbox = bounds(m);
+
+    auto face_box = [&](uint32_t f) {
+        vcg::Box3f b;
+        b.Set(m.P(m.V(f, 0)));
+        b.Add(m.P(m.V(f, 1)));
+        b.Add(m.P(m.V(f, 2)));
+        return b;
+    };
+
+    util::faceGrid_t grid;
+    grid.build(bbox, fn, face_box, good);
+    // most candidates are apart across a plane, the batch test drops them before the exact one
+    const kernels::triangles_t t = triangles(m);
+    auto pairs = util::self_pairs_filtered(grid, fn, face_box, good,
+        [&](uint32_t i, const uint32_t* faces, size_t n, unsigned char* pass) {
+            kernels::plane_separated(t, i, faces, n, pass);
+        },
+        [&](uint32_t i, uint32_t j) { return good_faces_intersect(m, i, j); });
+    return util::count_intersecting_faces(pairs);
+}
+
+checkResult_t indexed_check(indexedMesh_t& m, bool concurrent, util::stageTimes_t* times) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    checkResult_t r;
+
+    r.version = 6;
+
+    // the first stages edit the faces, everything after them only reads them
+    util::stageGraph_t graph;
+    auto degen = graph.add("degenerated_faces", [&]() { r.n_degen_faces = remove_degenerated_faces(m); });
+    auto dedup = graph.add("duplicated_faces", [&]() {
+        r.n_duplicate_faces = remove_duplicated_faces(m);
+        r.n_faces = m.FN();
+        r.n_vertices = m.VN();
+    }, {degen});
+
+    auto metrics = graph.add("metrics", [&]() {
+        SetMetrics(util::mesh_metrics(metricsView_t(m), true, concurrent), r);
+    }, {dedup});
+    auto ff = graph.add("face_face", [&]() { face_face(m); }, {dedup});
+    graph.add("intersecting_faces", [&]() { r.n_intersecting_faces = num_intersecting_faces(m); }, {dedup});
+
+    auto oriented = graph.add("coherently_oriented", [&]() { r.is_coherently_oriented = is_coherently_oriented(m); }, {ff});
+    graph.add("shells", [&]() { r.n_shells = num_shells(m); }, {ff});
+    auto nonManifold = graph.add("non_manifold_edges", [&]() { r.n_non_manifold_edges = num_non_manifold_edges(m); }, {ff});
+    // every edge with one face is a border, every edge with more than two a non manifold ring
+    auto watertight = graph.add("watertight", [&]() {
+        r.is_watertight = !has_border(m) && r.n_non_manifold_edges == 0;
+    }, {nonManifold});
+    graph.add("holes", [&]() {
+        if (r.n_non_manifold_edges == 0) {
+            r.n_holes = count_holes(m);
+        } else {
+            r.n_holes = -1; // -1 indicates it cannot be runned
+        }
+    }, {nonManifold});
+
+    graph.add("good_mesh", [&]() {
+        r.is_positive_volume = r.volume > 0.;
+        r.is_good_mesh = IsGoodMesh(r);
+    }, {metrics, watertight, oriented});
+
+    graph.run(concurrent);
+    if (times)
+        graph.times(*times, "check.");
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::cout << "indexed_check() took "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+        << " milliseconds\n";
+    return r;
+}
+
+int indexed_check_main(const std::string filepath, const std::string report_path) {
+    indexedMesh_t m;
+    try {
+        if (!load_indexed_mesh(m, filepath))
+            return 1;
+    } catch (const std::exception& e) {
+        printf("Error reading file  %s: %s\n", filepath.c_str(), e.what());
+        return 1;
+    }
+
+    json_t json;
+    indexed_check(m).output_report(json);
+
+    std::ofstream file(report_path);
+    file << json;
+    file.close();
+    return 0;
+}
+
+#ifdef FILECHECK_TEST
+static void require_same(const checkResult_t& s, const checkResult_t& r) {
+    REQUIRE( s.n_faces == r.n_faces );
+    REQUIRE( s.n_vertices == r.n_vertices );
+    REQUIRE( s.n_degen_faces == r.n_degen_faces );
+    REQUIRE( s.n_duplicate_faces == r.n_duplicate_faces );
+    REQUIRE( s.is_watertight == r.is_watertight );
+    REQUIRE( s.is_coherently_oriented == r.is_coherently_oriented );
+    REQUIRE( s.is_positive_volume == r.is_positive_volume );
+    REQUIRE( s.n_intersecting_faces == r.n_intersecting_faces );
+    REQUIRE( s.n_shells == r.n_shells );
+    REQUIRE( s.n_non_manifold_edges == r.n_non_manifold_edges );
+    REQUIRE( s.n_holes == r.n_holes );
+    REQUIRE( s.is_good_mesh == r.is_good_mesh );
+    REQUIRE( s.xmin == r.xmin ); REQUIRE( s.xmax == r.xmax );
+    REQUIRE( s.ymin == r.ymin ); REQUIRE( s.ymax == r.ymax );
+    REQUIRE( s.zmin == r.zmin ); REQUIRE( s.zmax == r.zmax );
+    REQUIRE( s.area == r.area );
+    REQUIRE( s.volume == r.volume );
+}
+
+TEST_CASE( "test indexed check same as file_check", "[file_check]" ) {
+    const std::string path = "./unittest/unittest_out/indexed.stl";
+
+    std::vector<generator::defects_t> cases(6);
+    cases[1].holes = 2;
+    cases[2].flipped_patches = 2;
+    cases[3].duplicates = 3;
+    cases[4].non_manifold_edges = 2;
+    cases[4].self_intersections = 1;
+    cases[5].self_intersections = 2;
+    cases[5].flipped_patches = 1;
+    cases[5].duplicates = 2;
+
+    for (size_t i = 0; i < cases.size(); ++i) {
+        MyMesh mesh;
+        generator::make_torus(mesh, 20000, cases[i]);
+        // a degenerate face too, two corners at the same place
+        const MyMesh::CoordType corner = mesh.vert[0].P();
+        vcg::tri::Allocator<MyMesh>::AddVertex(mesh, corner);
+        vcg::tri::Allocator<MyMesh>::AddFace(mesh, &mesh.vert[0], &mesh.vert.back(), &mesh.vert[1]);
+        exportMesh(mesh, path);
+
+        MyMesh loaded;
+        loadMesh(loaded, path);
+        indexedMesh_t m;
+        from_mesh(m, loaded);
+        auto r = file_check(loaded);
+
+        // straight from the file and through a MyMesh, the same mesh
+        indexedMesh_t direct;
+        REQUIRE( load_indexed_mesh(direct, path) );
+        for (int k = 0; k < 3; ++k) {
+            REQUIRE( direct.coord[k] == m.coord[k] );
+            REQUIRE( direct.corner[k] == m.corner[k] );
+        }
+
+        require_same(indexed_check(m), r);
+        REQUIRE( m.has_ff() );
+        // corners, positions and adjacency
+        REQUIRE( m.bytes() < 40 * m.FN() );
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "test indexed check non manifold rings", "[file_check]" ) {
+    // three faces on one edge, one of them turned the other way, and an open strip
+    MyMesh mesh;
+    generator::make_torus(mesh, 2000);
+    const size_t n = mesh.vert.size();
+    vcg::tri::Allocator<MyMesh>::AddVertices(mesh, 2);
+    mesh.vert[n].P() = mesh.vert[0].P() + MyMesh::CoordType(0, 0, 3);
+    mesh.vert[n + 1].P() = mesh.vert[0].P() + MyMesh::CoordType(0, 3, 0);
+    vcg::tri::Allocator<MyMesh>::AddFace(mesh, &mesh.vert[1], &mesh.vert[0], &mesh.vert[n]);
+    vcg::tri::Allocator<MyMesh>::AddFace(mesh, &mesh.vert[0], &mesh.vert[1], &mesh.vert[n + 1]);
+
+    indexedMesh_t m;
+    from_mesh(m, mesh);
+    require_same(indexed_check(m), file_check(mesh));
+
+    indexedMesh_t empty;
+    auto r = indexed_check(empty);
+    REQUIRE( r.n_faces == 0 );
+    REQUIRE( r.is_good_mesh == false );
+}
+#endif
+
+}
@@ -0,0 +1,76 @@
+#ifndef INDEXED_MESH_HPP
+#define INDEXED_MESH_HPP
+
+#include "fileCheck.hpp"
+
+#include <cstdint>
+
+// Compact mesh for the check pipeline, for the jobs a MyMesh does not fit in memory.
+//
+// A MyMesh face takes 72 bytes (FF pointers, normal, mark, flags) and a vertex 32,
+// a binary stl is loaded with three vertices per face and welded in place, so
+// a check costs about 170 bytes per face plus 36 per face to sort the edges.
+// indexedMesh_t keeps the positions and the corners in plain arrays with 32 bit
+// indices, the face face adjacency is built only when a stage asks for it:
+//
+//   corners          12 bytes per face
+//   positions        12 bytes per vertex, about 6 per face on a closed mesh
+//   face face        12 bytes per face, after face_face()
+//   transient        26 bytes per face while face_face() sorts the edges,
+//                    16 while the duplicated faces are sorted, the grid of
+//                    the intersection test about 4 per face and per cell it spans,
+//                    the welding table about 8 and the mapped stl 50 while loading
+//
+// that is about 30 bytes per face once loaded and 80 at the peak, against 260
+// for loadMesh() and file_check() (the indexed bench prints both).
+namespace indexed{
+
+struct indexedMesh_t {
+    std::vector<float> coord[3];       // x, y and z of the vertices
+    std::vector<uint32_t> corner[3];   // first, second and third vertex of the faces
+
+    // half edge 3*f+z to the next half edge on the same edge, itself on a border.
+    // empty until face_face() is called, cleared by anything that edits the faces
+    std::vector<uint32_t> ff;
+
+    size_t VN() const { return coord[0].size(); }
+    size_t FN() const { return corner[0].size(); }
+
+    uint32_t V(size_t f, int z) const { return corner[z][f]; }
+    vcg::Point3f P(uint32_t v) const { return vcg::Point3f(coord[0][v], coord[1][v], coord[2][v]); }
+    vcg::Triangle3<float> triangle(size_t f) const { return vcg::Triangle3<float>(P(V(f, 0)), P(V(f, 1)), P(V(f, 2))); }
+
+    bool has_ff() const { return ff.size() == 3 * FN(); }
+    bool is_border(uint32_t h) const { return ff[h] == h; }
+
+    // bytes held by the arrays
+    size_t bytes() const;
+    void clear();
+};
+
+// the welded mesh of a file, vertices in the order the welding of loadMesh() keeps them
+// and faces in the file order, degenerated ones included. binary stl are decoded straight
+// from the file, the other formats go through loadMesh(). returns false when it cannot be read
+bool load_indexed_mesh(indexedMesh_t& m, const std::string filepath);
+
+// the live vertices and faces of a welded MyMesh, in the same order
+void from_mesh(indexedMesh_t& m, const MyMesh& mesh);
+
+// removes the faces with two equal corners, returns how many
+unsigned int remove_degenerated_faces(indexedMesh_t& m);
+// removes the duplicated faces the way Clean::RemoveDuplicateFace() picks them, returns how many
+unsigned int remove_duplicated_faces(indexedMesh_t& m);
+
+// builds m.ff, the faces around a non manifold edge are linked in the order FaceFace() links them
+void face_face(indexedMesh_t& m);
+
+// same results as file_check() on the same welded mesh: the degenerated and the
+// duplicated faces are removed from m, the adjacency is built and the other stages only read it
+checkResult_t indexed_check(indexedMesh_t& m, bool concurrent = true, util::stageTimes_t* times = nullptr);
+
+// loads filepath compact, checks it and writes the check report, no repair
+int indexed_check_main(const std::string filepath, const std::string report_path);
+
+}
+
+#endif
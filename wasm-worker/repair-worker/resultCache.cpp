@@ -0,0 +1,309 @@
+#include "resultCache.hpp"
+#include "hash.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include <vcg/complex/algorithms/create/platonic.h>
+#endif
+
+namespace cache{
+
+static const std::string REPORT = "report.json";
+
+// keys of the entries are hex digits and dashes, the temporary ones start with a dot
+static bool is_entry(const std::string& name) {
+    return !name.empty() && name[0] != '.';
+}
+
+static std::vector<std::string> list_dir(const std::string& path) {
+    std::vector<std::string> names;
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+        return names;
+    while (struct dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            names.push_back(name);
+    }
+    closedir(dir);
+    return names;
+}
+
+static void remove_entry(const std::string& path) {
+    for (const std::string& name : list_dir(path))
+        unlink((path + "/" + name).c_str());
+    rmdir(path.c_str());
+}
+
+static bool copy_file(const std::string& from, const std::string& to) {
+    std::ifstream in(from, std::ios::binary);
+    if (!in)
+        return false;
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+    out.close();
+    return !out.fail();
+}
+
+static uint64_t hash_string(const std::string& s) {
+    util::hash64_t h;
+    h.update(s.data(), s.size());
+    return h.digest();
+}
+
+// the name of the repaired mesh in an entry, the exporter picks the format from the extension
+static std::string repaired_name(const std::string& repaired_path) {
+    return "repaired." + util::extension_lower(repaired_path);
+}
+
+std::string build_revision() {
+#ifdef FILECHECK_REVISION
+    return FILECHECK_REVISION;
+#else
+    return __DATE__ " " __TIME__;
+#endif
+}
+
+resultCache_t::resultCache_t(const std::string dir, unsigned long long max_bytes, const std::string revision)
+    : dir(dir), max_bytes(max_bytes),
+      n_hits(0), n_misses(0), n_evictions(0), n_bytes(0), n_stored(0) {
+    // any string can name the revision, the key only holds hex digits
+    this->revision = util::hex64(hash_string(revision)).substr(0, 8);
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str(), 0755) != 0)
+        throw std::runtime_error("cannot create cache directory " + dir);
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        throw std::runtime_error("not a directory " + dir);
+    evict();
+}
+
+std::string resultCache_t::key(const std::string filepath, const std::string repaired_path) const {
+    uint64_t hash;
+    unsigned long long size;
+    if (!util::hash_file(filepath, hash, size))
+        return "";
+    // the versions of the reports and the revision of the code, a change makes the old
+    // entries unreachable, they age out
+    return util::hex64(hash) + "-" + std::to_string(size)
+        + "-v" + std::to_string(checkResult_t().version)
+        + "-r" + std::to_string(repairRecord_t().r_version)
+        + "-b" + revision
+        + "-" + util::extension_lower(repaired_path);
+}
+
+bool resultCache_t::lookup(const std::string key, const std::string repaired_path, json_t& json) {
+    const std::string entry = dir + "/" + key;
+    std::ifstream report(entry + "/" + REPORT);
+    json_t cached;
+    bool hit = false;
+    if (report) {
+        try {
+            report >> cached;
+            // a repaired report comes with its mesh
+            hit = !cached.count("repair_version")
+                || copy_file(entry + "/" + repaired_name(repaired_path), repaired_path);
+        } catch (const std::exception&) {
+            hit = false;
+        }
+    }
+    if (!hit) {
+        // an entry that cannot be read would stay in the way of the one stored next
+        if (report)
+            remove_entry(entry);
+        ++n_misses;
+        return false;
+    }
+    utime(entry.c_str(), NULL); // last use, for the eviction
+    for (auto it = cached.begin(); it != cached.end(); ++it)
+        json[it.key()] = it.value();
+    ++n_hits;
+    return true;
+}
+
+void resultCache_t::store(const std::string key, const std::string repaired_path, const json_t& json) {
+    const std::string entry = dir + "/" + key;
+    const std::string tmp = dir + "/.tmp-" + key + "-" + std::to_string(getpid())
+        + "-" + std::to_string(n_stored++);
+    if (mkdir(tmp.c_str(), 0755) != 0)
+        return;
+
+    bool ok = !json.count("repair_version")
+        || copy_file(repaired_path, tmp + "/" + repaired_name(repaired_path));
+    if (ok) {
+        std::ofstream report(tmp + "/" + REPORT);
+        report << json;
+        report.close();
+        ok = !report.fail();
+    }
+    // another worker may have stored the same key first, its entry is as good
+    if (!ok || rename(tmp.c_str(), entry.c_str()) != 0)
+        remove_entry(tmp);
+    evict();
+}
+
+void resultCache_t::evict() {
+    std::lock_guard<std::mutex> lock(evict_mutex);
+
+    struct entry_t { std::string path; time_t used; unsigned long long bytes; };
+    std::vector<entry_t> entries;
+    unsigned long long total = 0;
+    struct stat st;
+    for (const std::string& name : list_dir(dir)) {
+        const std::string path = dir + "/" + name;
+        if (!is_entry(name) || stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+            continue;
+        entry_t e{path, st.st_mtime, 0};
+        for (const std::string& file : list_dir(path))
+            if (stat((path + "/" + file).c_str(), &st) == 0)
+                e.bytes += st.st_size;
+        total += e.bytes;
+        entries.push_back(e);
+    }
+
+    // oldest first, ties by name so that every worker agrees
+    std::sort(entries.begin(), entries.end(), [](const entry_t& a, const entry_t& b) {
+        return a.used != b.used ? a.used < b.used : a.path < b.path;
+    });
+    for (size_t k = 0; k < entries.size() && total > max_bytes; ++k) {
+        remove_entry(entries[k].path);
+        total -= entries[k].bytes;
+        ++n_evictions;
+    }
+    n_bytes = total;
+}
+
+void resultCache_t::output_report(json_t& json, bool hit) const {
+    json["cache_hit"]       = hit;
+    json["cache_hits"]      = hits();
+    json["cache_misses"]    = misses();
+    json["cache_evictions"] = evictions();
+    json["cache_bytes"]     = bytes();
+}
+
+bool cached_check_repair(
+        resultCache_t& cache,
+        const std::string filepath,
+        const std::string repaired_path,
+        json_t& json,
+        util::stageTimes_t* times
+) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    const std::string key = cache.key(filepath, repaired_path);
+    const bool hit = !key.empty() && cache.lookup(key, repaired_path, json);
+    if (times)
+        times->push_back(std::make_pair("cache.lookup", std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - t1).count()));
+    if (hit)
+        return true;
+
+    // the cache keeps the report alone, json may already hold the fields of the caller
+    json_t report;
+    if (!check_repair(filepath, repaired_path, report, times))
+        return false;
+    if (!key.empty())
+        cache.store(key, repaired_path, report);
+    for (auto it = report.begin(); it != report.end(); ++it)
+        json[it.key()] = it.value();
+    return true;
+}
+
+#ifdef FILECHECK_TEST
+static json_t without_cache_fields(json_t json) {
+    for (const char* field : {"cache_hit", "cache_hits", "cache_misses", "cache_evictions", "cache_bytes"})
+        json.erase(field);
+    return json;
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream s;
+    s << in.rdbuf();
+    return s.str();
+}
+
+TEST_CASE( "test result cache", "[util]" ) {
+    const std::string out = "./unittest/unittest_out";
+    const std::string dir = out + "/cache";
+    for (const std::string& name : list_dir(dir))
+        remove_entry(dir + "/" + name);
+    rmdir(dir.c_str());
+
+    MyMesh sphere;
+    vcg::tri::Sphere(sphere, 3);
+    exportMesh(sphere, out + "/cache_good.stl");
+    for (size_t i = 0; i < sphere.face.size(); i += 37)
+        vcg::tri::Allocator<MyMesh>::DeleteFace(sphere, sphere.face[i]);
+    exportMesh(sphere, out + "/cache_holes.stl");
+
+    resultCache_t cache(dir);
+    json_t reference, miss, hit;
+    REQUIRE( check_repair(out + "/cache_holes.stl", out + "/cache_reference.ply", reference) );
+    REQUIRE( reference.count("repair_version") == 1 );
+
+    REQUIRE( cached_check_repair(cache, out + "/cache_holes.stl", out + "/cache_miss.ply", miss) );
+    REQUIRE( cache.misses() == 1 );
+    REQUIRE( cache.hits() == 0 );
+    REQUIRE( cached_check_repair(cache, out + "/cache_holes.stl", out + "/cache_hit.ply", hit) );
+    REQUIRE( cache.hits() == 1 );
+
+    REQUIRE( without_cache_fields(miss) == reference );
+    REQUIRE( without_cache_fields(hit) == reference );
+    REQUIRE( read_file(out + "/cache_hit.ply") == read_file(out + "/cache_miss.ply") );
+    REQUIRE( read_file(out + "/cache_hit.ply") == read_file(out + "/cache_reference.ply") );
+
+    // the key follows the content, the format of the repaired mesh and not the name of the file
+    REQUIRE( cache.key(out + "/cache_holes.stl", "a.ply") == cache.key(out + "/cache_holes.stl", "b.ply") );
+    REQUIRE( cache.key(out + "/cache_holes.stl", "a.ply") != cache.key(out + "/cache_holes.stl", "a.stl") );
+    REQUIRE( cache.key(out + "/cache_holes.stl", "a.ply") != cache.key(out + "/cache_good.stl", "a.ply") );
+    REQUIRE( cache.key(out + "/cache_missing.stl", "a.ply") == "" );
+
+    // a good mesh is cached without a repaired mesh
+    json_t good;
+    REQUIRE( cached_check_repair(cache, out + "/cache_good.stl", out + "/cache_good_repaired.ply", good) );
+    REQUIRE( cached_check_repair(cache, out + "/cache_good.stl", out + "/cache_good_repaired.ply", good) );
+    REQUIRE( cache.hits() == 2 );
+    REQUIRE( good["is_good_mesh"] == true );
+    REQUIRE( cache.evictions() == 0 );
+
+    // a lost repaired mesh is a miss, the entry is stored again
+    unlink((dir + "/" + cache.key(out + "/cache_holes.stl", "a.ply") + "/repaired.ply").c_str());
+    json_t again;
+    REQUIRE( cached_check_repair(cache, out + "/cache_holes.stl", out + "/cache_hit.ply", again) );
+    REQUIRE( cache.misses() == 3 );
+    REQUIRE( without_cache_fields(again) == reference );
+    REQUIRE( cached_check_repair(cache, out + "/cache_holes.stl", out + "/cache_hit.ply", again) );
+    REQUIRE( cache.hits() == 3 );
+
+    // entries of another revision of the code are not found, and not overwritten
+    resultCache_t other(dir, 1ull << 30, "another revision");
+    REQUIRE( other.key(out + "/cache_holes.stl", "a.ply") != cache.key(out + "/cache_holes.stl", "a.ply") );
+    json_t rebuilt;
+    REQUIRE( cached_check_repair(other, out + "/cache_holes.stl", out + "/cache_hit.ply", rebuilt) );
+    REQUIRE( other.hits() == 0 );
+    REQUIRE( other.misses() == 1 );
+    REQUIRE( without_cache_fields(rebuilt) == reference );
+    json_t same;
+    REQUIRE( cached_check_repair(cache, out + "/cache_holes.stl", out + "/cache_hit.ply", same) );
+    REQUIRE( cache.hits() == 4 );
+
+    // a budget smaller than one entry keeps nothing
+    resultCache_t small(dir, 1);
+    REQUIRE( small.evictions() == 3 );
+    REQUIRE( small.bytes() == 0 );
+    REQUIRE( list_dir(dir).empty() );
+
+    json_t report;
+    cache.output_report(report, true);
+    REQUIRE( report["cache_hit"] == true );
+    REQUIRE( report["cache_hits"] == 4 );
+    REQUIRE( report["cache_misses"] == 3 );
+}
+#endif
+
+}
@@ -0,0 +1,79 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include "fileCheck.hpp"
+
+#include <atomic>
+#include <mutex>
+
+// On disk cache of the check_repair() results, for the files users upload again.
+// An entry is a directory named after its key: the content hash and the size of the
+// input, checkResult_t::version, repairRecord_t::r_version, the revision of the code
+// and the format of the repaired mesh. It holds report.json and, when the mesh was repaired, the repaired mesh.
+// Entries are written aside and renamed in place, so concurrent workers never read
+// half an entry. Once the entries take more than max_bytes the least recently used
+// ones are removed, a hit counts as a use.
+namespace cache{
+
+// revision of the code that fills the cache: the checksum of the sources the Makefile
+// passes as FILECHECK_REVISION, or the build time of the cache without it. Any change
+// of the checker, of the repair or of vcglib makes the old entries unreachable
+std::string build_revision();
+
+class resultCache_t {
+
+    public:
+
+    // dir is created if it does not exist, throws std::runtime_error when it cannot be.
+    // Only the entries stored with the same revision are found
+    resultCache_t(
+        const std::string dir,
+        unsigned long long max_bytes = 1ull << 30,
+        const std::string revision = build_revision()
+    );
+
+    // the key of a file, "" when it cannot be read
+    std::string key(const std::string filepath, const std::string repaired_path) const;
+
+    // on a hit json gets the cached report and the repaired mesh, if any, is copied to repaired_path
+    bool lookup(const std::string key, const std::string repaired_path, json_t& json);
+
+    // keeps the report json and the mesh at repaired_path when json has a repair, then evicts
+    void store(const std::string key, const std::string repaired_path, const json_t& json);
+
+    // adds the counters of the cache to a report
+    void output_report(json_t& json, bool hit) const;
+
+    unsigned long long hits() const { return n_hits; }
+    unsigned long long misses() const { return n_misses; }
+    unsigned long long evictions() const { return n_evictions; }
+    // bytes of the entries after the last eviction
+    unsigned long long bytes() const { return n_bytes; }
+
+    private:
+
+    void evict();
+
+    std::string dir;
+    unsigned long long max_bytes;
+    std::string revision; // hex digits, part of the key
+    std::atomic<unsigned long long> n_hits;
+    std::atomic<unsigned long long> n_misses;
+    std::atomic<unsigned long long> n_evictions;
+    std::atomic<unsigned long long> n_bytes;
+    std::atomic<unsigned long long> n_stored; // names the temporary entries
+    std::mutex evict_mutex;
+};
+
+// check_repair() answered from the cache when it has the file, stored into it otherwise
+bool cached_check_repair(
+    resultCache_t& cache,
+    const std::string filepath,
+    const std::string repaired_path,
+    json_t& json,
+    util::stageTimes_t* times = nullptr
+);
+
+}
+
+#endif
@@ -0,0 +1,616 @@
+#include "server.hpp"
+#include "batch.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include <sstream>
+#include <vcg/complex/algorithms/create/platonic.h>
+#endif
+
+namespace server{
+
+// set by SIGINT and SIGTERM once server_main() installed the handlers
+static volatile std::sig_atomic_t signalled = 0;
+
+static void on_signal(int) {
+    signalled = 1;
+}
+
+// a request line longer than this is refused and its connection closed
+static const size_t max_line = 1 << 20;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point t1) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count();
+}
+
+const int histogram_t::n_buckets;
+
+histogram_t::histogram_t() : n(0), sum_ms(0), max_ms(0) {
+    std::fill(counts, counts + n_buckets, 0ull);
+}
+
+double histogram_t::upper_bound(int bucket) {
+    return std::ldexp(1., bucket - 4);
+}
+
+void histogram_t::add(double ms) {
+    int b = 0;
+    while (b < n_buckets - 1 && ms > upper_bound(b))
+        ++b;
+    ++counts[b];
+    ++n;
+    sum_ms += ms;
+    max_ms = std::max(max_ms, ms);
+}
+
+double histogram_t::quantile(double q) const {
+    const unsigned long long target = (unsigned long long) std::ceil(q * n);
+    unsigned long long seen = 0;
+    for (int b = 0; b < n_buckets - 1; ++b) {
+        seen += counts[b];
+        if (seen >= target && seen > 0)
+            return std::min(upper_bound(b), max_ms);
+    }
+    return max_ms;
+}
+
+json_t histogram_t::to_json() const {
+    int last = n_buckets - 1;
+    while (last >= 0 && counts[last] == 0)
+        --last;
+    json_t le = json_t::array(), c = json_t::array();
+    for (int b = 0; b <= last; ++b) {
+        // the last bucket has no bound
+        le.push_back(b < n_buckets - 1 ? json_t(upper_bound(b)) : json_t());
+        c.push_back(counts[b]);
+    }
+    return {
+        {"count", n}, {"sum", sum_ms}, {"max", max_ms},
+        {"p50", quantile(0.5)}, {"p99", quantile(0.99)},
+        {"le", le}, {"counts", c}
+    };
+}
+
+bool parse_request(const std::string& line, request_t& request, std::string& error) {
+    json_t j;
+    try {
+        j = json_t::parse(line);
+    } catch (const std::exception& e) {
+        error = std::string("not json: ") + e.what();
+        return false;
+    }
+    if (!j.is_object()) {
+        error = "a request is a json object";
+        return false;
+    }
+    if (j.count("id"))
+        request.id = j["id"];
+
+    auto text = [&](const char* key, std::string& value) {
+        if (!j.count(key) || !j[key].is_string() || j[key].get<std::string>().empty()) {
+            error = std::string("missing ") + key;
+            return false;
+        }
+        value = j[key].get<std::string>();
+        return true;
+    };
+    if (!text("op", request.op))
+        return false;
+    if (request.op == "stats" || request.op == "shutdown")
+        return true;
+    if (request.op != "check" && request.op != "repair") {
+        error = "unknown op " + request.op;
+        return false;
+    }
+    if (!text("path", request.path))
+        return false;
+    if (request.op == "check")
+        return true;
+    if (!text("repaired_path", request.repaired_path))
+        return false;
+    // the repair would overwrite the mesh it reads
+    if (request.repaired_path == request.path) {
+        error = "repaired_path is the path";
+        return false;
+    }
+    return true;
+}
+
+static unsigned int workers_or_cores(unsigned int n_workers) {
+    return n_workers ? n_workers : std::max(1u, std::thread::hardware_concurrency());
+}
+
+server_t::server_t(unsigned int n_workers, size_t queue_capacity) :
+        n_workers(workers_or_cores(n_workers)),
+        capacity(queue_capacity ? queue_capacity : 2 * workers_or_cores(n_workers)),
+        stopped(false), running(0), n_completed(0), n_failed(0), n_refused(0) {
+    // as in the batch the meshes are on the heap unless pooling is asked for, the idle workers
+    // then keep at most a fifth of the free memory between them
+    if (util::pooling_requested()) {
+        const unsigned long long max_cached = batch::available_memory() / 5 / this->n_workers;
+        for (unsigned int i = 0; i < this->n_workers; ++i)
+            arenas.emplace_back(new util::arena_t(true, max_cached));
+    }
+    for (unsigned int i = 0; i < this->n_workers; ++i)
+        threads.emplace_back(&server_t::work, this, i);
+}
+
+server_t::~server_t() {
+    shutdown();
+    wait();
+}
+
+bool server_t::submit(const request_t& request, respond_t respond) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [&]() { return stopped || queue.size() < capacity; });
+    if (stopped) {
+        ++n_refused;
+        return false;
+    }
+    queue_depth.add(double(queue.size()));
+    queue.push_back(job_t{request, respond, std::chrono::steady_clock::now()});
+    not_empty.notify_one();
+    return true;
+}
+
+void server_t::handle(const std::string& line, respond_t respond) {
+    request_t request;
+    std::string error;
+    json_t response;
+    if (!parse_request(line, request, error)) {
+        response["error"] = error;
+    } else if (request.op == "stats") {
+        response = stats();
+    } else if (request.op == "shutdown") {
+        shutdown();
+        response["stopping"] = true;
+    } else if (submit(request, respond)) {
+        return;
+    } else {
+        response["error"] = "the server is shutting down";
+    }
+    response["id"] = request.id;
+    response["ok"] = error.empty() && !response.count("error");
+    respond(response);
+}
+
+void server_t::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+bool server_t::stopping() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stopped;
+}
+
+void server_t::wait() {
+    for (auto& thread : threads)
+        if (thread.joinable())
+            thread.join();
+}
+
+json_t server_t::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json_t latency = json_t::object();
+    for (auto& l : latencies)
+        latency[l.first] = l.second.to_json();
+    return {
+        {"workers", n_workers},
+        {"queue_capacity", capacity},
+        {"queue_depth", queue.size()},
+        {"running", running},
+        {"completed", n_completed},
+        {"failed", n_failed},
+        {"refused", n_refused},
+        {"stopping", stopped},
+        {"queue_depth_at_submit", queue_depth.to_json()},
+        {"latency_ms", latency}
+    };
+}
+
+json_t server_t::run(const request_t& request, unsigned int worker, util::stageTimes_t& times) {
+    util::arenaScope_t scope(arenas.empty() ? nullptr : arenas[worker].get());
+    json_t report;
+    if (request.op == "repair") {
+        if (!check_repair(request.path, request.repaired_path, report, &times))
+            throw std::runtime_error("cannot load the mesh");
+        return report;
+    }
+    MyMesh mesh;
+    auto t1 = std::chrono::steady_clock::now();
+    if (!loadMesh(mesh, request.path))
+        throw std::runtime_error("cannot load the mesh");
+    times.push_back(std::make_pair("load", elapsed_ms(t1)));
+    file_check(mesh, true, &times).output_report(report);
+    return report;
+}
+
+void server_t::work(unsigned int worker) {
+    for (;;) {
+        job_t job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [&]() { return stopped || !queue.empty(); });
+            // once stopped the queue still drains
+            if (queue.empty())
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            ++running;
+        }
+        not_full.notify_one();
+
+#ifdef _OPENMP
+        // the cores are shared between the workers
+        omp_set_num_threads(std::max(1, omp_get_num_procs() / (int) n_workers));
+#endif
+        const double queue_ms = elapsed_ms(job.queued);
+        auto t1 = std::chrono::steady_clock::now();
+
+        json_t response;
+        util::stageTimes_t times;
+        util::arena_t* const arena = arenas.empty() ? nullptr : arenas[worker].get();
+        const util::arenaStats_t before = arena ? arena->stats() : util::arenaStats_t();
+        try {
+            response["report"] = run(job.request, worker, times);
+        } catch (const std::exception& e) {
+            response["error"] = e.what();
+        } catch (...) {
+            response["error"] = "unknown error";
+        }
+        times.push_back(std::make_pair("total", elapsed_ms(t1)));
+        const util::arenaStats_t after = arena ? arena->stats() : util::arenaStats_t();
+        if (arena)
+            arena->reset();
+
+        json_t timings = json_t::object();
+        for (auto& t : times)
+            timings[t.first] = t.second;
+
+        const bool ok = !response.count("error");
+        response["id"] = job.request.id;
+        response["ok"] = ok;
+        response["worker"] = worker;
+        response["queue_ms"] = queue_ms;
+        response["timings_ms"] = timings;
+        if (arena)
+            response["arena"] = {
+                {"allocations", after.allocations - before.allocations},
+                {"system_allocations", after.system_allocations - before.system_allocations},
+                {"peak_bytes", after.peak_bytes}
+            };
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+            ++(ok ? n_completed : n_failed);
+            latencies["queue"].add(queue_ms);
+            for (auto& t : times)
+                latencies[t.first].add(t.second);
+        }
+        job.respond(response);
+    }
+}
+
+void serve_stream(server_t& server, std::istream& in, std::ostream& out) {
+    std::mutex out_mutex;
+    auto respond = [&](const json_t& response) {
+        std::lock_guard<std::mutex> lock(out_mutex);
+        out << response.dump() << "\n";
+        out.flush();
+    };
+
+    std::string line;
+    while (!signalled && !server.stopping() && std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        server.handle(line, respond);
+    }
+    server.shutdown();
+    server.wait();
+}
+
+// one client of the socket, shared by its reader and the responses still queued
+struct connection_t {
+    int fd;
+    std::mutex write_mutex;
+    std::atomic<bool> done;
+
+    explicit connection_t(int fd) : fd(fd), done(false) {}
+    ~connection_t() { close(fd); }
+
+    // a client that went away loses its responses
+    void write(const std::string& line) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        for (size_t sent = 0; sent < line.size();) {
+            const ssize_t n = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return;
+            sent += size_t(n);
+        }
+    }
+};
+
+static void read_requests(server_t& server, std::shared_ptr<connection_t> connection) {
+    auto respond = [connection](const json_t& response) {
+        connection->write(response.dump() + "\n");
+    };
+    std::string buffer;
+    char chunk[1 << 16];
+    for (;;) {
+        const ssize_t n = recv(connection->fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        buffer.append(chunk, size_t(n));
+        size_t start = 0;
+        for (size_t end; (end = buffer.find('\n', start)) != std::string::npos; start = end + 1) {
+            const std::string line = buffer.substr(start, end - start);
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                server.handle(line, respond);
+        }
+        buffer.erase(0, start);
+        if (buffer.size() > max_line) {
+            respond({{"ok", false}, {"error", "request line too long"}});
+            buffer.clear();
+            break;
+        }
+    }
+    if (buffer.find_first_not_of(" \t\r") != std::string::npos)
+        server.handle(buffer, respond);
+    connection->done = true;
+}
+
+int serve_socket(server_t& server, const std::string& socket_path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        printf("socket path too long %s\n", socket_path.c_str());
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        printf("cannot create a socket: %s\n", std::strerror(errno));
+        return 1;
+    }
+    // a socket left by a server that did not shut down
+    unlink(socket_path.c_str());
+    if (bind(listener, (sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        printf("cannot listen on %s: %s\n", socket_path.c_str(), std::strerror(errno));
+        close(listener);
+        return 1;
+    }
+
+    struct client_t {
+        std::shared_ptr<connection_t> connection;
+        std::thread reader;
+    };
+    std::vector<client_t> clients;
+
+    while (!signalled && !server.stopping()) {
+        pollfd p = {listener, POLLIN, 0};
+        if (poll(&p, 1, 100) > 0 && (p.revents & POLLIN)) {
+            const int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                client_t client;
+                client.connection = std::make_shared<connection_t>(fd);
+                client.reader = std::thread(read_requests, std::ref(server), client.connection);
+                clients.push_back(std::move(client));
+            }
+        }
+        // the readers of the clients that left
+        for (size_t i = 0; i < clients.size();) {
+            if (clients[i].connection->done) {
+                clients[i].reader.join();
+                clients[i] = std::move(clients.back());
+                clients.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    close(listener);
+    unlink(socket_path.c_str());
+    // the requests still coming are refused, the queued ones are answered
+    server.shutdown();
+    for (auto& client : clients)
+        ::shutdown(client.connection->fd, SHUT_RD);
+    for (auto& client : clients)
+        client.reader.join();
+    server.wait();
+    return 0;
+}
+
+int server_main(const std::string& socket_path, unsigned int n_workers, size_t queue_capacity) {
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    // no SA_RESTART, a blocking read returns and the loops see the flag
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    server_t server(n_workers, queue_capacity);
+    if (socket_path != "-") {
+        printf("serving on %s with %u workers\n", socket_path.c_str(), server.workers());
+        return serve_socket(server, socket_path);
+    }
+
+    // stdout carries the responses only, what the checks print goes to stderr
+    std::cout.flush();
+    fflush(stdout);
+    const int out_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    std::ofstream out("/dev/fd/" + std::to_string(out_fd));
+    serve_stream(server, std::cin, out);
+    close(out_fd);
+    return 0;
+}
+
+#ifdef FILECHECK_TEST
+TEST_CASE( "test server histogram", "[util]" ) {
+    histogram_t h;
+    for (int i = 0; i < 99; ++i)
+        h.add(0.5);
+    h.add(3000);
+    REQUIRE( h.count() == 100 );
+    REQUIRE( h.quantile(0.5) == 0.5 );
+    REQUIRE( h.quantile(0.99) == 0.5 );
+    REQUIRE( h.quantile(1.) == 3000 );
+    json_t j = h.to_json();
+    REQUIRE( j["counts"].size() == 17 );
+    REQUIRE( j["counts"][3] == 99 );
+    REQUIRE( j["le"][16] == 4096 );
+}
+
+TEST_CASE( "test server requests", "[util]" ) {
+    const std::string dir = "./unittest/unittest_out";
+    MyMesh sphere;
+    vcg::tri::Sphere(sphere, 3);
+    exportMesh(sphere, dir + "/server_good.stl");
+    for (size_t i = 0; i < sphere.face.size(); i += 37)
+        vcg::tri::Allocator<MyMesh>::DeleteFace(sphere, sphere.face[i]);
+    exportMesh(sphere, dir + "/server_holes.stl");
+
+    std::stringstream in, out;
+    in << "{\"id\": 1, \"op\": \"check\", \"path\": \"" << dir << "/server_good.stl\"}\n"
+       << "\n"
+       << "{\"id\": 2, \"op\": \"repair\", \"path\": \"" << dir << "/server_holes.stl\", "
+       << "\"repaired_path\": \"" << dir << "/server_repaired.stl\"}\n"
+       << "{\"id\": 3, \"op\": \"check\", \"path\": \"" << dir << "/server_missing.stl\"}\n"
+       << "{\"id\": 4, \"op\": \"repair\", \"path\": \"x.stl\"}\n"
+       << "{\"id\": 5, \"op\": \"repair\", \"path\": \"x.stl\", \"repaired_path\": \"x.stl\"}\n"
+       << "not json\n";
+    {
+        // a queue of one: the reader waits for the workers, pooled as asked
+        setenv("FILECHECK_ARENA", "pooled", 1);
+        server_t server(2, 1);
+        unsetenv("FILECHECK_ARENA");
+        serve_stream(server, in, out);
+        REQUIRE( server.stopping() );
+        json_t stats = server.stats();
+        REQUIRE( stats["completed"] == 2 );
+        REQUIRE( stats["failed"] == 1 );
+        REQUIRE( stats["queue_depth"] == 0 );
+        REQUIRE( stats["latency_ms"]["total"]["count"] == 3 );
+        REQUIRE( stats["latency_ms"].count("check.metrics") == 1 );
+    }
+
+    std::map<int, json_t> responses;
+    json_t unidentified;
+    for (std::string line; std::getline(out, line);) {
+        json_t r = json_t::parse(line);
+        if (r["id"].is_null())
+            unidentified = r;
+        else
+            responses[r["id"].get<int>()] = r;
+    }
+    REQUIRE( responses.size() == 5 );
+    REQUIRE( responses[1]["ok"] == true );
+    REQUIRE( responses[1]["report"]["is_good_mesh"] == true );
+    REQUIRE( responses[1]["report"].count("repair_version") == 0 );
+    REQUIRE( responses[2]["ok"] == true );
+    REQUIRE( responses[2]["report"]["is_good_mesh"] == false );
+    REQUIRE( responses[2]["report"].count("repair_version") == 1 );
+    REQUIRE( responses[2]["arena"]["allocations"].get<unsigned long long>() > 0 );
+    REQUIRE( util::exists(dir + "/server_repaired.stl") );
+    REQUIRE( responses[3]["ok"] == false );
+    REQUIRE( responses[3]["error"] == "cannot load the mesh" );
+    REQUIRE( responses[4]["ok"] == false );
+    REQUIRE( responses[4]["error"] == "missing repaired_path" );
+    REQUIRE( responses[5]["ok"] == false );
+    REQUIRE( responses[5]["error"] == "repaired_path is the path" );
+    REQUIRE( unidentified["ok"] == false );
+
+    for (auto name : {"/server_good.stl", "/server_holes.stl", "/server_repaired.stl"})
+        std::remove((dir + name).c_str());
+}
+
+TEST_CASE( "test server socket", "[util]" ) {
+    const std::string dir = "./unittest/unittest_out";
+    const std::string socket_path = dir + "/server.sock";
+    MyMesh sphere;
+    vcg::tri::Sphere(sphere, 2);
+    exportMesh(sphere, dir + "/server_socket.stl");
+
+    server_t server(1, 4);
+    int result = -1;
+    std::thread serving([&]() { result = serve_socket(server, socket_path); });
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool connected = false;
+    for (int attempt = 0; attempt < 100 && !connected; ++attempt) {
+        connected = connect(fd, (sockaddr*) &address, sizeof(address)) == 0;
+        if (!connected)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // the last request comes without its newline
+    const std::string requests =
+        "{\"id\": \"a\", \"op\": \"check\", \"path\": \"" + dir + "/server_socket.stl\"}\n"
+        "{\"id\": \"b\", \"op\": \"check\", \"path\": \"" + dir + "/server_socket.stl\"}\n"
+        "{\"id\": \"c\", \"op\": \"stats\"}";
+    send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+    ::shutdown(fd, SHUT_WR);
+
+    std::string received;
+    char chunk[4096];
+    for (ssize_t n; std::count(received.begin(), received.end(), '\n') < 3 &&
+                    (n = recv(fd, chunk, sizeof(chunk), 0)) > 0;)
+        received.append(chunk, size_t(n));
+    close(fd);
+
+    server.shutdown();
+    serving.join();
+
+    std::map<std::string, json_t> responses;
+    std::istringstream lines(received);
+    for (std::string line; std::getline(lines, line);) {
+        json_t r = json_t::parse(line);
+        responses[r["id"].get<std::string>()] = r;
+    }
+    REQUIRE( connected );
+    REQUIRE( result == 0 );
+    REQUIRE( responses.size() == 3 );
+    REQUIRE( responses["a"]["report"]["is_good_mesh"] == true );
+    REQUIRE( responses["b"]["report"]["is_good_mesh"] == true );
+    REQUIRE( responses["c"]["workers"] == 1 );
+    REQUIRE( responses["c"]["queue_capacity"] == 4 );
+    REQUIRE( !util::exists(socket_path) );
+
+    std::remove((dir + "/server_socket.stl").c_str());
+}
+#endif
+
+}
@@ -0,0 +1,145 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "fileCheck.hpp"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+
+// Server mode of the filecheck binary: a long lived process taking check and repair
+// requests, one json object per line, on a unix socket or on stdin, and writing one json
+// line per request back as soon as it is done, in the order they finish.
+//
+//   {"id": 1, "op": "check", "path": "in.stl"}
+//   {"id": 2, "op": "repair", "path": "in.stl", "repaired_path": "out.stl"}
+//   {"id": 3, "op": "stats"}       answered at once: queue depth, counters, latency histograms
+//   {"op": "shutdown"}             stops taking requests, the queued ones still run
+//
+// A response echoes the id and has ok, error when it failed, report, timings_ms and queue_ms.
+namespace server{
+
+// latencies in milliseconds, bucket i counts those up to 2^(i - 4) ms, the last one the rest
+class histogram_t {
+
+    public:
+
+    static const int n_buckets = 24;
+
+    histogram_t();
+
+    void add(double ms);
+    unsigned long long count() const { return n; }
+    // the upper bound of the first bucket where the count reaches q of the total
+    double quantile(double q) const;
+    // count, sum_ms, max_ms, p50_ms, p99_ms and the bucket counts up to the last non empty one
+    json_t to_json() const;
+
+    static double upper_bound(int bucket);
+
+    private:
+
+    unsigned long long counts[n_buckets];
+    unsigned long long n;
+    double sum_ms;
+    double max_ms;
+};
+
+struct request_t {
+    json_t id;
+    std::string op;             // check, repair, stats or shutdown
+    std::string path;
+    std::string repaired_path;  // repair only
+};
+
+// a request line, false with error set when it is not one
+bool parse_request(const std::string& line, request_t& request, std::string& error);
+
+// A bounded queue of requests in front of a fixed set of workers. submit() blocks while the
+// queue is full, so a client sending faster than the workers check stops being read and the
+// kernel buffers push back on it. With FILECHECK_ARENA=pooled every worker keeps a pooled arena
+// warm across requests, see util::arena_t. shutdown() refuses the new requests, the queued ones
+// run to the end.
+class server_t {
+
+    public:
+
+    typedef std::function<void(const json_t&)> respond_t;
+
+    // n_workers 0 means one per core, queue_capacity 0 twice the workers
+    server_t(unsigned int n_workers = 0, size_t queue_capacity = 0);
+    // shuts down and waits for the queue to drain
+    ~server_t();
+
+    server_t(const server_t&) = delete;
+    server_t& operator=(const server_t&) = delete;
+
+    // queues a request, respond is called from a worker with its response.
+    // Blocks while the queue is full, false when the server is shutting down
+    bool submit(const request_t& request, respond_t respond);
+
+    // answers one request line: stats and shutdown at once, check and repair through
+    // submit(), a malformed request with an error
+    void handle(const std::string& line, respond_t respond);
+
+    void shutdown();
+    bool stopping() const;
+    // until the queue is drained and the workers are done
+    void wait();
+
+    json_t stats() const;
+
+    unsigned int workers() const { return n_workers; }
+
+    private:
+
+    struct job_t {
+        request_t request;
+        respond_t respond;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    void work(unsigned int worker);
+    json_t run(const request_t& request, unsigned int worker, util::stageTimes_t& times);
+
+    const unsigned int n_workers;
+    const size_t capacity;
+    std::vector<std::unique_ptr<util::arena_t>> arenas;  // one per worker when pooled, else none
+    std::vector<std::thread> threads;
+
+    mutable std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<job_t> queue;
+    bool stopped;
+    unsigned int running;
+
+    unsigned long long n_completed;
+    unsigned long long n_failed;
+    unsigned long long n_refused;
+    histogram_t queue_depth;  // at every submit, in requests rather than milliseconds
+    std::map<std::string, histogram_t> latencies;  // queue, total and the stages
+};
+
+// request lines from in, response lines to out, until the end of in or a shutdown request.
+// Returns once every queued request is answered
+void serve_stream(server_t& server, std::istream& in, std::ostream& out);
+
+// listens on a unix socket at socket_path, any number of clients, until a shutdown
+// request, SIGINT or SIGTERM. Returns 1 when the socket cannot be set up
+int serve_socket(server_t& server, const std::string& socket_path);
+
+// socket_path "-" serves stdin and stdout
+int server_main(const std::string& socket_path, unsigned int n_workers = 0, size_t queue_capacity = 0);
+
+}
+
+#endif
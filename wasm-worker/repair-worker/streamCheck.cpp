@@ -0,0 +1,401 @@
+#include "streamCheck.hpp"
+#include "externalSort.hpp"
+
+#include <cstring>
+#include <cstdint>
+#include <limits>
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include "benchmark/meshGenerator.hpp"
+#endif
+
+namespace stream{
+
+// exact position of a vertex, -0 is folded on +0 as the vertex welding does
+struct key_t {
+    uint32_t c[3];
+
+    bool operator<(const key_t& o) const {
+        return c[0] != o.c[0] ? c[0] < o.c[0] : c[1] != o.c[1] ? c[1] < o.c[1] : c[2] < o.c[2];
+    }
+    bool operator==(const key_t& o) const {
+        return c[0] == o.c[0] && c[1] == o.c[1] && c[2] == o.c[2];
+    }
+    bool operator!=(const key_t& o) const { return !(*this == o); }
+
+    vcg::Point3d position() const {
+        float p[3];
+        memcpy(p, c, sizeof(p));
+        return vcg::Point3d(p[0], p[1], p[2]);
+    }
+};
+
+static key_t make_key(const float* p) {
+    key_t key;
+    for (int k = 0; k < 3; ++k) {
+        const float x = p[k] == 0.f ? 0.f : p[k];
+        memcpy(&key.c[k], &x, sizeof(float));
+    }
+    return key;
+}
+
+// a face by its sorted vertices, flipped when sorting them reversed the orientation
+struct face_t {
+    key_t v[3];
+    uint8_t flipped;
+
+    bool operator<(const face_t& o) const {
+        return v[0] != o.v[0] ? v[0] < o.v[0] : v[1] != o.v[1] ? v[1] < o.v[1] : v[2] < o.v[2];
+    }
+    bool same(const face_t& o) const { return v[0] == o.v[0] && v[1] == o.v[1] && v[2] == o.v[2]; }
+};
+
+// an edge by its sorted vertices, forward when the face goes from a to b
+struct edge_t {
+    key_t a, b;
+    uint8_t forward;
+
+    bool operator<(const edge_t& o) const { return a != o.a ? a < o.a : b < o.b; }
+    bool same(const edge_t& o) const { return a == o.a && b == o.b; }
+};
+
+// facets of a binary or ascii stl, one at a time
+class facetReader_t {
+
+    public:
+
+    explicit facetReader_t(const std::string& filepath) : n_read(0), n_facets(0) {
+        binary = vcg::tri::io::ImporterSTL<MyMesh>::IsSTLBinary(filepath.c_str());
+        file = fopen(filepath.c_str(), binary ? "rb" : "r");
+        if (file == NULL)
+            throw std::runtime_error("cannot open " + filepath);
+        if (binary) {
+            int facenum = 0;
+            if (fseek(file, 80, SEEK_SET) != 0 || fread(&facenum, sizeof(int), 1, file) != 1 || facenum < 0) {
+                fclose(file);
+                throw std::runtime_error("cannot read the header of " + filepath);
+            }
+            n_facets = facenum;
+            block.resize(4096 * 50);
+            next = end = 0;
+        }
+    }
+
+    ~facetReader_t() { fclose(file); }
+
+    // the three vertices of the next facet, false at the end of the file
+    bool next_facet(float p[9]) {
+        return binary ? next_binary(p) : next_ascii(p);
+    }
+
+    private:
+
+    bool next_binary(float p[9]) {
+        if (n_read == n_facets)
+            return false;
+        if (next == end) {
+            const size_t want = std::min<unsigned long long>(4096, n_facets - n_read);
+            if (fread(block.data(), 50, want, file) != want)
+                throw std::runtime_error("the stl ends before its last facet");
+            next = 0;
+            end = want * 50;
+        }
+        // normal, three vertices and the attribute short
+        memcpy(p, &block[next + 12], 9 * sizeof(float));
+        next += 50;
+        ++n_read;
+        return true;
+    }
+
+    bool next_ascii(float p[9]) {
+        char token[64];
+        int n_vertex = 0;
+        while (n_vertex < 3 && fscanf(file, "%63s", token) == 1) {
+            if (strcmp(token, "vertex") != 0)
+                continue;
+            if (fscanf(file, "%f %f %f", &p[n_vertex * 3], &p[n_vertex * 3 + 1], &p[n_vertex * 3 + 2]) != 3)
+                throw std::runtime_error("bad vertex in the ascii stl");
+            ++n_vertex;
+        }
+        if (n_vertex == 0)
+            return false;
+        if (n_vertex != 3)
+            throw std::runtime_error("the stl ends before its last facet");
+        ++n_read;
+        return true;
+    }
+
+    FILE* file;
+    bool binary;
+    std::vector<char> block;
+    size_t next, end;
+    unsigned long long n_read, n_facets;
+};
+
+// sorts three keys, returns true if the permutation was odd
+static bool sort3(key_t v[3]) {
+    bool odd = false;
+    if (v[1] < v[0]) { std::swap(v[0], v[1]); odd = !odd; }
+    if (v[2] < v[1]) { std::swap(v[1], v[2]); odd = !odd; }
+    if (v[1] < v[0]) { std::swap(v[0], v[1]); odd = !odd; }
+    return odd;
+}
+
+checkResult_t stream_check(const std::string filepath, unsigned long long memory_budget, streamStats_t* stats) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    checkResult_t r;
+    streamStats_t s;
+
+    // vertices and faces are sorted together, the edges once the faces are done
+    util::externalSorter_t<key_t> vertices(memory_budget / 3 / sizeof(key_t));
+    util::externalSorter_t<face_t> faces(memory_budget / 3 / sizeof(face_t));
+
+    const float inf = std::numeric_limits<float>::infinity();
+    vcg::Point3f bbmin(inf, inf, inf), bbmax(-inf, -inf, -inf);
+    r.n_degen_faces = 0;
+
+    facetReader_t reader(filepath);
+    float p[9];
+    while (reader.next_facet(p)) {
+        ++s.n_facets;
+        face_t f;
+        for (int k = 0; k < 3; ++k) {
+            f.v[k] = make_key(p + 3 * k);
+            vertices.push(f.v[k]);
+            for (int c = 0; c < 3; ++c) {
+                bbmin[c] = std::min(bbmin[c], p[3 * k + c]);
+                bbmax[c] = std::max(bbmax[c], p[3 * k + c]);
+            }
+        }
+        // two welded vertices make a degenerate face, as RemoveDegenerateFace() finds them
+        if (f.v[0] == f.v[1] || f.v[0] == f.v[2] || f.v[1] == f.v[2]) {
+            ++r.n_degen_faces;
+            continue;
+        }
+        f.flipped = sort3(f.v);
+        faces.push(f);
+    }
+
+    // an empty box is (1, -1) like vcg::Box3::SetNull()
+    if (s.n_facets == 0)
+        bbmin = vcg::Point3f(1, 1, 1), bbmax = vcg::Point3f(-1, -1, -1);
+    r.xmin = bbmin[0]; r.xmax = bbmax[0];
+    r.ymin = bbmin[1]; r.ymax = bbmax[1];
+    r.zmin = bbmin[2]; r.zmax = bbmax[2];
+
+    unsigned long long n_vertices = 0;
+    key_t last_vertex;
+    vertices.merge([&](const key_t& v) {
+        if (n_vertices == 0 || v != last_vertex)
+            ++n_vertices;
+        last_vertex = v;
+    });
+    s.n_runs += vertices.n_runs();
+
+    util::externalSorter_t<edge_t> edges(memory_budget / 2 / sizeof(edge_t));
+    unsigned long long n_faces = 0;
+    r.n_duplicate_faces = 0;
+    util::moments_t moments;
+    face_t last_face;
+    faces.merge([&](const face_t& f) {
+        if (n_faces > 0 && f.same(last_face)) {
+            ++r.n_duplicate_faces; // one of them is kept, as RemoveDuplicateFace() does
+            return;
+        }
+        last_face = f;
+        ++n_faces;
+
+        const key_t q[3] = {f.v[0], f.flipped ? f.v[2] : f.v[1], f.flipped ? f.v[1] : f.v[2]};
+        const vcg::Point3d p0 = q[0].position(), p1 = q[1].position(), p2 = q[2].position();
+        moments.add(p0, p1, p2);
+
+        for (int k = 0; k < 3; ++k) {
+            const key_t& a = q[k];
+            const key_t& b = q[(k + 1) % 3];
+            edges.push(a < b ? edge_t{a, b, 1} : edge_t{b, a, 0});
+        }
+    });
+    s.n_runs += faces.n_runs();
+
+    // faces on an edge: one is a border, more than two a non manifold edge and
+    // two coherently oriented faces walk it in opposite directions
+    unsigned long long n_non_manifold = 0, n_incoherent = 0;
+    unsigned int on_edge = 0, forward = 0;
+    edge_t last_edge;
+    auto close_edge = [&]() {
+        if (on_edge == 0)
+            return;
+        ++s.n_edges;
+        if (on_edge == 1)
+            ++s.n_boundary_edges;
+        else if (on_edge > 2)
+            ++n_non_manifold;
+        // the faces around a non manifold edge form a ring and each one is checked against
+        // the next, that can only hold with as many faces walking the edge each way
+        if (on_edge >= 2 && 2 * forward != on_edge)
+            ++n_incoherent;
+    };
+    edges.merge([&](const edge_t& e) {
+        if (on_edge == 0 || !e.same(last_edge)) {
+            close_edge();
+            on_edge = 0;
+            forward = 0;
+        }
+        last_edge = e;
+        ++on_edge;
+        forward += e.forward;
+    });
+    close_edge();
+    s.n_runs += edges.n_runs();
+
+    r.n_faces = n_faces;
+    r.n_vertices = n_vertices;
+    const util::meshMetrics_t metrics = util::metrics(moments, vcg::Box3f(), true);
+    r.area = metrics.area;
+    r.volume = metrics.volume;
+    for (int k = 0; k < 3; ++k)
+        r.centroid[k] = metrics.centroid[k];
+    for (int k = 0; k < 6; ++k)
+        r.inertia[k] = metrics.inertia[k];
+    r.n_non_manifold_edges = n_non_manifold;
+    r.is_watertight = s.n_boundary_edges == 0 && n_non_manifold == 0;
+    r.is_coherently_oriented = n_incoherent == 0;
+    r.is_positive_volume = r.volume > 0.;
+    r.is_good_mesh = IsGoodMesh(r);
+    // not computed in a stream, see streamCheck.hpp
+    r.n_intersecting_faces = 0;
+    r.n_shells = 0;
+    r.n_holes = 0;
+
+    if (stats)
+        *stats = s;
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::cout << "stream_check() took "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+        << " milliseconds\n";
+    return r;
+}
+
+int stream_check_main(const std::string filepath, const std::string report_path, unsigned long long memory_budget) {
+    streamStats_t stats;
+    checkResult_t r;
+    try {
+        r = stream_check(filepath, memory_budget, &stats);
+    } catch (const std::exception& e) {
+        printf("Error reading file  %s: %s\n", filepath.c_str(), e.what());
+        return 1;
+    }
+
+    json_t json;
+    r.output_report(json);
+    json.erase("num_intersecting_faces");
+    json.erase("num_shells");
+    json.erase("num_holes");
+    json["num_boundary_edges"] = stats.n_boundary_edges;
+
+    std::ofstream file(report_path);
+    file << json;
+    file.close();
+    return 0;
+}
+
+#ifdef FILECHECK_TEST
+TEST_CASE( "test external sort spills", "[util]" ) {
+    std::vector<int> values;
+    for (int i = 0; i < 10000; ++i)
+        values.push_back((i * 7919) % 1237);
+
+    util::externalSorter_t<int> sorter(300, 16);
+    for (auto v : values)
+        sorter.push(v);
+    REQUIRE( sorter.n_runs() > 1 );
+
+    std::vector<int> merged;
+    sorter.merge([&](int v) { merged.push_back(v); });
+    std::sort(values.begin(), values.end());
+    REQUIRE( merged == values );
+}
+
+static void require_same_as_file_check(const checkResult_t& s, const checkResult_t& r) {
+    REQUIRE( s.n_faces == r.n_faces );
+    REQUIRE( s.n_vertices == r.n_vertices );
+    REQUIRE( s.n_degen_faces == r.n_degen_faces );
+    REQUIRE( s.n_duplicate_faces == r.n_duplicate_faces );
+    REQUIRE( s.is_watertight == r.is_watertight );
+    REQUIRE( s.is_coherently_oriented == r.is_coherently_oriented );
+    REQUIRE( s.is_positive_volume == r.is_positive_volume );
+    REQUIRE( s.n_non_manifold_edges == r.n_non_manifold_edges );
+    REQUIRE( s.is_good_mesh == r.is_good_mesh );
+    REQUIRE( s.xmin == r.xmin ); REQUIRE( s.xmax == r.xmax );
+    REQUIRE( s.ymin == r.ymin ); REQUIRE( s.ymax == r.ymax );
+    REQUIRE( s.zmin == r.zmin ); REQUIRE( s.zmax == r.zmax );
+    // the same sums over the faces in another order
+    REQUIRE( s.area == Approx(r.area).epsilon(1e-6) );
+    REQUIRE( s.volume == Approx(r.volume).epsilon(1e-6) );
+    // the moments are taken around the first face, an open or badly oriented mesh
+    // has no solid and each reference point gives its own numbers
+    if (r.is_watertight && r.is_coherently_oriented) {
+        for (int k = 0; k < 3; ++k)
+            REQUIRE( s.centroid[k] == Approx(r.centroid[k]).epsilon(1e-5).margin(1e-5) );
+        for (int k = 0; k < 6; ++k)
+            REQUIRE( s.inertia[k] == Approx(r.inertia[k]).epsilon(1e-5).margin(1e-5) );
+    }
+}
+
+// signed volume of the loaded mesh summed in double, as stream_check() does
+static double volume_in_double(MyMesh& mesh) {
+    double volume = 0.;
+    for (auto& f : mesh.face) if (!f.IsD()) {
+        vcg::Point3d p0, p1, p2;
+        p0.Import(f.P(0)); p1.Import(f.P(1)); p2.Import(f.P(2));
+        volume += p0 * (p1 ^ p2) / 6.;
+    }
+    return volume;
+}
+
+TEST_CASE( "test stream check same as file_check", "[file_check]" ) {
+    const std::string path = "./unittest/unittest_out/stream.stl";
+
+    std::vector<generator::defects_t> cases(5);
+    cases[1].holes = 2;
+    cases[2].flipped_patches = 2;
+    cases[3].duplicates = 3;
+    cases[4].non_manifold_edges = 2;
+    cases[4].self_intersections = 1;
+
+    for (size_t i = 0; i < cases.size(); ++i) {
+        MyMesh mesh;
+        generator::make_torus(mesh, 20000, cases[i]);
+        // a degenerate face too, two corners at the same place
+        const MyMesh::CoordType corner = mesh.vert[0].P();
+        vcg::tri::Allocator<MyMesh>::AddVertex(mesh, corner);
+        vcg::tri::Allocator<MyMesh>::AddFace(mesh, &mesh.vert[0], &mesh.vert.back(), &mesh.vert[1]);
+        exportMesh(mesh, path);
+
+        MyMesh loaded;
+        loadMesh(loaded, path);
+        auto r = file_check(loaded);
+
+        streamStats_t stats;
+        // a budget of a few thousand records forces the runs out to temporary files
+        auto s = stream_check(path, 64 << 10, &stats);
+        REQUIRE( stats.n_runs > 3 );
+        REQUIRE( stats.n_facets == (unsigned long long) mesh.FN() );
+        require_same_as_file_check(s, r);
+        REQUIRE( s.volume == Approx(volume_in_double(loaded)).epsilon(1e-6) );
+    }
+
+    // and an ascii stl
+    MyMesh mesh;
+    generator::make_torus(mesh, 2000);
+    vcg::tri::io::ExporterSTL<MyMesh>::Save(mesh, path.c_str(), false);
+    MyMesh loaded;
+    loadMesh(loaded, path);
+    require_same_as_file_check(stream_check(path), file_check(loaded));
+    std::remove(path.c_str());
+}
+#endif
+
+}
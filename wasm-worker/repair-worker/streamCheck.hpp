@@ -0,0 +1,41 @@
+#ifndef STREAM_CHECK_HPP
+#define STREAM_CHECK_HPP
+
+#include "fileCheck.hpp"
+
+// Check of a stl in bounded memory, for meshes that do not fit in a MyMesh.
+// The facets are read once, vertices, faces and edges are counted through
+// external sorts on their exact positions, the same identity loadMesh() welds on.
+//
+// Filled checkResult_t fields: n_faces, n_vertices, n_degen_faces,
+// n_duplicate_faces, is_watertight, is_coherently_oriented, is_positive_volume,
+// n_non_manifold_edges, is_good_mesh, the bounding box, area and volume.
+// n_intersecting_faces, n_shells and n_holes need the whole mesh and are left out.
+// Area and volume are summed in double, file_check() drifts from them on big meshes.
+namespace stream{
+
+struct streamStats_t {
+    unsigned long long n_facets = 0;          // facets in the file
+    unsigned long long n_edges = 0;
+    unsigned long long n_boundary_edges = 0;
+    size_t n_runs = 0;                        // sorted runs spilled to temporary files
+};
+
+// memory_budget bounds the sort buffers, the rest of the memory use is constant.
+// throws std::runtime_error when the file cannot be read
+checkResult_t stream_check(
+    const std::string filepath,
+    unsigned long long memory_budget = 256ull << 20,
+    streamStats_t* stats = nullptr
+);
+
+// writes the json report of stream_check() without the fields it cannot fill
+int stream_check_main(
+    const std::string filepath,
+    const std::string report_path,
+    unsigned long long memory_budget = 256ull << 20
+);
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "catch.hpp"
+
+#include "fileCheck.hpp"
+#include "benchmark/meshGenerator.hpp"
+
+#include <vcg/complex/algorithms/intersection.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vcg/space/index/bvh.h>
+#include <vcg/space/index/aabb_binary_tree/aabb_binary_tree.h>
+
+#include <algorithm>
+#include <random>
+
+// vcg::BVHIndex of vcg/space/index/bvh.h against the grid and the aabb tree it stands in for
+
+typedef vcg::GridStaticPtr<MyFace, MyMesh::ScalarType> grid_t;
+typedef vcg::AABBBinaryTreeIndex<MyFace, MyMesh::ScalarType, vcg::EmptyClass> tree_t;
+typedef vcg::BVHIndex<MyFace, MyMesh::ScalarType> bvh_t;
+
+// a torus large enough for a few levels of nodes, with faces through its surface.
+// The distance to a face is measured with its normal
+static void make_indexed_torus(MyMesh& mesh) {
+    generator::defects_t defects;
+    defects.self_intersections = 4;
+    generator::make_torus(mesh, 20000, defects);
+    vcg::tri::UpdateBounding<MyMesh>::Box(mesh);
+    vcg::tri::UpdateNormal<MyMesh>::PerFaceNormalized(mesh);
+}
+
+// points around the surface, as the samples of a distance between meshes
+static std::vector<vcg::Point3f> points_near(const MyMesh& mesh, int n, std::mt19937& rng) {
+    const float diag = mesh.bbox.Diag();
+    std::uniform_int_distribution<int> uf(0, mesh.FN() - 1);
+    std::uniform_real_distribution<float> ub(0, 1), near(-0.02f * diag, 0.02f * diag);
+    std::vector<vcg::Point3f> points(n);
+    for (auto& p : points) {
+        const MyFace& f = mesh.face[uf(rng)];
+        float b1 = ub(rng), b2 = ub(rng);
+        if (b1 + b2 > 1) {
+            b1 = 1 - b1;
+            b2 = 1 - b2;
+        }
+        p = f.cP(0) * (1 - b1 - b2) + f.cP(1) * b1 + f.cP(2) * b2 + vcg::Point3f(near(rng), near(rng), near(rng));
+    }
+    return points;
+}
+
+TEST_CASE( "test bvh closest points", "[util]" ) {
+    MyMesh mesh;
+    make_indexed_torus(mesh);
+    grid_t grid;
+    tree_t tree;
+    bvh_t bvh;
+    grid.Set(mesh.face.begin(), mesh.face.end());
+    tree.Set(mesh.face.begin(), mesh.face.end());
+    bvh.Set(mesh.face.begin(), mesh.face.end());
+    REQUIRE( bvh.NodeCount() > 1 );
+
+    std::mt19937 rng(7);
+    const float max_dist = mesh.bbox.Diag();
+    for (const auto& p : points_near(mesh, 2000, rng)) {
+        float d_grid, d_tree, d_bvh;
+        vcg::Point3f c_grid, c_tree, c_bvh;
+        MyFace* f_grid = vcg::tri::GetClosestFaceBase(mesh, grid, p, max_dist, d_grid, c_grid);
+        MyFace* f_tree = vcg::tri::GetClosestFaceBase(mesh, tree, p, max_dist, d_tree, c_tree);
+        MyFace* f_bvh = vcg::tri::GetClosestFaceBase(mesh, bvh, p, max_dist, d_bvh, c_bvh);
+        REQUIRE( f_grid != nullptr );
+        REQUIRE( f_tree != nullptr );
+        REQUIRE( f_bvh != nullptr );
+        // a point closest to an edge or a vertex may pick any of its faces, the distance is the same
+        // up to the rounding of the face it was measured on
+        REQUIRE( d_bvh == Approx(d_grid).margin(1e-6f * max_dist) );
+        REQUIRE( d_bvh == Approx(d_tree).margin(1e-6f * max_dist) );
+    }
+
+    // nothing within a distance shorter than the one to the surface
+    const vcg::Point3f far = mesh.bbox.max + vcg::Point3f(max_dist, max_dist, max_dist);
+    float d;
+    vcg::Point3f c;
+    REQUIRE( vcg::tri::GetClosestFaceBase(mesh, bvh, far, max_dist, d, c) == nullptr );
+}
+
+TEST_CASE( "test bvh rays", "[util]" ) {
+    MyMesh mesh;
+    make_indexed_torus(mesh);
+    tree_t tree;
+    bvh_t bvh;
+    tree.Set(mesh.face.begin(), mesh.face.end());
+    bvh.Set(mesh.face.begin(), mesh.face.end());
+
+    std::mt19937 rng(11);
+    vcg::Box3f box = mesh.bbox;
+    box.Offset(box.Diag() * 0.1f);
+    std::uniform_real_distribution<float> ux(box.min[0], box.max[0]), uy(box.min[1], box.max[1]), uz(box.min[2], box.max[2]);
+    std::normal_distribution<float> dir;
+    const float max_dist = box.Diag();
+    int n_hits = 0;
+    for (int q = 0; q < 2000; ++q) {
+        const vcg::Ray3f ray(vcg::Point3f(ux(rng), uy(rng), uz(rng)), vcg::Point3f(dir(rng), dir(rng), dir(rng)));
+        // the grid misses some nearer hits of the rays starting outside its box, the trees do not
+        float t_tree = -1, t_bvh = -1;
+        const bool hit_tree = vcg::tri::DoRay(mesh, tree, ray, max_dist, t_tree) != nullptr;
+        const bool hit_bvh = vcg::tri::DoRay(mesh, bvh, ray, max_dist, t_bvh) != nullptr;
+        REQUIRE( hit_bvh == hit_tree );
+        if (!hit_bvh)
+            continue;
+        ++n_hits;
+        REQUIRE( t_bvh == t_tree );
+
+        // the nearest hit ahead of the origin, on the face returned
+        vcg::Point3f p_tree, p_bvh;
+        MyFace *f_tree = nullptr, *f_bvh = nullptr;
+        REQUIRE( vcg::IntersectionRayMesh(mesh, tree, ray, p_tree, f_tree) );
+        REQUIRE( vcg::IntersectionRayMesh(mesh, bvh, ray, p_bvh, f_bvh) );
+        REQUIRE( p_bvh == p_tree );
+        float d = max_dist;
+        vcg::Point3f c;
+        vcg::face::PointDistanceBase(*f_bvh, p_bvh, d, c);
+        REQUIRE( d <= 1e-4f * max_dist );
+    }
+    REQUIRE( n_hits > 0 );
+}
+
+TEST_CASE( "test bvh faces in a box", "[util]" ) {
+    MyMesh mesh;
+    make_indexed_torus(mesh);
+    grid_t grid;
+    bvh_t bvh;
+    grid.Set(mesh.face.begin(), mesh.face.end());
+    bvh.Set(mesh.face.begin(), mesh.face.end());
+
+    std::mt19937 rng(13);
+    const float diag = mesh.bbox.Diag();
+    std::uniform_real_distribution<float> side(0, 0.1f * diag);
+    for (const auto& p : points_near(mesh, 500, rng)) {
+        vcg::Box3f box(p, side(rng));
+        std::vector<MyFace*> by_grid, by_bvh;
+        vcg::tri::GetInBoxFace(mesh, grid, box, by_grid);
+        vcg::tri::GetInBoxFace(mesh, bvh, box, by_bvh);
+        std::sort(by_grid.begin(), by_grid.end());
+        std::sort(by_bvh.begin(), by_bvh.end());
+        REQUIRE( by_bvh == by_grid );
+    }
+}
+
+TEST_CASE( "test bvh self intersections", "[util]" ) {
+    MyMesh mesh;
+    make_indexed_torus(mesh);
+    bvh_t bvh;
+    bvh.Set(mesh.face.begin(), mesh.face.end());
+
+    std::vector<MyFace*> by_grid, by_bvh;
+    Clean_t::SelfIntersectionsParallel(mesh, by_grid);
+    Clean_t::SelfIntersectionsParallel(mesh, by_bvh, bvh);
+    REQUIRE( !by_grid.empty() );
+    REQUIRE( by_bvh == by_grid );
+}
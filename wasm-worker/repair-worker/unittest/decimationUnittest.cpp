@@ -0,0 +1,196 @@
+#include "catch.hpp"
+
+#include "fileCheck.hpp"
+#include "benchmark/meshGenerator.hpp"
+
+#include <vcg/complex/append.h>
+#include <vcg/complex/algorithms/local_optimization.h>
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric_parallel.h>
+#include <vcg/complex/algorithms/point_sampling.h>
+#include <vcg/complex/algorithms/update/normal.h>
+
+#include <thread>
+
+// the decimation of vcg::tri::TriEdgeCollapseQuadricParallel by regions against the serial
+// LocalOptimization, on the mesh classes of apps/tridecimator
+
+namespace {
+
+class DeciVertex;
+class DeciFace;
+struct DeciUsedTypes : public vcg::UsedTypes<vcg::Use<DeciVertex>::AsVertexType, vcg::Use<DeciFace>::AsFaceType> {};
+
+class DeciVertex : public vcg::Vertex<DeciUsedTypes, vcg::vertex::VFAdj, vcg::vertex::Coord3f, vcg::vertex::Mark,
+                                      vcg::vertex::Qualityf, vcg::vertex::BitFlags> {
+public:
+    vcg::math::Quadric<double>& Qd() { return q; }
+private:
+    vcg::math::Quadric<double> q;
+};
+
+class DeciFace : public vcg::Face<DeciUsedTypes, vcg::face::VFAdj, vcg::face::VertexRef, vcg::face::BitFlags> {};
+
+class DeciMesh : public vcg::tri::TriMesh<std::vector<DeciVertex>, std::vector<DeciFace> > {};
+
+typedef vcg::tri::BasicVertexPair<DeciVertex> DeciVertexPair;
+
+class DeciCollapse : public vcg::tri::TriEdgeCollapseQuadric<DeciMesh, DeciVertexPair, DeciCollapse, vcg::tri::QInfoStandard<DeciVertex> > {
+public:
+    typedef vcg::tri::TriEdgeCollapseQuadric<DeciMesh, DeciVertexPair, DeciCollapse, vcg::tri::QInfoStandard<DeciVertex> > TECQ;
+    inline DeciCollapse(const DeciVertexPair& p, int i, vcg::BaseParameterClass* pp) : TECQ(p, i, pp) {}
+
+    // the mark of the calling thread
+    static int Mark() { return TECQ::GlobalMark(); }
+};
+
+typedef vcg::tri::TriEdgeCollapseQuadricParallel<DeciMesh, DeciCollapse> parallelDecimation_t;
+typedef vcg::tri::HausdorffSampler<MyMesh> hausdorffSampler_t;
+
+}
+
+// the parameters of tridecimator
+static vcg::tri::TriEdgeCollapseQuadricParameter decimation_parameters() {
+    vcg::tri::TriEdgeCollapseQuadricParameter params;
+    params.QualityThr = .3;
+    return params;
+}
+
+// a torus, with the welded vertices the collapses need
+static void make_decimation_mesh(DeciMesh& mesh, MyMesh& original, unsigned long long n_triangles) {
+    generator::make_torus(original, n_triangles);
+    vcg::tri::UpdateBounding<MyMesh>::Box(original);
+    vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFaceNormalized(original);
+    vcg::tri::Append<DeciMesh, MyMesh>::MeshCopy(mesh, original);
+    vcg::tri::UpdateBounding<DeciMesh>::Box(mesh);
+}
+
+static void decimate_serial(DeciMesh& mesh, int target) {
+    vcg::tri::TriEdgeCollapseQuadricParameter params = decimation_parameters();
+    vcg::LocalOptimization<DeciMesh> session(mesh, &params);
+    session.Init<DeciCollapse>();
+    session.SetTargetSimplices(target);
+    while (session.DoOptimization() && mesh.fn > target);
+    session.Finalize<DeciCollapse>();
+}
+
+static int decimate_parallel(DeciMesh& mesh, int target, int threads) {
+    vcg::tri::TriEdgeCollapseQuadricParameter params = decimation_parameters();
+    parallelDecimation_t decimation(mesh, &params);
+    decimation.threads = threads;
+    decimation.Do(target);
+    return decimation.nRegions;
+}
+
+static void require_same_mesh(const DeciMesh& a, const DeciMesh& b) {
+    REQUIRE( a.vn == b.vn );
+    REQUIRE( a.fn == b.fn );
+    REQUIRE( a.vert.size() == b.vert.size() );
+    REQUIRE( a.face.size() == b.face.size() );
+    for (size_t i = 0; i < a.vert.size(); ++i) {
+        REQUIRE( a.vert[i].IsD() == b.vert[i].IsD() );
+        if (!a.vert[i].IsD())
+            REQUIRE( a.vert[i].cP() == b.vert[i].cP() );
+    }
+    for (size_t i = 0; i < a.face.size(); ++i) {
+        REQUIRE( a.face[i].IsD() == b.face[i].IsD() );
+        if (!a.face[i].IsD())
+            for (int j = 0; j < 3; ++j)
+                REQUIRE( vcg::tri::Index(a, a.face[i].cV(j)) == vcg::tri::Index(b, b.face[i].cV(j)) );
+    }
+}
+
+// the distance sampled on a, measured to b
+static void sample_distance(MyMesh& a, MyMesh& b, float& max_dist, double& mean_dist) {
+    hausdorffSampler_t sampler(&b);
+    sampler.dist_upper_bound = b.bbox.Diag();
+    vcg::tri::SurfaceSampling<MyMesh, hausdorffSampler_t>::SamplingRandomGenerator().initialize(7);
+    vcg::tri::SurfaceSampling<MyMesh, hausdorffSampler_t>::Montecarlo(a, sampler, 50000);
+    max_dist = sampler.getMaxDist();
+    mean_dist = sampler.getMeanDist();
+}
+
+// the symmetric Hausdorff distance and the larger mean between the original and a decimation
+static void hausdorff(MyMesh& original, DeciMesh& decimated, float& max_dist, double& mean_dist) {
+    MyMesh copy;
+    vcg::tri::Append<MyMesh, DeciMesh>::MeshCopy(copy, decimated);
+    vcg::tri::UpdateBounding<MyMesh>::Box(copy);
+    vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFaceNormalized(copy);
+    float there, back;
+    double mean_there, mean_back;
+    sample_distance(original, copy, there, mean_there);
+    sample_distance(copy, original, back, mean_back);
+    max_dist = std::max(there, back);
+    mean_dist = std::max(mean_there, mean_back);
+}
+
+TEST_CASE( "test parallel decimation", "[util]" ) {
+    // past twice the faces of a region the mesh is split
+    MyMesh original;
+    DeciMesh mesh;
+    make_decimation_mesh(mesh, original, 4 * parallelDecimation_t::RegionFaces + 4096);
+    const int target = mesh.fn / 10;
+
+    DeciMesh serial, one, two, four;
+    vcg::tri::Append<DeciMesh, DeciMesh>::MeshCopy(serial, mesh);
+    vcg::tri::Append<DeciMesh, DeciMesh>::MeshCopy(one, mesh);
+    vcg::tri::Append<DeciMesh, DeciMesh>::MeshCopy(two, mesh);
+    vcg::tri::Append<DeciMesh, DeciMesh>::MeshCopy(four, mesh);
+    decimate_serial(serial, target);
+    REQUIRE( decimate_parallel(one, target, 1) == 1 );
+    REQUIRE( decimate_parallel(two, target, 2) == 4 );
+    REQUIRE( decimate_parallel(four, target, 4) == 4 );
+
+    // every collapse removes two faces
+    for (DeciMesh* decimated : {&serial, &one, &two, &four}) {
+        REQUIRE( decimated->fn <= target );
+        REQUIRE( decimated->fn >= target - 1 );
+    }
+
+    // a single thread is the serial decimation, the regions do not depend on the thread count
+    require_same_mesh(one, serial);
+    require_same_mesh(four, two);
+
+    // the regions only change the order of the collapses: the distance to the original is
+    // within a quarter of the serial one
+    float serial_max, regions_max;
+    double serial_mean, regions_mean;
+    hausdorff(original, serial, serial_max, serial_mean);
+    hausdorff(original, four, regions_max, regions_mean);
+    REQUIRE( serial_max > 0 );
+    REQUIRE( regions_max <= 1.25f * serial_max );
+    REQUIRE( regions_mean <= 1.25 * serial_mean );
+}
+
+TEST_CASE( "test decimation counters per thread", "[util]" ) {
+    MyMesh original;
+    DeciMesh mesh, other;
+    make_decimation_mesh(mesh, original, 20000);
+    vcg::tri::Append<DeciMesh, DeciMesh>::MeshCopy(other, mesh);
+
+    DeciCollapse::TEC::FailStat::Init();
+    decimate_serial(mesh, 2000);
+    const int mark = DeciCollapse::Mark();
+    const int out_of_date = DeciCollapse::TEC::FailStat::OutOfDate();
+    REQUIRE( mark > 0 );
+    REQUIRE( out_of_date > 0 );
+
+    // another thread starts from its own zero, and leaves the ones of this thread alone
+    int other_start_mark = -1, other_start_out_of_date = -1, other_mark = 0, other_out_of_date = 0;
+    std::thread([&]() {
+        other_start_mark = DeciCollapse::Mark();
+        other_start_out_of_date = DeciCollapse::TEC::FailStat::OutOfDate();
+        decimate_serial(other, 2000);
+        other_mark = DeciCollapse::Mark();
+        other_out_of_date = DeciCollapse::TEC::FailStat::OutOfDate();
+    }).join();
+    REQUIRE( other_start_mark == 0 );
+    REQUIRE( other_start_out_of_date == 0 );
+    REQUIRE( other_mark > 0 );
+    REQUIRE( other_out_of_date > 0 );
+    REQUIRE( DeciCollapse::Mark() == mark );
+    REQUIRE( DeciCollapse::TEC::FailStat::OutOfDate() == out_of_date );
+
+    // the same collapses from the same start
+    require_same_mesh(other, mesh);
+}
@@ -2,6 +2,10 @@
 
 #include "catch.hpp"
 #include "fileCheck.hpp"
+#include "benchmark/meshGenerator.hpp"
+
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/inertia.h>
 
 std::string meshPath = "./unittest/meshes/";
 checkResult_t results, repair_results;
@@ -138,6 +142,61 @@ TEST_CASE( "test mesh volume", "[file_check]" ) {
     REQUIRE(Volume(Mesh) == (float) 8.);
 }
 
+TEST_CASE( "test fused metrics", "[file_check]" ) {
+    // a 2x2x2 cube far from the origin
+    MyMesh cube;
+    vcg::tri::Box(cube, vcg::Box3f(vcg::Point3f(1000, 2000, 3000), vcg::Point3f(1002, 2002, 3002)));
+    vcg::tri::Clean<MyMesh>::RemoveDuplicateVertex(cube);
+    util::meshMetrics_t m = Metrics(cube);
+    REQUIRE( m.area == Approx(24.) );
+    REQUIRE( m.volume == Approx(8.) );
+    REQUIRE( m.centroid[0] == Approx(1001.) );
+    REQUIRE( m.centroid[1] == Approx(2001.) );
+    REQUIRE( m.centroid[2] == Approx(3001.) );
+    // 8 (2^2 + 2^2) / 12 on the axes, no products
+    for (int k = 0; k < 3; ++k)
+        REQUIRE( m.inertia[k] == Approx(16. / 3.).epsilon(1e-9) );
+    for (int k = 3; k < 6; ++k)
+        REQUIRE( m.inertia[k] == Approx(0.).margin(1e-9) );
+    REQUIRE( m.bbox.min == vcg::Point3f(1000, 2000, 3000) );
+    REQUIRE( m.bbox.max == vcg::Point3f(1002, 2002, 3002) );
+
+    // the second order moments Inertia computes, on a torus
+    MyMesh torus;
+    generator::make_torus(torus, 100000, generator::defects_t());
+    m = Metrics(torus);
+    vcg::tri::Inertia<MyMesh> inertia(torus);
+    vcg::Matrix33f J;
+    inertia.InertiaTensor(J);
+    REQUIRE( m.volume == Approx(inertia.Mass()).epsilon(1e-5) );
+    for (int k = 0; k < 3; ++k)
+        REQUIRE( m.centroid[k] == Approx(inertia.CenterOfMass()[k]).margin(1e-4) );
+    const int u[6] = {0, 1, 2, 0, 0, 1}, v[6] = {0, 1, 2, 1, 2, 2};
+    for (int k = 0; k < 6; ++k)
+        REQUIRE( m.inertia[k] == Approx(J[u[k]][v[k]]).epsilon(1e-4).margin(1e-4 * J[0][0]) );
+
+    // no second sweep for the volume alone, the serial sweep adds up the same
+    util::meshMetrics_t serial = Metrics(torus, false, false);
+    REQUIRE( serial.area == m.area );
+    REQUIRE( serial.volume == m.volume );
+    REQUIRE( serial.centroid == m.centroid );
+    REQUIRE( !serial.has_inertia );
+
+    // deleted faces in between do not change the blocks the live ones are added up in
+    MyMesh holed;
+    vcg::tri::Append<MyMesh, MyMesh>::MeshCopy(holed, torus);
+    for (size_t f = 0; f < holed.face.size(); f += 7)
+        vcg::tri::Allocator<MyMesh>::DeleteFace(holed, holed.face[f]);
+    const util::meshMetrics_t sparse = Metrics(holed);
+    vcg::tri::Allocator<MyMesh>::CompactFaceVector(holed);
+    const util::meshMetrics_t compacted = Metrics(holed);
+    REQUIRE( sparse.area == compacted.area );
+    REQUIRE( sparse.volume == compacted.volume );
+    REQUIRE( sparse.centroid == compacted.centroid );
+    for (int k = 0; k < 6; ++k)
+        REQUIRE( sparse.inertia[k] == compacted.inertia[k] );
+}
+
 TEST_CASE( "test if non manifold edges exists no count hole", "[file_check]" ) {
     MyMesh mesh;
     auto filepath = meshPath+"3dpia-frontplate.stl";
@@ -212,7 +271,7 @@ TEST_CASE( "test no file repair", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.does_fix_coherently_oriented == 0); // no fix coherently oriented
     REQUIRE(repair_record.does_fix_positive_volume == 0); // no fix negative volume
     REQUIRE(repair_record.n_non_manif_f_removed == 0); // no fix for remove non manifold
@@ -229,7 +288,7 @@ TEST_CASE( "test fix volume and coherent oriented", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.does_fix_coherently_oriented == true); // fix for coherently oriented
     REQUIRE(repair_record.does_fix_positive_volume == true); // fix for negative volume
     REQUIRE(repair_record.n_non_manif_f_removed == 0); // no fix for remove non manifold
@@ -247,7 +306,7 @@ TEST_CASE( "test only fix positive volume", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.does_fix_coherently_oriented == 0); // no fix for coherently oriented
     REQUIRE(repair_record.does_fix_positive_volume == 1); // fix for negative volume
     REQUIRE(repair_record.n_non_manif_f_removed == 0); // no fix for remove non manifold
@@ -265,7 +324,7 @@ TEST_CASE( "test only fix coherently oriented", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.does_fix_coherently_oriented == 1); // fix for coherenltly oriented
     REQUIRE(repair_record.does_fix_positive_volume == 0); // fix for negative volume
     REQUIRE(repair_record.n_non_manif_f_removed == 0); // no fix for remove non manifold
@@ -304,7 +363,7 @@ TEST_CASE( "test repair for hole", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.does_fix_coherently_oriented == 0); // no fix for coherently oriented
     REQUIRE(repair_record.does_fix_positive_volume == 0); // fix for negative volume
     REQUIRE(repair_record.n_non_manif_f_removed == 0); // no fix for remove non manifold
@@ -332,7 +391,7 @@ TEST_CASE( "test repair for non manifold", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.does_fix_coherently_oriented == 0); // no fix for coherently oriented
     REQUIRE(repair_record.does_fix_positive_volume == 0); // fix for negative volume
     REQUIRE(repair_record.n_non_manif_f_removed == 3); // remove 3 non manifold faces
@@ -360,7 +419,7 @@ TEST_CASE( "test successful repair", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.is_good_repair == 1); // good repair
 }
 
@@ -377,7 +436,7 @@ TEST_CASE( "test non-successful repair", "[file_repair]" ) {
     // file_repair(mesh, results, repair_record, repaired_path);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.is_good_repair == 0); // bad repair
 }
 
@@ -389,7 +448,7 @@ TEST_CASE( "test repair hole with 4 edges", "[file_repair]" ) {
 
     results = file_check(mesh);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.n_hole_filled == 1); // good repair
 }
 
@@ -402,7 +461,7 @@ TEST_CASE( "test repair hole with more than 1 hole", "[file_repair]" ) {
     results = file_check(mesh);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.n_hole_filled == 2); // good repair
 }
 
@@ -415,10 +474,429 @@ TEST_CASE( "test not repair large hole", "[file_repair]" ) {
     results = file_check(mesh);
     repair_record = file_repair_then_check(mesh, results, repaired_path);
 
-    assert(repair_record.r_version == 1);  // version 1
+    assert(repair_record.r_version == 2);  // version 2
     REQUIRE(repair_record.n_hole_filled == 0); // good repair
 }
 
+// sphere with a few faces removed the way RemoveNonManifoldFace() does it
+void makeDamagedSphere(MyMesh& mesh) {
+    vcg::tri::Sphere(mesh, 3);
+    vcg::tri::UpdateTopology<MyMesh>::FaceFace(mesh);
+    for (size_t i = 0; i < mesh.face.size(); i += 50) {
+        for (int j = 0; j < 3; ++j)
+            if (!vcg::face::IsBorder(mesh.face[i], j))
+                vcg::face::FFDetach(mesh.face[i], j);
+        vcg::tri::Allocator<MyMesh>::DeleteFace(mesh, mesh.face[i]);
+    }
+}
+
+TEST_CASE( "test compactMesh same as reloadMesh", "[file_repair]" ) {
+    MyMesh reloaded, compacted;
+    makeDamagedSphere(reloaded);
+    makeDamagedSphere(compacted);
+
+    reloadMesh(reloaded);
+    compactMesh(compacted);
+
+    REQUIRE( compacted.FN() == reloaded.FN() );
+    REQUIRE( compacted.VN() == reloaded.VN() );
+    REQUIRE( compacted.face.size() == (size_t) compacted.FN() ); // no deleted faces left
+    REQUIRE( Clean_t::IsFFAdjacencyConsistent(compacted) );
+
+    for (size_t i = 0; i < compacted.face.size(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            REQUIRE( vcg::tri::Index(compacted, compacted.face[i].V(j)) == vcg::tri::Index(reloaded, reloaded.face[i].V(j)) );
+            REQUIRE( vcg::tri::Index(compacted, compacted.face[i].FFp(j)) == vcg::tri::Index(reloaded, reloaded.face[i].FFp(j)) );
+            REQUIRE( compacted.face[i].IsB(j) == vcg::face::IsBorder(compacted.face[i], j) );
+        }
+    }
+
+    REQUIRE( Clean_t::CountHoles(compacted) == Clean_t::CountHoles(reloaded) );
+}
+
+TEST_CASE( "test compactMesh links the edges a weld creates", "[file_repair]" ) {
+    // two faces share u, the second one has its own copy of s: welding it joins the edges s u
+    auto make = [](MyMesh& m) {
+        auto v = vcg::tri::Allocator<MyMesh>::AddVertices(m, 5);
+        v[0].P() = MyMesh::CoordType(0, 0, 0);  // s
+        v[1].P() = MyMesh::CoordType(1, 0, 0);  // u
+        v[2].P() = MyMesh::CoordType(0.5f, -1, 0);
+        v[3].P() = MyMesh::CoordType(0, 0, 0);  // copy of s
+        v[4].P() = MyMesh::CoordType(0.5f, 1, 0);
+        vcg::tri::Allocator<MyMesh>::AddFace(m, &m.vert[0], &m.vert[1], &m.vert[2]);
+        vcg::tri::Allocator<MyMesh>::AddFace(m, &m.vert[1], &m.vert[3], &m.vert[4]);
+        vcg::tri::UpdateTopology<MyMesh>::FaceFace(m);
+    };
+    auto count_borders = [](MyMesh& m) {
+        int n = 0;
+        for (auto& f : m.face)
+            for (int j = 0; j < 3; ++j)
+                n += vcg::face::IsBorder(f, j);
+        return n;
+    };
+    MyMesh reloaded, compacted;
+    make(reloaded);
+    make(compacted);
+
+    reloadMesh(reloaded);
+    compactMesh(compacted);
+
+    REQUIRE( compacted.VN() == 4 );
+    REQUIRE( Clean_t::IsFFAdjacencyConsistent(compacted) );
+    REQUIRE( count_borders(compacted) == count_borders(reloaded) );
+    REQUIRE( count_borders(compacted) == 4 );
+    REQUIRE( Clean_t::CountNonManifoldEdgeFF(compacted) == Clean_t::CountNonManifoldEdgeFF(reloaded) );
+}
+
+void checkSameResult(checkResult_t a, checkResult_t b) {
+    REQUIRE( a.n_faces == b.n_faces );
+    REQUIRE( a.n_vertices == b.n_vertices );
+    REQUIRE( a.n_degen_faces == b.n_degen_faces );
+    REQUIRE( a.n_duplicate_faces == b.n_duplicate_faces );
+    REQUIRE( a.is_watertight == b.is_watertight );
+    REQUIRE( a.is_coherently_oriented == b.is_coherently_oriented );
+    REQUIRE( a.is_positive_volume == b.is_positive_volume );
+    REQUIRE( a.n_intersecting_faces == b.n_intersecting_faces );
+    REQUIRE( a.n_shells == b.n_shells );
+    REQUIRE( a.n_non_manifold_edges == b.n_non_manifold_edges );
+    REQUIRE( a.n_holes == b.n_holes );
+    REQUIRE( a.is_good_mesh == b.is_good_mesh );
+    REQUIRE( a.xmin == b.xmin ); REQUIRE( a.xmax == b.xmax );
+    REQUIRE( a.ymin == b.ymin ); REQUIRE( a.ymax == b.ymax );
+    REQUIRE( a.zmin == b.zmin ); REQUIRE( a.zmax == b.zmax );
+    REQUIRE( a.area == b.area );
+    REQUIRE( a.volume == b.volume );
+    for (int k = 0; k < 3; ++k)
+        REQUIRE( a.centroid[k] == b.centroid[k] );
+    for (int k = 0; k < 6; ++k)
+        REQUIRE( a.inertia[k] == b.inertia[k] );
+}
+
+// two overlapping spheres, one of them with holes, plus a fin on a non manifold edge
+void makeDefectiveMesh(MyMesh& mesh, bool withFin) {
+    MyMesh other;
+    makeDamagedSphere(mesh);
+    vcg::tri::Sphere(other, 3);
+    vcg::tri::UpdatePosition<MyMesh>::Translate(other, MyMesh::CoordType(0.5, 0, 0));
+    // the intersection test skips faces smaller than 0.01, work in mm
+    vcg::tri::UpdatePosition<MyMesh>::Scale(mesh, 10.f);
+    vcg::tri::UpdatePosition<MyMesh>::Scale(other, 10.f);
+    vcg::tri::Append<MyMesh, MyMesh>::Mesh(mesh, other);
+    if (withFin) {
+        MyFace& f = other.face[0];
+        vcg::tri::Allocator<MyMesh>::AddFace(mesh, f.P(0), f.P(1), MyMesh::CoordType(30, 30, 30));
+    }
+    vcg::tri::Clean<MyMesh>::RemoveDuplicateVertex(mesh, false);
+    vcg::tri::Allocator<MyMesh>::CompactEveryVector(mesh);
+}
+
+TEST_CASE( "test concurrent file_check same as serial", "[file_check]" ) {
+    for (bool withFin : {false, true}) {
+        MyMesh serialMesh, concurrentMesh;
+        makeDefectiveMesh(serialMesh, withFin);
+        makeDefectiveMesh(concurrentMesh, withFin);
+
+        checkResult_t serial = file_check(serialMesh, false);
+        checkResult_t concurrent = file_check(concurrentMesh, true);
+
+        REQUIRE( serial.n_intersecting_faces > 0 );
+        REQUIRE( serial.n_shells == 2 );
+        REQUIRE( serial.n_non_manifold_edges == (withFin ? 1 : 0) );
+        checkSameResult(serial, concurrent);
+    }
+}
+
+TEST_CASE( "test parallel self intersections same as serial", "[file_check]" ) {
+    MyMesh mesh;
+    makeDefectiveMesh(mesh, true);
+
+    std::vector<MyFace*> serial, parallel;
+    Clean_t::SelfIntersections(mesh, serial);
+    Clean_t::SelfIntersectionsParallel(mesh, parallel);
+
+    REQUIRE( serial.size() > 0 );
+    REQUIRE( parallel.size() == serial.size() );
+    std::sort(serial.begin(), serial.end());
+    std::sort(parallel.begin(), parallel.end());
+    REQUIRE( parallel == serial );
+}
+
+// the repaired mesh goes through file_recheck() only when the state is passed
+repairResult_t checkSameRecheck(MyMesh& full, MyMesh& incremental) {
+    const std::string path = "recheck.stl";
+    checkState_t state;
+    checkResult_t fullCheck = file_check(full);
+    checkResult_t incrementalCheck = file_check(incremental, true, nullptr, &state);
+    checkSameResult(fullCheck, incrementalCheck);
+
+    util::stageTimes_t times;
+    repairResult_t fullRepair = file_repair_then_check(full, fullCheck, path);
+    repairResult_t incrementalRepair = file_repair_then_check(incremental, incrementalCheck, path, &times, &state);
+    std::remove(path.c_str());
+
+    REQUIRE( incrementalRepair.n_hole_filled == fullRepair.n_hole_filled );
+    REQUIRE( incrementalRepair.n_non_manif_f_removed == fullRepair.n_non_manif_f_removed );
+    checkSameResult(fullRepair, incrementalRepair);
+    REQUIRE( incrementalRepair.is_good_repair == fullRepair.is_good_repair );
+
+    bool rechecked = false;
+    for (auto& t : times)
+        rechecked = rechecked || t.first == "r_check.repaired_faces";
+    REQUIRE( rechecked );
+    return incrementalRepair;
+}
+
+TEST_CASE( "test incremental recheck same as file_check", "[file_repair]" ) {
+    for (bool withFin : {false, true}) {
+        MyMesh full, incremental;
+        makeDefectiveMesh(full, withFin);
+        makeDefectiveMesh(incremental, withFin);
+        checkSameRecheck(full, incremental);
+    }
+
+    generator::defects_t defects;
+    defects.holes = 4;
+    defects.flipped_patches = 2;
+    defects.self_intersections = 3;
+    defects.non_manifold_edges = 2;
+    MyMesh full, incremental;
+    generator::make_torus(full, 200000, defects);
+    generator::make_torus(incremental, 200000, defects);
+    repairResult_t r = checkSameRecheck(full, incremental);
+    REQUIRE( r.n_hole_filled == defects.holes );
+    REQUIRE( r.n_intersecting_faces > 0 );
+}
+
+TEST_CASE( "test budgeted file_check", "[file_check]" ) {
+    generator::defects_t defects;
+    defects.holes = 3;
+    defects.self_intersections = 4;
+    MyMesh full, unlimited, capped, expired;
+    for (MyMesh* m : {&full, &unlimited, &capped, &expired})
+        generator::make_torus(*m, 20000, defects);
+
+    checkResult_t reference = file_check(full);
+    REQUIRE( reference.n_intersecting_faces > 1 );
+    REQUIRE( reference.partial.empty() );
+
+    // a budget that is never reached changes nothing
+    util::budget_t large(1e9);
+    checkResult_t r = file_check(unlimited, true, nullptr, nullptr, &large);
+    checkSameResult(reference, r);
+    REQUIRE( r.budgeted );
+    REQUIRE( r.partial.empty() );
+
+    // the intersection test stops at the first pair, the rest is exact
+    util::budget_t onePair(0, 1);
+    r = file_check(capped, true, nullptr, nullptr, &onePair);
+    REQUIRE( r.partial == std::vector<std::string>{"num_intersecting_faces"} );
+    REQUIRE( r.n_intersecting_faces >= 1 );
+    REQUIRE( r.n_intersecting_faces < reference.n_intersecting_faces );
+    REQUIRE( r.n_holes == reference.n_holes );
+    REQUIRE( r.is_watertight == reference.is_watertight );
+
+    // past the deadline only the cheap stages run
+    util::budget_t gone(1e-6);
+    while (!gone.expired()) {}
+    r = file_check(expired, true, nullptr, nullptr, &gone);
+    REQUIRE( r.n_faces == reference.n_faces );
+    REQUIRE( r.n_vertices == reference.n_vertices );
+    REQUIRE( r.area == reference.area );
+    REQUIRE( r.volume == reference.volume );
+    REQUIRE( r.xmin == reference.xmin );
+    REQUIRE( r.partial == std::vector<std::string>{
+        "is_coherently_oriented", "is_good_mesh", "is_watertight", "num_holes",
+        "num_intersecting_faces", "num_non_manifold_edges", "num_shells"} );
+
+    json_t json;
+    r.output_report(json);
+    REQUIRE( json["is_exact"] == false );
+    REQUIRE( json["partial_fields"].size() == 7 );
+    json_t plain;
+    reference.output_report(plain);
+    REQUIRE( plain.count("is_exact") == 0 );
+
+    // the pairs of a budgeted check can be partial, file_recheck() could not trust them
+    checkState_t state;
+    util::budget_t budget(1e9);
+    REQUIRE_THROWS_AS( file_check(full, true, nullptr, &state, &budget), std::invalid_argument );
+}
+
+// a torus with small holes, and pairs of faces removed around a common vertex whose
+// border is a single loop through that vertex
+void makeHoledTorus(MyMesh& mesh) {
+    generator::defects_t defects;
+    defects.holes = 12;
+    generator::make_torus(mesh, 200000, defects);
+    vcg::tri::UpdateTopology<MyMesh>::FaceFace(mesh);
+    for (size_t i = 1000; i < mesh.face.size(); i += 20000) {
+        MyFace& f = mesh.face[i];
+        vcg::face::Pos<MyFace> p(&f, 0, f.V(0));
+        for (int k = 0; k < 3; ++k) {
+            p.FlipE();
+            p.FlipF();
+        }
+        vcg::tri::Allocator<MyMesh>::DeleteFace(mesh, f);
+        vcg::tri::Allocator<MyMesh>::DeleteFace(mesh, *p.F());
+    }
+    vcg::tri::Allocator<MyMesh>::CompactEveryVector(mesh);
+    vcg::tri::UpdateTopology<MyMesh>::FaceFace(mesh);
+}
+
+// the holes filled one at a time, each ear tested against the whole ring of its hole
+int fillHolesOneAtATime(MyMesh& m, int maxSizeHole, float maxHoleBBMin) {
+    typedef vcg::tri::SelfIntersectionEar<MyMesh> ear_t;
+    typedef vcg::tri::Hole<MyMesh> hole_t;
+    std::vector<hole_t::Info> vinfo;
+    hole_t::GetInfo(m, false, vinfo);
+    std::vector<MyFace**> vfpOrig;
+    for (auto& h : vinfo)
+        vfpOrig.push_back(&h.p.f);
+
+    int holeCnt = 0;
+    for (auto& h : vinfo) {
+        if (h.size >= maxSizeHole || h.maxDim >= maxHoleBBMin)
+            continue;
+        ++holeCnt;
+        const int holeSize = ear_t::InitNonManifoldBitOnHoleBoundary(h.p);
+        auto f = vcg::tri::Allocator<MyMesh>::AddFaces(m, holeSize - 2, vfpOrig);
+        std::vector<MyFace*> ring;
+        vcg::face::Pos<MyFace> ip = h.p;
+        do {
+            vcg::face::Pos<MyFace> inp = ip;
+            do {
+                inp.FlipE();
+                inp.FlipF();
+                ring.push_back(inp.f);
+            } while (!inp.IsBorder());
+            ip.NextB();
+        } while (ip != h.p);
+        ear_t::AdjacencyRing().clear();
+        for (auto g : ring)
+            ear_t::AdjacencyRing().push_back(g); // not indexed, every face is tested
+        f += hole_t::CloseEars<ear_t>(h.p, f, holeSize);
+        ear_t::AdjacencyRing().clear();
+        for (; f != m.face.end(); ++f)
+            vcg::tri::Allocator<MyMesh>::DeleteFace(m, *f);
+    }
+    return holeCnt;
+}
+
+TEST_CASE( "test batched hole filling same as one at a time", "[file_repair]" ) {
+    MyMesh batched, single;
+    makeHoledTorus(batched);
+    makeHoledTorus(single);
+    vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFace(batched);
+    vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFace(single);
+    vcg::tri::UpdateBounding<MyMesh>::Box(batched);
+    const float maxDim = 0.01 * batched.bbox.Dim()[batched.bbox.MaxDim()];
+
+    const int batchedHoles = vcg::tri::Hole<MyMesh>::EarCuttingIntersectionFill<vcg::tri::SelfIntersectionEar<MyMesh>>(batched, 100, maxDim, false);
+    const int singleHoles = fillHolesOneAtATime(single, 100, maxDim);
+
+    REQUIRE( batchedHoles > 12 );
+    REQUIRE( batchedHoles == singleHoles );
+    REQUIRE( batched.FN() == single.FN() );
+    REQUIRE( batched.face.size() == single.face.size() );
+    REQUIRE( Clean_t::IsFFAdjacencyConsistent(batched) );
+    for (size_t i = 0; i < batched.face.size(); ++i) {
+        REQUIRE( batched.face[i].IsD() == single.face[i].IsD() );
+        if (batched.face[i].IsD())
+            continue;
+        for (int j = 0; j < 3; ++j) {
+            REQUIRE( vcg::tri::Index(batched, batched.face[i].V(j)) == vcg::tri::Index(single, single.face[i].V(j)) );
+            REQUIRE( vcg::tri::Index(batched, batched.face[i].FFp(j)) == vcg::tri::Index(single, single.face[i].FFp(j)) );
+        }
+    }
+}
+
+// unwelded triangle soup as read from a stl, with a few deleted and signed zero vertices
+void makeTriangleSoup(MyMesh& soup) {
+    MyMesh sphere;
+    vcg::tri::Sphere(sphere, 3);
+    vcg::tri::UpdatePosition<MyMesh>::Translate(sphere, MyMesh::CoordType(1, 0, 0));
+    for (auto fi = sphere.face.begin(); fi != sphere.face.end(); ++fi)
+        vcg::tri::Allocator<MyMesh>::AddFace(soup, fi->P(0), fi->P(1), fi->P(2));
+
+    for (size_t i = 0; i < soup.vert.size(); i += 7) {
+        auto vi = vcg::tri::Allocator<MyMesh>::AddVertex(soup, soup.vert[i].P());
+        vcg::tri::Allocator<MyMesh>::DeleteVertex(soup, *vi);
+    }
+    vcg::tri::Allocator<MyMesh>::AddVertex(soup, MyMesh::CoordType(0.f, 1.f, 0.f));
+    vcg::tri::Allocator<MyMesh>::AddVertex(soup, MyMesh::CoordType(-0.f, 1.f, 0.f));
+    for (size_t i = 0; i < soup.vert.size(); i += 11)
+        vcg::tri::Allocator<MyMesh>::AddVertex(soup, soup.vert[i].P());
+}
+
+TEST_CASE( "test hashed RemoveDuplicateVertex same as sorted", "[file_check]" ) {
+    for (bool removeDegenerate : {false, true}) {
+        MyMesh hashed, sorted;
+        makeTriangleSoup(hashed);
+        makeTriangleSoup(sorted);
+
+        const int hashedDeleted = Clean_t::RemoveDuplicateVertex(hashed, removeDegenerate);
+        const int sortedDeleted = Clean_t::RemoveDuplicateVertexSorted(sorted, removeDegenerate);
+
+        REQUIRE( hashedDeleted > 0 );
+        REQUIRE( hashedDeleted == sortedDeleted );
+        REQUIRE( hashed.VN() == sorted.VN() );
+        REQUIRE( hashed.FN() == sorted.FN() );
+        for (size_t i = 0; i < hashed.vert.size(); ++i)
+            REQUIRE( hashed.vert[i].IsD() == sorted.vert[i].IsD() );
+        for (size_t i = 0; i < hashed.face.size(); ++i)
+            for (int k = 0; k < 3; ++k)
+                REQUIRE( vcg::tri::Index(hashed, hashed.face[i].V(k)) == vcg::tri::Index(sorted, sorted.face[i].V(k)) );
+    }
+}
+
+TEST_CASE( "test flag free counters same as Clean", "[file_check]" ) {
+    for (bool withFin : {false, true}) {
+        MyMesh mesh;
+        makeDefectiveMesh(mesh, withFin);
+        vcg::tri::UpdateTopology<MyMesh>::FaceFace(mesh);
+
+        REQUIRE( NumShell(mesh) == (unsigned int) Clean_t::CountConnectedComponents(mesh) );
+        REQUIRE( NumNonManifoldEdges(mesh) == (unsigned int) Clean_t::CountNonManifoldEdgeFF(mesh) );
+        if (!withFin)
+            REQUIRE( CountHoles(mesh) == Clean_t::CountHoles(mesh) );
+    }
+}
+
+TEST_CASE( "test mapped stl import", "[file_check]" ) {
+    typedef vcg::tri::io::ImporterSTL<MyMesh> ImporterSTL_t;
+    const std::string stl_path = "./unittest/unittest_out/import.stl";
+    MyMesh sphere;
+    vcg::tri::Sphere(sphere, 4);
+    vcg::tri::UpdatePosition<MyMesh>::Translate(sphere, MyMesh::CoordType(-0.25f, 0.5f, 2.f));
+
+    for (bool binary : {true, false}) {
+        vcg::tri::io::ExporterSTL<MyMesh>::Save(sphere, stl_path.c_str(), binary);
+        REQUIRE( ImporterSTL_t::IsSTLBinary(stl_path.c_str()) == binary );
+
+        MyMesh mesh;
+        int mask = 0;
+        REQUIRE( ImporterSTL_t::Open(mesh, stl_path.c_str(), mask) == 0 );
+        REQUIRE( mesh.FN() == sphere.FN() );
+        REQUIRE( mesh.VN() == 3 * sphere.FN() );
+        for (size_t i = 0; i < mesh.face.size(); ++i)
+            for (int k = 0; k < 3; ++k)
+                REQUIRE( vcg::Distance(mesh.face[i].P(k), sphere.face[i].P(k)) < 1e-5f );
+    }
+
+    // a binary file cut in the middle of a facet is reported, not read past its end
+    vcg::tri::io::ExporterSTL<MyMesh>::Save(sphere, stl_path.c_str(), true);
+    std::ifstream in(stl_path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream out(stl_path, std::ios::binary);
+    out.write(bytes.data(), bytes.size() - 30);
+    out.close();
+    MyMesh truncated;
+    int mask = 0;
+    REQUIRE( ImporterSTL_t::Open(truncated, stl_path.c_str(), mask) == ImporterSTL_t::E_UNESPECTEDEOF );
+    std::remove(stl_path.c_str());
+}
+
 TEST_CASE( "test exporter", "[util]" ) {
     MyMesh mesh;
     bool is_successful = loadMesh(mesh, meshPath+"perfect.stl");
@@ -470,6 +948,15 @@ TEST_CASE( "test final export json", "[overall]" ) {
         "max_z",
         "area",
         "volume",
+        "centroid_x",
+        "centroid_y",
+        "centroid_z",
+        "inertia_xx",
+        "inertia_yy",
+        "inertia_zz",
+        "inertia_xy",
+        "inertia_xz",
+        "inertia_yz",
         "repair_version",
         "does_make_coherent_orient",
         "does_flip_normal_outside",
@@ -497,6 +984,8 @@ TEST_CASE( "test final export json", "[overall]" ) {
         "r_max_z",
         "r_area",
         "r_volume",
+        "r_centroid_x",
+        "r_inertia_xx",
     };
 
     for (auto key : keys) {
@@ -0,0 +1,101 @@
+#include "catch.hpp"
+
+#include "fileCheck.hpp"
+#include "benchmark/meshGenerator.hpp"
+
+#include <vcg/complex/algorithms/point_sampling.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vcg/math/histogram.h>
+
+#include <random>
+
+// the sampled distance of vcg/complex/algorithms/point_sampling.h on several threads against
+// HausdorffSampler, with the same seeded montecarlo samples
+
+typedef vcg::tri::HausdorffSampler<MyMesh> serialSampler_t;
+typedef vcg::tri::ParallelHausdorffSampler<MyMesh> parallelSampler_t;
+
+static const unsigned int hausdorff_seed = 7;
+static const int hausdorff_samples = 100000;
+
+// a damaged torus against the clean one, as an original mesh against its repair
+static void make_original_and_repaired(MyMesh& original, MyMesh& repaired) {
+    generator::defects_t defects;
+    defects.holes = 4;
+    defects.self_intersections = 16;
+    generator::make_torus(original, 20000, defects);
+    generator::make_torus(repaired, 20000);
+    vcg::tri::UpdateBounding<MyMesh>::Box(repaired);
+    vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalized(original);
+}
+
+static void sample_parallel(MyMesh& original, parallelSampler_t& sampler, int threads) {
+    sampler.threads = threads;
+    sampler.dist_upper_bound = sampler.m->bbox.Diag();
+    vcg::tri::SurfaceSampling<MyMesh, parallelSampler_t>::SamplingRandomGenerator().initialize(hausdorff_seed);
+    vcg::tri::SurfaceSampling<MyMesh, parallelSampler_t>::Montecarlo(original, sampler, hausdorff_samples);
+    sampler.Compute();
+}
+
+static void require_same_histogram(vcg::Histogramf& a, vcg::Histogramf& b) {
+    REQUIRE( a.BinNum() == b.BinNum() );
+    for (int i = 0; i < a.BinNum() + 2; ++i)
+        REQUIRE( a.BinCountInd(i) == b.BinCountInd(i) );
+    REQUIRE( a.Cnt() == b.Cnt() );
+    REQUIRE( a.Sum() == b.Sum() );
+    REQUIRE( a.RMS() == b.RMS() );
+    REQUIRE( a.MinElem() == b.MinElem() );
+    REQUIRE( a.MaxElem() == b.MaxElem() );
+}
+
+TEST_CASE( "test parallel hausdorff against the serial sampler", "[util]" ) {
+    MyMesh original, repaired;
+    make_original_and_repaired(original, repaired);
+
+    serialSampler_t serial(&repaired);
+    serial.dist_upper_bound = repaired.bbox.Diag();
+    vcg::tri::SurfaceSampling<MyMesh, serialSampler_t>::SamplingRandomGenerator().initialize(hausdorff_seed);
+    vcg::tri::SurfaceSampling<MyMesh, serialSampler_t>::Montecarlo(original, serial, hausdorff_samples);
+
+    parallelSampler_t one(&repaired), several(&repaired);
+    sample_parallel(original, one, 1);
+    sample_parallel(original, several, 4);
+
+    REQUIRE( serial.n_total_samples > hausdorff_samples / 2 );
+    REQUIRE( serial.getMaxDist() > 0 );
+    for (parallelSampler_t* sampler : {&one, &several}) {
+        REQUIRE( sampler->n_total_samples == serial.n_total_samples );
+        REQUIRE( sampler->getMinDist() == serial.getMinDist() );
+        REQUIRE( sampler->getMaxDist() == serial.getMaxDist() );
+        REQUIRE( sampler->getMeanDist() == serial.getMeanDist() );
+        REQUIRE( sampler->getRMSDist() == serial.getRMSDist() );
+        require_same_histogram(sampler->hist, serial.hist);
+    }
+}
+
+TEST_CASE( "test histogram merge", "[util]" ) {
+    std::mt19937 rng(1);
+    std::exponential_distribution<float> value(10);
+    vcg::Histogramf whole, first, second;
+    whole.SetRange(0, 1, 50);
+    first.SetRange(0, 1, 50);
+    second.SetRange(0, 1, 50);
+    for (int i = 0; i < 10000; ++i) {
+        const float v = value(rng);
+        whole.Add(v);
+        (i % 3 ? first : second).Add(v);
+    }
+    first.Merge(second);
+
+    // the counts are whole, the sums only within rounding
+    for (int i = 0; i < whole.BinNum() + 2; ++i)
+        REQUIRE( first.BinCountInd(i) == whole.BinCountInd(i) );
+    REQUIRE( first.Cnt() == whole.Cnt() );
+    REQUIRE( first.MinElem() == whole.MinElem() );
+    REQUIRE( first.MaxElem() == whole.MaxElem() );
+    REQUIRE( first.Avg() == Approx(whole.Avg()) );
+
+    second.ClearCounts();
+    REQUIRE( second.Cnt() == 0 );
+    REQUIRE( second.BinNum() == 50 );
+}
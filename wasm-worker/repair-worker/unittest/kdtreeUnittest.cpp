@@ -0,0 +1,182 @@
+#include "catch.hpp"
+
+#include "fileCheck.hpp"
+#include "benchmark/meshGenerator.hpp"
+
+#include <vcg/space/index/kdtree/kdtree.h>
+#include <vcg/complex/algorithms/point_outlier.h>
+#include <vcg/complex/algorithms/pointcloud_normal.h>
+
+#include <random>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// the batched queries and the parallel build of vcg::KdTree against the queries one at a time
+// and the serial build, and the algorithms that moved to the batches
+
+typedef vcg::KdTree<float> kdTree_t;
+
+// the points of a torus and a few far from it
+static void make_cloud(MyMesh& mesh, int n_outliers) {
+    generator::make_torus(mesh, 50000, generator::defects_t());
+    vcg::tri::UpdateBounding<MyMesh>::Box(mesh);
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> u(-1, 1);
+    const vcg::Box3f box = mesh.bbox;
+    auto vi = vcg::tri::Allocator<MyMesh>::AddVertices(mesh, n_outliers);
+    for (int i = 0; i < n_outliers; ++i, ++vi)
+        vi->P() = box.max + vcg::Point3f(u(rng), u(rng), u(rng)) * box.Diag();
+}
+
+// the k nearest of p one query at a time, nearest first
+static void query_k(kdTree_t& tree, const vcg::Point3f& p, int k,
+                    std::vector<unsigned int>& indices, std::vector<float>& dists) {
+    kdTree_t::PriorityQueue queue;
+    tree.doQueryK(p, k, queue);
+    queue.sort();
+    for (int e = 0; e < queue.getNofElements(); ++e) {
+        indices.push_back(queue.getIndex(e));
+        dists.push_back(queue.getWeight(e));
+    }
+}
+
+TEST_CASE( "test kdtree batch queries", "[util]" ) {
+    MyMesh mesh;
+    make_cloud(mesh, 0);
+    vcg::VertexConstDataWrapper<MyMesh> points(mesh);
+    kdTree_t tree(points);
+
+    // queries around the points, not on them
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> uv(0, mesh.VN() - 1);
+    std::normal_distribution<float> near(0, 0.01f * mesh.bbox.Diag());
+    std::vector<vcg::Point3f> queries(5000);
+    for (auto& q : queries)
+        q = mesh.vert[uv(rng)].cP() + vcg::Point3f(near(rng), near(rng), near(rng));
+    vcg::VectorConstDataWrapper<std::vector<vcg::Point3f> > wrapped(queries);
+
+    const int k = 12;
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> indices;
+    std::vector<float> dists;
+    tree.doQueryKBatch(wrapped, k, offsets, indices, dists);
+    std::vector<size_t> one_offsets(1, 0);
+    std::vector<unsigned int> one_indices;
+    std::vector<float> one_dists;
+    for (const auto& q : queries) {
+        query_k(tree, q, k, one_indices, one_dists);
+        one_offsets.push_back(one_indices.size());
+    }
+    REQUIRE( offsets == one_offsets );
+    REQUIRE( indices == one_indices );
+    REQUIRE( dists == one_dists );
+
+    const float radius = 2 * std::sqrt(one_dists[k - 1]);
+    tree.doQueryDistBatch(wrapped, radius, offsets, indices, dists);
+    one_offsets.assign(1, 0);
+    one_indices.clear();
+    one_dists.clear();
+    for (const auto& q : queries) {
+        tree.doQueryDist(q, radius, one_indices, one_dists);
+        one_offsets.push_back(one_indices.size());
+    }
+    REQUIRE( one_indices.size() > queries.size() );
+    REQUIRE( offsets == one_offsets );
+    REQUIRE( indices == one_indices );
+    REQUIRE( dists == one_dists );
+
+    // fewer points than neighbours asked for, every row has them all
+    std::vector<vcg::Point3f> few(queries.begin(), queries.begin() + 5);
+    vcg::VectorConstDataWrapper<std::vector<vcg::Point3f> > few_points(few);
+    kdTree_t small(few_points);
+    small.doQueryKBatch(wrapped, k, offsets, indices, dists);
+    REQUIRE( offsets.back() == 5 * queries.size() );
+}
+
+#ifdef _OPENMP
+TEST_CASE( "test kdtree parallel build", "[util]" ) {
+    MyMesh mesh;
+    make_cloud(mesh, 0);
+    vcg::VertexConstDataWrapper<MyMesh> points(mesh);
+
+    const int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    kdTree_t serial(points);
+    // past 64 points a leaf per thread the top of the tree is split between the threads
+    omp_set_num_threads(4);
+    REQUIRE( (size_t) mesh.VN() > 64 * 4 * 16 );
+    kdTree_t parallel(points);
+    omp_set_num_threads(threads);
+
+    REQUIRE( parallel._getNumLevel() == serial._getNumLevel() );
+    REQUIRE( parallel._getNodes().size() == serial._getNodes().size() );
+    std::vector<unsigned int> by_serial, by_parallel;
+    std::vector<float> d_serial, d_parallel;
+    for (int i = 0; i < mesh.VN(); i += 7) {
+        query_k(serial, mesh.vert[i].cP(), 8, by_serial, d_serial);
+        query_k(parallel, mesh.vert[i].cP(), 8, by_parallel, d_parallel);
+    }
+    REQUIRE( by_parallel == by_serial );
+    REQUIRE( d_parallel == d_serial );
+}
+#endif
+
+TEST_CASE( "test kdtree callers", "[util]" ) {
+    MyMesh mesh;
+    const int n_outliers = 5;
+    make_cloud(mesh, n_outliers);
+    vcg::VertexConstDataWrapper<MyMesh> points(mesh);
+    kdTree_t tree(points);
+    const int vn = mesh.VN(), k = 16;
+
+    // the LoOP score from the k nearest, one query at a time
+    std::vector<std::vector<unsigned int> > near(vn);
+    std::vector<std::vector<float> > near_dists(vn);
+    for (int i = 0; i < vn; ++i)
+        query_k(tree, mesh.vert[i].cP(), k, near[i], near_dists[i]);
+    std::vector<float> sigma(vn), plof(vn);
+    for (int i = 0; i < vn; ++i) {
+        float sum = 0;
+        for (float d : near_dists[i])
+            sum += d;
+        sigma[i] = std::sqrt(sum / k);
+    }
+    float mean = 0;
+    for (int i = 0; i < vn; ++i) {
+        float sum = 0;
+        for (unsigned int j : near[i])
+            sum += sigma[j];
+        plof[i] = sigma[i] / (sum / k) - 1.0f;
+        mean += plof[i] * plof[i];
+    }
+    mean = std::sqrt(mean / vn);
+
+    vcg::tri::OutlierRemoval<MyMesh>::ComputeLoOPScore(mesh, tree, k);
+    auto score = vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<float>(mesh, std::string("outlierScore"));
+    for (int i = 0; i < vn; ++i) {
+        const float value = plof[i] / (mean * std::sqrt(2.0f));
+        const double dem = 1.0 + 0.278393 * value + 0.230389 * value * value
+            + 0.000972 * value * value * value + 0.078108 * value * value * value * value;
+        REQUIRE( score[i] == Approx(std::max(0.0, 1.0 - 1.0 / dem)).margin(1e-4) );
+    }
+    for (int i = vn - n_outliers; i < vn; ++i)
+        REQUIRE( score[i] > 0.9f );
+
+    // the planes through the neighbours within the distance, one query at a time
+    const float max_dist = 4 * std::sqrt(near_dists[0][k - 1]);
+    vcg::tri::PointCloudNormal<MyMesh>::ComputeUndirectedNormal(mesh, 10, max_dist, tree);
+    for (int i = 0; i < vn; ++i) {
+        std::vector<unsigned int> indices;
+        std::vector<float> dists;
+        query_k(tree, mesh.vert[i].cP(), 10, indices, dists);
+        std::vector<vcg::Point3f> plane_points;
+        for (size_t e = 0; e < indices.size(); ++e)
+            if (dists[e] < max_dist * max_dist)
+                plane_points.push_back(mesh.vert[indices[e]].cP());
+        vcg::Plane3f plane;
+        vcg::FitPlaneToPointSet(plane_points, plane);
+        REQUIRE( mesh.vert[i].cN() == plane.Direction() );
+    }
+}
@@ -0,0 +1,83 @@
+#include "catch.hpp"
+
+#include <vcg/space/intersection3.h>
+#include <vcg/space/intersection/triangle_triangle3_robust.h>
+
+#include <random>
+
+// the exact predicates of vcg/space/intersection/triangle_triangle3_robust.h used by the self intersection check
+
+TEST_CASE( "test robust triangle intersection", "[file_check]" ) {
+    typedef vcg::Point3f P;
+    auto hit = [](P a, P b, P c, P d, P e, P f) { return vcg::IntersectionTriangleTriangleRobust(a, b, c, d, e, f); };
+    const P o(0, 0, 0), x(1, 0, 0), y(0, 1, 0);
+    // crossing along a segment, along an edge in the plane, overlapping on the plane
+    REQUIRE( hit(o, x, y, P(0.25f, 0.25f, -1), P(0.25f, 0.25f, 1), P(2, 2, 0)) );
+    REQUIRE( hit(o, x, y, P(0.5f, -0.5f, 0), P(0.5f, 0.5f, 1), P(0.5f, 0.5f, -1)) );
+    REQUIRE( hit(o, x, y, P(0.2f, 0.2f, 0), P(0.4f, 0.2f, 0), P(0.3f, 0.3f, 1)) );
+    REQUIRE( hit(o, x, y, P(0.25f, 0.25f, 0), P(2, 0, 0), P(0, 2, 0)) );
+    // a single point of contact: a vertex on the face, a vertex on the edge, two edges
+    REQUIRE( !hit(o, x, y, P(0.25f, 0.25f, 0), P(1, 1, 1), P(0, 1, 1)) );
+    REQUIRE( !hit(o, x, y, P(0.5f, 0.5f, 0), P(1, 1, 1), P(1, 1, -1)) );
+    REQUIRE( !hit(o, x, y, P(1, 0, 0), P(2, 0, 1), P(2, 1, -1)) );
+    // just apart
+    REQUIRE( !hit(o, x, y, P(0.5f, 0.5f + 1e-7f, -1), P(0.5f, 0.5f + 1e-7f, 1), P(2, 2, 0)) );
+    REQUIRE( !hit(o, x, y, P(1, 1, 0), P(2, 1, 0), P(1, 2, 0)) );
+    REQUIRE( !hit(o, x, y, P(0, 0, 1e-30f), P(1, 0, 1e-30f), P(0, 1, 1e-30f)) );
+
+    // faces sharing o, the opposite edge through the inside or only on the border of the other
+    auto crosses = [](P a, P b, P p, P q, P r) { return vcg::IntersectionSegmentTriangleInteriorRobust(a, b, p, q, r); };
+    REQUIRE( crosses(P(0.25f, 0.25f, -1), P(0.25f, 0.25f, 1), o, x, y) );
+    REQUIRE( !crosses(P(0.5f, 0.5f, -1), P(0.5f, 0.5f, 1), o, x, y) );
+    REQUIRE( !crosses(P(0.25f, 0.25f, 0), P(0.5f, 0.25f, 0), o, x, y) );
+    REQUIRE( crosses(P(0.25f, 0.25f, 0), P(0.25f, 0.25f, 1), o, x, y) );
+
+    // on a small grid most pairs are degenerate: the answer does not depend on the order
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> grid(0, 3);
+    size_t n_hits = 0;
+    for (int k = 0; k < 20000; ++k) {
+        P t[6];
+        for (auto& p : t)
+            p = P(grid(rng), grid(rng), grid(rng)) * 0.25f;
+        if (vcg::DoubleArea(vcg::Triangle3<float>(t[0], t[1], t[2])) == 0 ||
+            vcg::DoubleArea(vcg::Triangle3<float>(t[3], t[4], t[5])) == 0)
+            continue;
+        const bool h = hit(t[0], t[1], t[2], t[3], t[4], t[5]);
+        n_hits += h;
+        REQUIRE( hit(t[3], t[4], t[5], t[0], t[1], t[2]) == h );
+        REQUIRE( hit(t[1], t[2], t[0], t[5], t[3], t[4]) == h );
+        REQUIRE( hit(t[0], t[2], t[1], t[3], t[5], t[4]) == h );
+    }
+    REQUIRE( n_hits > 1000 );
+
+    // in general position two triangles meet when an edge of one goes through the other
+    auto edge_through = [](const P& a, const P& b, const P* t) {
+        using namespace vcg::predicates;
+        const double e[2][3] = {{a[0], a[1], a[2]}, {b[0], b[1], b[2]}};
+        const double f[3][3] = {{t[0][0], t[0][1], t[0][2]}, {t[1][0], t[1][1], t[1][2]}, {t[2][0], t[2][1], t[2][2]}};
+        if (Orient3D(f[0], f[1], f[2], e[0]) == Orient3D(f[0], f[1], f[2], e[1]))
+            return false;
+        const int s = Orient3D(e[0], e[1], f[0], f[1]);
+        return Orient3D(e[0], e[1], f[1], f[2]) == s && Orient3D(e[0], e[1], f[2], f[0]) == s;
+    };
+    std::uniform_real_distribution<float> box(-1.f, 1.f);
+    size_t n_same = 0, n = 0, n_float = 0;
+    for (int k = 0; k < 20000; ++k, ++n) {
+        P t[6];
+        for (auto& p : t)
+            p = P(box(rng), box(rng), box(rng));
+        bool through = false;
+        for (int z = 0; z < 3; ++z)
+            through = through || edge_through(t[z], t[(z + 1) % 3], t + 3) || edge_through(t[3 + z], t[3 + (z + 1) % 3], t);
+        const bool h = hit(t[0], t[1], t[2], t[3], t[4], t[5]);
+        n_same += h == through;
+        // the float test of vcg misses some
+        if (vcg::IntersectionTriangleTriangle(t[0], t[1], t[2], t[3], t[4], t[5])) {
+            ++n_float;
+            REQUIRE( h );
+        }
+    }
+    REQUIRE( n_float > 0 );
+    REQUIRE( n_same == n );
+}
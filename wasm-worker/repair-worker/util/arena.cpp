@@ -0,0 +1,205 @@
+#include "arena.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include <thread>
+#endif
+
+namespace util{
+
+static thread_local arena_t* current_arena = nullptr;
+
+const int arena_t::n_classes;
+
+// the sizes of the blocks go up by quarter octaves from 64 bytes, a block wastes at most a
+// fifth of itself: class c is (4 + c % 4) << (c / 4 + 4) bytes
+static size_t class_size(int c) {
+    return size_t(4 + c % 4) << (c / 4 + 4);
+}
+
+// the class of the smallest block of at least bytes
+static int block_class(size_t bytes) {
+    int c = 0;
+    while (class_size(c) < bytes)
+        ++c;
+    return c;
+}
+
+arena_t::arena_t(bool pooled, size_t max_cached) : pooled(pooled), max_cached(max_cached) {}
+
+arena_t::~arena_t() {
+    for (auto& blocks : cached)
+        for (void* p : blocks)
+            std::free(p);
+}
+
+// a pooled block starts with its class, the memory handed out follows it
+static const size_t header = 16;
+
+void* arena_t::allocate(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.allocations;
+    if (!pooled) {
+        const size_t size = std::max<size_t>(bytes, 1);
+        void* p = std::malloc(size);
+        if (p == nullptr)
+            throw std::bad_alloc();
+        ++counters.system_allocations;
+        counters.bytes_in_use += size;
+        counters.peak_bytes = std::max(counters.peak_bytes, counters.bytes_in_use);
+        return p;
+    }
+
+    const int c = block_class(bytes + header);
+    // a cached block up to an octave larger is resident already, better than a new one
+    int reuse = c;
+    while (reuse < std::min(c + 4, n_classes) && cached[reuse].empty())
+        ++reuse;
+    char* block = nullptr;
+    if (reuse < std::min(c + 4, n_classes)) {
+        block = static_cast<char*>(cached[reuse].back());
+        cached[reuse].pop_back();
+        counters.bytes_cached -= class_size(reuse);
+        ++counters.reuses;
+    } else {
+        reuse = c;
+        block = static_cast<char*>(std::malloc(class_size(c)));
+        if (block == nullptr)
+            throw std::bad_alloc();
+        ++counters.system_allocations;
+    }
+    *reinterpret_cast<int*>(block) = reuse;
+    counters.bytes_in_use += class_size(reuse);
+    counters.peak_bytes = std::max(counters.peak_bytes, counters.bytes_in_use);
+    return block + header;
+}
+
+void arena_t::release(void* p, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.releases;
+    if (!pooled) {
+        counters.bytes_in_use -= std::max<size_t>(bytes, 1);
+        std::free(p);
+        return;
+    }
+    char* block = static_cast<char*>(p) - header;
+    const int c = *reinterpret_cast<int*>(block);
+    counters.bytes_in_use -= class_size(c);
+    counters.bytes_cached += class_size(c);
+    cached[c].push_back(block);
+}
+
+void arena_t::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.resets;
+    counters.peak_bytes = counters.bytes_in_use;
+    for (int c = n_classes - 1; c >= 0 && max_cached > 0 && counters.bytes_cached > max_cached; --c)
+        while (!cached[c].empty() && counters.bytes_cached > max_cached) {
+            std::free(cached[c].back());
+            cached[c].pop_back();
+            counters.bytes_cached -= class_size(c);
+        }
+}
+
+arenaStats_t arena_t::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+bool pooling_requested() {
+    const char* arena = getenv("FILECHECK_ARENA");
+    return arena != NULL && strcmp(arena, "pooled") == 0;
+}
+
+arena_t* arena_t::current() {
+    return current_arena;
+}
+
+arenaScope_t::arenaScope_t(arena_t* arena) : previous(current_arena) {
+    current_arena = arena;
+}
+
+arenaScope_t::~arenaScope_t() {
+    current_arena = previous;
+}
+
+#ifdef FILECHECK_TEST
+TEST_CASE( "test arena reuses released blocks", "[util]" ) {
+    arena_t arena(true);
+    {
+        arenaScope_t scope(&arena);
+        arenaVector_t<int> v;
+        v.resize(1000);
+        REQUIRE( v.get_allocator().arena == &arena );
+        // a thread keeps the arena the container was built with
+        std::thread([&]() { v.resize(100000); }).join();
+    }
+    arenaStats_t s = arena.stats();
+    REQUIRE( s.bytes_in_use == 0 );
+    REQUIRE( s.allocations == 2 );
+    REQUIRE( s.system_allocations == 2 );
+    REQUIRE( s.bytes_cached == 4096 + 458752 );
+
+    // the same sizes again come from the cache
+    arena.reset();
+    {
+        arenaScope_t scope(&arena);
+        arenaVector_t<int> v(1000);
+        v.resize(100000);
+        REQUIRE( arena.stats().peak_bytes == 4096 + 458752 );
+    }
+    s = arena.stats();
+    REQUIRE( s.system_allocations == 2 );
+    REQUIRE( s.reuses == 2 );
+    REQUIRE( s.resets == 1 );
+
+    // outside of a scope the containers are on the heap
+    arenaVector_t<int> heap(10);
+    REQUIRE( heap.get_allocator().arena == nullptr );
+    REQUIRE( arena.stats().allocations == 4 );
+}
+
+TEST_CASE( "test arena reset trims the cache", "[util]" ) {
+    arena_t arena(true, 1 << 20);
+    void* big = arena.allocate(3 << 20);
+    void* small = arena.allocate(100);
+    void* p = nullptr;
+    arena.release(big, 3 << 20);
+    arena.release(small, 100);
+    REQUIRE( arena.stats().bytes_cached == (7 << 19) + 128 );
+
+    // a cached block up to an octave larger serves a smaller allocation
+    p = arena.allocate(2 << 20);
+    REQUIRE( arena.stats().reuses == 1 );
+    REQUIRE( arena.stats().bytes_in_use == 7 << 19 );
+    arena.release(p, 2 << 20);
+    p = arena.allocate(1 << 20);
+    REQUIRE( arena.stats().system_allocations == 3 );
+    arena.release(p, 1 << 20);
+
+    arena.reset();
+    REQUIRE( arena.stats().bytes_cached == 128 );
+
+    arena_t unpooled(false);
+    p = unpooled.allocate(100);
+    unpooled.release(p, 100);
+    p = unpooled.allocate(100);
+    unpooled.release(p, 100);
+    REQUIRE( unpooled.stats().system_allocations == 2 );
+    REQUIRE( unpooled.stats().bytes_cached == 0 );
+}
+
+TEST_CASE( "test arena pooling is opt in", "[util]" ) {
+    unsetenv("FILECHECK_ARENA");
+    REQUIRE( !pooling_requested() );
+    setenv("FILECHECK_ARENA", "pooled", 1);
+    REQUIRE( pooling_requested() );
+    unsetenv("FILECHECK_ARENA");
+}
+#endif
+
+}
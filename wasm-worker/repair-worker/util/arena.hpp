@@ -0,0 +1,134 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace util{
+
+struct arenaStats_t {
+    unsigned long long allocations = 0;         // allocate() calls
+    unsigned long long releases = 0;            // release() calls
+    unsigned long long reuses = 0;              // allocations served from the cached blocks
+    unsigned long long system_allocations = 0;  // allocations that went to malloc
+    unsigned long long bytes_in_use = 0;        // in the blocks handed out and not released
+    unsigned long long peak_bytes = 0;          // of bytes_in_use since the last reset
+    unsigned long long bytes_cached = 0;        // released and kept for the next allocations
+    unsigned long long resets = 0;
+};
+
+// Pool of memory blocks for the containers of a job, kept warm across jobs.
+//
+// The block sizes go up by quarter octaves. A released block goes to the free list of its size
+// and the next allocation takes back the smallest cached block that fits, up to an octave larger,
+// before going to malloc. A mesh of similar size then runs out of the blocks the previous one
+// left, already resident, and the heap does not see the large vectors come and go. reset() ends
+// a job: the cache is trimmed to max_cached bytes, the largest blocks first. The containers of a
+// job must be gone before its reset().
+//
+// Unpooled, every allocation goes to malloc and every release to free, to count what the
+// heap sees without it. It is thread safe, the stages of a check allocate concurrently.
+//
+// The cache holds every block a job released until its reset() and only hands it back to its
+// own sizes, so a pooled job peaks higher in resident memory than on the heap: the batch and
+// server workers only pool with FILECHECK_ARENA=pooled in the environment, see pooling_requested().
+class arena_t {
+
+    public:
+
+    explicit arena_t(bool pooled = false, size_t max_cached = 0);
+    ~arena_t();
+
+    arena_t(const arena_t&) = delete;
+    arena_t& operator=(const arena_t&) = delete;
+
+    void* allocate(size_t bytes);
+    void release(void* p, size_t bytes);
+
+    // between jobs, max_cached 0 keeps every block
+    void reset();
+    arenaStats_t stats() const;
+
+    // the arena of the calling thread, nullptr when none is set, see arenaScope_t
+    static arena_t* current();
+
+    private:
+
+    friend class arenaScope_t;
+
+    const bool pooled;
+    const size_t max_cached;
+    mutable std::mutex mutex;
+    static const int n_classes = 4 * 56;
+    std::vector<void*> cached[n_classes];  // by block size class
+    arenaStats_t counters;
+};
+
+// whether FILECHECK_ARENA=pooled asks the batch and server workers for pooled arenas
+bool pooling_requested();
+
+// makes an arena the current one of the calling thread for its lifetime,
+// nullptr puts the thread back on the heap
+class arenaScope_t {
+
+    public:
+
+    explicit arenaScope_t(arena_t* arena);
+    ~arenaScope_t();
+
+    arenaScope_t(const arenaScope_t&) = delete;
+    arenaScope_t& operator=(const arenaScope_t&) = delete;
+
+    private:
+
+    arena_t* previous;
+};
+
+// Allocator of the mesh containers and of the scratch buffers of the algorithms on them.
+// It takes the current arena of the thread that builds it, or the heap when there is none,
+// a container keeps its arena when it is moved or swapped
+template <class T>
+class arenaAllocator_t {
+
+    public:
+
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    arenaAllocator_t() : arena(arena_t::current()) {}
+    explicit arenaAllocator_t(arena_t* arena) : arena(arena) {}
+    template <class U>
+    arenaAllocator_t(const arenaAllocator_t<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (arena)
+            return static_cast<T*>(arena->allocate(n * sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (arena)
+            arena->release(p, n * sizeof(T));
+        else
+            ::operator delete(p);
+    }
+
+    arena_t* arena;
+};
+
+template <class T, class U>
+bool operator==(const arenaAllocator_t<T>& a, const arenaAllocator_t<U>& b) { return a.arena == b.arena; }
+template <class T, class U>
+bool operator!=(const arenaAllocator_t<T>& a, const arenaAllocator_t<U>& b) { return a.arena != b.arena; }
+
+template <class T>
+using arenaVector_t = std::vector<T, arenaAllocator_t<T>>;
+
+}
+
+#endif
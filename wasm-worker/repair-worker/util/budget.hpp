@@ -0,0 +1,44 @@
+#ifndef BUDGET_HPP
+#define BUDGET_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace util{
+
+// Deadline and work cap of a check, shared by its stages. The expensive loops poll it
+// and stop early, what they found so far is kept as a partial result. 0 is no limit
+class budget_t {
+
+    public:
+
+    explicit budget_t(double max_ms = 0, unsigned long long max_intersections = 0)
+        : max_intersections(max_intersections), max_ms(max_ms), stopped(false),
+          start(std::chrono::steady_clock::now()) {}
+
+    // intersecting face pairs after which the intersection test stops
+    const unsigned long long max_intersections;
+
+    bool expired() {
+        if (stopped)
+            return true;
+        if (max_ms > 0 && std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count() > max_ms)
+            stopped = true;
+        return stopped;
+    }
+
+    // expired() every 1024 steps of a loop, the clock is not free
+    bool poll(size_t step) { return (step & 1023) == 0 ? expired() : bool(stopped); }
+
+    private:
+
+    const double max_ms;
+    std::atomic<bool> stopped;
+    const std::chrono::steady_clock::time_point start;
+};
+
+}
+
+#endif
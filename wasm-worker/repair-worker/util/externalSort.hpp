@@ -0,0 +1,118 @@
+#ifndef EXTERNAL_SORT_HPP
+#define EXTERNAL_SORT_HPP
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <stdio.h>
+
+namespace util{
+
+// Sorts more records than fit in memory. Records are buffered up to
+// max_records, each full buffer is sorted and spilled as a run to a temporary
+// file, merge() then streams all the records in order through a k-way merge.
+// T must be trivially copyable and ordered by operator<.
+template <class T>
+class externalSorter_t {
+
+    public:
+
+    explicit externalSorter_t(size_t max_records, size_t read_block = 4096)
+        : max_records(std::max<size_t>(max_records, 1)), read_block(std::max<size_t>(read_block, 1)) {
+        buffer.reserve(std::min<size_t>(this->max_records, 1 << 20));
+    }
+
+    ~externalSorter_t() {
+        for (auto run : runs)
+            fclose(run.file);
+    }
+
+    void push(const T& record) {
+        buffer.push_back(record);
+        if (buffer.size() >= max_records)
+            spill();
+    }
+
+    size_t n_runs() const { return runs.size(); }
+
+    // calls fn(record) for every record in sorted order, once
+    template <class F>
+    void merge(F fn) {
+        std::sort(buffer.begin(), buffer.end());
+        if (runs.empty()) {
+            for (const auto& record : buffer)
+                fn(record);
+            std::vector<T>().swap(buffer);
+            return;
+        }
+        spill();
+        std::vector<T>().swap(buffer);
+
+        for (auto& run : runs) {
+            rewind(run.file);
+            run.block.resize(read_block);
+            run.next = run.end = 0;
+        }
+
+        // heap of the current head of each run
+        auto greater = [this](size_t a, size_t b) { return runs[b].head() < runs[a].head(); };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heads(greater);
+        for (size_t i = 0; i < runs.size(); ++i)
+            if (runs[i].fill())
+                heads.push(i);
+
+        while (!heads.empty()) {
+            const size_t i = heads.top();
+            heads.pop();
+            fn(runs[i].head());
+            ++runs[i].next;
+            if (runs[i].fill())
+                heads.push(i);
+        }
+    }
+
+    private:
+
+    struct run_t {
+        FILE* file;
+        std::vector<T> block;
+        size_t next, end;
+
+        const T& head() const { return block[next]; }
+
+        // true if there is a record at next, reads the following block when needed
+        bool fill() {
+            if (next < end)
+                return true;
+            end = fread(block.data(), sizeof(T), block.size(), file);
+            next = 0;
+            return end > 0;
+        }
+    };
+
+    void spill() {
+        if (buffer.empty())
+            return;
+        std::sort(buffer.begin(), buffer.end());
+        FILE* file = tmpfile();
+        if (file == NULL)
+            throw std::runtime_error("cannot create a temporary file for the external sort");
+        if (fwrite(buffer.data(), sizeof(T), buffer.size(), file) != buffer.size()) {
+            fclose(file);
+            throw std::runtime_error("cannot write a run of the external sort");
+        }
+        runs.push_back(run_t{file, {}, 0, 0});
+        buffer.clear();
+    }
+
+    size_t max_records;
+    size_t read_block;
+    std::vector<T> buffer;
+    std::vector<run_t> runs;
+};
+
+}
+
+#endif
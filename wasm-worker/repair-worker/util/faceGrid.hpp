@@ -0,0 +1,185 @@
+#ifndef FACE_GRID_HPP
+#define FACE_GRID_HPP
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <atomic>
+
+#include "budget.hpp"
+
+#include <vcg/space/box3.h>
+#include <vcg/space/index/grid_util.h>
+
+namespace util{
+
+// faces (i, j) by index, i < j
+typedef std::pair<uint32_t, uint32_t> facePair_t;
+
+// Uniform grid of the boxes of faces known by index, laid out as offsets and
+// entries, two arrays of indices in place of a vector per cell. A face goes in
+// every cell its box spans, so any two colliding boxes share a cell.
+// Nothing points into the mesh: the grid stays valid for the faces a repair
+// leaves alone, as long as their old indices can be told apart from the new ones.
+class faceGrid_t {
+
+    public:
+
+    // box(i) is the box of face i, only the faces with keep[i] set go in.
+    // bbox holds all the boxes, the cells are sized as GridStaticPtr sizes them
+    template <class BoxFn>
+    void build(const vcg::Box3f& bbox, size_t n, BoxFn box, const std::vector<char>& keep) {
+        this->bbox = bbox;
+        if (bbox.IsNull())
+            siz = vcg::Point3i(1, 1, 1); // nothing to keep
+        else
+            vcg::BestDim((long long) std::max<size_t>(n, 1), bbox.Dim(), siz);
+        voxel = vcg::Point3f(bbox.DimX() / siz[0], bbox.DimY() / siz[1], bbox.DimZ() / siz[2]);
+
+        // counts per cell, then the offsets, then the entries
+        offset.assign(size_t(siz[0]) * siz[1] * siz[2] + 1, 0);
+        vcg::Point3i lo, hi;
+        for (size_t f = 0; f < n; ++f) if (keep[f]) {
+            cells(box(f), lo, hi);
+            for (int z = lo[2]; z <= hi[2]; ++z)
+                for (int y = lo[1]; y <= hi[1]; ++y)
+                    for (int x = lo[0]; x <= hi[0]; ++x)
+                        ++offset[cell_index(x, y, z) + 1];
+        }
+        for (size_t c = 1; c < offset.size(); ++c)
+            offset[c] += offset[c - 1];
+        entry.resize(offset.back());
+        std::vector<uint32_t> next(offset.begin(), offset.end() - 1);
+        for (size_t f = 0; f < n; ++f) if (keep[f]) {
+            cells(box(f), lo, hi);
+            for (int z = lo[2]; z <= hi[2]; ++z)
+                for (int y = lo[1]; y <= hi[1]; ++y)
+                    for (int x = lo[0]; x <= hi[0]; ++x)
+                        entry[next[cell_index(x, y, z)]++] = (uint32_t) f;
+        }
+    }
+
+    // appends the faces of the cells b spans, a face once per cell.
+    // with min_face, only the faces after it
+    void query(const vcg::Box3f& b, std::vector<uint32_t>& out, long long min_face = -1) const {
+        if (offset.empty())
+            return;
+        vcg::Point3i lo, hi;
+        cells(b, lo, hi);
+        for (int z = lo[2]; z <= hi[2]; ++z)
+            for (int y = lo[1]; y <= hi[1]; ++y)
+                for (int x = lo[0]; x <= hi[0]; ++x) {
+                    const size_t c = cell_index(x, y, z);
+                    for (uint32_t k = offset[c]; k < offset[c + 1]; ++k)
+                        if ((long long) entry[k] > min_face)
+                            out.push_back(entry[k]);
+                }
+    }
+
+    size_t bytes() const { return (offset.capacity() + entry.capacity()) * sizeof(uint32_t); }
+
+    void clear() {
+        std::vector<uint32_t>().swap(offset);
+        std::vector<uint32_t>().swap(entry);
+    }
+
+    private:
+
+    void cells(const vcg::Box3f& b, vcg::Point3i& lo, vcg::Point3i& hi) const {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = cell(b.min[k], k);
+            hi[k] = cell(b.max[k], k);
+        }
+    }
+
+    int cell(float x, int k) const {
+        const int c = voxel[k] > 0 ? int((x - bbox.min[k]) / voxel[k]) : 0;
+        return std::min(std::max(c, 0), siz[k] - 1);
+    }
+
+    size_t cell_index(int x, int y, int z) const { return (size_t(z) * siz[1] + y) * siz[0] + x; }
+
+    vcg::Box3f bbox;
+    vcg::Point3i siz;
+    vcg::Point3f voxel;
+    std::vector<uint32_t> offset;
+    std::vector<uint32_t> entry;
+};
+
+// the pairs of kept faces whose boxes collide and for which intersect(i, j) holds,
+// sorted. The boxes are tested as GridGetInBox() tests them.
+// Before intersect(), filter(i, faces, n, pass) may clear pass[k] for the candidates faces[k]
+// of face i that cannot intersect it, to reject them in a batch (see kernels::plane_separated()).
+// With a budget the search stops when it expires or max_intersections pairs are found,
+// cut is then set and the pairs are the ones found so far
+template <class BoxFn, class FilterFn, class IntersectFn>
+std::vector<facePair_t> self_pairs_filtered(
+    const faceGrid_t& grid, size_t n, BoxFn box, const std::vector<char>& keep, FilterFn filter,
+    IntersectFn intersect, budget_t* budget = nullptr, bool* cut = nullptr
+) {
+    const long long fn = (long long) n;
+    std::vector<facePair_t> pairs;
+    std::atomic<bool> stop(false);
+    std::atomic<unsigned long long> found(0);
+    const unsigned long long max_found = budget ? budget->max_intersections : 0;
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> inBox;
+        std::vector<unsigned char> pass;
+        std::vector<facePair_t> localPairs;
+
+        #pragma omp for schedule(dynamic, 256) nowait
+        for (long long i = 0; i < fn; ++i) if (keep[i] && !stop) {
+            if (budget && budget->poll(i)) {
+                stop = true;
+                continue;
+            }
+            const vcg::Box3f b0 = box(i);
+            inBox.clear();
+            grid.query(b0, inBox, i);
+            std::sort(inBox.begin(), inBox.end());
+            inBox.erase(std::unique(inBox.begin(), inBox.end()), inBox.end());
+            inBox.erase(std::remove_if(inBox.begin(), inBox.end(),
+                [&](uint32_t j) { return !box(j).Collide(b0); }), inBox.end());
+            pass.assign(inBox.size(), 1);
+            filter((uint32_t) i, inBox.data(), inBox.size(), pass.data());
+            for (size_t k = 0; k < inBox.size(); ++k)
+                if (pass[k] && intersect(i, inBox[k])) {
+                    localPairs.push_back(std::make_pair((uint32_t) i, inBox[k]));
+                    if (max_found > 0 && ++found >= max_found)
+                        stop = true;
+                }
+        }
+
+        #pragma omp critical
+        pairs.insert(pairs.end(), localPairs.begin(), localPairs.end());
+    }
+    std::sort(pairs.begin(), pairs.end());
+    if (cut)
+        *cut = stop;
+    return pairs;
+}
+
+// self_pairs_filtered() without a filter
+template <class BoxFn, class IntersectFn>
+std::vector<facePair_t> self_pairs(
+    const faceGrid_t& grid, size_t n, BoxFn box, const std::vector<char>& keep, IntersectFn intersect,
+    budget_t* budget = nullptr, bool* cut = nullptr
+) {
+    return self_pairs_filtered(grid, n, box, keep,
+        [](uint32_t, const uint32_t*, size_t, unsigned char*) {}, intersect, budget, cut);
+}
+
+// the count of SelfIntersectionsParallel() from sorted pairs:
+// every partner, and every face once more for its first pair
+inline unsigned int count_intersecting_faces(const std::vector<facePair_t>& pairs) {
+    unsigned int n = 0;
+    for (size_t k = 0; k < pairs.size(); ++k)
+        n += (k == 0 || pairs[k - 1].first != pairs[k].first) ? 2 : 1;
+    return n;
+}
+
+}
+
+#endif
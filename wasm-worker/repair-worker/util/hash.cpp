@@ -0,0 +1,164 @@
+#include "hash.hpp"
+
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#endif
+
+namespace util{
+
+static const uint64_t P1 = 11400714785074694791ULL;
+static const uint64_t P2 = 14029467366897019727ULL;
+static const uint64_t P3 = 1609587929392839161ULL;
+static const uint64_t P4 = 9650029242287828579ULL;
+static const uint64_t P5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// little endian loads, the hash does not depend on the host
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t x = 0;
+    for (int k = 7; k >= 0; --k)
+        x = (x << 8) | p[k];
+    return x;
+}
+
+static inline uint64_t read32(const unsigned char* p) {
+    return (uint64_t) p[0] | ((uint64_t) p[1] << 8) | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24);
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t merge64(uint64_t h, uint64_t v) {
+    h ^= round64(0, v);
+    return h * P1 + P4;
+}
+
+hash64_t::hash64_t(uint64_t seed) : seed(seed), total(0), buffered(0) {
+    v[0] = seed + P1 + P2;
+    v[1] = seed + P2;
+    v[2] = seed;
+    v[3] = seed - P1;
+}
+
+void hash64_t::update(const void* data, size_t size) {
+    const unsigned char* p = (const unsigned char*) data;
+    const unsigned char* end = p + size;
+    total += size;
+
+    if (buffered + size < 32) {
+        memcpy(buffer + buffered, p, size);
+        buffered += size;
+        return;
+    }
+    if (buffered > 0) {
+        const size_t fill = 32 - buffered;
+        memcpy(buffer + buffered, p, fill);
+        for (int k = 0; k < 4; ++k)
+            v[k] = round64(v[k], read64(buffer + 8 * k));
+        p += fill;
+        buffered = 0;
+    }
+    for (; p + 32 <= end; p += 32)
+        for (int k = 0; k < 4; ++k)
+            v[k] = round64(v[k], read64(p + 8 * k));
+    buffered = end - p;
+    memcpy(buffer, p, buffered);
+}
+
+uint64_t hash64_t::digest() const {
+    uint64_t h;
+    if (total >= 32) {
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+        for (int k = 0; k < 4; ++k)
+            h = merge64(h, v[k]);
+    } else {
+        h = seed + P5;
+    }
+    h += total;
+
+    const unsigned char* p = buffer;
+    const unsigned char* end = buffer + buffered;
+    for (; p + 8 <= end; p += 8) {
+        h ^= round64(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+    }
+    if (p + 4 <= end) {
+        h ^= read32(p) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * P5;
+        h = rotl(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+bool hash_file(const std::string filepath, uint64_t& hash, unsigned long long& size) {
+    FILE* file = fopen(filepath.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    hash64_t h;
+    std::vector<unsigned char> block(1 << 20);
+    size_t n;
+    while ((n = fread(block.data(), 1, block.size(), file)) > 0)
+        h.update(block.data(), n);
+    const bool ok = !ferror(file);
+    fclose(file);
+    hash = h.digest();
+    size = h.size();
+    return ok;
+}
+
+std::string hex64(uint64_t x) {
+    char s[17];
+    snprintf(s, sizeof(s), "%016llx", (unsigned long long) x);
+    return s;
+}
+
+#ifdef FILECHECK_TEST
+TEST_CASE( "test hash64 reference values", "[util]" ) {
+    hash64_t empty;
+    REQUIRE( empty.digest() == 0xef46db3751d8e999ULL );
+
+    hash64_t abc;
+    abc.update("abc", 3);
+    REQUIRE( abc.digest() == 0x44bc2cf5ad770999ULL );
+
+    // 1027 bytes fed whole and in uneven pieces, with and without a seed
+    std::vector<unsigned char> bytes;
+    for (int k = 0; k < 4; ++k)
+        for (int i = 0; i < 256; ++i)
+            bytes.push_back((unsigned char) i);
+    bytes.push_back('x'); bytes.push_back('y'); bytes.push_back('z');
+
+    for (uint64_t seed : {0ULL, 7ULL}) {
+        hash64_t whole(seed), pieces(seed);
+        whole.update(bytes.data(), bytes.size());
+        for (size_t i = 0, step = 1; i < bytes.size(); i += step, step = step * 3 % 67 + 1)
+            pieces.update(bytes.data() + i, std::min(step, bytes.size() - i));
+        REQUIRE( whole.digest() == (seed == 0 ? 0xe146cb31b65bc21aULL : 0x6238bde2ace77002ULL) );
+        REQUIRE( pieces.digest() == whole.digest() );
+    }
+
+    REQUIRE( hex64(0xe146cb31b65bc21aULL) == "e146cb31b65bc21a" );
+    REQUIRE( hex64(42) == "000000000000002a" );
+}
+#endif
+
+}
@@ -0,0 +1,39 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace util{
+
+// XXH64, a fast non cryptographic 64 bit hash, fed in pieces of any size.
+// The digest is the same however the input is split
+class hash64_t {
+
+    public:
+
+    explicit hash64_t(uint64_t seed = 0);
+
+    void update(const void* data, size_t size);
+    uint64_t digest() const;
+    unsigned long long size() const { return total; }
+
+    private:
+
+    uint64_t v[4];
+    uint64_t seed;
+    unsigned long long total;
+    unsigned char buffer[32];
+    size_t buffered;
+};
+
+// hash64_t of the bytes of a file, size gets its size. false when it cannot be read
+bool hash_file(const std::string filepath, uint64_t& hash, unsigned long long& size);
+
+// 16 lowercase hex digits
+std::string hex64(uint64_t x);
+
+}
+
+#endif
@@ -0,0 +1,535 @@
+#include "kernels.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#include <vector>
+#include <random>
+#include <vcg/space/triangle3.h>
+#include <vcg/space/intersection3.h>
+#endif
+
+namespace kernels{
+
+isa_t best_isa() {
+    static const isa_t best = []() {
+        isa_t isa = isa_scalar;
+#ifdef KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2"))
+            isa = isa_sse42;
+        if (__builtin_cpu_supports("avx2"))
+            isa = isa_avx2;
+#endif
+        const char* cap = getenv("FILECHECK_ISA");
+        if (cap != NULL) {
+            if (strcmp(cap, "scalar") == 0)
+                isa = isa_scalar;
+            else if (strcmp(cap, "sse4.2") == 0)
+                isa = std::min(isa, isa_sse42);
+        }
+        return isa;
+    }();
+    return best;
+}
+
+const char* isa_name(isa_t isa) {
+    switch (isa) {
+        case isa_avx2: return "avx2";
+        case isa_sse42: return "sse4.2";
+        default: return "scalar";
+    }
+}
+
+// ------------------------------------------------------------------ scalar
+
+static inline void load(const triangles_t& t, size_t f, float p[3][3]) {
+    for (int z = 0; z < 3; ++z)
+        for (int k = 0; k < 3; ++k)
+            p[z][k] = t.coord[k][t.corner[z][f]];
+}
+
+// twice the area and six times the signed volume of a face, in the order the vector versions use
+static inline void face_sums(const float p[3][3], float& area, float& volume) {
+    const float e1x = p[1][0] - p[0][0], e1y = p[1][1] - p[0][1], e1z = p[1][2] - p[0][2];
+    const float e2x = p[2][0] - p[0][0], e2y = p[2][1] - p[0][1], e2z = p[2][2] - p[0][2];
+    const float cx = e1y * e2z - e1z * e2y;
+    const float cy = e1z * e2x - e1x * e2z;
+    const float cz = e1x * e2y - e1y * e2x;
+    area = std::sqrt((cx * cx + cy * cy) + cz * cz);
+    volume = (p[0][0] * cx + p[0][1] * cy) + p[0][2] * cz;
+}
+
+static void sums_scalar(const triangles_t& t, size_t begin, double& area, double& volume) {
+    float p[3][3], a, v;
+    for (size_t f = begin; f < t.n; ++f) {
+        load(t, f, p);
+        face_sums(p, a, v);
+        area += a;
+        volume += v;
+    }
+}
+
+static void bbox_scalar(const float* const coord[3], size_t begin, size_t n, float min[3], float max[3]) {
+    for (int k = 0; k < 3; ++k)
+        for (size_t i = begin; i < n; ++i) {
+            min[k] = std::min(min[k], coord[k][i]);
+            max[k] = std::max(max[k], coord[k][i]);
+        }
+}
+
+// the corners of q strictly on one side of the plane of p, by more than the rounding
+static inline bool one_side(const float p[3][3], const float q[3][3]) {
+    const float e1x = p[1][0] - p[0][0], e1y = p[1][1] - p[0][1], e1z = p[1][2] - p[0][2];
+    const float e2x = p[2][0] - p[0][0], e2y = p[2][1] - p[0][1], e2z = p[2][2] - p[0][2];
+    const float nx = e1y * e2z - e1z * e2y;
+    const float ny = e1z * e2x - e1x * e2z;
+    const float nz = e1x * e2y - e1y * e2x;
+    const float e1m = std::max(std::max(std::fabs(e1x), std::fabs(e1y)), std::fabs(e1z));
+    const float e2m = std::max(std::max(std::fabs(e2x), std::fabs(e2y)), std::fabs(e2z));
+
+    float s[3], cm = 0;
+    for (int i = 0; i < 3; ++i) {
+        const float dx = q[i][0] - p[0][0], dy = q[i][1] - p[0][1], dz = q[i][2] - p[0][2];
+        s[i] = (nx * dx + ny * dy) + nz * dz;
+        cm = std::max(cm, std::max(std::max(std::fabs(q[i][0]), std::fabs(q[i][1])), std::fabs(q[i][2])));
+        cm = std::max(cm, std::max(std::max(std::fabs(p[i][0]), std::fabs(p[i][1])), std::fabs(p[i][2])));
+    }
+    // the exact test works on the absolute coordinates, its rounding grows with them,
+    // and the normal of a sliver is mostly rounding, its size comes from the edges
+    const float tol = 1e-5f * (((std::fabs(nx) + std::fabs(ny)) + std::fabs(nz)) + e1m * e2m) * cm;
+    return (s[0] > tol && s[1] > tol && s[2] > tol) || (s[0] < -tol && s[1] < -tol && s[2] < -tol);
+}
+
+static void plane_separated_scalar(
+    const triangles_t& t, uint32_t a, const uint32_t* faces, size_t begin, size_t n, unsigned char* keep
+) {
+    float p[3][3], q[3][3];
+    load(t, a, p);
+    for (size_t k = begin; k < n; ++k) {
+        load(t, faces[k], q);
+        if (one_side(p, q) || one_side(q, p))
+            keep[k] = 0;
+    }
+}
+
+#ifdef KERNELS_X86
+
+// ------------------------------------------------------------------ sse4.2
+
+#define SSE42 __attribute__((target("sse4.2")))
+
+SSE42 static inline __m128 gather4(const float* base, const uint32_t* idx) {
+    return _mm_setr_ps(base[idx[0]], base[idx[1]], base[idx[2]], base[idx[3]]);
+}
+
+SSE42 static inline __m128 abs4(__m128 x) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+}
+
+SSE42 static inline void add4(__m128d acc[2], __m128 x) {
+    acc[0] = _mm_add_pd(acc[0], _mm_cvtps_pd(x));
+    acc[1] = _mm_add_pd(acc[1], _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+}
+
+SSE42 static inline double hsum4(const __m128d acc[2]) {
+    double s[4];
+    _mm_storeu_pd(s, acc[0]);
+    _mm_storeu_pd(s + 2, acc[1]);
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+SSE42 static void sums_sse42(const triangles_t& t, double& area, double& volume) {
+    __m128d accA[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+    __m128d accV[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+    size_t f = 0;
+    for (; f + 4 <= t.n; f += 4) {
+        __m128 p[3][3];
+        for (int z = 0; z < 3; ++z)
+            for (int k = 0; k < 3; ++k)
+                p[z][k] = gather4(t.coord[k], t.corner[z] + f);
+        const __m128 e1x = _mm_sub_ps(p[1][0], p[0][0]), e1y = _mm_sub_ps(p[1][1], p[0][1]), e1z = _mm_sub_ps(p[1][2], p[0][2]);
+        const __m128 e2x = _mm_sub_ps(p[2][0], p[0][0]), e2y = _mm_sub_ps(p[2][1], p[0][1]), e2z = _mm_sub_ps(p[2][2], p[0][2]);
+        const __m128 cx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+        const __m128 cy = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+        const __m128 cz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+        const __m128 a = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+        const __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[0][0], cx), _mm_mul_ps(p[0][1], cy)), _mm_mul_ps(p[0][2], cz));
+        add4(accA, a);
+        add4(accV, v);
+    }
+    area += hsum4(accA);
+    volume += hsum4(accV);
+    sums_scalar(t, f, area, volume);
+}
+
+SSE42 static void bbox_sse42(const float* const coord[3], size_t n, float min[3], float max[3]) {
+    size_t i = 0;
+    for (int k = 0; k < 3; ++k) {
+        __m128 lo = _mm_set1_ps(min[k]), hi = _mm_set1_ps(max[k]);
+        for (i = 0; i + 4 <= n; i += 4) {
+            const __m128 x = _mm_loadu_ps(coord[k] + i);
+            lo = _mm_min_ps(lo, x);
+            hi = _mm_max_ps(hi, x);
+        }
+        float l[4], h[4];
+        _mm_storeu_ps(l, lo);
+        _mm_storeu_ps(h, hi);
+        min[k] = std::min(std::min(l[0], l[1]), std::min(l[2], l[3]));
+        max[k] = std::max(std::max(h[0], h[1]), std::max(h[2], h[3]));
+    }
+    bbox_scalar(coord, i, n, min, max);
+}
+
+// one_side() on four pairs at once
+SSE42 static inline __m128 one_side4(const __m128 p[3][3], const __m128 q[3][3]) {
+    const __m128 e1x = _mm_sub_ps(p[1][0], p[0][0]), e1y = _mm_sub_ps(p[1][1], p[0][1]), e1z = _mm_sub_ps(p[1][2], p[0][2]);
+    const __m128 e2x = _mm_sub_ps(p[2][0], p[0][0]), e2y = _mm_sub_ps(p[2][1], p[0][1]), e2z = _mm_sub_ps(p[2][2], p[0][2]);
+    const __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+    const __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+    const __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+    const __m128 e1m = _mm_max_ps(_mm_max_ps(abs4(e1x), abs4(e1y)), abs4(e1z));
+    const __m128 e2m = _mm_max_ps(_mm_max_ps(abs4(e2x), abs4(e2y)), abs4(e2z));
+
+    __m128 s[3], cm = _mm_setzero_ps();
+    for (int i = 0; i < 3; ++i) {
+        const __m128 dx = _mm_sub_ps(q[i][0], p[0][0]), dy = _mm_sub_ps(q[i][1], p[0][1]), dz = _mm_sub_ps(q[i][2], p[0][2]);
+        s[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dx), _mm_mul_ps(ny, dy)), _mm_mul_ps(nz, dz));
+        cm = _mm_max_ps(cm, _mm_max_ps(_mm_max_ps(abs4(q[i][0]), abs4(q[i][1])), abs4(q[i][2])));
+        cm = _mm_max_ps(cm, _mm_max_ps(_mm_max_ps(abs4(p[i][0]), abs4(p[i][1])), abs4(p[i][2])));
+    }
+    const __m128 norm = _mm_add_ps(_mm_add_ps(abs4(nx), abs4(ny)), abs4(nz));
+    const __m128 tol = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(1e-5f), _mm_add_ps(norm, _mm_mul_ps(e1m, e2m))), cm);
+    const __m128 ntol = _mm_sub_ps(_mm_setzero_ps(), tol);
+    const __m128 above = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(s[0], tol), _mm_cmpgt_ps(s[1], tol)), _mm_cmpgt_ps(s[2], tol));
+    const __m128 below = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(s[0], ntol), _mm_cmplt_ps(s[1], ntol)), _mm_cmplt_ps(s[2], ntol));
+    return _mm_or_ps(above, below);
+}
+
+SSE42 static void plane_separated_sse42(
+    const triangles_t& t, uint32_t a, const uint32_t* faces, size_t n, unsigned char* keep
+) {
+    __m128 p[3][3], q[3][3];
+    for (int z = 0; z < 3; ++z)
+        for (int k = 0; k < 3; ++k)
+            p[z][k] = _mm_set1_ps(t.coord[k][t.corner[z][a]]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t idx[4];
+        for (int z = 0; z < 3; ++z) {
+            for (int l = 0; l < 4; ++l)
+                idx[l] = t.corner[z][faces[i + l]];
+            for (int k = 0; k < 3; ++k)
+                q[z][k] = gather4(t.coord[k], idx);
+        }
+        const int separated = _mm_movemask_ps(_mm_or_ps(one_side4(p, q), one_side4(q, p)));
+        for (int l = 0; l < 4; ++l)
+            if (separated & (1 << l))
+                keep[i + l] = 0;
+    }
+    plane_separated_scalar(t, a, faces, i, n, keep);
+}
+
+// ------------------------------------------------------------------ avx2
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256 gather8(const float* base, const uint32_t* idx) {
+    return _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*) idx), 4);
+}
+
+AVX2 static inline __m256 abs8(__m256 x) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+}
+
+AVX2 static inline void add8(__m256d acc[2], __m256 x) {
+    acc[0] = _mm256_add_pd(acc[0], _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+    acc[1] = _mm256_add_pd(acc[1], _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+}
+
+AVX2 static inline double hsum8(const __m256d acc[2]) {
+    double s[8];
+    _mm256_storeu_pd(s, acc[0]);
+    _mm256_storeu_pd(s + 4, acc[1]);
+    return ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+}
+
+AVX2 static void sums_avx2(const triangles_t& t, double& area, double& volume) {
+    __m256d accA[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    __m256d accV[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    size_t f = 0;
+    for (; f + 8 <= t.n; f += 8) {
+        __m256 p[3][3];
+        for (int z = 0; z < 3; ++z)
+            for (int k = 0; k < 3; ++k)
+                p[z][k] = gather8(t.coord[k], t.corner[z] + f);
+        const __m256 e1x = _mm256_sub_ps(p[1][0], p[0][0]), e1y = _mm256_sub_ps(p[1][1], p[0][1]), e1z = _mm256_sub_ps(p[1][2], p[0][2]);
+        const __m256 e2x = _mm256_sub_ps(p[2][0], p[0][0]), e2y = _mm256_sub_ps(p[2][1], p[0][1]), e2z = _mm256_sub_ps(p[2][2], p[0][2]);
+        const __m256 cx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e1z, e2y));
+        const __m256 cy = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e1x, e2z));
+        const __m256 cz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e1y, e2x));
+        const __m256 a = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz)));
+        const __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p[0][0], cx), _mm256_mul_ps(p[0][1], cy)), _mm256_mul_ps(p[0][2], cz));
+        add8(accA, a);
+        add8(accV, v);
+    }
+    area += hsum8(accA);
+    volume += hsum8(accV);
+    sums_scalar(t, f, area, volume);
+}
+
+AVX2 static void bbox_avx2(const float* const coord[3], size_t n, float min[3], float max[3]) {
+    size_t i = 0;
+    for (int k = 0; k < 3; ++k) {
+        __m256 lo = _mm256_set1_ps(min[k]), hi = _mm256_set1_ps(max[k]);
+        for (i = 0; i + 8 <= n; i += 8) {
+            const __m256 x = _mm256_loadu_ps(coord[k] + i);
+            lo = _mm256_min_ps(lo, x);
+            hi = _mm256_max_ps(hi, x);
+        }
+        float l[8], h[8];
+        _mm256_storeu_ps(l, lo);
+        _mm256_storeu_ps(h, hi);
+        min[k] = *std::min_element(l, l + 8);
+        max[k] = *std::max_element(h, h + 8);
+    }
+    bbox_scalar(coord, i, n, min, max);
+}
+
+// one_side() on eight pairs at once
+AVX2 static inline __m256 one_side8(const __m256 p[3][3], const __m256 q[3][3]) {
+    const __m256 e1x = _mm256_sub_ps(p[1][0], p[0][0]), e1y = _mm256_sub_ps(p[1][1], p[0][1]), e1z = _mm256_sub_ps(p[1][2], p[0][2]);
+    const __m256 e2x = _mm256_sub_ps(p[2][0], p[0][0]), e2y = _mm256_sub_ps(p[2][1], p[0][1]), e2z = _mm256_sub_ps(p[2][2], p[0][2]);
+    const __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e1z, e2y));
+    const __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e1x, e2z));
+    const __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e1y, e2x));
+    const __m256 e1m = _mm256_max_ps(_mm256_max_ps(abs8(e1x), abs8(e1y)), abs8(e1z));
+    const __m256 e2m = _mm256_max_ps(_mm256_max_ps(abs8(e2x), abs8(e2y)), abs8(e2z));
+
+    __m256 s[3], cm = _mm256_setzero_ps();
+    for (int i = 0; i < 3; ++i) {
+        const __m256 dx = _mm256_sub_ps(q[i][0], p[0][0]), dy = _mm256_sub_ps(q[i][1], p[0][1]), dz = _mm256_sub_ps(q[i][2], p[0][2]);
+        s[i] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, dx), _mm256_mul_ps(ny, dy)), _mm256_mul_ps(nz, dz));
+        cm = _mm256_max_ps(cm, _mm256_max_ps(_mm256_max_ps(abs8(q[i][0]), abs8(q[i][1])), abs8(q[i][2])));
+        cm = _mm256_max_ps(cm, _mm256_max_ps(_mm256_max_ps(abs8(p[i][0]), abs8(p[i][1])), abs8(p[i][2])));
+    }
+    const __m256 norm = _mm256_add_ps(_mm256_add_ps(abs8(nx), abs8(ny)), abs8(nz));
+    const __m256 tol = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(1e-5f), _mm256_add_ps(norm, _mm256_mul_ps(e1m, e2m))), cm);
+    const __m256 ntol = _mm256_sub_ps(_mm256_setzero_ps(), tol);
+    const __m256 above = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(s[0], tol, _CMP_GT_OQ),
+        _mm256_cmp_ps(s[1], tol, _CMP_GT_OQ)), _mm256_cmp_ps(s[2], tol, _CMP_GT_OQ));
+    const __m256 below = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(s[0], ntol, _CMP_LT_OQ),
+        _mm256_cmp_ps(s[1], ntol, _CMP_LT_OQ)), _mm256_cmp_ps(s[2], ntol, _CMP_LT_OQ));
+    return _mm256_or_ps(above, below);
+}
+
+AVX2 static void plane_separated_avx2(
+    const triangles_t& t, uint32_t a, const uint32_t* faces, size_t n, unsigned char* keep
+) {
+    __m256 p[3][3], q[3][3];
+    for (int z = 0; z < 3; ++z)
+        for (int k = 0; k < 3; ++k)
+            p[z][k] = _mm256_set1_ps(t.coord[k][t.corner[z][a]]);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i f = _mm256_loadu_si256((const __m256i*) (faces + i));
+        for (int z = 0; z < 3; ++z) {
+            const __m256i idx = _mm256_i32gather_epi32((const int*) t.corner[z], f, 4);
+            for (int k = 0; k < 3; ++k)
+                q[z][k] = _mm256_i32gather_ps(t.coord[k], idx, 4);
+        }
+        const int separated = _mm256_movemask_ps(_mm256_or_ps(one_side8(p, q), one_side8(q, p)));
+        for (int l = 0; l < 8; ++l)
+            if (separated & (1 << l))
+                keep[i + l] = 0;
+    }
+    plane_separated_scalar(t, a, faces, i, n, keep);
+}
+
+#endif
+
+// ------------------------------------------------------------------ dispatch
+
+static void sums(const triangles_t& t, double& area, double& volume, isa_t isa) {
+    area = 0;
+    volume = 0;
+#ifdef KERNELS_X86
+    if (isa == isa_avx2)
+        return sums_avx2(t, area, volume);
+    if (isa == isa_sse42)
+        return sums_sse42(t, area, volume);
+#endif
+    sums_scalar(t, 0, area, volume);
+}
+
+double area(const triangles_t& t, isa_t isa) {
+    double a, v;
+    sums(t, a, v, isa);
+    return a / 2;
+}
+
+double signed_volume(const triangles_t& t, isa_t isa) {
+    double a, v;
+    sums(t, a, v, isa);
+    return v / 6;
+}
+
+void bbox(const float* const coord[3], size_t n, float min[3], float max[3], isa_t isa) {
+    for (int k = 0; k < 3; ++k) {
+        min[k] = std::numeric_limits<float>::infinity();
+        max[k] = -std::numeric_limits<float>::infinity();
+    }
+#ifdef KERNELS_X86
+    if (isa == isa_avx2)
+        return bbox_avx2(coord, n, min, max);
+    if (isa == isa_sse42)
+        return bbox_sse42(coord, n, min, max);
+#endif
+    bbox_scalar(coord, 0, n, min, max);
+}
+
+void plane_separated(
+    const triangles_t& t, uint32_t a, const uint32_t* faces, size_t n, unsigned char* keep, isa_t isa
+) {
+#ifdef KERNELS_X86
+    if (isa == isa_avx2)
+        return plane_separated_avx2(t, a, faces, n, keep);
+    if (isa == isa_sse42)
+        return plane_separated_sse42(t, a, faces, n, keep);
+#endif
+    plane_separated_scalar(t, a, faces, 0, n, keep);
+}
+
+#ifdef FILECHECK_TEST
+// random soup of small triangles in a box, indexed the way indexedMesh_t is
+struct soup_t {
+    std::vector<float> coord[3];
+    std::vector<uint32_t> corner[3];
+
+    soup_t(size_t n_faces, float spread, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> box(-spread, spread), jitter(-1.f, 1.f);
+        std::uniform_int_distribution<uint32_t> pick(0, 3 * n_faces - 1);
+        for (size_t f = 0; f < n_faces; ++f) {
+            const float c[3] = {box(rng) + 100.f, box(rng), box(rng)};
+            for (int z = 0; z < 3; ++z)
+                for (int k = 0; k < 3; ++k)
+                    coord[k].push_back(c[k] + jitter(rng));
+        }
+        // faces share corners, some pairs are neighbours
+        for (size_t f = 0; f < n_faces; ++f)
+            for (int z = 0; z < 3; ++z)
+                corner[z].push_back(f % 5 == 0 ? pick(rng) : uint32_t(3 * f + z));
+    }
+
+    triangles_t view() const {
+        triangles_t t;
+        for (int k = 0; k < 3; ++k) {
+            t.coord[k] = coord[k].data();
+            t.corner[k] = corner[k].data();
+        }
+        t.n = corner[0].size();
+        return t;
+    }
+
+    vcg::Point3f P(uint32_t f, int z) const {
+        const uint32_t v = corner[z][f];
+        return vcg::Point3f(coord[0][v], coord[1][v], coord[2][v]);
+    }
+};
+
+TEST_CASE( "test kernels same as scalar", "[util]" ) {
+    soup_t soup(10007, 20.f, 1);
+    const triangles_t t = soup.view();
+    const double area0 = area(t, isa_scalar);
+    const double volume0 = signed_volume(t, isa_scalar);
+
+    double area1 = 0, volume1 = 0;
+    for (size_t f = 0; f < t.n; ++f) {
+        vcg::Triangle3<float> tri(soup.P(f, 0), soup.P(f, 1), soup.P(f, 2));
+        area1 += vcg::DoubleArea(tri) / 2;
+        volume1 += (tri.cP(0) * (tri.cP(1) ^ tri.cP(2))) / 6.;
+    }
+    REQUIRE( std::fabs(area0 - area1) <= 1e-5 * area1 );
+    REQUIRE( std::fabs(volume0 - volume1) <= 1e-3 * std::fabs(volume1) );
+
+    float min0[3], max0[3];
+    const float* const coord[3] = {soup.coord[0].data(), soup.coord[1].data(), soup.coord[2].data()};
+    bbox(coord, soup.coord[0].size(), min0, max0, isa_scalar);
+    REQUIRE( min0[0] == *std::min_element(soup.coord[0].begin(), soup.coord[0].end()) );
+    REQUIRE( max0[2] == *std::max_element(soup.coord[2].begin(), soup.coord[2].end()) );
+
+    std::vector<uint32_t> faces;
+    for (uint32_t f = 1; f < t.n; ++f)
+        faces.push_back(f);
+    std::vector<unsigned char> keep0(faces.size(), 1);
+    plane_separated(t, 0, faces.data(), faces.size(), keep0.data(), isa_scalar);
+
+    // the faces are added in a different order, the per face values are the same
+    for (int isa = isa_sse42; isa <= best_isa(); ++isa) {
+        INFO( isa_name(isa_t(isa)) );
+        REQUIRE( std::fabs(area(t, isa_t(isa)) - area0) <= 1e-12 * area0 );
+        REQUIRE( std::fabs(signed_volume(t, isa_t(isa)) - volume0) <= 1e-12 * std::fabs(area0 * 100) );
+
+        float min[3], max[3];
+        bbox(coord, soup.coord[0].size(), min, max, isa_t(isa));
+        for (int k = 0; k < 3; ++k) {
+            REQUIRE( min[k] == min0[k] );
+            REQUIRE( max[k] == max0[k] );
+        }
+        for (size_t n : {0, 1, 5, 8}) {
+            bbox(coord, n, min, max, isa_t(isa));
+            float lo[3], hi[3];
+            bbox(coord, n, lo, hi, isa_scalar);
+            REQUIRE( min[0] == lo[0] );
+            REQUIRE( max[1] == hi[1] );
+        }
+
+        for (uint32_t a : {0u, 17u, 9999u}) {
+            std::vector<unsigned char> keep(faces.size(), 1), keepScalar(faces.size(), 1);
+            plane_separated(t, a, faces.data(), faces.size(), keep.data(), isa_t(isa));
+            plane_separated(t, a, faces.data(), faces.size(), keepScalar.data(), isa_scalar);
+            REQUIRE( keep == keepScalar );
+        }
+    }
+}
+
+TEST_CASE( "test plane separation keeps the intersecting pairs", "[util]" ) {
+    // dense enough for many pairs to intersect
+    soup_t soup(3000, 3.f, 2);
+    const triangles_t t = soup.view();
+    std::vector<uint32_t> faces;
+    for (uint32_t f = 0; f < t.n; ++f)
+        faces.push_back(f);
+
+    size_t n_intersecting = 0, n_cleared = 0;
+    for (uint32_t a = 0; a < 200; ++a) {
+        std::vector<unsigned char> keep(faces.size(), 1);
+        plane_separated(t, a, faces.data(), faces.size(), keep.data());
+        for (uint32_t b = 0; b < t.n; ++b) {
+            if (b == a)
+                continue;
+            const bool hit = vcg::IntersectionTriangleTriangle(
+                soup.P(a, 0), soup.P(a, 1), soup.P(a, 2), soup.P(b, 0), soup.P(b, 1), soup.P(b, 2));
+            n_intersecting += hit;
+            n_cleared += !keep[b];
+            if (hit)
+                REQUIRE( keep[b] );
+        }
+    }
+    REQUIRE( n_intersecting > 0 );
+    REQUIRE( n_cleared > 0 );
+}
+#endif
+
+}
@@ -0,0 +1,49 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Batched geometry over contiguous coordinate arrays, with a scalar, an SSE4.2 and an
+// AVX2 version of every kernel. The version is picked at run time from the cpu, the
+// build flags stay the baseline ones so the same binary runs everywhere; non x86
+// targets (e.g. the wasm build) only have the scalar one.
+//
+// Every version computes the per face values with the same float operations in the
+// same order, only the double sums are added up in a different order.
+namespace kernels{
+
+enum isa_t { isa_scalar = 0, isa_sse42 = 1, isa_avx2 = 2 };
+
+// the best version the cpu runs, capped by the FILECHECK_ISA environment variable
+// (scalar, sse4.2 or avx2) when it is set
+isa_t best_isa();
+const char* isa_name(isa_t isa);
+
+// faces by the indices of their corners into coordinate arrays, the layout of indexed::indexedMesh_t
+struct triangles_t {
+    const float* coord[3];       // x, y and z of the vertices
+    const uint32_t* corner[3];   // first, second and third vertex of the faces
+    size_t n;                    // faces
+};
+
+// sum of the face areas
+double area(const triangles_t& t, isa_t isa = best_isa());
+
+// sum of the signed volumes of the tetrahedra from the origin to the faces
+double signed_volume(const triangles_t& t, isa_t isa = best_isa());
+
+// bounds of n points, min > max when n is 0
+void bbox(const float* const coord[3], size_t n, float min[3], float max[3], isa_t isa = best_isa());
+
+// keep[k] is cleared when face faces[k] lies strictly on one side of the plane of face a,
+// or face a strictly on one side of the plane of faces[k]. The margin is wide enough for the
+// float rounding: a pair that touches is never cleared, the exact test decides on the others
+void plane_separated(
+    const triangles_t& t, uint32_t a, const uint32_t* faces, size_t n, unsigned char* keep,
+    isa_t isa = best_isa()
+);
+
+}
+
+#endif
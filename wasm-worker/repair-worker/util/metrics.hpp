@@ -0,0 +1,196 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstddef>
+
+#include <vcg/space/point3.h>
+#include <vcg/space/box3.h>
+
+namespace util{
+
+// The integrals a sweep over the faces adds up, in double. Every face adds the tetrahedron
+// it spans with a reference point, the first corner of the first face: the terms keep the
+// size of the mesh wherever it sits, far from the origin the moments do not cancel out.
+// The volume is also summed from the origin, that is the one reported, as the stream check
+// and Inertia report it on an open mesh too
+struct moments_t {
+    bool has_ref = false;
+    vcg::Point3d ref;
+    double area = 0;
+    double volume = 0;       // signed, from the origin
+    double volume_ref = 0;   // signed, from ref
+    vcg::Point3d first;      // first moment of the solid, from ref
+    vcg::Point3d surface;    // area weighted sum of the face centroids, from ref
+    double second[6];        // xx yy zz xy xz yz moments of the solid, from ref
+
+    moments_t() : ref(0, 0, 0), first(0, 0, 0), surface(0, 0, 0) {
+        std::fill(second, second + 6, 0.);
+    }
+    explicit moments_t(const vcg::Point3d& ref) : moments_t() {
+        this->ref = ref;
+        has_ref = true;
+    }
+
+    void add(const vcg::Point3d& p0, const vcg::Point3d& p1, const vcg::Point3d& p2, bool with_second = true) {
+        if (!has_ref) {
+            ref = p0;
+            has_ref = true;
+        }
+        const double doubleArea = ((p1 - p0) ^ (p2 - p0)).Norm();
+        area += doubleArea / 2.;
+        volume += p0 * (p1 ^ p2) / 6.;
+
+        const vcg::Point3d a = p0 - ref, b = p1 - ref, c = p2 - ref, s = a + b + c;
+        const double d = a * (b ^ c);
+        volume_ref += d / 6.;
+        first += s * (d / 24.);
+        surface += s * (doubleArea / 6.);
+        if (!with_second)
+            return;
+        // the covariance of the tetrahedron (ref, a, b, c) is d/120 (aa' + bb' + cc' + ss')
+        const double k = d / 120.;
+        for (int i = 0; i < 3; ++i)
+            second[i] += k * (a[i] * a[i] + b[i] * b[i] + c[i] * c[i] + s[i] * s[i]);
+        const int u[3] = {0, 0, 1}, v[3] = {1, 2, 2};
+        for (int j = 0; j < 3; ++j)
+            second[3 + j] += k * (a[u[j]] * a[v[j]] + b[u[j]] * b[v[j]] + c[u[j]] * c[v[j]] + s[u[j]] * s[v[j]]);
+    }
+
+    // the sums of other, from the same ref
+    void add(const moments_t& other) {
+        area += other.area;
+        volume += other.volume;
+        volume_ref += other.volume_ref;
+        first += other.first;
+        surface += other.surface;
+        for (int i = 0; i < 6; ++i)
+            second[i] += other.second[i];
+    }
+};
+
+struct meshMetrics_t {
+    double area = 0;
+    double volume = 0;         // signed, from the origin
+    vcg::Point3d centroid;     // of the solid, of the surface when it encloses no volume
+    vcg::Box3f bbox;           // of the live vertices, as UpdateBounding::Box() has it
+    bool has_inertia = false;
+    double inertia[6];         // xx yy zz xy xz yz of the tensor about the centroid, unit density,
+                               // 0 when the mesh encloses no volume
+};
+
+inline meshMetrics_t metrics(const moments_t& m, const vcg::Box3f& bbox, bool with_inertia) {
+    meshMetrics_t r;
+    r.area = m.area;
+    r.volume = m.volume;
+    r.bbox = bbox;
+    r.has_inertia = with_inertia;
+    std::fill(r.inertia, r.inertia + 6, 0.);
+
+    // a flat or open surface adds up to rounding
+    const bool solid = std::fabs(m.volume_ref) > 1e-9 * std::pow(m.area, 1.5);
+    vcg::Point3d c(0, 0, 0);
+    if (solid)
+        c = m.first / m.volume_ref;
+    else if (m.area > 0)
+        c = m.surface / m.area;
+    r.centroid = m.ref + c;
+
+    if (with_inertia && solid) {
+        // the parallel axis theorem moves the moments from ref to the centroid
+        const double v = m.volume_ref;
+        const double xx = m.second[0] - v * c[0] * c[0];
+        const double yy = m.second[1] - v * c[1] * c[1];
+        const double zz = m.second[2] - v * c[2] * c[2];
+        r.inertia[0] = yy + zz;
+        r.inertia[1] = xx + zz;
+        r.inertia[2] = xx + yy;
+        r.inertia[3] = -(m.second[3] - v * c[0] * c[1]);
+        r.inertia[4] = -(m.second[4] - v * c[0] * c[2]);
+        r.inertia[5] = -(m.second[5] - v * c[1] * c[2]);
+    }
+    return r;
+}
+
+// faces per block of mesh_metrics()
+static const size_t metrics_block = 1 << 14;
+
+// the metrics of a mesh in one parallel sweep over the faces and the vertices. View has
+//   FN(), live(f), corners(f, p[3]) for the faces, deleted ones included,
+//   compact(), true when none is deleted,
+//   VN(), bound(begin, end, box) to add the live vertices [begin, end) to box.
+// The live faces are cut in blocks of metrics_block added up in order: the same faces in the
+// same order give the same sums whatever the threads and the deleted faces between them
+template <class View>
+meshMetrics_t mesh_metrics(const View& view, bool with_inertia = true, bool concurrent = true) {
+    const size_t fn = view.FN(), vn = view.VN();
+
+    // live faces before every block of face indices
+    const long long n_raw = (long long) ((fn + metrics_block - 1) / metrics_block);
+    std::vector<size_t> before(n_raw + 1, 0);
+    if (view.compact()) {
+        for (long long b = 0; b <= n_raw; ++b)
+            before[b] = std::min(fn, size_t(b) * metrics_block);
+    } else {
+        #pragma omp parallel for schedule(static) if(concurrent)
+        for (long long b = 0; b < n_raw; ++b) {
+            size_t n = 0;
+            for (size_t f = size_t(b) * metrics_block; f < std::min(fn, size_t(b + 1) * metrics_block); ++f)
+                n += view.live(f);
+            before[b + 1] = n;
+        }
+        std::partial_sum(before.begin(), before.end(), before.begin());
+    }
+    const size_t n_live = before[n_raw];
+
+    vcg::Point3d p[3];
+    moments_t zero;
+    for (size_t f = 0; f < fn && n_live > 0; ++f)
+        if (view.live(f)) {
+            view.corners(f, p);
+            zero = moments_t(p[0]);
+            break;
+        }
+
+    const long long n_blocks = (long long) ((std::max(n_live, vn) + metrics_block - 1) / metrics_block);
+    std::vector<moments_t> sums(n_blocks, zero);
+    std::vector<vcg::Box3f> boxes(n_blocks);
+    #pragma omp parallel for schedule(dynamic, 1) if(concurrent)
+    for (long long b = 0; b < n_blocks; ++b) {
+        const size_t start = size_t(b) * metrics_block;
+        if (start < n_live) {
+            // the index of the live face number start
+            const size_t raw = std::upper_bound(before.begin(), before.end(), start) - before.begin() - 1;
+            size_t f = raw * metrics_block, seen = before[raw];
+            for (;; ++f)
+                if (view.live(f) && seen++ == start)
+                    break;
+            vcg::Point3d q[3];
+            for (size_t n = 0; f < fn && n < metrics_block; ++f)
+                if (view.live(f)) {
+                    view.corners(f, q);
+                    sums[b].add(q[0], q[1], q[2], with_inertia);
+                    ++n;
+                }
+        }
+        boxes[b].SetNull();
+        if (start < vn)
+            view.bound(start, std::min(vn, start + metrics_block), boxes[b]);
+    }
+
+    moments_t m = zero;
+    vcg::Box3f bbox;
+    bbox.SetNull();
+    for (long long b = 0; b < n_blocks; ++b) {
+        m.add(sums[b]);
+        bbox.Add(boxes[b]);
+    }
+    return metrics(m, bbox, with_inertia);
+}
+
+}
+
+#endif
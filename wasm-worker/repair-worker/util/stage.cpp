@@ -0,0 +1,139 @@
+#include "stage.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef FILECHECK_TEST
+#include "catch.hpp"
+#endif
+
+namespace util{
+
+size_t stageGraph_t::add(const std::string name, stageFn_t fn, std::vector<size_t> deps) {
+    const size_t id = stages.size();
+    for (auto dep : deps) {
+        if (dep >= id)
+            throw std::invalid_argument("stage " + name + " depends on a stage added after it");
+        stages[dep].dependents.push_back(id);
+    }
+    stages.push_back(stage_t{name, fn, {}, (int) deps.size(), 0.});
+    return id;
+}
+
+void stageGraph_t::launch(size_t id) {
+    #pragma omp task firstprivate(id)
+    {
+        auto t1 = std::chrono::high_resolution_clock::now();
+        bool ok = true;
+        try {
+            stages[id].fn();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+            ok = false;
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        stages[id].ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        if (ok) {
+            for (auto dependent : stages[id].dependents)
+                if (--pending[dependent] == 0)
+                    launch(dependent);
+        }
+    }
+}
+
+void stageGraph_t::run(bool concurrent) {
+    error = nullptr;
+    pending = std::vector<std::atomic<int>>(stages.size());
+    for (size_t id = 0; id < stages.size(); ++id) {
+        pending[id] = stages[id].n_deps;
+        stages[id].ms = 0.;
+    }
+
+    // no more threads than stages, the nesting setting of the process is left as it is:
+    // by default a parallel loop inside a concurrent stage runs on the thread of the stage
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = std::max(1, std::min(omp_get_max_threads(), (int) stages.size()));
+#endif
+
+    #pragma omp parallel if(concurrent) num_threads(n_threads)
+    #pragma omp single
+    {
+        for (size_t id = 0; id < stages.size(); ++id)
+            if (stages[id].n_deps == 0)
+                launch(id);
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void stageGraph_t::times(stageTimes_t& out, const std::string prefix) const {
+    for (const auto& stage : stages)
+        out.push_back(std::make_pair(prefix + stage.name, stage.ms));
+}
+
+#ifdef FILECHECK_TEST
+TEST_CASE( "test stage graph order", "[util]" ) {
+    std::vector<int> done(4, 0);
+    std::atomic<int> clock(0);
+    stageGraph_t graph;
+    auto a = graph.add("a", [&]() { done[0] = ++clock; });
+    auto b = graph.add("b", [&]() { done[1] = ++clock; }, {a});
+    auto c = graph.add("c", [&]() { done[2] = ++clock; }, {a});
+    graph.add("d", [&]() { done[3] = ++clock; }, {b, c});
+    graph.run();
+
+    REQUIRE( done[0] == 1 );
+    REQUIRE( done[1] > done[0] );
+    REQUIRE( done[2] > done[0] );
+    REQUIRE( done[3] == 4 );
+
+    stageTimes_t times;
+    graph.times(times, "check.");
+    REQUIRE( times.size() == 4 );
+    REQUIRE( times[3].first == "check.d" );
+    REQUIRE( times[3].second >= 0. );
+}
+
+TEST_CASE( "test stage graph error", "[util]" ) {
+    bool dependent_ran = false;
+    stageGraph_t graph;
+    auto a = graph.add("a", []() { throw std::runtime_error("stage failed"); });
+    graph.add("b", [&]() { dependent_ran = true; }, {a});
+
+    REQUIRE_THROWS_AS( graph.run(), std::runtime_error );
+    REQUIRE( dependent_ran == false );
+    REQUIRE_THROWS_AS( graph.add("c", []() {}, {5}), std::invalid_argument );
+}
+
+#ifdef _OPENMP
+TEST_CASE( "test stage graph keeps the nesting setting", "[util]" ) {
+    const int levels = omp_get_max_active_levels();
+    std::atomic<int> most_threads(0);
+    stageGraph_t graph;
+    for (auto name : {"a", "b", "c"})
+        graph.add(name, [&]() {
+            #pragma omp parallel
+            {
+                int n = omp_get_num_threads(), seen = most_threads;
+                while (n > seen && !most_threads.compare_exchange_weak(seen, n)) {}
+            }
+        });
+    graph.run();
+
+    REQUIRE( omp_get_max_active_levels() == levels );
+    if (levels < 2)
+        REQUIRE( most_threads == 1 );
+}
+#endif
+#endif
+
+}
@@ -0,0 +1,62 @@
+#ifndef STAGE_HPP
+#define STAGE_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+namespace util{
+
+// wall time in milliseconds of named pipeline steps, in the order they were added
+typedef std::vector<std::pair<std::string, double>> stageTimes_t;
+
+// A small dependency graph of pipeline stages.
+// A stage starts as soon as all the stages it depends on are done, independent
+// stages run concurrently as OpenMP tasks. Without OpenMP (e.g. the wasm build)
+// the pragmas are ignored and the stages run one after the other.
+// The OpenMP loops of a stage only get threads of their own when the stages
+// run one after the other, or when the caller enabled nested parallelism.
+class stageGraph_t {
+
+    public:
+
+    typedef std::function<void()> stageFn_t;
+
+    // deps must be ids returned by previous calls, so the graph is always acyclic
+    size_t add(const std::string name, stageFn_t fn, std::vector<size_t> deps = {});
+
+    // rethrows the first exception raised by a stage, its dependents are skipped
+    void run(bool concurrent = true);
+
+    size_t size() const { return stages.size(); }
+    const std::string& name(size_t id) const { return stages[id].name; }
+    double milliseconds(size_t id) const { return stages[id].ms; }
+
+    // appends the time of every stage of the last run, names prefixed with prefix
+    void times(stageTimes_t& out, const std::string prefix = "") const;
+
+    private:
+
+    struct stage_t {
+        std::string name;
+        stageFn_t fn;
+        std::vector<size_t> dependents;
+        int n_deps;
+        double ms;
+    };
+
+    void launch(size_t id);
+
+    std::vector<stage_t> stages;
+    std::vector<std::atomic<int>> pending;
+    std::exception_ptr error;
+    std::mutex error_mutex;
+};
+
+}
+
+#endif
@@ -31,6 +31,9 @@
 #include <vcg/complex/algorithms/update/component_ep.h>
 #include <vcg/complex/algorithms/update/bounding.h>
 #include "sampling.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 // project definitions.
@@ -68,6 +71,7 @@ using namespace vcg;
 bool NumberOfSamples                = false;
 bool SamplesPerAreaUnit             = false;
 bool CleaningFlag=false;
+bool SeedFlag=false;
 // -----------------------------------------------------------------------------------------------
 
 void Usage()
@@ -94,6 +98,9 @@ void Usage()
 																				"  -O         Use an octree as a Search Structure\n"\
                                         "  -A         Use an AxisAligned Bounding Box Tree as Search Structure\n"\
                                         "  -H         Use an Hashed Uniform Grid as Search Structure\n"\
+                                        "  -B         Use a Bounding Volume Hierarchy as Search Structure\n"\
+                                        "  -j#        compute the distances on # threads (0 for all), implies -B\n"\
+                                        "  -r#        set the seed of the montecarlo sampling\n"\
                                         "\n"
                                         "Default options are to sample vertexes, edge and faces by taking \n"
                                         "a number of samples that is approx. 10x the face number.\n"
@@ -136,6 +143,8 @@ int main(int argc, char**argv)
     unsigned long         n_samples_target, elapsed_time;
     double								n_samples_per_area_unit;
     int                   flags;
+    int                   n_threads = 0;
+    unsigned int          seed = 0;
 
     // print program info
     printf("-------------------------------\n"
@@ -181,13 +190,24 @@ int main(int argc, char**argv)
         case 'G':  flags |= SamplingFlags::USE_STATIC_GRID; printf("Using static uniform grid as search structure\n"); break;
         case 'H':  flags |= SamplingFlags::USE_HASH_GRID;   printf("Using hashed uniform grid as search structure\n"); break;
 				case 'O':  flags |= SamplingFlags::USE_OCTREE;      printf("Using octree as search structure\n");              break;
+        case 'B':  flags |= SamplingFlags::USE_BVH;         printf("Using bounding volume hierarchy as search structure\n"); break;
+        case 'j':  n_threads = atoi(&(argv[i][2]));
+#ifdef _OPENMP
+                   if(n_threads <= 0) n_threads = omp_get_max_threads();
+#else
+                   n_threads = 1;
+#endif
+                   printf("Computing the distances on %d threads\n", n_threads); break;
+        case 'r':  SeedFlag = true; seed = (unsigned int) atoi(&(argv[i][2])); break;
         default  :  printf(MSG_ERR_INVALID_OPTION, argv[i]);
           exit(0);
       }
       i++;
     }
 
-		if(!(flags & SamplingFlags::USE_HASH_GRID) && !(flags & SamplingFlags::USE_AABB_TREE) && !(flags & SamplingFlags::USE_OCTREE))
+		if(n_threads > 0)
+       flags |= SamplingFlags::USE_BVH;
+		if(!(flags & SamplingFlags::USE_HASH_GRID) && !(flags & SamplingFlags::USE_AABB_TREE) && !(flags & SamplingFlags::USE_OCTREE) && !(flags & SamplingFlags::USE_BVH))
        flags |= SamplingFlags::USE_STATIC_GRID;
 
     // load input meshes.
@@ -237,6 +257,8 @@ int main(int argc, char**argv)
     // Forward distance.
     printf("\nForward distance (M1 -> M2):\n");
     ForwardSampling.SetFlags(flags);
+    ForwardSampling.SetThreads(n_threads);
+    if(SeedFlag) ForwardSampling.SetRandomSeed(seed);
     if(NumberOfSamples)
     {
         ForwardSampling.SetSamplesTarget(n_samples_target);
@@ -262,6 +284,8 @@ int main(int argc, char**argv)
     // Backward distance.
     printf("\nBackward distance (M2 -> M1):\n");
     BackwardSampling.SetFlags(flags);
+    BackwardSampling.SetThreads(n_threads);
+    if(SeedFlag) BackwardSampling.SetRandomSeed(seed);
     if(NumberOfSamples)
     {
         BackwardSampling.SetSamplesTarget(n_samples_target);
@@ -6,5 +6,9 @@ CONFIG += console stl  c++11 debug_and_release
 TEMPLATE = app
 SOURCES += metro.cpp ../../wrap/ply/plylib.cpp
 
+# the distances are computed on several threads with -j
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:LIBS += -fopenmp
+
 # Mac specific Config required to avoid to make application bundles
 CONFIG -= app_bundle
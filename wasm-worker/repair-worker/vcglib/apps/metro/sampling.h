@@ -35,6 +35,8 @@
 #include <vcg/space/index/aabb_binary_tree/aabb_binary_tree.h>
 #include <vcg/space/index/octree.h>
 #include <vcg/space/index/spatial_hashing.h>
+#include <vcg/space/index/bvh.h>
+#include <vcg/complex/algorithms/point_sampling.h>
 namespace vcg
 {
 
@@ -53,7 +55,8 @@ struct SamplingFlags{
 			USE_STATIC_GRID                 = 0x0400,
 			USE_HASH_GRID                   = 0x0800,
 			USE_AABB_TREE                   = 0x1000,
-						USE_OCTREE                      = 0x2000
+						USE_OCTREE                      = 0x2000,
+						USE_BVH                         = 0x4000
 				};
 	};
 // -----------------------------------------------------------------------------------------------
@@ -76,6 +79,7 @@ private:
 	  typedef SpatialHashTable		<FaceType, typename MetroMesh::ScalarType >									MetroMeshHash;
 	typedef AABBBinaryTreeIndex	<FaceType, typename MetroMesh::ScalarType, vcg::EmptyClass>	MetroMeshAABB;
 		typedef Octree							<FaceType, typename MetroMesh::ScalarType >                 MetroMeshOctree;
+	typedef BVHIndex						<FaceType, typename MetroMesh::ScalarType >                 MetroMeshBVH;
 
 	typedef Point3<typename MetroMesh::ScalarType> Point3x;
 
@@ -89,6 +93,22 @@ private:
     MetroMeshHash   hS2;
     MetroMeshAABB   tS2;
         MetroMeshOctree oS2;
+    MetroMeshBVH    bS2;
+
+    // closest point query on the BVH, safe to call from several threads
+    struct ClosestQuery
+    {
+        MetroMesh    &S2;
+        MetroMeshBVH &bS2;
+        ClosestQuery(MetroMesh &_s2, MetroMeshBVH &_b) : S2(_s2), bS2(_b) {}
+        ScalarType operator()(const Point3x &p, ScalarType upperBound, Point3x &closestPt) const
+        {
+            Point3x normf, ip;
+            ScalarType dist = upperBound;
+            tri::GetClosestFaceEP<MetroMesh,MetroMeshBVH>(S2, bS2, p, upperBound, dist, closestPt, normf, ip);
+            return dist;
+        }
+    };
 
 
 		unsigned int n_samples_per_face    ;
@@ -104,6 +124,13 @@ private:
 	double					n_samples_per_area_unit;
 	unsigned long   n_samples_target;
 	int             Flags;
+	int             n_threads;
+	bool            fixed_seed;
+	unsigned int    random_seed;
+
+    // samples waiting for EvaluateSamples(), with the vertices receiving their error
+    std::vector<Point3x>        samples;
+    std::vector<VertexPointer>  sample_vert;
 
     // results
     Histogram<double>            hist;
@@ -132,6 +159,7 @@ private:
     void            MontecarloFaceSampling();
     void            SubdivFaceSampling();
     void            SimilarFaceSampling();
+    void            EvaluateSamples();
 
 public :
     // public methods
@@ -155,6 +183,8 @@ public :
     void            SetParam(double _n_samp)    {n_samples_target = _n_samp;}
     void            SetSamplesTarget(unsigned long _n_samp);
     void            SetSamplesPerAreaUnit(double _n_samp);
+    void            SetThreads(int _n_threads)  {n_threads = _n_threads;}
+    void            SetRandomSeed(unsigned int _seed) {fixed_seed = true; random_seed = _seed;}
 };
 
 // -----------------------------------------------------------------------------------------------
@@ -164,6 +194,9 @@ template <class MetroMesh>
 Sampling<MetroMesh>::Sampling(MetroMesh &_s1, MetroMesh &_s2):S1(_s1),S2(_s2)
 {
     Flags = 0;
+    n_threads = 0;
+    fixed_seed = false;
+    random_seed = 0;
     area_S1 = ComputeMeshArea(_s1);
         // set default numbers
         n_samples_per_face             =	10;
@@ -230,6 +263,13 @@ float Sampling<MetroMesh>::AddSample(const Point3x &p )
 
     dist = dist_upper_bound;
 
+    // with several threads the distance is computed later by EvaluateSamples()
+    if(n_threads > 0)
+    {
+        samples.push_back(p);
+        return 0;
+    }
+
     // compute distance between p_i and the mesh S2
     if(Flags & SamplingFlags::USE_AABB_TREE)
       f=tri::GetClosestFaceEP<MetroMesh,MetroMeshAABB>(S2, tS2, p, dist_upper_bound, dist, normf, bestq, ip);
@@ -239,6 +279,8 @@ float Sampling<MetroMesh>::AddSample(const Point3x &p )
       f=tri::GetClosestFaceEP<MetroMesh,MetroMeshGrid>(S2, gS2, p, dist_upper_bound, dist, normf, bestq, ip);
     if (Flags & SamplingFlags::USE_OCTREE)
       f=tri::GetClosestFaceEP<MetroMesh,MetroMeshOctree>(S2, oS2, p, dist_upper_bound, dist, normf, bestq, ip);
+    if (Flags & SamplingFlags::USE_BVH)
+      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshBVH>(S2, bS2, p, dist_upper_bound, dist, normf, bestq, ip);
 
     // update distance measures
     if(dist == dist_upper_bound)
@@ -279,7 +321,11 @@ void Sampling<MetroMesh>::VertexSampling()
         n_total_vertex_samples++;
 
         // save vertex quality
-        if(Flags & SamplingFlags::SAVE_ERROR)  (*vi).Q() = error;
+        if(Flags & SamplingFlags::SAVE_ERROR)
+        {
+            if(n_threads > 0) sample_vert.push_back(&*vi);
+            else              (*vi).Q() = error;
+        }
 
         // print progress information
         if(!(++cnt % print_every_n_elements))
@@ -392,7 +438,7 @@ void Sampling<MetroMesh>::MontecarloFaceSampling()
     double  n_samples_decimal = 0.0;
     FaceIterator fi;
 
-    srand(clock());
+    srand(fixed_seed ? random_seed : clock());
  //   printf("Montecarlo face sampling\n");
     for(fi=S1.face.begin(); fi != S1.face.end(); fi++)
         if(!(*fi).IsD())
@@ -543,6 +589,32 @@ void Sampling<MetroMesh>::SimilarFaceSampling()
 // -----------------------------------------------------------------------------------------------
 // --- Distance ----------------------------------------------------------------------------------
 
+// Computes the distances of the samples collected since the last call on
+// n_threads threads, see tri::ParallelHausdorff. The totals are the same
+// whatever the number of threads.
+template <class MetroMesh>
+void Sampling<MetroMesh>::EvaluateSamples()
+{
+    tri::HausdorffStats stats;
+    std::vector<ScalarType> dist;
+    ClosestQuery        query(S2, bS2);
+
+    Histogram<double> *h = (Flags & SamplingFlags::HIST) ? &hist : 0;
+    tri::ParallelHausdorff<Point3x>::Evaluate(samples, query, ScalarType(dist_upper_bound), n_threads, stats, h, &dist);
+
+    for(size_t i = 0; i < sample_vert.size(); ++i)
+        sample_vert[i]->Q() = (dist[i] == dist_upper_bound) ? -1.0 : dist[i];
+
+    if(stats.n > 0 && stats.max_dist > max_dist)
+        max_dist = stats.max_dist;
+    mean_dist += stats.sum_dist;
+    RMS_dist  += stats.sqr_sum_dist;
+    n_total_samples += stats.n;
+
+    samples.clear();
+    sample_vert.clear();
+}
+
 template <class MetroMesh>
 void Sampling<MetroMesh>::Hausdorff()
 {
@@ -553,6 +625,7 @@ void Sampling<MetroMesh>::Hausdorff()
     if(Flags & SamplingFlags::USE_AABB_TREE)   tS2.Set(S2.face.begin(),S2.face.end());
     if(Flags & SamplingFlags::USE_STATIC_GRID) gS2.Set(S2.face.begin(),S2.face.end());
         if(Flags & SamplingFlags::USE_OCTREE)      oS2.Set(S2.face.begin(),S2.face.end());
+    if((Flags & SamplingFlags::USE_BVH) || n_threads > 0) bS2.Set(S2.face.begin(),S2.face.end());
 
     // set bounding box
     bbox = S2.bbox;
@@ -568,6 +641,7 @@ void Sampling<MetroMesh>::Hausdorff()
     // Vertex sampling.
     if(Flags & SamplingFlags::VERTEX_SAMPLING)
         VertexSampling();
+    EvaluateSamples();
     // Edge sampling.
     if(n_samples_target > n_total_samples)
             {
@@ -576,6 +650,7 @@ void Sampling<MetroMesh>::Hausdorff()
                 if(Flags & SamplingFlags::EDGE_SAMPLING)
         {
             EdgeSampling();
+            EvaluateSamples();
            if(n_samples_target > n_total_samples) n_samples_target -= (int) n_total_samples;
            else n_samples_target=0;
         }
@@ -586,6 +661,7 @@ void Sampling<MetroMesh>::Hausdorff()
             if(Flags & SamplingFlags::MONTECARLO_SAMPLING)        MontecarloFaceSampling();
             if(Flags & SamplingFlags::SUBDIVISION_SAMPLING)       SubdivFaceSampling();
             if(Flags & SamplingFlags::SIMILAR_SAMPLING) SimilarFaceSampling();
+            EvaluateSamples();
         }
     }
 
@@ -8,6 +8,9 @@
 // local optimization
 #include <vcg/complex/algorithms/local_optimization.h>
 #include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric_parallel.h>
+
+#include <chrono>
 
 using namespace vcg;
 using namespace tri;
@@ -96,6 +99,7 @@ void Usage()
           "     -T[y|n]  Preserve or not Topology (default no)\n"
           "     -W[y|n]  Use or not per vertex Quality to weight the quadric error (default no)\n"
           "     -C       Before simplification, remove duplicate & unreferenced vertices\n"
+          "     -j#      Decimate spatial regions on # threads (0 for all), then the region borders\n"
           );
   exit(-1);
 }
@@ -119,6 +123,7 @@ int main(int argc ,char**argv)
   qparams.QualityThr  =.3;
   double TargetError=std::numeric_limits<double >::max();
   bool CleaningFlag =false;
+  int Threads=-1;
      // parse command line.
     for(int i=4; i < argc;)
     {
@@ -154,6 +159,7 @@ int main(int argc ,char**argv)
         case 'E' : qparams.QuadricEpsilon         = atof(argv[i]+2);       printf("Setting QuadricEpsilon to %f\n",atof(argv[i]+2)); break;
         case 'e' : TargetError                    = atof(argv[i]+2);       printf("Setting TargetError to %g\n",atof(argv[i]+2)); break;
         case 'C' : CleaningFlag=true;  printf("Cleaning mesh before simplification\n"); break;
+        case 'j' : Threads=atoi(argv[i]+2);                                printf("Decimating regions on %i threads\n",Threads); break;
 
         default  :  printf("Unknown option '%s'\n", argv[i]);
           exit(0);
@@ -172,6 +178,22 @@ int main(int argc ,char**argv)
 
   vcg::tri::UpdateBounding<MyMesh>::Box(mesh);
 
+  if(Threads>=0)
+  {
+    TriEdgeCollapseQuadricParallel<MyMesh,MyTriEdgeCollapse> ParallelDeci(mesh,&qparams);
+    ParallelDeci.threads=Threads;
+    int t1=clock();
+    std::chrono::steady_clock::time_point w1=std::chrono::steady_clock::now();
+    ParallelDeci.Do(FinalSize,TargetError);
+    int t2=clock();
+    double w2=std::chrono::duration<double>(std::chrono::steady_clock::now()-w1).count();
+    printf("mesh  %d %d Error %g \n",mesh.vn,mesh.fn,ParallelDeci.currMetric);
+    printf("%i regions, %i border faces\n",ParallelDeci.nRegions,ParallelDeci.nBorderFaces);
+    printf("\nCompleted in %5.3f sec cpu, %5.3f sec wall\n",float(t2-t1)/CLOCKS_PER_SEC,w2);
+    vcg::tri::io::ExporterPLY<MyMesh>::Save(mesh,argv[2]);
+    return 0;
+  }
+
   // decimator initialization
   vcg::LocalOptimization<MyMesh> DeciSession(mesh,&qparams);
 
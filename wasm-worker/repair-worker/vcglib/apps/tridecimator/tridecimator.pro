@@ -7,6 +7,9 @@ TEMPLATE = app
 HEADERS += 
 SOURCES += tridecimator.cpp ../../wrap/ply/plylib.cpp
 
+# the regions are decimated on several threads with -j
+unix:QMAKE_CXXFLAGS += -fopenmp
+unix:LIBS += -fopenmp
 
 # Mac specific Config required to avoid to make application bundles
 CONFIG -= app_bundle 
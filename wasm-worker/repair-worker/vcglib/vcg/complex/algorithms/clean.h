@@ -31,6 +31,7 @@
 #include <vcg/space/index/spatial_hashing.h>
 #include <vcg/complex/algorithms/update/normal.h>
 #include <vcg/space/triangle3.h>
+#include <vcg/space/intersection/triangle_triangle3_robust.h>
 
 namespace vcg {
 namespace tri{
@@ -128,14 +129,119 @@ public:
   };
 
 
+  /// Open addressing table mapping a position to the vertex that currently represents it.
+  /// A slot holds -1 when empty, the index of a live vertex or -(index+2) of a deleted one.
+  class VertexPositionHash
+  {
+  public:
+    VertexPositionHash(const MeshType &_m, size_t n) : m(_m), slot(ScratchVector<MeshType,int>::Allocator(_m))
+    {
+      size_t cap=16;
+      while(cap < 2*n) cap<<=1;
+      slot.assign(cap,-1);
+      mask=cap-1;
+    }
+
+    /// slot holding the vertex with the same position of v, or the empty slot where it goes
+    int &Find(const CoordType &p)
+    {
+      size_t h=Hash(p) & mask;
+      while(slot[h]!=-1 && !(m.vert[Vert(slot[h])].cP()==p))
+        h=(h+1) & mask;
+      return slot[h];
+    }
+
+    static size_t Vert(int s) { return s>=0 ? size_t(s) : size_t(-s-2); }
+
+  private:
+    static size_t Hash(const CoordType &p)
+    {
+      // positions equal for operator== must hash the same: adding zero turns -0 into +0
+      unsigned long long h=0;
+      for(int i=0;i<3;++i)
+      {
+        ScalarType c=p[i]+ScalarType(0);
+        unsigned long long bits=0;
+        memcpy(&bits,&c,sizeof(ScalarType));
+        h=(h ^ bits) * 0x9E3779B97F4A7C15ull;
+      }
+      // murmur3 finalizer, integer coordinates have all the low mantissa bits at zero
+      h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+      h ^= h >> 33;
+      return size_t(h);
+    }
+
+    const MeshType &m;
+    typename ScratchVector<MeshType,int>::Type slot;
+    size_t mask;
+  };
+
   /** This function removes all duplicate vertices of the mesh by looking only at their spatial positions.
     *  Note that it does not update any topology relation that could be affected by this like the VT or TT relation.
     *  the reason this function is usually performed BEFORE building any topology information.
+    *
+    *  Vertices are welded with a position hash into a dense remap array, the result is the same of
+    *  RemoveDuplicateVertexSorted(): among vertices with the same position the first one in the vector
+    *  survives, and a deleted vertex in between starts a new group (as it breaks the sorted run).
     */
   static int RemoveDuplicateVertex( MeshType & m, bool RemoveDegenerateFlag=true)    // V1.0
   {
     if(m.vert.size()==0 || m.vn==0) return 0;
 
+    const size_t num_vert = m.vert.size();
+    typename ScratchVector<MeshType,unsigned int>::Type remap(num_vert,0,ScratchVector<MeshType,unsigned int>::Allocator(m));
+    VertexPositionHash hash(m,num_vert);
+    int deleted=0;
+
+    for(size_t i=0;i<num_vert;++i)
+    {
+      remap[i]=(unsigned int)i;
+      int &s=hash.Find(m.vert[i].cP());
+      if(m.vert[i].IsD())
+        s=-int(i)-2;
+      else if(s>=0)
+      {
+        remap[i]=(unsigned int)s;
+        Allocator<MeshType>::DeleteVertex(m,m.vert[i]);
+        deleted++;
+      }
+      else
+        s=int(i);
+    }
+
+    if(deleted>0)
+    {
+      VertexPointer vbase=&m.vert[0];
+      const int face_num=int(m.face.size());
+#pragma omp parallel for schedule(static)
+      for(int fi=0;fi<face_num;++fi)
+        if( !m.face[fi].IsD() )
+          for(int k = 0; k < m.face[fi].VN(); ++k)
+            m.face[fi].V(k) = vbase + remap[m.face[fi].V(k) - vbase];
+
+      for(EdgeIterator ei = m.edge.begin(); ei!=m.edge.end(); ++ei)
+        if( !(*ei).IsD() )
+          for(int k = 0; k < 2; ++k)
+            (*ei).V(k) = vbase + remap[(*ei).V(k) - vbase];
+    }
+
+    if(RemoveDegenerateFlag) RemoveDegenerateFace(m);
+    if(RemoveDegenerateFlag && m.en>0) {
+      RemoveDegenerateEdge(m);
+      RemoveDuplicateEdge(m);
+    }
+    return deleted;
+  }
+
+  /** Sort and std::map based implementation of RemoveDuplicateVertex().
+    *  It is slower and allocates one map node per merged vertex, it is kept as the reference
+    *  the hashed version must match exactly.
+    */
+  static int RemoveDuplicateVertexSorted( MeshType & m, bool RemoveDegenerateFlag=true)
+  {
+    if(m.vert.size()==0 || m.vn==0) return 0;
+
     std::map<VertexPointer, VertexPointer> mp;
     size_t i,j;
     VertexIterator vi;
@@ -255,7 +361,7 @@ public:
      */
   static int RemoveDuplicateFace( MeshType & m)    // V1.0
   {
-    std::vector<SortedTriple> fvec;
+    typename ScratchVector<MeshType,SortedTriple>::Type fvec(ScratchVector<MeshType,SortedTriple>::Allocator(m));
     for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
       if(!(*fi).IsD())
       {
@@ -996,7 +1102,8 @@ public:
 
   static void CountEdgeNum( MeshType & m, int &total_e, int &boundary_e, int &non_manif_e )
   {
-    std::vector< typename tri::UpdateTopology<MeshType>::PEdge > edgeVec;
+    typedef ScratchVector<MeshType, typename tri::UpdateTopology<MeshType>::PEdge> EdgeScratch;
+    typename EdgeScratch::Type edgeVec(EdgeScratch::Allocator(m));
     tri::UpdateTopology<MeshType>::FillEdgeVector(m,edgeVec,true);
     sort(edgeVec.begin(), edgeVec.end());		// Lo ordino per vertici
     total_e=0;
@@ -1498,15 +1605,12 @@ static int CountHoles( MeshType & m)
   {
     RequirePerFaceMark(m);
     ret.clear();
-    int referredBit = FaceType::NewBitFlag();
-    tri::UpdateFlags<MeshType>::FaceClear(m,referredBit);
 
     TriMeshGrid gM;
     gM.Set(m.face.begin(),m.face.end());
 
     for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi) if(!(*fi).IsD())
     {
-      (*fi).SetUserBit(referredBit);
       Box3< ScalarType> bbox;
       (*fi).GetBBox(bbox);
       std::vector<FaceType*> inBox;
@@ -1515,7 +1619,8 @@ static int CountHoles( MeshType & m)
       typename std::vector<FaceType*>::iterator fib;
       for(fib=inBox.begin();fib!=inBox.end();++fib)
       {
-        if(!(*fib)->IsUserBit(referredBit) && (*fib != &*fi) )
+        // each pair is tested once, from the face that comes first in the face vector
+        if( *fib > &*fi )
           if(Clean<MeshType>::TestFaceFaceIntersection(&*fi,*fib)){
             ret.push_back(*fib);
             if(!Intersected) {
@@ -1527,8 +1632,84 @@ static int CountHoles( MeshType & m)
       inBox.clear();
     }
 
-    // removed by tiger TODO: understand why cause test error??
-    // FaceType::DeleteBitFlag(referredBit);
+    // no user bit is allocated here: it was never released (DeleteBitFlag asserts unless
+    // bits are freed in stack order) and every call leaked one of the few available bits.
+    // Not writing the face flags also lets this run next to other read only algorithms.
+    return (ret.size()>0);
+  }
+
+  /**
+      Parallel version of SelfIntersections() returning the same faces.
+      The grid is built once and only read by the threads, each thread keeps its own candidate and
+      result buffers (no marks are written so no per face allocation nor locking is needed).
+      The intersecting pairs are sorted before filling ret, so the output is the same whatever the
+      number of threads: for each face, in face order, its first intersecting partner, the face itself
+      and then its other partners, partners being sorted by position and coming after the face.
+      */
+  static bool SelfIntersectionsParallel(MeshType &m, std::vector<FaceType*> &ret)
+  {
+    ret.clear();
+    if(m.fn==0) return false;
+
+    TriMeshGrid gM;
+    gM.Set(m.face.begin(),m.face.end());
+    return SelfIntersectionsParallel(m,ret,gM);
+  }
+
+  /**
+      The same on faces already in a spatial index, a TriMeshGrid or a BVHIndex of the faces for
+      instance: only its GetInBox() is used, concurrently, with an EmptyTMark marker.
+      */
+  template <class SpatialIndexType>
+  static bool SelfIntersectionsParallel(MeshType &m, std::vector<FaceType*> &ret, SpatialIndexType &gM)
+  {
+    ret.clear();
+    const int fn = int(m.face.size());
+    if(m.fn==0) return false;
+
+    // GoodFace() only depends on the face, compute it once instead of once per pair
+    std::vector<char> good(fn,0);
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<fn;++i)
+      good[i] = !m.face[i].IsD() && GoodFace(&m.face[i]);
+
+    std::vector< std::pair<int,int> > pairs;
+#pragma omp parallel
+    {
+      tri::EmptyTMark<MeshType> noMarker;
+      std::vector<FaceType*> inBox;
+      std::vector< std::pair<int,int> > localPairs;
+
+#pragma omp for schedule(dynamic,256) nowait
+      for(int i=0;i<fn;++i) if(good[i])
+      {
+        FaceType *f0 = &m.face[i];
+        Box3< ScalarType> bbox;
+        f0->GetBBox(bbox);
+        gM.GetInBox(noMarker,bbox,inBox);
+        // without marks a face spanning many cells of a grid is returned many times
+        std::sort(inBox.begin(),inBox.end());
+        typename std::vector<FaceType*>::iterator last=std::unique(inBox.begin(),inBox.end());
+        for(typename std::vector<FaceType*>::iterator fib=inBox.begin();fib!=last;++fib)
+        {
+          const int j = int(*fib - &m.face[0]);
+          if(j>i && good[j] && TestGoodFaceFaceIntersection(f0,*fib))
+            localPairs.push_back(std::make_pair(i,j));
+        }
+      }
+
+#pragma omp critical
+      pairs.insert(pairs.end(),localPairs.begin(),localPairs.end());
+    }
+
+    std::sort(pairs.begin(),pairs.end());
+    ret.reserve(pairs.size()*2);
+    for(size_t k=0;k<pairs.size();++k)
+    {
+      ret.push_back(&m.face[pairs[k].second]);
+      if(k==0 || pairs[k-1].first!=pairs[k].first)
+        ret.push_back(&m.face[pairs[k].first]);
+    }
     return (ret.size()>0);
   }
 
@@ -1616,10 +1797,11 @@ static int CountHoles( MeshType & m)
   */
 
   static bool GoodFace(FaceType *f0) {
+    return GoodTriangle((*f0).cV(0)->cP(), (*f0).cV(1)->cP(), (*f0).cV(2)->cP());
+  }
 
-    auto v0 = (*f0).cV(0)->cP();
-    auto v1 = (*f0).cV(1)->cP();
-    auto v2 = (*f0).cV(2)->cP();
+  /// GoodFace() on the corners of a triangle, for meshes that do not keep vcg faces.
+  static bool GoodTriangle(const CoordType &v0, const CoordType &v1, const CoordType &v2) {
     // printf("v %f %f %f \n", v0[0], v0[1], v0[2]);
     // printf("v %f %f %f \n", v1[0], v1[1], v1[2]);
     // printf("v %f %f %f \n", v2[0], v2[1], v2[2]);
@@ -1667,6 +1849,45 @@ static int CountHoles( MeshType & m)
     if (!GoodFace(f0) or !GoodFace(f1))
         return false;
 
+    return TestGoodFaceFaceIntersection(f0,f1);
+  }
+
+  /// Same as TestFaceFaceIntersection() for two faces already known to pass GoodFace().
+  /// It only reads the two faces so it can be called concurrently on any pairs.
+  /// Faces sharing no vertex intersect when they cross along a segment, or, when they are
+  /// coplanar, when the closed triangles meet; a single point of contact between faces in
+  /// different planes does not count. Faces sharing one vertex intersect when the edge opposite
+  /// to it in one face crosses the inside of the other face.
+  /// The predicates are exact, see triangle_triangle3_robust.h, so the answer does not depend
+  /// on the compiler or on the platform.
+  static	bool TestGoodFaceFaceIntersection(FaceType *f0,FaceType *f1)
+  {
+    int sv = face::CountSharedVertex(f0,f1);
+    int i0=0,i1=0;
+    if(sv==1) face::FindSharedVertex(f0,f1,i0,i1);
+    const CoordType p[3]={f0->cP(0),f0->cP(1),f0->cP(2)};
+    const CoordType q[3]={f1->cP(0),f1->cP(1),f1->cP(2)};
+    return TestGoodTriangleTriangleIntersection(p,q,sv,i0,i1);
+  }
+
+  /// TestGoodFaceFaceIntersection() on the corners p and q of two triangles sharing sv vertices,
+  /// p[i0] and q[i1] being the shared one when sv==1, for meshes that do not keep vcg faces.
+  static bool TestGoodTriangleTriangleIntersection(const CoordType p[3],const CoordType q[3],int sv,int i0,int i1)
+  {
+    if(sv==3) return true;
+    if(sv==0)
+      return vcg::IntersectionTriangleTriangleRobust(p[0],p[1],p[2],q[0],q[1],q[2]);
+    if(sv==1)
+      return vcg::IntersectionSegmentTriangleInteriorRobust(p[(i0+1)%3],p[(i0+2)%3],q[0],q[1],q[2]) ||
+             vcg::IntersectionSegmentTriangleInteriorRobust(q[(i1+1)%3],q[(i1+2)%3],p[0],p[1],p[2]);
+    return false;
+  }
+
+  /// The float test TestGoodFaceFaceIntersection() used before, with epsilons on the plane
+  /// distances and on the barycentric coordinates. Kept as a reference for the benchmarks, its
+  /// answer for nearly touching faces depends on how the compiler rounds.
+  static	bool TestGoodFaceFaceIntersectionFloat(FaceType *f0,FaceType *f1)
+  {
     int sv = face::CountSharedVertex(f0,f1);
     if(sv==3) {
         // printf("3 shared vertex\n");
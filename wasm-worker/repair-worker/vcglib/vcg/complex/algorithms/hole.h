@@ -24,6 +24,7 @@
 #define __VCG_TRI_UPDATE_HOLE
 
 #include <vcg/complex/algorithms/clean.h>
+#include <vcg/space/index/grid_util.h>
 
 // This file contains three Ear Classes
 // - TrivialEar
@@ -132,11 +133,10 @@ public:
    * of the vertices of the hole boundary that are traversed by more than a single boundary.
    * 
    */
-  static int &NonManifoldBit() { static int _NonManifoldBit=0; return _NonManifoldBit; }
+  // allocated by the (thread safe) static initialization, meshes may be filled from several threads
+  static int &NonManifoldBit() { static int _NonManifoldBit=VertexType::NewBitFlag(); return _NonManifoldBit; }
   static int InitNonManifoldBitOnHoleBoundary(const PosType &p)       
   {
-    if(NonManifoldBit()==0) 
-      NonManifoldBit() = VertexType::NewBitFlag(); 
     int holeSize=0;
     
     //First loop around the hole to mark non manifold vertices.
@@ -331,6 +331,129 @@ public:
 
 
 //Ear for selfintersection algorithm
+/** EarRing
+ * The faces the ears of a hole are tested against: the faces around the hole and
+ * the ones added so far to close it. Once Index() is called they are kept in a
+ * uniform grid over the hole, so an ear is only tested against the faces whose
+ * box touches its own instead of the whole ring.
+ */
+template<class MESH> class EarRing
+{
+public:
+  typedef typename MESH::FacePointer FacePointer;
+  typedef typename MESH::ScalarType  ScalarType;
+  typedef Box3<ScalarType>           BoxType;
+
+  EarRing():stamp(0){}
+
+  void clear()
+  {
+    faces.clear();
+    boxes.clear();
+    mark.clear();
+    cells.clear();
+  }
+
+  size_t size() const { return faces.size(); }
+
+  void push_back(FacePointer f)
+  {
+    BoxType b;
+    f->GetBBox(b);
+    faces.push_back(f);
+    boxes.push_back(b);
+    mark.push_back(0);
+    if(!cells.empty()) Insert(int(faces.size())-1);
+  }
+
+  // lays the grid over the faces collected so far, the ones added later go in it as they come
+  void Index()
+  {
+    bbox.SetNull();
+    for(size_t i=0;i<boxes.size();++i) bbox.Add(boxes[i]);
+    if(bbox.IsNull()) bbox.Set(Point3<ScalarType>(0,0,0));
+    // faces closer than the rounding of the intersection test are still tested
+    margin = bbox.Diag()*ScalarType(1e-5);
+    BestDim((long long)std::max<size_t>(faces.size(),1), bbox.Dim(), siz);
+    for(int k=0;k<3;++k) voxel[k] = bbox.Dim()[k]/siz[k];
+    cells.assign(size_t(siz[0])*siz[1]*siz[2], std::vector<int>());
+    for(size_t i=0;i<faces.size();++i) Insert(int(i));
+  }
+
+  // true as soon as fn(f) holds for a face f whose box touches b, each face is tried once.
+  // before Index() every face is tried
+  template<class FN>
+  bool Any(const BoxType &b, FN fn)
+  {
+    if(cells.empty())
+    {
+      for(size_t i=0;i<faces.size();++i)
+        if(fn(faces[i])) return true;
+      return false;
+    }
+    BoxType q=b;
+    q.Offset(margin);
+    Point3i lo,hi;
+    Cells(q,lo,hi);
+    ++stamp;
+    for(int z=lo[2];z<=hi[2];++z)
+      for(int y=lo[1];y<=hi[1];++y)
+        for(int x=lo[0];x<=hi[0];++x)
+        {
+          const std::vector<int> &c = cells[CellIndex(x,y,z)];
+          for(size_t k=0;k<c.size();++k)
+          {
+            const int i=c[k];
+            if(mark[i]==stamp) continue;
+            mark[i]=stamp;
+            if(Touch(boxes[i],q) && fn(faces[i])) return true;
+          }
+        }
+    return false;
+  }
+
+private:
+  static bool Touch(const BoxType &a, const BoxType &b)
+  {
+    for(int k=0;k<3;++k)
+      if(a.min[k]>b.max[k] || b.min[k]>a.max[k]) return false;
+    return true;
+  }
+
+  int Cell(ScalarType x, int k) const
+  {
+    const int c = voxel[k]>0 ? int((x-bbox.min[k])/voxel[k]) : 0;
+    return std::min(std::max(c,0),siz[k]-1);
+  }
+
+  void Cells(const BoxType &b, Point3i &lo, Point3i &hi) const
+  {
+    for(int k=0;k<3;++k) { lo[k]=Cell(b.min[k],k); hi[k]=Cell(b.max[k],k); }
+  }
+
+  size_t CellIndex(int x, int y, int z) const { return (size_t(z)*siz[1]+y)*siz[0]+x; }
+
+  void Insert(int i)
+  {
+    Point3i lo,hi;
+    Cells(boxes[i],lo,hi);
+    for(int z=lo[2];z<=hi[2];++z)
+      for(int y=lo[1];y<=hi[1];++y)
+        for(int x=lo[0];x<=hi[0];++x)
+          cells[CellIndex(x,y,z)].push_back(i);
+  }
+
+  std::vector<FacePointer> faces;
+  std::vector<BoxType> boxes;
+  std::vector<unsigned int> mark;
+  unsigned int stamp;
+  std::vector< std::vector<int> > cells;
+  BoxType bbox;
+  ScalarType margin;
+  Point3i siz;
+  Point3<ScalarType> voxel;
+};
+
 template<class MESH> class SelfIntersectionEar : public MinimumWeightEar<MESH>
 {
 public:
@@ -340,9 +463,10 @@ public:
   typedef typename MESH::ScalarType ScalarType;
   typedef typename MESH::CoordType CoordType;
 
-  static std::vector<FacePointer> &AdjacencyRing()
+  // one ring per thread, holes are filled concurrently
+  static EarRing<MESH> &AdjacencyRing()
   {
-    static std::vector<FacePointer> ar;
+    static thread_local EarRing<MESH> ar;
     return ar;
   }
 
@@ -365,25 +489,28 @@ public:
     face::FFSetBorder(f,1);
     face::FFSetBorder(f,2);
 
-    typename std::vector< FacePointer >::iterator it;
-    for(it = this->AdjacencyRing().begin();it!= this->AdjacencyRing().end();++it)
+    // a face whose box does not touch the new one can neither intersect it nor share an edge with it
+    Box3<ScalarType> box;
+    f->GetBBox(box);
+    const bool rejected = AdjacencyRing().Any(box, [&](FacePointer g)
     {
-      if(!(*it)->IsD())
+      if(g->IsD()) return false;
+      if(tri::Clean<MESH>::TestFaceFaceIntersection(f,g))
+        return true;
+      // We must also check that the newly created face does not have any edge in common with other existing surrounding faces
+      // Only the two faces of the ear can share an edge with the new face
+      if(face::CountSharedVertex(f,g)==2)
       {
-        if(	tri::Clean<MESH>::TestFaceFaceIntersection(f,*it))
-          return false;
-        // We must also check that the newly created face does not have any edge in common with other existing surrounding faces
-        // Only the two faces of the ear can share an edge with the new face
-        if(face::CountSharedVertex(f,*it)==2)
-        {
-          int e0,e1;
-          bool ret=face::FindSharedEdge(f,*it,e0,e1);
-          assert(ret); (void)ret;
-          if(!face::IsBorder(**it,e1))
-            return false;
-        }
+        int e0,e1;
+        bool ret=face::FindSharedEdge(f,g,e0,e1);
+        assert(ret); (void)ret;
+        if(!face::IsBorder(*g,e1))
+          return true;
       }
-    }
+      return false;
+    });
+    if(rejected) return false;
+
     bool ret=TrivialEar<MESH>::Close(np0,np1,f);
     if(ret) AdjacencyRing().push_back(f);
     return ret;
@@ -480,7 +607,26 @@ template<class EAR>
       assert(p.IsBorder());
       int holeSize = EAR::InitNonManifoldBitOnHoleBoundary(p);
       FaceIterator f = tri::Allocator<MESH>::AddFaces(m, holeSize-2, facePointersToBeUpdated);
+      f += CloseEars<EAR>(p, f, holeSize);
+
+      // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ), 
+      // so we delete the remaining ones. 
+      while(f!=m.face.end()){
+        tri::Allocator<MESH>::DeleteFace(m,*f);
+        f++;
+      }
+    }
 
+    /** CloseEars
+     * Closes the ears of the hole p of holeSize edges with the faces allocated from f on,
+     * it uses a priority queue to choose the best ear to be closed.
+     * Returns how many faces it used, the mesh itself is not touched
+     * so holes that share no vertex can be closed concurrently
+     */
+    template<class EAR>
+    static int CloseEars(const PosType &p, FaceIterator f, int holeSize)
+    {
+      int used=0;
       std::priority_queue< EAR > EarHeap;
       PosType fp = p;
       do{
@@ -514,16 +660,11 @@ template<class EAR>
             }
             --holeSize;
             ++f;
+            ++used;
           }
         }//is update()
       } 
-      
-      // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ), 
-      // so we delete the remaining ones. 
-      while(f!=m.face.end()){
-        tri::Allocator<MESH>::DeleteFace(m,*f);
-        f++;
-      }
+      return used;
     }
 
     template<class EAR>
@@ -557,32 +698,80 @@ template<class EAR>
 /// It returns the number of filled holes.
 /// Tiger comments limit by bounding volume is not a good idea because if the hole is
 /// completely flat then the volume is zero
+///
+/// The holes are taken in order in batches of holes that share no vertex. The faces of
+/// a batch are added at once and its holes are closed concurrently, each hole testing
+/// its ears against its own EarRing. The mesh is the one the holes would give filled
+/// one at a time, faces in the same order.
 template<class EAR>
     static int EarCuttingIntersectionFill(MESH &m, const int maxSizeHole, const float maxHoleBBMin, bool Selected, CallBackPos *cb=0)
     {
       std::vector<Info > vinfo;
       GetInfo(m, Selected,vinfo);
-      typename std::vector<Info>::iterator ith;
 
       // collect the face pointer that has to be updated by the various addfaces
       std::vector<FacePointer *> vfpOrig;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
-        vfpOrig.push_back( &(*ith).p.f );
-
-      int indCb=0;
-      int holeCnt=0;
-      for(ith = vinfo.begin(); ith!= vinfo.end(); ++ith)
+      std::vector<size_t> toFill;
+      size_t maxNewFaces=0;
+      for(size_t k=0;k<vinfo.size();++k)
       {
-        indCb++;
-        if(cb) (*cb)(indCb*10/vinfo.size(),"Closing Holes");
-        // printf("hole size %i Given Max Dim %f this max dim %f", (*ith).size, maxHoleBBMin, (*ith).maxDim);
-        if((*ith).size < maxSizeHole and (*ith).maxDim < maxHoleBBMin){
-          std::vector<FacePointer *> facePtrToBeUpdated;
-          holeCnt++;
-          facePtrToBeUpdated=vfpOrig;
+        vfpOrig.push_back( &vinfo[k].p.f );
+        // printf("hole size %i Given Max Dim %f this max dim %f", vinfo[k].size, maxHoleBBMin, vinfo[k].maxDim);
+        if(vinfo[k].size < maxSizeHole and vinfo[k].maxDim < maxHoleBBMin)
+        {
+          toFill.push_back(k);
+          maxNewFaces+=std::max(vinfo[k].size-2,0);
+        }
+      }
+      ReserveFaces(m, m.face.size()+maxNewFaces, vfpOrig);
+
+      std::vector<int> batchOf(m.vert.size(),-1); // last batch a vertex was in
+      std::vector<size_t> batch;
+      std::vector<int> batchSize;
+      std::vector<size_t> batchFirst;
+      std::vector<int> batchUsed;
+      size_t next=0;
+      for(int b=0; next<toFill.size(); ++b)
+      {
+        if(cb) (*cb)(int(next*10/toFill.size()),"Closing Holes");
+
+        // the next holes, as long as they share no vertex with the ones before them in the batch
+        batch.clear(); batchSize.clear(); batchFirst.clear();
+        size_t newFaces=0;
+        for(; next<toFill.size(); ++next)
+        {
+          const PosType &p = vinfo[toFill[next]].p;
+          assert(p.IsBorder());
+          bool shared=false;
+          int holeSize=0;
+          PosType ip=p;
+          do{
+            shared = shared || batchOf[tri::Index(m,ip.V())]==b;
+            ip.NextB();
+            ++holeSize;
+          } while(ip!=p);
+          if(shared) break;
+          do{
+            batchOf[tri::Index(m,ip.V())]=b;
+            ip.NextB();
+          } while(ip!=p);
+          batch.push_back(toFill[next]);
+          batchSize.push_back(holeSize);
+          batchFirst.push_back(newFaces);
+          newFaces+=std::max(holeSize-2,0);
+        }
+
+        const size_t firstNew=m.face.size();
+        tri::Allocator<MESH>::AddFaces(m, newFaces, vfpOrig);
+        batchUsed.assign(batch.size(),0);
+
+#pragma omp parallel for schedule(dynamic,1) if(batch.size()>1)
+        for(int h=0;h<int(batch.size());++h)
+        {
+          const PosType &p = vinfo[batch[h]].p;
           EAR::AdjacencyRing().clear();
           //Loops around the hole to collect the faces that have to be tested for intersection.
-          PosType ip = (*ith).p;
+          PosType ip = p;
           do
           {
             PosType inp = ip;
@@ -593,17 +782,43 @@ template<class EAR>
               EAR::AdjacencyRing().push_back(inp.f);
             } while(!inp.IsBorder());
             ip.NextB();
-          }while(ip != (*ith).p);
+          }while(ip != p);
+          EAR::AdjacencyRing().Index();
 
-          typename std::vector<FacePointer>::iterator fpi;
-          for(fpi=EAR::AdjacencyRing().begin();fpi!=EAR::AdjacencyRing().end();++fpi)
-            facePtrToBeUpdated.push_back( &*fpi );
-
-          FillHoleEar<EAR >(m, ith->p,facePtrToBeUpdated);
+          EAR::InitNonManifoldBitOnHoleBoundary(p);
+          FaceIterator f = m.face.begin();
+          std::advance(f, firstNew+batchFirst[h]);
+          batchUsed[h] = CloseEars<EAR>(p, f, batchSize[h]);
           EAR::AdjacencyRing().clear();
         }
+
+        // If the hole had k non manifold vertexes it requires less than n-2 face ( it should be n - 2*(k+1) ),
+        // so we delete the remaining ones.
+        for(size_t h=0;h<batch.size();++h)
+        {
+          FaceIterator f = m.face.begin();
+          std::advance(f, firstNew+batchFirst[h]+batchUsed[h]);
+          for(int i=batchUsed[h];i<batchSize[h]-2;++i,++f)
+            tri::Allocator<MESH>::DeleteFace(m,*f);
+        }
       }
-      return holeCnt;
+      return int(toFill.size());
+    }
+
+    /// Grows the capacity of m.face to n faces, the face pointers (the ones in
+    /// facePointersToBeUpdated and the FF adjacency) are updated as AddFaces() updates them.
+    /// The AddFaces() that follow, up to n faces, do not move the faces again
+    static void ReserveFaces(MESH &m, size_t n, std::vector<FacePointer *> &facePointersToBeUpdated)
+    {
+      if(n<=m.face.capacity()) return;
+      const size_t size=m.face.size();
+      const int fn=m.fn;
+      tri::Allocator<MESH>::AddFaces(m, n-size, facePointersToBeUpdated);
+      m.face.resize(size);
+      m.fn=fn;
+      typename std::set<PointerToAttribute>::iterator ai;
+      for(ai = m.face_attr.begin(); ai != m.face_attr.end(); ++ai)
+        ((PointerToAttribute)(*ai)).Resize(m.face.size());
     }
 
 
@@ -314,8 +314,32 @@ bool IntersectionRayMesh(
 	return hit;
 }
 
-/** 
-    Compute the intersection between a mesh and a ball. 
+/**
+	 Computes the first intersection along a Ray with a Mesh whose faces are in a spatial index,
+	 a GridStaticPtr, an AABBBinaryTreeIndex or a BVHIndex. Unlike the two above, which test
+	 every face against the whole line and keep the last hit, only the faces ahead of the
+	 origin count and the nearest one is returned, with the point hit.
+*/
+template < typename  TriMeshType, class SpatialIndexType, class ScalarType>
+bool IntersectionRayMesh(
+	/* Input Mesh */		TriMeshType & m,
+	/* Index of its faces */	SpatialIndexType & index,
+	/* Ray */				const Ray3<ScalarType> & ray,
+	/* Intersect Point */	Point3<ScalarType> & hitPoint,
+	/* FacePointer */ typename TriMeshType::FacePointer & fp)
+{
+	ScalarType t;
+	fp = tri::DoRay(m, index, ray, std::numeric_limits<ScalarType>::max(), t);
+	if(fp==0) return false;
+
+	Ray3<ScalarType> dir = ray;
+	dir.Normalize();
+	hitPoint = dir.P(t);
+	return true;
+}
+
+/**
+    Compute the intersection between a mesh and a ball.
 		given a mesh return a new mesh made by a copy of all the faces entirely includeded in the ball plus
 		new faces created by refining the ones intersected by the ball border.
 		It works by recursively splitting the triangles that cross the border, as long as their area is greater than
@@ -46,15 +46,16 @@ template<class TriMeshType, class VertexPair, class MYTYPE>
 class TriEdgeCollapse: public LocalOptimization<TriMeshType>::LocModType
 {
 public:
- /// static data to gather statistical information about the reasons of collapse failures
+ /// static data to gather statistical information about the reasons of collapse failures,
+ /// one copy per thread as the mark below
   class FailStat {
   public:
-  static int &Volume()           {static int vol=0; return vol;}
-  static int &LinkConditionFace(){static int lkf=0; return lkf;}
-  static int &LinkConditionEdge(){static int lke=0; return lke;}
-  static int &LinkConditionVert(){static int lkv=0; return lkv;}
-  static int &OutOfDate()        {static int ofd=0; return ofd;}
-  static int &Border()           {static int bor=0; return bor;}
+  static int &Volume()           {static thread_local int vol=0; return vol;}
+  static int &LinkConditionFace(){static thread_local int lkf=0; return lkf;}
+  static int &LinkConditionEdge(){static thread_local int lke=0; return lke;}
+  static int &LinkConditionVert(){static thread_local int lkv=0; return lkv;}
+  static int &OutOfDate()        {static thread_local int ofd=0; return ofd;}
+  static int &Border()           {static thread_local int bor=0; return bor;}
   static void Init()
   {
    Volume()           =0;
@@ -78,8 +79,8 @@ protected:
   ///the pair to collapse
   VertexPair pos;
 
-  ///mark for up_dating
-  static int& GlobalMark(){ static int im=0; return im;}
+  ///mark for up_dating, one per thread so that separate meshes can be decimated concurrently
+  static int& GlobalMark(){ static thread_local int im=0; return im;}
 
   ///mark for up_dating
   int localMark;
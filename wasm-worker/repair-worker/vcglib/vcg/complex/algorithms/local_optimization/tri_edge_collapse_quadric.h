@@ -132,8 +132,9 @@ public:
   CoordType optimalPos;  // Local storage of the once computed optimal position of the collapse.
   
   // Pointer to the vector that store the Write flags. Used to preserve them if you ask to preserve for the boundaries.
+  // One per thread, so that separate meshes can be decimated concurrently.
   static std::vector<typename TriMeshType::VertexPointer>  & WV(){
-    static std::vector<typename TriMeshType::VertexPointer> _WV; return _WV;
+    static thread_local std::vector<typename TriMeshType::VertexPointer> _WV; return _WV;
   }
   
   inline TriEdgeCollapseQuadric(){}
@@ -213,7 +214,15 @@ public:
     h_ret.clear();
     vcg::tri::UpdateTopology<TriMeshType>::VertexFace(m);
     vcg::tri::UpdateFlags<TriMeshType>::FaceBorderFromVF(m);
-    
+    InitPreserveBoundary(m,pp);
+    InitQuadric(m,pp);
+    InitHeap(m,h_ret,_pp);
+  }
+
+  // Clear the write flag of the border vertices that must be preserved, using the face border flags.
+  static void InitPreserveBoundary(TriMeshType &m, BaseParameterClass *_pp)
+  {
+    QParameter *pp=(QParameter *)_pp;
     if(pp->FastPreserveBoundary)
     {
       for(auto pf=m.face.begin();pf!=m.face.end();++pf)
@@ -238,10 +247,12 @@ public:
               if((*pf).V1(j)->IsW()) {(*pf).V1(j)->ClearW();WV().push_back((*pf).V1(j));}
             }
     }
-    
-    InitQuadric(m,pp);
-    
-    // Initialize the heap with all the possible collapses
+  }
+
+  // Fill the heap with all the possible collapses; it needs the VF adjacency and the quadrics.
+  static void InitHeap(TriMeshType &m, HeapType &h_ret, BaseParameterClass *_pp)
+  {
+    QParameter *pp=(QParameter *)_pp;
     if(IsSymmetric(pp))
     { // if the collapse is symmetric (e.g. u->v == v->u)
       for(auto vi=m.vert.begin();vi!=m.vert.end();++vi)
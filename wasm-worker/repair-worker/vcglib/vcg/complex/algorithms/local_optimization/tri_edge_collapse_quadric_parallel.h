@@ -0,0 +1,268 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __VCG_TRIMESHCOLLAPSE_QUADRIC_PARALLEL__
+#define __VCG_TRIMESHCOLLAPSE_QUADRIC_PARALLEL__
+
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <vcg/complex/algorithms/update/flag.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace vcg{
+namespace tri{
+
+/**
+  Quadric edge collapse decimation on several threads.
+
+  The vertices are split in spatial regions by recursive median cuts along
+  the longest side of their box. A face whose vertices are all in a region
+  belongs to it; the other ones are the border faces, and their vertices are
+  locked. Every region is copied in a mesh of its own and decimated there by
+  a LocalOptimization with the collapse MYTYPE, down to its share of the
+  target (with some slack), concurrently with the others. The locked vertices are not writable,
+  so a collapse never reaches a face or a vertex shared with another region.
+  The regions are then written back and a last serial pass over the whole
+  mesh collapses the border faces, left at full resolution, and the slack
+  down to the target.
+
+  The quadrics are computed once on the whole mesh, exactly as
+  TriEdgeCollapseQuadric::Init() does, and carried through the regions to the
+  last pass, so every collapse is measured with the same metric as in a
+  serial decimation; only the order of the collapses differs. With a single
+  region (threads==1 or a small mesh) the result is the serial one.
+
+  The number of regions depends on the number of faces only, so the result
+  does not depend on the number of threads.
+
+  The collapse must be a TriEdgeCollapseQuadric; the mesh must have the
+  components it requires (VF adjacency, per vertex mark and quadric).
+*/
+template <class TriMeshType, class MYTYPE>
+class TriEdgeCollapseQuadricParallel
+{
+public:
+  typedef typename TriMeshType::ScalarType ScalarType;
+  typedef typename TriMeshType::VertexType VertexType;
+  typedef typename TriMeshType::FaceType FaceType;
+  typedef typename TriMeshType::CoordType CoordType;
+  typedef typename MYTYPE::QH QH;
+  typedef LocalOptimization<TriMeshType> SessionType;
+
+  /// faces per region, about 2% of them on the borders
+  static const int RegionFaces = 32768;
+  static const int MaxRegions = 1024;
+  /// the regions stop at this multiple of their share of the target, so that
+  /// the last pass still picks the cheapest collapses over the whole mesh
+  static constexpr double RegionSlack = 1.5;
+
+  TriEdgeCollapseQuadricParallel(TriMeshType &_m, TriEdgeCollapseQuadricParameter *_pp)
+    : m(_m), pp(_pp), threads(0), nRegions(0), nBorderFaces(0), currMetric(0) {}
+
+  TriMeshType &m;
+  TriEdgeCollapseQuadricParameter *pp;
+  int threads;        /// threads decimating the regions, all the available ones when zero
+  int nRegions;       /// regions of the last Do(), 1 when it was serial
+  int nBorderFaces;   /// faces left to the final pass
+  ScalarType currMetric;
+
+  /// Decimate down to targetFaces faces, or until the error of the next collapse exceeds targetError
+  void Do(int targetFaces, ScalarType targetError = std::numeric_limits<ScalarType>::max())
+  {
+    pp->CosineThr=cos(pp->NormalThrRad);
+    UpdateTopology<TriMeshType>::VertexFace(m);
+    UpdateFlags<TriMeshType>::FaceBorderFromVF(m);
+    typename SessionType::HeapType h;
+    MYTYPE::InitPreserveBoundary(m,pp);
+    MYTYPE::InitQuadric(m,pp);
+    MYTYPE::Finalize(m,h,pp);
+
+    nRegions=1;
+    while(nRegions*2<=MaxRegions && m.fn/(nRegions*2)>=RegionFaces) nRegions*=2;
+    nBorderFaces=m.fn;
+    if(threads!=1 && nRegions>1 && m.fn>targetFaces)
+      DecimateRegions(targetFaces,targetError);
+    else nRegions=1;
+
+    // the final pass, over the whole mesh with the quadrics of the regions
+    SessionType session(m,pp);
+    InitSession(session,m);
+    session.SetTargetSimplices(targetFaces);
+    if(targetError<std::numeric_limits<ScalarType>::max()) session.SetTargetMetric(targetError);
+    session.DoOptimization();
+    session.template Finalize<MYTYPE>();
+    currMetric=session.currMetric;
+  }
+
+private:
+  // LocalOptimization::Init() without the quadrics; the face border flags must be set
+  static void InitSession(SessionType &session, TriMeshType &mesh)
+  {
+    InitVertexIMark(mesh);
+    session.HeapSimplexRatio = MYTYPE::HeapSimplexRatio(session.pp);
+    UpdateTopology<TriMeshType>::VertexFace(mesh);
+    MYTYPE::InitPreserveBoundary(mesh,session.pp);
+    MYTYPE::InitHeap(mesh,session.h,session.pp);
+    std::make_heap(session.h.begin(),session.h.end());
+    if(!session.h.empty()) session.currMetric=session.h.front().pri;
+  }
+
+  struct AxisLess
+  {
+    const TriMeshType &m;
+    int axis;
+    AxisLess(const TriMeshType &_m, int _axis) : m(_m), axis(_axis) {}
+    bool operator()(int a, int b) const
+    {
+      const ScalarType pa=m.vert[a].cP()[axis], pb=m.vert[b].cP()[axis];
+      return pa<pb || (pa==pb && a<b);
+    }
+  };
+
+  void Partition(std::vector<int> &ids, int begin, int end, int region, int regions, std::vector<int> &regionOf)
+  {
+    if(regions==1 || end-begin<2)
+    {
+      for(int i=begin;i<end;++i) regionOf[ids[i]]=region;
+      return;
+    }
+    Box3<ScalarType> b;
+    for(int i=begin;i<end;++i) b.Add(m.vert[ids[i]].cP());
+    const CoordType d=b.Dim();
+    const int axis = (d[0]>=d[1] && d[0]>=d[2]) ? 0 : (d[1]>=d[2] ? 1 : 2);
+    const int mid=begin+(end-begin)/2;
+    std::nth_element(ids.begin()+begin,ids.begin()+mid,ids.begin()+end,AxisLess(m,axis));
+    Partition(ids,begin,mid,region,regions/2,regionOf);
+    Partition(ids,mid,end,region+regions/2,regions/2,regionOf);
+  }
+
+  void DecimateRegions(int targetFaces, ScalarType targetError)
+  {
+    std::vector<int> ids;
+    for(size_t i=0;i<m.vert.size();++i)
+      if(!m.vert[i].IsD()) ids.push_back(int(i));
+    std::vector<int> regionOf(m.vert.size(),-1);
+    Partition(ids,0,int(ids.size()),0,nRegions,regionOf);
+
+    std::vector<std::vector<int> > regionFace(nRegions);
+    std::vector<char> locked(m.vert.size(),0);
+    nBorderFaces=0;
+    for(size_t i=0;i<m.face.size();++i)
+    {
+      const FaceType &f=m.face[i];
+      if(f.IsD()) continue;
+      const int r=regionOf[Index(m,f.cV(0))];
+      if(r==regionOf[Index(m,f.cV(1))] && r==regionOf[Index(m,f.cV(2))])
+        regionFace[r].push_back(int(i));
+      else
+      {
+        for(int j=0;j<3;++j) locked[Index(m,f.cV(j))]=1;
+        ++nBorderFaces;
+      }
+    }
+
+    const double ratio=std::min(1.0,RegionSlack*targetFaces/double(m.fn));
+    std::vector<int> localIndex(m.vert.size(),-1);
+    std::vector<std::vector<int> > deadFace(nRegions), deadVert(nRegions);
+    int nt=threads;
+#ifdef _OPENMP
+    if(nt<=0) nt=omp_get_max_threads();
+#endif
+    nt=std::max(1,nt);
+
+#pragma omp parallel for schedule(dynamic,1) num_threads(nt)
+    for(int r=0;r<nRegions;++r)
+      DecimateRegion(regionFace[r],int(ratio*regionFace[r].size()),targetError,locked,localIndex,deadFace[r],deadVert[r]);
+
+    for(int r=0;r<nRegions;++r)
+    {
+      for(size_t i=0;i<deadFace[r].size();++i) Allocator<TriMeshType>::DeleteFace(m,m.face[deadFace[r][i]]);
+      for(size_t i=0;i<deadVert[r].size();++i) Allocator<TriMeshType>::DeleteVertex(m,m.vert[deadVert[r][i]]);
+    }
+    UpdateTopology<TriMeshType>::VertexFace(m);
+    UpdateFlags<TriMeshType>::FaceBorderFromVF(m);
+  }
+
+  // Every vertex of the faces of a region is in that region, so the regions
+  // touch disjoint vertices, faces and entries of localIndex.
+  void DecimateRegion(const std::vector<int> &faces, int target, ScalarType targetError,
+                      const std::vector<char> &locked, std::vector<int> &localIndex,
+                      std::vector<int> &deadFace, std::vector<int> &deadVert)
+  {
+    if(faces.empty()) return;
+    std::vector<int> vert;
+    for(size_t i=0;i<faces.size();++i)
+      for(int j=0;j<3;++j)
+      {
+        const int vi=int(Index(m,m.face[faces[i]].cV(j)));
+        if(localIndex[vi]<0) { localIndex[vi]=int(vert.size()); vert.push_back(vi); }
+      }
+
+    TriMeshType sub;
+    Allocator<TriMeshType>::AddVertices(sub,vert.size());
+    Allocator<TriMeshType>::AddFaces(sub,faces.size());
+    for(size_t i=0;i<vert.size();++i)
+    {
+      sub.vert[i].ImportData(m.vert[vert[i]]);
+      QH::Qd(sub.vert[i])=QH::Qd(m.vert[vert[i]]);
+      if(locked[vert[i]]) sub.vert[i].ClearW();
+    }
+    for(size_t i=0;i<faces.size();++i)
+    {
+      const FaceType &f=m.face[faces[i]];
+      sub.face[i].ImportData(f);
+      for(int j=0;j<3;++j)
+        sub.face[i].V(j)=&sub.vert[localIndex[Index(m,f.cV(j))]];
+    }
+
+    SessionType session(sub,pp);
+    InitSession(session,sub);
+    session.SetTargetSimplices(target);
+    if(targetError<std::numeric_limits<ScalarType>::max()) session.SetTargetMetric(targetError);
+    session.DoOptimization();
+
+    for(size_t i=0;i<vert.size();++i)
+    {
+      VertexType &v=m.vert[vert[i]];
+      if(sub.vert[i].IsD()) deadVert.push_back(vert[i]);
+      else if(!locked[vert[i]])
+      {
+        v.P()=sub.vert[i].P();
+        QH::Qd(v)=QH::Qd(sub.vert[i]);
+      }
+    }
+    for(size_t i=0;i<faces.size();++i)
+    {
+      if(sub.face[i].IsD()) { deadFace.push_back(faces[i]); continue; }
+      FaceType &f=m.face[faces[i]];
+      for(int j=0;j<3;++j)
+        f.V(j)=&m.vert[vert[sub.face[i].V(j)-&sub.vert[0]]];
+    }
+  }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif
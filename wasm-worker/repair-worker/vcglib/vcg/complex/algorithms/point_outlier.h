@@ -57,15 +57,19 @@ class OutlierRemoval
       typename MeshType::template PerVertexAttributeHandle<ScalarType> sigma =        tri::Allocator<MeshType>:: template GetPerVertexAttribute<ScalarType>(mesh, std::string("sigma"));
       typename MeshType::template PerVertexAttributeHandle<ScalarType> plof =         tri::Allocator<MeshType>:: template GetPerVertexAttribute<ScalarType>(mesh, std::string("plof"));
 
+      // the neighbours once for both passes
+      std::vector<size_t> offsets;
+      std::vector<unsigned int> neighbours;
+      std::vector<ScalarType> squareDists;
+      kdTree.doQueryKBatch(VertexConstDataWrapper<MeshType>(mesh), kNearest, offsets, neighbours, squareDists);
+
 #pragma omp parallel for schedule(dynamic, 10)
       for (size_t i = 0; i < mesh.vert.size(); i++)
       {
-        PriorityQueue queue;
-        kdTree.doQueryK(mesh.vert[i].cP(), kNearest, queue);
         ScalarType sum = 0;
-        for (int j = 0; j < queue.getNofElements(); j++)
-          sum += queue.getWeight(j);
-        sum /= (queue.getNofElements());
+        for (size_t j = offsets[i]; j < offsets[i + 1]; j++)
+          sum += squareDists[j];
+        sum /= (offsets[i + 1] - offsets[i]);
         sigma[i] = sqrt(sum);
       }
 
@@ -73,12 +77,10 @@ class OutlierRemoval
 #pragma omp parallel for reduction(+: mean) schedule(dynamic, 10)
       for (size_t i = 0; i < mesh.vert.size(); i++)
       {
-        PriorityQueue queue;
-        kdTree.doQueryK(mesh.vert[i].cP(), kNearest, queue);
         ScalarType sum = 0;
-        for (int j = 0; j < queue.getNofElements(); j++)
-          sum += sigma[queue.getIndex(j)];
-        sum /= (queue.getNofElements());
+        for (size_t j = offsets[i]; j < offsets[i + 1]; j++)
+          sum += sigma[neighbours[j]];
+        sum /= (offsets[i + 1] - offsets[i]);
         plof[i] = sigma[i] / sum  - 1.0f;
         mean += plof[i] * plof[i];
       }
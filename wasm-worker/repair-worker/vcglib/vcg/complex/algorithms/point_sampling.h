@@ -46,6 +46,10 @@ sampling strategies (montecarlo, stratified etc).
 #include <vcg/complex/algorithms/update/bounding.h>
 #include <vcg/space/segment2.h>
 #include <vcg/space/index/grid_static_ptr.h>
+#include <vcg/space/index/bvh.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace vcg
 {
@@ -344,6 +348,279 @@ public:
 }; // end class HausdorffSampler
 
 
+/* The statistics of a set of distance samples: the extremes, the sums of the
+ * distances and of their squares (L_1 and L_2) and the number of samples.
+ * Partial statistics of disjoint sets of samples can be merged.
+ */
+class HausdorffStats
+{
+public:
+  double          min_dist;
+  double          max_dist;
+  double          sum_dist;
+  double          sqr_sum_dist;
+  unsigned long   n;
+
+  HausdorffStats() { Clear(); }
+
+  void Clear()
+  {
+    min_dist = std::numeric_limits<double>::max();
+    max_dist = 0;
+    sum_dist = 0;
+    sqr_sum_dist = 0;
+    n = 0;
+  }
+
+  void Add(double dist)
+  {
+    if(dist > max_dist) max_dist = dist;
+    if(dist < min_dist) min_dist = dist;
+    sum_dist += dist;
+    sqr_sum_dist += dist*dist;
+    n++;
+  }
+
+  void Merge(const HausdorffStats &s)
+  {
+    if(s.max_dist > max_dist) max_dist = s.max_dist;
+    if(s.min_dist < min_dist) min_dist = s.min_dist;
+    sum_dist += s.sum_dist;
+    sqr_sum_dist += s.sqr_sum_dist;
+    n += s.n;
+  }
+
+  double Mean() const { return sum_dist / n; }
+  double RMS() const { return sqrt(sqr_sum_dist / n); }
+};
+
+/* Evaluates the distance of a set of sample points from a mesh on several threads.
+ *
+ * The query is a functor, called as query(point, upperBound, closestPt), that
+ * returns the distance of the point from the mesh, or upperBound when nothing
+ * is closer; such samples are not counted, as in HausdorffSampler. It is
+ * called concurrently, so the spatial index behind it must allow concurrent
+ * queries: BVHIndex does, the grids with a mark based marker do not.
+ *
+ * The samples are split in blocks of ChunkSize handed out to the threads, which
+ * only run the queries. The statistics and the histogram are then filled in
+ * sample order, as HausdorffSampler fills them one sample at a time: the sums
+ * are rounded the same way whatever the number of threads or the scheduling.
+ */
+template <class CoordType>
+class ParallelHausdorff
+{
+public:
+  typedef typename CoordType::ScalarType ScalarType;
+
+  static const int ChunkSize = 1024;
+
+  template <class QUERY, class HISTOGRAM>
+  static void Evaluate(const std::vector<CoordType> &samples, QUERY &query, ScalarType upperBound, int threads,
+                       HausdorffStats &stats, HISTOGRAM *hist,
+                       std::vector<ScalarType> *dist=0, std::vector<CoordType> *closest=0)
+  {
+    const int n = int(samples.size());
+    std::vector<ScalarType> localDist;
+    if(!dist) dist = &localDist;
+    dist->resize(n);
+    if(closest) closest->resize(n);
+    if(n == 0) return;
+
+    const int chunks = (n + ChunkSize - 1) / ChunkSize;
+#ifdef _OPENMP
+    if(threads <= 0) threads = omp_get_max_threads();
+#endif
+    threads = std::max(1, std::min(threads, chunks));
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+    for(int c = 0; c < chunks; ++c)
+    {
+      const int end = std::min(n, (c + 1) * ChunkSize);
+      for(int i = c * ChunkSize; i < end; ++i)
+      {
+        CoordType closestPt;
+        (*dist)[i] = query(samples[i], upperBound, closestPt);
+        if(closest) (*closest)[i] = closestPt;
+      }
+    }
+
+    for(int i = 0; i < n; ++i)
+    {
+      const ScalarType d = (*dist)[i];
+      if(d == upperBound) continue;
+      stats.Add(d);
+      if(hist) hist->Add((float)fabs(d));
+    }
+  }
+};
+
+/* A HausdorffSampler that defers the distance queries. The sampling functions
+ * only collect the samples; Compute() evaluates them with ParallelHausdorff,
+ * on a BVHIndex of the faces (of the vertices for a mesh without faces), then
+ * fills the quality of the sampled vertices and the optional sample and
+ * closest point meshes in sample order.
+ *
+ * With the same samples the results are those of HausdorffSampler, the sums
+ * included, and do not depend on the number of threads: with a fixed seed of
+ * the sampling random generator the whole evaluation is reproducible.
+ */
+template <class MeshType>
+class ParallelHausdorffSampler
+{
+  typedef typename MeshType::FaceType    FaceType;
+  typedef typename MeshType::VertexType    VertexType;
+  typedef typename MeshType::CoordType   CoordType;
+  typedef typename MeshType::ScalarType   ScalarType;
+  typedef BVHIndex<FaceType, ScalarType> MetroMeshFaceBVH;
+  typedef BVHIndex<VertexType, ScalarType> MetroMeshVertexBVH;
+
+  struct FaceQuery
+  {
+    MetroMeshFaceBVH &index;
+    FaceQuery(MetroMeshFaceBVH &_index) : index(_index) {}
+    ScalarType operator()(const CoordType &p, ScalarType upperBound, CoordType &closestPt) const
+    {
+      vcg::face::PointDistanceBaseFunctor<ScalarType> PDistFunct;
+      EmptyTMark<MeshType> marker;
+      ScalarType dist = upperBound;
+      index.GetClosest(PDistFunct, marker, p, upperBound, dist, closestPt);
+      return dist;
+    }
+  };
+
+  struct VertexQuery
+  {
+    MetroMeshVertexBVH &index;
+    VertexQuery(MetroMeshVertexBVH &_index) : index(_index) {}
+    ScalarType operator()(const CoordType &p, ScalarType upperBound, CoordType &closestPt) const
+    {
+      vcg::vertex::PointDistanceFunctor<ScalarType> PDistFunct;
+      EmptyTMark<MeshType> marker;
+      ScalarType dist = upperBound;
+      index.GetClosest(PDistFunct, marker, p, upperBound, dist, closestPt);
+      return dist;
+    }
+  };
+
+public:
+
+  ParallelHausdorffSampler(MeshType* _m, MeshType* _sampleMesh=0, MeshType* _closestMesh=0 )
+  {
+    m=_m;
+    threads=0;
+    init(_sampleMesh,_closestMesh);
+  }
+
+  MeshType *m;           /// the mesh for which we search the closest points.
+  MeshType *samplePtMesh;  /// the mesh containing the sample points
+  MeshType *closestPtMesh; /// the mesh containing the corresponding closest points that have been found
+
+  MetroMeshVertexBVH   bvhVert;
+  MetroMeshFaceBVH   bvhFace;
+
+  HausdorffStats stats;
+  Histogramf hist;
+  int             n_total_samples;
+  bool useVertexSampling;
+  ScalarType dist_upper_bound;  // samples that have a distance beyond this threshold distance are not considered.
+  int threads;                  // threads used by Compute(), all the available ones when zero
+
+  // the samples waiting for Compute(), with the vertex whose quality receives the distance
+  std::vector<CoordType> samplePt;
+  std::vector<CoordType> sampleN;
+  std::vector<VertexType *> sampleV;
+
+  float getMeanDist() const { return stats.Mean(); }
+  float getMinDist() const { return stats.min_dist; }
+  float getMaxDist() const { return stats.max_dist; }
+  float getRMSDist() const { return stats.RMS(); }
+
+  void init(MeshType* _sampleMesh=0, MeshType* _closestMesh=0 )
+  {
+    samplePtMesh =_sampleMesh;
+    closestPtMesh = _closestMesh;
+    if(m)
+    {
+      tri::UpdateNormal<MeshType>::PerFaceNormalized(*m);
+      if(m->fn==0) useVertexSampling = true;
+      else useVertexSampling = false;
+
+      if(useVertexSampling) bvhVert.Set(m->vert.begin(),m->vert.end());
+      else  bvhFace.Set(m->face.begin(),m->face.end());
+      hist.SetRange(0.0, m->bbox.Diag()/100.0, 100);
+    }
+    stats.Clear();
+    n_total_samples = 0;
+    samplePt.clear();
+    sampleN.clear();
+    sampleV.clear();
+  }
+
+  void AddFace(const FaceType &f, CoordType interp)
+  {
+    CoordType startPt = f.cP(0)*interp[0] + f.cP(1)*interp[1] +f.cP(2)*interp[2]; // point to be sampled
+    CoordType startN  = f.cV(0)->cN()*interp[0] + f.cV(1)->cN()*interp[1] +f.cV(2)->cN()*interp[2]; // Normal of the interpolated point
+    AddSample(startPt,startN);
+  }
+
+  void AddVert(VertexType &p)
+  {
+    AddSample(p.cP(),p.cN());
+    sampleV.back()=&p;
+  }
+
+  void AddSample(const CoordType &startPt,const CoordType &startN)
+  {
+    samplePt.push_back(startPt);
+    sampleN.push_back(startN);
+    sampleV.push_back(0);
+  }
+
+  void Compute()
+  {
+    std::vector<ScalarType> dist;
+    std::vector<CoordType> closest;
+    std::vector<CoordType> *closestPtr = closestPtMesh ? &closest : 0;
+    if(useVertexSampling)
+    {
+      VertexQuery query(bvhVert);
+      ParallelHausdorff<CoordType>::Evaluate(samplePt, query, dist_upper_bound, threads, stats, &hist, &dist, closestPtr);
+    }
+    else
+    {
+      FaceQuery query(bvhFace);
+      ParallelHausdorff<CoordType>::Evaluate(samplePt, query, dist_upper_bound, threads, stats, &hist, &dist, closestPtr);
+    }
+    n_total_samples = int(stats.n);
+
+    for(size_t i=0; i<samplePt.size(); ++i)
+    {
+      if(sampleV[i]) sampleV[i]->Q()=dist[i];
+      if(dist[i] == dist_upper_bound)
+        continue;
+      if(samplePtMesh)
+      {
+        tri::Allocator<MeshType>::AddVertices(*samplePtMesh,1);
+        samplePtMesh->vert.back().P() = samplePt[i];
+        samplePtMesh->vert.back().Q() = dist[i];
+        samplePtMesh->vert.back().N() = sampleN[i];
+      }
+      if(closestPtMesh)
+      {
+        tri::Allocator<MeshType>::AddVertices(*closestPtMesh,1);
+        closestPtMesh->vert.back().P() = closest[i];
+        closestPtMesh->vert.back().Q() = dist[i];
+        closestPtMesh->vert.back().N() = sampleN[i];
+      }
+    }
+    samplePt.clear();
+    sampleN.clear();
+    sampleV.clear();
+  }
+}; // end class ParallelHausdorffSampler
+
+
 
 /* This sampler is used to transfer the detail of a mesh onto another one.
  * It keep internally the spatial indexing structure used to find the closest point
@@ -59,29 +59,26 @@ public:
 
   static void ComputeUndirectedNormal(MeshType &m, int nn, ScalarType maxDist, KdTree<ScalarType> &tree,vcg::CallBackPos * cb=0)
   {
-//    tree.setMaxNofNeighbors(nn);
     const ScalarType maxDistSquared = maxDist*maxDist;
-    int cnt=0;
-	int step = max(m.vn, int(m.vn / 100));
-    typename KdTree<ScalarType>::PriorityQueue nq;
-    for (VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+    // the neighbours of all the vertices in one batch, then the planes on all the threads
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> neighbours;
+    std::vector<ScalarType> squareDists;
+    tree.doQueryKBatch(VertexConstDataWrapper<MeshType>(m),nn,offsets,neighbours,squareDists);
+    if(cb) cb(50,"Fitting planes");
+
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < int(m.vert.size()); i++)
     {
-        tree.doQueryK(vi->cP(),nn,nq);
-        if(cb && (++cnt%step)==0) cb(cnt/step,"Fitting planes");
-
-//        int neighbours = tree.getNofFoundNeighbors();
-        int neighbours = nq.getNofElements();
         std::vector<CoordType> ptVec;
-        for (int i = 0; i < neighbours; i++)
+        for (size_t j = offsets[i]; j < offsets[i+1]; j++)
         {
-//            int neightId = tree.getNeighborId(i);
-            int neightId = nq.getIndex(i);
-            if(nq.getWeight(i) <maxDistSquared)
-              ptVec.push_back(m.vert[neightId].cP());
+            if(squareDists[j] <maxDistSquared)
+              ptVec.push_back(m.vert[neighbours[j]].cP());
         }
         Plane3<ScalarType> plane;
         FitPlaneToPointSet(ptVec,plane);
-        vi->N()=plane.Direction();
+        m.vert[i].N()=plane.Direction();
     }
   }
 
@@ -109,7 +109,8 @@ public:
 /// each edge is stored in the vector the number of times that it appears in the mesh, with the referring face.
 /// optionally it can skip the faux edges (to retrieve only the real edges of a triangulated polygonal mesh)
 
-static void FillEdgeVector(MeshType &m, std::vector<PEdge> &edgeVec, bool includeFauxEdge=true)
+template <class EdgeVector>
+static void FillEdgeVector(MeshType &m, EdgeVector &edgeVec, bool includeFauxEdge=true)
 {
   edgeVec.reserve(m.fn*3);
   for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
@@ -237,21 +238,14 @@ static void ClearFaceFace(MeshType &m)
   }
 }
 
-/// \brief Update the Face-Face topological relation by allowing to retrieve for each face what other faces shares their edges.
-static void FaceFace(MeshType &m)
+/// \brief Link together the faces of a vector of edges already sorted by vertex.
+/// Each block of equal edges becomes a (possibly non manifold) ring of FF adjacencies.
+static void FaceFaceFromSortedEdges(std::vector<PEdge> &e)
 {
-  RequireFFAdjacency(m);
-  if( m.fn == 0 ) return;
-
-  std::vector<PEdge> e;
-  FillEdgeVector(m,e);
-  sort(e.begin(), e.end());							// Lo ordino per vertici
-
-  int ne = 0;											// Numero di edge reali
+  if( e.empty() ) return;
 
   typename std::vector<PEdge>::iterator pe,ps;
   ps = e.begin();pe=e.begin();
-  //for(ps = e.begin(),pe=e.begin();pe<=e.end();++pe)	// Scansione vettore ausiliario
   do
   {
     if( pe==e.end() || !(*pe == *ps) )					// Trovo blocco di edge uguali
@@ -260,7 +254,6 @@ static void FaceFace(MeshType &m)
       for (q=ps;q<pe-1;++q)						// Scansione facce associate
       {
         assert((*q).z>=0);
-        //assert((*q).z< 3);
         q_next = q;
         ++q_next;
         assert((*q_next).z>=0);
@@ -273,13 +266,141 @@ static void FaceFace(MeshType &m)
       (*q).f->FFp((*q).z) = ps->f;
       (*q).f->FFi((*q).z) = ps->z;
       ps = pe;
-      ++ne;										// Aggiorno il numero di edge
     }
     if(pe==e.end()) break;
     ++pe;
   } while(true);
 }
 
+/// \brief Link together the faces around the edges of the live faces, only the edges with both
+/// the endpoints visited when onlyVisited is set.
+/**
+The half edges are bucketed by their smaller vertex index with a parallel counting sort, each one
+as a 64 bit key: the larger vertex index and its id 3*face+z. A bucket holds the few half edges
+around a vertex, sorting it puts the ones of the same edge next to each other in face order.
+It takes 8 bytes per half edge and a linear pass in place of the std::sort of the 32 bytes PEdge.
+Manifold and border edges get the same links of the PEdge sort, the faces around a non manifold
+edge are linked in face order (the order left by std::sort was unspecified).
+*/
+static void FaceFaceFromHalfEdges(MeshType &m, bool onlyVisited)
+{
+  const int fn = int(m.face.size());
+  const long long vn = (long long)m.vert.size();
+  const VertexPointer vbase = &m.vert[0];
+  const FacePointer fbase = &m.face[0];
+
+  struct Take {
+    static bool Edge(const FaceType &f, int j, bool onlyVisited) {
+      return !f.IsD() && (!onlyVisited || (f.cV0(j)->IsV() && f.cV1(j)->IsV()));
+    }
+  };
+
+  typedef ScratchVector<MeshType,uint32_t> Index32;
+  typedef ScratchVector<MeshType,uint64_t> Index64;
+
+  // half edges per smaller vertex, then the offsets of the buckets
+  typename Index32::Type start(size_t(vn)+1,0,Index32::Allocator(m));
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<fn;++i)
+    for(int j=0;j<3;++j)
+      if(Take::Edge(m.face[i],j,onlyVisited))
+      {
+        const size_t a = std::min(m.face[i].cV0(j),m.face[i].cV1(j)) - vbase;
+#pragma omp atomic
+        ++start[a+1];
+      }
+  for(long long v=0;v<vn;++v)
+    start[v+1]+=start[v];
+
+  typename Index64::Type he(start[vn],0,Index64::Allocator(m));
+  {
+    typename Index32::Type next(start.begin(),start.end()-1,Index32::Allocator(m));
+#pragma omp parallel for schedule(static)
+    for(int i=0;i<fn;++i)
+      for(int j=0;j<3;++j)
+        if(Take::Edge(m.face[i],j,onlyVisited))
+        {
+          const VertexPointer v0 = m.face[i].cV0(j), v1 = m.face[i].cV1(j);
+          assert(v0 != v1); // The face is Degenerate (two coincident vertexes)
+          const size_t a = std::min(v0,v1) - vbase, b = std::max(v0,v1) - vbase;
+          uint32_t pos;
+#pragma omp atomic capture
+          pos = next[a]++;
+          he[pos] = (uint64_t(b)<<32) | uint64_t(3*i+j);
+        }
+  }
+
+  // in each bucket the runs with the same larger vertex are the edges
+#pragma omp parallel for schedule(dynamic,4096)
+  for(long long v=0;v<vn;++v)
+  {
+    uint64_t *first = he.data()+start[v], *last = he.data()+start[v+1];
+    std::sort(first,last);
+    for(uint64_t *ps=first;ps<last;)
+    {
+      uint64_t *pe=ps+1;
+      while(pe<last && (*pe>>32)==(*ps>>32)) ++pe;
+      for(uint64_t *q=ps;q<pe;++q)
+      {
+        const uint32_t h = uint32_t(*q), next = uint32_t(q+1<pe ? q[1] : *ps);
+        FacePointer f = fbase + h/3;
+        f->FFp(h%3) = fbase + next/3;
+        f->FFi(h%3) = next%3;
+      }
+      ps=pe;
+    }
+  }
+}
+
+/// \brief Update the Face-Face topological relation by allowing to retrieve for each face what other faces shares their edges.
+static void FaceFace(MeshType &m)
+{
+  RequireFFAdjacency(m);
+  if( m.fn == 0 ) return;
+
+  // triangles only, and the half edge ids are 32 bits
+  if( !tri::HasPolyInfo(m) && m.face.size() < size_t(0xffffffffu)/3 )
+  {
+    FaceFaceFromHalfEdges(m,false);
+    return;
+  }
+
+  std::vector<PEdge> e;
+  FillEdgeVector(m,e);
+  sort(e.begin(), e.end());							// Lo ordino per vertici
+
+  FaceFaceFromSortedEdges(e);
+}
+
+/// \brief Update the Face-Face topological relation only for the edges having both the endpoints marked as visited.
+/**
+All the other FF links are left untouched. Any face sharing an edge with a face that has been added, deleted or
+modified must have visited vertices, so marking the vertices of those faces is enough to get the same relation
+that FaceFace() would build on the whole mesh, the faces around non manifold edges in the same order too.
+*/
+static void FaceFaceAroundVisitedVertex(MeshType &m)
+{
+  RequireFFAdjacency(m);
+  RequirePerVertexFlags(m);
+  if( m.fn == 0 ) return;
+
+  if( !tri::HasPolyInfo(m) && m.face.size() < size_t(0xffffffffu)/3 )
+  {
+    FaceFaceFromHalfEdges(m,true);
+    return;
+  }
+
+  std::vector<PEdge> e;
+  for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+    if( ! (*fi).IsD() )
+      for(int j=0;j<(*fi).VN();++j)
+        if( (*fi).V0(j)->IsV() && (*fi).V1(j)->IsV() )
+          e.push_back(PEdge(&*fi,j));
+  sort(e.begin(), e.end());
+
+  FaceFaceFromSortedEdges(e);
+}
+
 /// \brief Update the Vertex-Face topological relation.
 /**
 The function allows to retrieve for each vertex the list of faces sharing this vertex.
@@ -74,6 +74,22 @@ void ResizeAttribute(ATTR_CONT &c, size_t sz, MeshType &/*m*/){
     ((typename MeshType::PointerToAttribute)(*ai)).Resize(sz);
 }
 
+/** \brief Vector for the temporary buffers of an algorithm on a mesh.
+
+It takes the allocator of the vertex container rebound to T: a mesh whose containers live in a pool
+gets the scratch of the algorithms from the same pool, with std::allocator it is a plain std::vector.
+\code
+typename ScratchVector<MeshType,int>::Type remap(n, 0, ScratchVector<MeshType,int>::Allocator(m));
+\endcode
+*/
+template <class MeshType, class T>
+struct ScratchVector
+{
+  typedef typename std::allocator_traits<typename MeshType::VertContainer::allocator_type>::template rebind_alloc<T> AllocatorType;
+  typedef std::vector<T, AllocatorType> Type;
+  static AllocatorType Allocator(const MeshType &m) { return AllocatorType(m.vert.get_allocator()); }
+};
+
 /*!
         \brief  Class to safely add and delete elements in a mesh.
 
@@ -477,11 +477,11 @@ template <class MeshType> inline void UnMarkAll(MeshType & m)
 //template < class  CType0, class CType1, class CType2 , class CType3>
 //bool HasPerEdgeVEAdjacency   (const TriMesh < CType0, CType1, CType2, CType3> & /*m*/) {return TriMesh < CType0 , CType1, CType2, CType3>::EdgeContainer::value_type::HasVEAdjacency();}
 
-template < class VertexType> bool VertexVectorHasVFAdjacency     (const std::vector<VertexType> &) {  return VertexType::HasVFAdjacency(); }
-template < class VertexType> bool VertexVectorHasVEAdjacency     (const std::vector<VertexType> &) {  return VertexType::HasVEAdjacency(); }
-template < class EdgeType  > bool   EdgeVectorHasVEAdjacency     (const std::vector<EdgeType  > &) {  return EdgeType::HasVEAdjacency(); }
-template < class EdgeType  > bool   EdgeVectorHasEEAdjacency     (const std::vector<EdgeType> &) {  return EdgeType::HasEEAdjacency(); }
-template < class FaceType  > bool   FaceVectorHasVFAdjacency     (const std::vector<FaceType  > &) {  return FaceType::HasVFAdjacency(); }
+template < class VertexType, class Alloc> bool VertexVectorHasVFAdjacency     (const std::vector<VertexType, Alloc> &) {  return VertexType::HasVFAdjacency(); }
+template < class VertexType, class Alloc> bool VertexVectorHasVEAdjacency     (const std::vector<VertexType, Alloc> &) {  return VertexType::HasVEAdjacency(); }
+template < class EdgeType, class Alloc> bool   EdgeVectorHasVEAdjacency     (const std::vector<EdgeType  , Alloc> &) {  return EdgeType::HasVEAdjacency(); }
+template < class EdgeType, class Alloc> bool   EdgeVectorHasEEAdjacency     (const std::vector<EdgeType, Alloc> &) {  return EdgeType::HasEEAdjacency(); }
+template < class FaceType, class Alloc> bool   FaceVectorHasVFAdjacency     (const std::vector<FaceType  , Alloc> &) {  return FaceType::HasVFAdjacency(); }
 
 template < class TriMeshType> bool HasPerVertexVFAdjacency     (const TriMeshType &m) { return tri::VertexVectorHasVFAdjacency(m.vert); }
 template < class TriMeshType> bool HasPerVertexVEAdjacency     (const TriMeshType &m) { return tri::VertexVectorHasVEAdjacency(m.vert); }
@@ -489,15 +489,15 @@ template < class TriMeshType> bool   HasPerEdgeVEAdjacency     (const TriMeshTyp
 template < class TriMeshType> bool   HasPerFaceVFAdjacency     (const TriMeshType &m) { return tri::FaceVectorHasVFAdjacency  (m.face); }
 
 
-template < class VertexType> bool VertexVectorHasPerVertexQuality     (const std::vector<VertexType> &) {  return VertexType::HasQuality     (); }
-template < class VertexType> bool VertexVectorHasPerVertexNormal      (const std::vector<VertexType> &) {  return VertexType::HasNormal      (); }
-template < class VertexType> bool VertexVectorHasPerVertexColor       (const std::vector<VertexType> &) {  return VertexType::HasColor       (); }
-template < class VertexType> bool VertexVectorHasPerVertexMark        (const std::vector<VertexType> &) {  return VertexType::HasMark        (); }
-template < class VertexType> bool VertexVectorHasPerVertexFlags       (const std::vector<VertexType> &) {  return VertexType::HasFlags       (); }
-template < class VertexType> bool VertexVectorHasPerVertexRadius      (const std::vector<VertexType> &) {  return VertexType::HasRadius      (); }
-template < class VertexType> bool VertexVectorHasPerVertexCurvature   (const std::vector<VertexType> &) {  return VertexType::HasCurvature   (); }
-template < class VertexType> bool VertexVectorHasPerVertexCurvatureDir(const std::vector<VertexType> &) {  return VertexType::HasCurvatureDir(); }
-template < class VertexType> bool VertexVectorHasPerVertexTexCoord    (const std::vector<VertexType> &) {  return VertexType::HasTexCoord    (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexQuality     (const std::vector<VertexType, Alloc> &) {  return VertexType::HasQuality     (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexNormal      (const std::vector<VertexType, Alloc> &) {  return VertexType::HasNormal      (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexColor       (const std::vector<VertexType, Alloc> &) {  return VertexType::HasColor       (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexMark        (const std::vector<VertexType, Alloc> &) {  return VertexType::HasMark        (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexFlags       (const std::vector<VertexType, Alloc> &) {  return VertexType::HasFlags       (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexRadius      (const std::vector<VertexType, Alloc> &) {  return VertexType::HasRadius      (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexCurvature   (const std::vector<VertexType, Alloc> &) {  return VertexType::HasCurvature   (); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexCurvatureDir(const std::vector<VertexType, Alloc> &) {  return VertexType::HasCurvatureDir(); }
+template < class VertexType, class Alloc> bool VertexVectorHasPerVertexTexCoord    (const std::vector<VertexType, Alloc> &) {  return VertexType::HasTexCoord    (); }
 
 template < class TriMeshType> bool HasPerVertexQuality     (const TriMeshType &m) { return tri::VertexVectorHasPerVertexQuality     (m.vert); }
 template < class TriMeshType> bool HasPerVertexNormal      (const TriMeshType &m) { return tri::VertexVectorHasPerVertexNormal      (m.vert); }
@@ -509,11 +509,11 @@ template < class TriMeshType> bool HasPerVertexCurvature   (const TriMeshType &m
 template < class TriMeshType> bool HasPerVertexCurvatureDir(const TriMeshType &m) { return tri::VertexVectorHasPerVertexCurvatureDir(m.vert); }
 template < class TriMeshType> bool HasPerVertexTexCoord    (const TriMeshType &m) { return tri::VertexVectorHasPerVertexTexCoord    (m.vert); }
 
-template < class EdgeType> bool EdgeVectorHasPerEdgeQuality     (const std::vector<EdgeType> &) {  return EdgeType::HasQuality     (); }
-template < class EdgeType> bool EdgeVectorHasPerEdgeNormal      (const std::vector<EdgeType> &) {  return EdgeType::HasNormal      (); }
-template < class EdgeType> bool EdgeVectorHasPerEdgeColor       (const std::vector<EdgeType> &) {  return EdgeType::HasColor       (); }
-template < class EdgeType> bool EdgeVectorHasPerEdgeMark        (const std::vector<EdgeType> &) {  return EdgeType::HasMark        (); }
-template < class EdgeType> bool EdgeVectorHasPerEdgeFlags       (const std::vector<EdgeType> &) {  return EdgeType::HasFlags       (); }
+template < class EdgeType, class Alloc> bool EdgeVectorHasPerEdgeQuality     (const std::vector<EdgeType, Alloc> &) {  return EdgeType::HasQuality     (); }
+template < class EdgeType, class Alloc> bool EdgeVectorHasPerEdgeNormal      (const std::vector<EdgeType, Alloc> &) {  return EdgeType::HasNormal      (); }
+template < class EdgeType, class Alloc> bool EdgeVectorHasPerEdgeColor       (const std::vector<EdgeType, Alloc> &) {  return EdgeType::HasColor       (); }
+template < class EdgeType, class Alloc> bool EdgeVectorHasPerEdgeMark        (const std::vector<EdgeType, Alloc> &) {  return EdgeType::HasMark        (); }
+template < class EdgeType, class Alloc> bool EdgeVectorHasPerEdgeFlags       (const std::vector<EdgeType, Alloc> &) {  return EdgeType::HasFlags       (); }
 
 template < class TriMeshType> bool HasPerEdgeQuality     (const TriMeshType &m) { return tri::EdgeVectorHasPerEdgeQuality     (m.edge); }
 template < class TriMeshType> bool HasPerEdgeNormal      (const TriMeshType &m) { return tri::EdgeVectorHasPerEdgeNormal      (m.edge); }
@@ -522,9 +522,9 @@ template < class TriMeshType> bool HasPerEdgeMark        (const TriMeshType &m)
 template < class TriMeshType> bool HasPerEdgeFlags       (const TriMeshType &m) { return tri::EdgeVectorHasPerEdgeFlags       (m.edge); }
 
 
-template < class FaceType>    bool FaceVectorHasPerWedgeColor   (const std::vector<FaceType> &) {  return FaceType::HasWedgeColor   (); }
-template < class FaceType>    bool FaceVectorHasPerWedgeNormal  (const std::vector<FaceType> &) {  return FaceType::HasWedgeNormal  (); }
-template < class FaceType>    bool FaceVectorHasPerWedgeTexCoord(const std::vector<FaceType> &) {  return FaceType::HasWedgeTexCoord(); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerWedgeColor   (const std::vector<FaceType, Alloc> &) {  return FaceType::HasWedgeColor   (); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerWedgeNormal  (const std::vector<FaceType, Alloc> &) {  return FaceType::HasWedgeNormal  (); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerWedgeTexCoord(const std::vector<FaceType, Alloc> &) {  return FaceType::HasWedgeTexCoord(); }
 
 template < class TriMeshType> bool HasPerWedgeColor   (const TriMeshType &m) { return tri::FaceVectorHasPerWedgeColor   (m.face); }
 template < class TriMeshType> bool HasPerWedgeNormal  (const TriMeshType &m) { return tri::FaceVectorHasPerWedgeNormal  (m.face); }
@@ -533,15 +533,15 @@ template < class TriMeshType> bool HasPerWedgeTexCoord(const TriMeshType &m) { r
 template < class  CType0, class CType1, class CType2 , class CType3>
 bool HasPolyInfo (const TriMesh < CType0, CType1, CType2, CType3> & /*m*/) {return TriMesh < CType0 , CType1, CType2, CType3>::FaceContainer::value_type::HasPolyInfo();}
 
-template < class FaceType>    bool FaceVectorHasPerFaceFlags  (const std::vector<FaceType> &) {  return FaceType::HasFlags  (); }
-template < class FaceType>    bool FaceVectorHasPerFaceNormal (const std::vector<FaceType> &) {  return FaceType::HasNormal (); }
-template < class FaceType>    bool FaceVectorHasPerFaceColor  (const std::vector<FaceType> &) {  return FaceType::HasColor  (); }
-template < class FaceType>    bool FaceVectorHasPerFaceMark   (const std::vector<FaceType> &) {  return FaceType::HasMark   (); }
-template < class FaceType>    bool FaceVectorHasPerFaceQuality(const std::vector<FaceType> &) {  return FaceType::HasQuality(); }
-template < class FaceType>    bool FaceVectorHasFFAdjacency   (const std::vector<FaceType> &) {  return FaceType::HasFFAdjacency(); }
-template < class FaceType>    bool FaceVectorHasFEAdjacency   (const std::vector<FaceType> &) {  return FaceType::HasFEAdjacency(); }
-template < class FaceType>    bool FaceVectorHasFVAdjacency   (const std::vector<FaceType> &) {  return FaceType::HasFVAdjacency(); }
-template < class FaceType>    bool FaceVectorHasPerFaceCurvatureDir   (const std::vector<FaceType> &) {  return FaceType::HasCurvatureDir(); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerFaceFlags  (const std::vector<FaceType, Alloc> &) {  return FaceType::HasFlags  (); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerFaceNormal (const std::vector<FaceType, Alloc> &) {  return FaceType::HasNormal (); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerFaceColor  (const std::vector<FaceType, Alloc> &) {  return FaceType::HasColor  (); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerFaceMark   (const std::vector<FaceType, Alloc> &) {  return FaceType::HasMark   (); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerFaceQuality(const std::vector<FaceType, Alloc> &) {  return FaceType::HasQuality(); }
+template < class FaceType, class Alloc>    bool FaceVectorHasFFAdjacency   (const std::vector<FaceType, Alloc> &) {  return FaceType::HasFFAdjacency(); }
+template < class FaceType, class Alloc>    bool FaceVectorHasFEAdjacency   (const std::vector<FaceType, Alloc> &) {  return FaceType::HasFEAdjacency(); }
+template < class FaceType, class Alloc>    bool FaceVectorHasFVAdjacency   (const std::vector<FaceType, Alloc> &) {  return FaceType::HasFVAdjacency(); }
+template < class FaceType, class Alloc>    bool FaceVectorHasPerFaceCurvatureDir   (const std::vector<FaceType, Alloc> &) {  return FaceType::HasCurvatureDir(); }
 
 template < class TriMeshType> bool HasPerFaceFlags       (const TriMeshType &m) { return tri::FaceVectorHasPerFaceFlags       (m.face); }
 template < class TriMeshType> bool HasPerFaceNormal      (const TriMeshType &m) { return tri::FaceVectorHasPerFaceNormal      (m.face); }
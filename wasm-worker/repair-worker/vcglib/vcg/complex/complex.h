@@ -40,6 +40,7 @@
 #include <limits>
 #include <iterator>
 #include <typeindex>
+#include <memory>
 #include <wrap/callback.h>
 #include <vcg/complex/exception.h>
 #include <vcg/container/simple_temporary_data.h>
@@ -178,6 +178,20 @@ public:
      */
   void Add(ScalarType v, ScalarType increment=ScalarType(1.0));
 
+  /**
+     * Add the content of another histogram with the same bins, e.g. one
+     * filled by another thread on a different subset of the data.
+     *
+     * The bin counts are sums of whole increments and do not depend on the
+     * order of the merges; Sum() and RMS() do, within rounding.
+     */
+  void Merge(const Histogram<ScalarType> &h);
+
+  /**
+     * Set every counter to zero, keeping the bins.
+     */
+  void ClearCounts();
+
   ScalarType MaxCount() const;        //! Max number of elements among all buckets (including the two infinity bounded buckets)
   ScalarType MaxCountInRange() const; //! Max number of elements among all buckets between MinV and MaxV.
   int BinNum() const {return n;}
@@ -317,6 +331,30 @@ void Histogram<ScalarType>::Add(ScalarType v, ScalarType increment)
   rms += (v*v)*increment;
 }
 
+template <class ScalarType>
+void Histogram<ScalarType>::Merge(const Histogram<ScalarType> &h)
+{
+  assert(h.H.size()==H.size() && h.n==n);
+  for(size_t i=0; i<H.size(); ++i)
+    H[i]+=h.H[i];
+  if(h.minElem<minElem) minElem=h.minElem;
+  if(h.maxElem>maxElem) maxElem=h.maxElem;
+  cnt+=h.cnt;
+  sum+=h.sum;
+  rms+=h.rms;
+}
+
+template <class ScalarType>
+void Histogram<ScalarType>::ClearCounts()
+{
+  fill(H.begin(),H.end(),0);
+  cnt=0;
+  sum=0;
+  rms=0;
+  minElem = std::numeric_limits<ScalarType>::max();
+  maxElem = -std::numeric_limits<ScalarType>::max();
+}
+
 template <class ScalarType>
 ScalarType Histogram<ScalarType>::BinCount(ScalarType v)
 {
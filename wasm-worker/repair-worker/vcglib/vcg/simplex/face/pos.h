@@ -128,13 +128,9 @@ public:
         return ((*this)<=p);
     }
 
-    /// Assignment operator
-    inline PosType & operator = ( const PosType & h ){
-        f=h.f;
-        z=h.z;
-        v=h.v;
-        return *this;
-    }
+    /// Copy constructor and assignment operator
+    Pos( const PosType & h ) = default;
+    inline PosType & operator = ( const PosType & h ) = default;
 
     /// Set to null the half-edge
     void SetNull(){
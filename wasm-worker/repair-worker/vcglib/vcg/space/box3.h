@@ -51,8 +51,9 @@ public:
     Point3<BoxScalarType> max;
         /// The bounding box constructor
     inline  Box3() { min.X()= 1;max.X()= -1;min.Y()= 1;max.Y()= -1;min.Z()= 1;max.Z()= -1;}
-        /// Copy constructor
-    inline  Box3( const Box3 & b ) { min=b.min; max=b.max; }
+        /// Copy constructor and assignment
+    inline  Box3( const Box3 & b ) = default;
+    inline  Box3 & operator = ( const Box3 & b ) = default;
         /// Min Max constructor
     inline  Box3( const Point3<BoxScalarType> & mi, const Point3<BoxScalarType> & ma ) { min = mi; max = ma; }
     /// Point Radius Constructor
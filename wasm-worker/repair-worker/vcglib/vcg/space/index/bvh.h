@@ -0,0 +1,772 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *   
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __VCGLIB_BVHINDEX_H
+#define __VCGLIB_BVHINDEX_H
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <vcg/space/index/base.h>
+#include <vcg/space/box3.h>
+#include <vcg/space/ray3.h>
+
+namespace vcg {
+
+/** Allocator of arrays starting on an ALIGN byte boundary, for the nodes of BVHIndex */
+template <class T, size_t ALIGN>
+class BVHAlignedAllocator {
+public:
+  typedef T value_type;
+  template <class U> struct rebind { typedef BVHAlignedAllocator<U, ALIGN> other; };
+
+  BVHAlignedAllocator() {}
+  template <class U> BVHAlignedAllocator(const BVHAlignedAllocator<U, ALIGN> &) {}
+
+  T * allocate(size_t n)
+  {
+    // the block handed out by new is kept just before the aligned start
+    char * raw = static_cast<char *>(::operator new(n * sizeof(T) + ALIGN + sizeof(void *)));
+    uintptr_t p = (uintptr_t(raw) + sizeof(void *) + ALIGN - 1) & ~uintptr_t(ALIGN - 1);
+    reinterpret_cast<void **>(p)[-1] = raw;
+    return reinterpret_cast<T *>(p);
+  }
+  void deallocate(T * p, size_t) { ::operator delete(reinterpret_cast<void **>(p)[-1]); }
+
+  template <class U> bool operator==(const BVHAlignedAllocator<U, ALIGN> &) const { return true; }
+  template <class U> bool operator!=(const BVHAlignedAllocator<U, ALIGN> &) const { return false; }
+};
+
+/****************************************************************************
+Class BVHIndex
+
+Description:
+	A bounding volume hierarchy over objects exposing GetBBox() and IsD(),
+	typically the faces of a mesh, with the SpatialIndex interface of
+	GridStaticPtr and AABBBinaryTreeIndex: Set(), GetClosest(), DoRay() and
+	GetInBox() take the same functors and markers, so it can replace them in
+	GetClosestFaceBase(), tri::DoRay() or Clean::SelfIntersectionsParallel().
+
+	The tree is four wide. Every node holds the boxes of its four children,
+	coordinate by coordinate, so that a query tests the four boxes at once
+	with a handful of simd instructions (a scalar loop without SSE2). The
+	nodes are 128 bytes, two cache lines, stored in a flat array aligned on
+	a cache line in depth first order, and traversed with a short fixed size
+	stack, nearest child first. The objects of a leaf are contiguous.
+
+	It is built top down with the surface area heuristic evaluated on a few
+	bins per axis; a node takes the best split of its child of largest area
+	until it has four children. Subtrees are built as OpenMP tasks, the
+	result does not depend on the number of threads. Past a fixed depth the
+	splits fall back to the median, which keeps the stack bounded.
+
+	The boxes are stored in float, rounded outwards when SCALARTYPE is wider.
+	Deleted objects are left out at Set() and skipped by the queries.
+
+Template Parameters:
+	OBJTYPE:      Type of the indexed objects.
+	SCALARTYPE:   Scalar type of the queries.
+
+****************************************************************************/
+template <class OBJTYPE, class SCALARTYPE = float>
+class BVHIndex : public SpatialIndex<OBJTYPE, SCALARTYPE> {
+public:
+  typedef BVHIndex<OBJTYPE, SCALARTYPE> ClassType;
+  typedef OBJTYPE ObjType;
+  typedef SCALARTYPE ScalarType;
+  typedef ObjType * ObjPtr;
+  typedef Point3<ScalarType> CoordType;
+  typedef vcg::Box3<ScalarType> BoxType;
+
+  // objects in a leaf the heuristic may choose, and the size below which a child is not split further
+  static const int MaxLeafSize = 8;
+  static const int MinSplitSize = 4;
+  static const int BinCount = 16;
+  // binary split depth past which the splits are at the median: at most
+  // MaxSahDepth + 32 levels, three more stack entries each
+  static const int MaxSahDepth = 48;
+  static const int StackSize = 256;
+  // the subtrees and the binning passes larger than this run as tasks
+  static const int TaskSize = 4096;
+
+  struct Node {
+    float bounds[6][4];   // min x, y, z then max x, y, z of the four children
+    int child[4];         // a node, or the first object of a leaf
+    int count[4];         // 0 for a node, the objects of a leaf, -1 for an empty slot
+  };
+
+  BVHIndex() {}
+
+  bool Empty() const { return nodes.empty(); }
+
+  void Clear()
+  {
+    nodes.clear();
+    objects.clear();
+  }
+
+  size_t NodeCount() const { return nodes.size(); }
+
+  template <class OBJITER>
+  void Set(const OBJITER & _oBegin, const OBJITER & _oEnd)
+  {
+    Clear();
+    std::vector<ObjPtr> all;
+    for (OBJITER i = _oBegin; i != _oEnd; ++i)
+      if (!(*i).IsD()) all.push_back(&(*i));
+    const int n = int(all.size());
+    if (n == 0) return;
+
+    std::vector<PrimRef> refs(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i)
+    {
+      BoxType b;
+      all[i]->GetBBox(b);
+      for (int a = 0; a < 3; ++a)
+      {
+        refs[i].lo[a] = RoundDown(b.min[a]);
+        refs[i].hi[a] = RoundUp(b.max[a]);
+      }
+      refs[i].id = i;
+    }
+    typename Builder::Range whole;
+    whole.begin = 0; whole.end = n; whole.depth = 0; whole.final = false;
+    whole.box.Reset();
+    whole.centers.Reset();
+    for (int i = 0; i < n; ++i)
+    {
+      whole.box.Add(refs[i].lo, refs[i].hi);
+      Builder::AddCenter(whole.centers, refs[i]);
+    }
+
+    Builder builder(&refs[0]);
+    BuildNode * root = 0;
+#pragma omp parallel
+    {
+#pragma omp single
+      root = builder.Build(whole);
+    }
+    // the tasks are done at the barrier closing the parallel region
+
+    nodes.resize(root->Count());
+    int next = 0;
+    Flatten(root, next);
+    delete root;
+
+    objects.resize(n);
+    for (int i = 0; i < n; ++i)
+      objects[i] = all[refs[i].id];
+  }
+
+  template <class OBJPOINTDISTFUNCTOR, class OBJMARKER>
+  ObjPtr GetClosest(OBJPOINTDISTFUNCTOR & _getPointDistance, OBJMARKER & _marker,
+    const typename OBJPOINTDISTFUNCTOR::QueryType & _p, const ScalarType & _maxDist,
+    ScalarType & _minDist, CoordType & _closestPt)
+  {
+    (void)_marker; // every object is in one leaf only
+    _minDist = _maxDist;
+    if (nodes.empty()) return 0;
+
+    const Point3<ScalarType> p = OBJPOINTDISTFUNCTOR::Pos(_p);
+    const float q[3] = { float(p[0]), float(p[1]), float(p[2]) };
+    float reach = Reach2(_minDist);
+    ObjPtr winner = 0;
+    CoordType t_res;
+
+    StackEntry stack[StackSize];
+    int sp = 0;
+    stack[sp++] = StackEntry(0, 0, 0.0f);
+    while (sp > 0)
+    {
+      const StackEntry e = stack[--sp];
+      if (e.d > reach) continue;
+      if (e.count > 0)
+      {
+        for (int i = e.child; i < e.child + e.count; ++i)
+        {
+          ObjPtr elem = objects[i];
+          if (!elem->IsD() && _getPointDistance(*elem, _p, _minDist, t_res))
+          {
+            winner = elem;
+            _closestPt = t_res;
+            reach = Reach2(_minDist);
+          }
+        }
+        continue;
+      }
+      const Node & node = nodes[e.child];
+      float d[4];
+      PointDist2(node, q, d);
+      Push(node, d, reach, stack, sp);
+    }
+    return winner;
+  }
+
+  template <class OBJRAYISECTFUNCTOR, class OBJMARKER>
+  ObjPtr DoRay(OBJRAYISECTFUNCTOR & _rayIntersector, OBJMARKER & _marker,
+    const Ray3<ScalarType> & _ray, const ScalarType & _maxDist, ScalarType & _t)
+  {
+    (void)_marker;
+    if (nodes.empty()) return 0;
+
+    const RayData r(_ray);
+    ScalarType bestT = _maxDist;
+    float reach = ReachT(bestT);
+    ObjPtr winner = 0;
+
+    StackEntry stack[StackSize];
+    int sp = 0;
+    stack[sp++] = StackEntry(0, 0, 0.0f);
+    while (sp > 0)
+    {
+      const StackEntry e = stack[--sp];
+      if (e.d > reach) continue;
+      if (e.count > 0)
+      {
+        for (int i = e.child; i < e.child + e.count; ++i)
+        {
+          ObjPtr elem = objects[i];
+          ScalarType t;
+          if (!elem->IsD() && _rayIntersector(*elem, _ray, t) && t < bestT)
+          {
+            winner = elem;
+            bestT = t;
+            reach = ReachT(bestT);
+          }
+        }
+        continue;
+      }
+      const Node & node = nodes[e.child];
+      float tn[4];
+      RayEnter(node, r, reach, tn);
+      Push(node, tn, reach, stack, sp);
+    }
+    if (winner) _t = bestT;
+    return winner;
+  }
+
+  template <class OBJMARKER, class OBJPTRCONTAINER>
+  unsigned int GetInBox(OBJMARKER & _marker, const vcg::Box3<ScalarType> _bbox, OBJPTRCONTAINER & _objectPtrs)
+  {
+    (void)_marker;
+    _objectPtrs.clear();
+    if (nodes.empty() || _bbox.IsNull()) return 0;
+
+    float lo[3], hi[3];
+    for (int a = 0; a < 3; ++a)
+    {
+      lo[a] = RoundDown(_bbox.min[a]);
+      hi[a] = RoundUp(_bbox.max[a]);
+    }
+    int stack[StackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0)
+    {
+      const Node & node = nodes[stack[--sp]];
+      const int hit = BoxOverlap(node, lo, hi);
+      for (int k = 0; k < 4; ++k) if (hit & (1 << k))
+      {
+        if (node.count[k] == 0)
+        {
+          stack[sp++] = node.child[k];
+          continue;
+        }
+        for (int i = node.child[k]; i < node.child[k] + node.count[k]; ++i)
+        {
+          ObjPtr elem = objects[i];
+          BoxType box_elem;
+          elem->GetBBox(box_elem);
+          if (!elem->IsD() && box_elem.Collide(_bbox))
+            _objectPtrs.push_back(elem);
+        }
+      }
+    }
+    return static_cast<unsigned int>(_objectPtrs.size());
+  }
+
+private:
+
+  struct PrimRef {
+    float lo[3];
+    int id;
+    float hi[3];
+    int pad;
+  };
+
+  struct Bounds {
+    float lo[3], hi[3];
+
+    void Reset()
+    {
+      for (int a = 0; a < 3; ++a) { lo[a] = FLT_MAX; hi[a] = -FLT_MAX; }
+    }
+    void Add(const float l[3], const float h[3])
+    {
+      for (int a = 0; a < 3; ++a) { lo[a] = std::min(lo[a], l[a]); hi[a] = std::max(hi[a], h[a]); }
+    }
+    void Add(const Bounds & b) { Add(b.lo, b.hi); }
+    float HalfArea() const
+    {
+      if (lo[0] > hi[0]) return 0;
+      const float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+      return dx * dy + dy * dz + dz * dx;
+    }
+  };
+
+  // a node while building, its children are subtrees or leaves (kid 0)
+  struct BuildNode {
+    int n;
+    int begin[4], end[4];
+    Bounds box[4];
+    BuildNode * kid[4];
+
+    BuildNode() : n(0) { kid[0] = kid[1] = kid[2] = kid[3] = 0; }
+    ~BuildNode() { for (int k = 0; k < n; ++k) delete kid[k]; }
+    int Count() const
+    {
+      int c = 1;
+      for (int k = 0; k < n; ++k) if (kid[k]) c += kid[k]->Count();
+      return c;
+    }
+  };
+
+  struct Builder {
+    PrimRef * refs;
+
+    explicit Builder(PrimRef * _refs) : refs(_refs) {}
+
+    // objects [begin, end), their bounds and the bounds of their centroids
+    struct Range {
+      int begin, end, depth;
+      Bounds box, centers;
+      bool final;
+    };
+
+    struct Bins {
+      int count[3][BinCount];
+      Bounds box[3][BinCount];
+
+      void Reset()
+      {
+        for (int a = 0; a < 3; ++a)
+          for (int b = 0; b < BinCount; ++b) { count[a][b] = 0; box[a][b].Reset(); }
+      }
+    };
+
+    // twice the centroid, the halving does not change the order
+    static float Center(const PrimRef & r, int a) { return r.lo[a] + r.hi[a]; }
+    static void AddCenter(Bounds & cb, const PrimRef & r)
+    {
+      for (int a = 0; a < 3; ++a)
+      {
+        cb.lo[a] = std::min(cb.lo[a], Center(r, a));
+        cb.hi[a] = std::max(cb.hi[a], Center(r, a));
+      }
+    }
+
+    BuildNode * Build(const Range & whole)
+    {
+      BuildNode * node = new BuildNode();
+      Range r[4];
+      r[0] = whole;
+      r[0].final = false;
+      int n = 1;
+      while (n < 4)
+      {
+        int best = -1;
+        float area = -1;
+        for (int k = 0; k < n; ++k)
+          if (!r[k].final && r[k].end - r[k].begin > MinSplitSize && r[k].box.HalfArea() > area)
+          {
+            best = k;
+            area = r[k].box.HalfArea();
+          }
+        if (best < 0) break;
+        if (!Split(r[best], r[best], r[n])) { r[best].final = true; continue; }
+        ++n;
+      }
+
+      node->n = n;
+      for (int k = 0; k < n; ++k)
+      {
+        node->begin[k] = r[k].begin;
+        node->end[k] = r[k].end;
+        node->box[k] = r[k].box;
+        const int size = r[k].end - r[k].begin;
+        if (r[k].final || size <= MinSplitSize) continue;
+        if (size > TaskSize)
+        {
+          const Range rk = r[k];
+#pragma omp task firstprivate(node, k, rk)
+          node->kid[k] = Build(rk);
+        }
+        else
+          node->kid[k] = Build(r[k]);
+      }
+      return node;
+    }
+
+    static void Scale(const Bounds & cb, float scale[3])
+    {
+      for (int a = 0; a < 3; ++a)
+      {
+        const float extent = cb.hi[a] - cb.lo[a];
+        scale[a] = extent > 0 ? BinCount / extent * (1 - 1e-6f) : 0;
+      }
+    }
+
+    static int BinOf(const PrimRef & r, int a, const Bounds & cb, const float scale[3])
+    {
+      return std::min(BinCount - 1, int((Center(r, a) - cb.lo[a]) * scale[a]));
+    }
+
+    void Bin(int begin, int end, const Bounds & cb, const float scale[3], Bins & bins) const
+    {
+      bins.Reset();
+      for (int i = begin; i < end; ++i)
+      {
+        const PrimRef r = refs[i];
+        for (int a = 0; a < 3; ++a) if (scale[a] > 0)
+        {
+          const int b = BinOf(r, a, cb, scale);
+          bins.count[a][b]++;
+          bins.box[a][b].Add(r.lo, r.hi);
+        }
+      }
+    }
+
+    // the bins of a large range in chunks, one task each
+    void ParallelBin(int begin, int end, const Bounds & cb, const float scale[3], Bins & bins) const
+    {
+      const int n = end - begin;
+      if (n <= 2 * TaskSize)
+      {
+        Bin(begin, end, cb, scale, bins);
+        return;
+      }
+      const int chunks = std::min(64, n / TaskSize);
+      std::vector<Bins> parts(chunks);
+      for (int c = 0; c < chunks; ++c)
+      {
+#pragma omp task firstprivate(c) shared(parts)
+        Bin(begin + int((long long)n * c / chunks), begin + int((long long)n * (c + 1) / chunks), cb, scale, parts[c]);
+      }
+#pragma omp taskwait
+      bins = parts[0];
+      for (int c = 1; c < chunks; ++c)
+        for (int a = 0; a < 3; ++a)
+          for (int b = 0; b < BinCount; ++b)
+          {
+            bins.count[a][b] += parts[c].count[a][b];
+            bins.box[a][b].Add(parts[c].box[a][b]);
+          }
+    }
+
+    // s splits in left and right, s may be left. False when it is better as a leaf
+    bool Split(const Range & s, Range & left, Range & right)
+    {
+      const int n = s.end - s.begin;
+      float scale[3];
+      Scale(s.centers, scale);
+
+      int axis = -1, split = 0;
+      float bestCost = FLT_MAX;
+      Bins bins;
+      if (s.depth < MaxSahDepth)
+      {
+        ParallelBin(s.begin, s.end, s.centers, scale, bins);
+        for (int a = 0; a < 3; ++a) if (scale[a] > 0)
+        {
+          // areas times counts of the left sides, then the right sides swept back
+          float leftCost[BinCount];
+          Bounds acc;
+          acc.Reset();
+          int count = 0;
+          for (int b = 0; b < BinCount - 1; ++b)
+          {
+            acc.Add(bins.box[a][b]);
+            count += bins.count[a][b];
+            leftCost[b] = acc.HalfArea() * count;
+          }
+          acc.Reset();
+          count = 0;
+          for (int b = BinCount - 1; b > 0; --b)
+          {
+            acc.Add(bins.box[a][b]);
+            count += bins.count[a][b];
+            const float cost = leftCost[b - 1] + acc.HalfArea() * count;
+            if (count < n && count > 0 && cost < bestCost) { bestCost = cost; axis = a; split = b; }
+          }
+        }
+      }
+
+      const int begin = s.begin, end = s.end, depth = s.depth + 1;
+      Bounds lbox, rbox, lcenters, rcenters;
+      lbox.Reset(); rbox.Reset(); lcenters.Reset(); rcenters.Reset();
+      int mid;
+      if (axis >= 0)
+      {
+        // a traversal step costs as much as an object test
+        const float area = s.box.HalfArea();
+        if (n <= MaxLeafSize && area + bestCost >= area * n) return false;
+        for (int b = 0; b < BinCount; ++b)
+          (b < split ? lbox : rbox).Add(bins.box[axis][b]);
+        // partition, the centroid bounds of the two sides on the way
+        const Bounds cb = s.centers;
+        int i = begin, j = end;
+        for (;;)
+        {
+          while (i < j && BinOf(refs[i], axis, cb, scale) < split) AddCenter(lcenters, refs[i++]);
+          while (i < j && BinOf(refs[j - 1], axis, cb, scale) >= split) AddCenter(rcenters, refs[--j]);
+          if (i >= j) break;
+          std::swap(refs[i], refs[j - 1]);
+        }
+        mid = i;
+      }
+      else
+      {
+        // the centroids all coincide, or the tree is too deep: halves around the median
+        if (n <= MaxLeafSize && s.depth < MaxSahDepth) return false;
+        int a = 0;
+        for (int k = 1; k < 3; ++k)
+          if (s.centers.hi[k] - s.centers.lo[k] > s.centers.hi[a] - s.centers.lo[a]) a = k;
+        mid = begin + n / 2;
+        std::nth_element(refs + begin, refs + mid, refs + end, CenterLess(a));
+        for (int i = begin; i < mid; ++i) { lbox.Add(refs[i].lo, refs[i].hi); AddCenter(lcenters, refs[i]); }
+        for (int i = mid; i < end; ++i) { rbox.Add(refs[i].lo, refs[i].hi); AddCenter(rcenters, refs[i]); }
+      }
+
+      right.begin = mid; right.end = end; right.depth = depth; right.box = rbox; right.centers = rcenters; right.final = false;
+      left.begin = begin; left.end = mid; left.depth = depth; left.box = lbox; left.centers = lcenters; left.final = false;
+      return true;
+    }
+
+    struct CenterLess {
+      int axis;
+      explicit CenterLess(int _axis) : axis(_axis) {}
+      bool operator()(const PrimRef & a, const PrimRef & b) const
+      {
+        const float ca = Center(a, axis), cb = Center(b, axis);
+        return ca < cb || (ca == cb && a.id < b.id);
+      }
+    };
+  };
+
+  // depth first, a node before its subtrees
+  void Flatten(const BuildNode * b, int & next)
+  {
+    const int index = next++;
+    for (int k = 0; k < 4; ++k)
+    {
+      Node & node = nodes[index];
+      if (k >= b->n)
+      {
+        for (int a = 0; a < 3; ++a) { node.bounds[a][k] = FLT_MAX; node.bounds[a + 3][k] = -FLT_MAX; }
+        node.child[k] = 0;
+        node.count[k] = -1;
+        continue;
+      }
+      for (int a = 0; a < 3; ++a) { node.bounds[a][k] = b->box[k].lo[a]; node.bounds[a + 3][k] = b->box[k].hi[a]; }
+      if (b->kid[k])
+      {
+        node.count[k] = 0;
+        const int child = next;
+        Flatten(b->kid[k], next);
+        nodes[index].child[k] = child;
+      }
+      else
+      {
+        node.child[k] = b->begin[k];
+        node.count[k] = b->end[k] - b->begin[k];
+      }
+    }
+  }
+
+  // float bounds enclosing a value of the query scalar type
+  static float RoundDown(ScalarType v)
+  {
+    float f = float(v);
+    if (ScalarType(f) > v) f = std::nextafter(f, -FLT_MAX);
+    return f;
+  }
+  static float RoundUp(ScalarType v)
+  {
+    float f = float(v);
+    if (ScalarType(f) < v) f = std::nextafter(f, FLT_MAX);
+    return f;
+  }
+
+  // the float box distances carry a few roundings, the pruning allows for them.
+  // Finite, so that a missed box, at infinity, is never within reach
+  static float Reach2(ScalarType d)
+  {
+    const float r = RoundUp(d);
+    return std::min(r * r * (1 + 8 * FLT_EPSILON), FLT_MAX);
+  }
+  static float ReachT(ScalarType t) { return std::min(RoundUp(t) * (1 + 8 * FLT_EPSILON), FLT_MAX); }
+
+  struct StackEntry {
+    int child, count;
+    float d;
+    StackEntry() {}
+    StackEntry(int _child, int _count, float _d) : child(_child), count(_count), d(_d) {}
+  };
+
+  // the children within reach, the farthest pushed first so the nearest comes out first
+  static void Push(const Node & node, const float d[4], float reach, StackEntry * stack, int & sp)
+  {
+    int order[4];
+    int n = 0;
+    for (int k = 0; k < 4; ++k)
+      if (node.count[k] >= 0 && d[k] <= reach)
+      {
+        int j = n++;
+        for (; j > 0 && d[order[j - 1]] < d[k]; --j) order[j] = order[j - 1];
+        order[j] = k;
+      }
+    for (int j = 0; j < n; ++j)
+      stack[sp++] = StackEntry(node.child[order[j]], node.count[order[j]], d[order[j]]);
+  }
+
+  struct RayData {
+    float o[3], inv[3];
+    int neg[3];
+
+    explicit RayData(const Ray3<ScalarType> & ray)
+    {
+      for (int a = 0; a < 3; ++a)
+      {
+        const float dir = float(ray.Direction()[a]);
+        o[a] = float(ray.Origin()[a]);
+        // no infinities times zero: a flat direction goes far but finite
+        inv[a] = dir != 0 ? 1 / dir : FLT_MAX;
+        neg[a] = inv[a] < 0;
+      }
+    }
+  };
+
+  // where the ray enters the four boxes, infinity when it misses one or enters past tmax
+#ifdef __SSE2__
+  static void RayEnter(const Node & node, const RayData & r, float tmax, float tn[4])
+  {
+    __m128 tnear = _mm_setzero_ps();
+    __m128 tfar = _mm_set1_ps(tmax);
+    const __m128 grow = _mm_set1_ps(1 + 4 * FLT_EPSILON);
+    for (int a = 0; a < 3; ++a)
+    {
+      const __m128 o = _mm_set1_ps(r.o[a]);
+      const __m128 inv = _mm_set1_ps(r.inv[a]);
+      const __m128 lo = _mm_load_ps(node.bounds[a + 3 * r.neg[a]]);
+      const __m128 hi = _mm_load_ps(node.bounds[a + 3 - 3 * r.neg[a]]);
+      tnear = _mm_max_ps(tnear, _mm_mul_ps(_mm_sub_ps(lo, o), inv));
+      tfar = _mm_min_ps(tfar, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(hi, o), inv), grow));
+    }
+    const __m128 hit = _mm_cmple_ps(tnear, tfar);
+    _mm_storeu_ps(tn, _mm_or_ps(_mm_and_ps(hit, tnear), _mm_andnot_ps(hit, _mm_set1_ps(std::numeric_limits<float>::infinity()))));
+  }
+
+  static void PointDist2(const Node & node, const float q[3], float d[4])
+  {
+    __m128 sum = _mm_setzero_ps();
+    for (int a = 0; a < 3; ++a)
+    {
+      const __m128 p = _mm_set1_ps(q[a]);
+      const __m128 out = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.bounds[a]), p),
+                                               _mm_sub_ps(p, _mm_load_ps(node.bounds[a + 3]))), _mm_setzero_ps());
+      sum = _mm_add_ps(sum, _mm_mul_ps(out, out));
+    }
+    _mm_storeu_ps(d, sum);
+  }
+
+  static int BoxOverlap(const Node & node, const float lo[3], const float hi[3])
+  {
+    __m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int a = 0; a < 3; ++a)
+    {
+      in = _mm_and_ps(in, _mm_cmple_ps(_mm_load_ps(node.bounds[a]), _mm_set1_ps(hi[a])));
+      in = _mm_and_ps(in, _mm_cmpge_ps(_mm_load_ps(node.bounds[a + 3]), _mm_set1_ps(lo[a])));
+    }
+    return _mm_movemask_ps(in);
+  }
+#else
+  static void RayEnter(const Node & node, const RayData & r, float tmax, float tn[4])
+  {
+    for (int k = 0; k < 4; ++k)
+    {
+      float tnear = 0, tfar = tmax;
+      for (int a = 0; a < 3; ++a)
+      {
+        tnear = std::max(tnear, (node.bounds[a + 3 * r.neg[a]][k] - r.o[a]) * r.inv[a]);
+        tfar = std::min(tfar, (node.bounds[a + 3 - 3 * r.neg[a]][k] - r.o[a]) * r.inv[a] * (1 + 4 * FLT_EPSILON));
+      }
+      tn[k] = tnear <= tfar ? tnear : std::numeric_limits<float>::infinity();
+    }
+  }
+
+  static void PointDist2(const Node & node, const float q[3], float d[4])
+  {
+    for (int k = 0; k < 4; ++k)
+    {
+      d[k] = 0;
+      for (int a = 0; a < 3; ++a)
+      {
+        const float out = std::max(std::max(node.bounds[a][k] - q[a], q[a] - node.bounds[a + 3][k]), 0.0f);
+        d[k] += out * out;
+      }
+    }
+  }
+
+  static int BoxOverlap(const Node & node, const float lo[3], const float hi[3])
+  {
+    int mask = 0;
+    for (int k = 0; k < 4; ++k)
+    {
+      bool in = true;
+      for (int a = 0; a < 3; ++a)
+        in = in && node.bounds[a][k] <= hi[a] && node.bounds[a + 3][k] >= lo[a];
+      if (in) mask |= 1 << k;
+    }
+    return mask;
+  }
+#endif
+
+  std::vector<Node, BVHAlignedAllocator<Node, 64> > nodes;
+  std::vector<ObjPtr> objects;
+};
+
+} // end namespace vcg
+
+#endif // __VCGLIB_BVHINDEX_H
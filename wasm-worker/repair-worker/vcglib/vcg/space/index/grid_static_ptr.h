@@ -25,6 +25,10 @@
 #define __VCGLIB_UGRID
 
 #include <stdio.h>
+#include <iterator>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <vcg/space/box3.h>
 #include <vcg/space/line3.h>
@@ -311,22 +315,95 @@ namespace vcg {
 
 
 		// This is the REAL LOW LEVEL function
-			
+		/**
+		The links are laid out by cell with a two pass counting sort. The objects are split in
+		contiguous chunks, one per thread: each chunk counts its links per cell, the counts become
+		the offsets of every chunk in every cell, and each chunk writes its links there. A cell
+		lists its objects in the order of the range, whatever the number of threads.
+		A chunk keeps a count per cell: a grid with many more cells than objects is built by fewer
+		chunks, so that the counts stay within four ints per object.
+		*/
 		template <class OBJITER>
     inline void Set(const OBJITER & _oBegin, const OBJITER & _oEnd, const Box3x &_bbox, Point3i _siz)
+		{
+			SetDim(_bbox,_siz);
+			const int ncell = this->siz[0]*this->siz[1]*this->siz[2];
+
+			const long long n = (long long)std::distance(_oBegin,_oEnd);
+			int nchunk = 1;
+#ifdef _OPENMP
+			nchunk = std::max(1,std::min<int>(omp_get_max_threads(),int(n/16384)));
+			nchunk = int(std::max(1LL,std::min<long long>(nchunk,4*n/std::max(1,ncell))));
+#endif
+			std::vector<OBJITER> first(nchunk+1,_oBegin);
+			for(int t=1;t<=nchunk;++t)
+			{
+				first[t]=first[t-1];
+				std::advance(first[t],n*t/nchunk-n*(t-1)/nchunk);
+			}
+
+			// links of every chunk per cell
+			std::vector< std::vector<int> > count(nchunk);
+#pragma omp parallel for schedule(static,1)
+			for(int t=0;t<nchunk;++t)
+			{
+				count[t].assign(ncell,0);
+				for(OBJITER i=first[t]; i!=first[t+1]; ++i)
+				{
+					Box3i ib;
+					if(ObjIBox(*i,ib))
+						ForCells(ib,[&](int c){ ++count[t][c]; });
+				}
+			}
+
+			// the offset of every chunk in every cell
+			grid.resize(ncell+1);
+			std::vector<int> start(ncell+1,0);
+#pragma omp parallel for schedule(static)
+			for(int c=0;c<ncell;++c)
+				for(int t=0;t<nchunk;++t)
+					start[c+1]+=count[t][c];
+			for(int c=0;c<ncell;++c)
+				start[c+1]+=start[c];
+#pragma omp parallel for schedule(static)
+			for(int c=0;c<ncell;++c)
+			{
+				int pos=start[c];
+				for(int t=0;t<nchunk;++t)
+				{
+					const int k=count[t][c];
+					count[t][c]=pos;
+					pos+=k;
+				}
+			}
+
+			// one more link as the sentinel after the last cell
+			links.resize(start[ncell]+1);
+#pragma omp parallel for schedule(static,1)
+			for(int t=0;t<nchunk;++t)
+			{
+				for(OBJITER i=first[t]; i!=first[t+1]; ++i)
+				{
+					Box3i ib;
+					if(ObjIBox(*i,ib))
+						ForCells(ib,[&](int c){ links[count[t][c]++]=Link(&(*i),c); });
+				}
+			}
+			links.back()=Link(NULL,ncell);
+
+			for(int c=0;c<=ncell;++c)
+				grid[c]=&links[start[c]];
+		}
+
+		/// The single threaded build of Set() used before, the links sorted with std::sort.
+		/// Kept as a reference for the benchmarks, the order of the objects in a cell is unspecified
+		template <class OBJITER>
+		inline void SetSorted(const OBJITER & _oBegin, const OBJITER & _oEnd, const Box3x &_bbox, Point3i _siz)
 		{
 			OBJITER i;
-			
-			this->bbox=_bbox;
-			this->siz=_siz;
-			
-			// find voxel size starting from the provided bbox and grid size. 
-			
-			this->dim  = this->bbox.max - this->bbox.min;
-			this->voxel[0] = this->dim[0]/this->siz[0];
-			this->voxel[1] = this->dim[1]/this->siz[1];
-			this->voxel[2] = this->dim[2]/this->siz[2];			
-			
+
+			SetDim(_bbox,_siz);
+
         // Allocate the grid (add one more for the final sentinel)
 				grid.resize( this->siz[0]*this->siz[1]*this->siz[2]+1 );
 
@@ -334,33 +411,11 @@ namespace vcg {
 				links.clear();
 				for(i=_oBegin; i!=_oEnd; ++i)
 				{
-					Box3x bb;			// Boundig box del tetraedro corrente
-					(*i).GetBBox(bb);
-					bb.Intersect(this->bbox);
-					if(! bb.IsNull() )
-					{
-
-						Box3i ib;		// Boundig box in voxels
-						this->BoxToIBox( bb,ib );
-						int x,y,z;
-						for(z=ib.min[2];z<=ib.max[2];++z)
-						{
-							int bz = z*this->siz[1];
-							for(y=ib.min[1];y<=ib.max[1];++y)
-							{
-								int by = (y+bz)*this->siz[0];
-								for(x=ib.min[0];x<=ib.max[0];++x)
-									// Inserire calcolo cella corrente
-									// if( pt->Intersect( ... )
-									links.push_back( Link(&(*i),by+x) );
-							}
-						}
-					}
+					Box3i ib;		// Boundig box in voxels
+					if(ObjIBox(*i,ib))
+						ForCells(ib,[&](int c){ links.push_back( Link(&(*i),c) ); });
 				}
 				// Push della sentinella
-				/*links.push_back( Link((typename ContainerType::iterator)NULL,
-				(grid.size()-1)));*/
-
 				links.push_back( Link( NULL,	int(grid.size())-1) );
 
 				// Ordinamento dei links
@@ -381,9 +436,49 @@ namespace vcg {
 							break;
 					}
 				}
+		}
+
+	private:
+
+		// find voxel size starting from the provided bbox and grid size.
+		void SetDim(const Box3x &_bbox, const Point3i &_siz)
+		{
+			this->bbox=_bbox;
+			this->siz=_siz;
+			this->dim  = this->bbox.max - this->bbox.min;
+			this->voxel[0] = this->dim[0]/this->siz[0];
+			this->voxel[1] = this->dim[1]/this->siz[1];
+			this->voxel[2] = this->dim[2]/this->siz[2];
+		}
 
-		}		
+		// the cells the box of the object spans, false when it is out of the grid
+		template <class OBJ>
+		bool ObjIBox(OBJ &o, Box3i &ib) const
+		{
+			Box3x bb;
+			o.GetBBox(bb);
+			bb.Intersect(this->bbox);
+			if(bb.IsNull()) return false;
+			this->BoxToIBox(bb,ib);
+			return true;
+		}
 
+		template <class CELLFUNCTOR>
+		void ForCells(const Box3i &ib, CELLFUNCTOR f) const
+		{
+			for(int z=ib.min[2];z<=ib.max[2];++z)
+			{
+				int bz = z*this->siz[1];
+				for(int y=ib.min[1];y<=ib.max[1];++y)
+				{
+					int by = (y+bz)*this->siz[0];
+					for(int x=ib.min[0];x<=ib.max[0];++x)
+						f(by+x);
+				}
+			}
+		}
+
+	public:
 
 		int MemUsed()
 		{
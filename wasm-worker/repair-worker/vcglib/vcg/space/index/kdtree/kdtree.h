@@ -31,7 +31,11 @@
 #include <vector>
 #include <limits>
 #include <iostream>
+#include <algorithm>
 #include <cstdint>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace vcg {
 
@@ -78,6 +82,7 @@ namespace vcg {
   /**
   * This class allows to create a Kd-Tree thought to perform the neighbour query (radius search, knn-nearest serach and closest search).
   * The class implemetantion is thread-safe.
+  * With OpenMP the subtrees are built on all the threads, and the batched queries answer many points at once on all the threads.
   */
   template<typename _Scalar>
   class KdTree
@@ -127,6 +132,18 @@ namespace vcg {
 
     void doQueryClosest(const VectorType& queryPoint, unsigned int& index, Scalar& dist);
 
+    /** Batched queries: every point of queries, on all the threads.
+    * The neighbours of queries[i] are indices[offsets[i]] .. indices[offsets[i + 1] - 1] with their squared
+    * distances in squareDists, nearest first for doQueryKBatch, in the order of doQueryDist for doQueryDistBatch.
+    * The queries are answered in the Morton order of their positions, so that the consecutive ones walk the same
+    * nodes; the output does not depend on that nor on the number of threads.
+    */
+    void doQueryKBatch(const ConstDataWrapper<VectorType>& queries, int k,
+                       std::vector<size_t>& offsets, std::vector<unsigned int>& indices, std::vector<Scalar>& squareDists);
+
+    void doQueryDistBatch(const ConstDataWrapper<VectorType>& queries, float dist,
+                          std::vector<size_t>& offsets, std::vector<unsigned int>& indices, std::vector<Scalar>& squareDists);
+
   protected:
 
     // element of the stack
@@ -138,11 +155,30 @@ namespace vcg {
       Scalar sq;            // squared distance to the next node
     };
 
+    // a subtree left to build on its own, see createTreeParallel()
+    struct Subtree
+    {
+      unsigned int nodeId, start, end, level;
+    };
+
+    // the queries on a stack of the caller, so that a batch does not allocate one per point
+    void queryK(const VectorType& queryPoint, int k, PriorityQueue& mNeighborQueue, std::vector<QueryNode>& mNodeStack);
+
+    void queryDist(const VectorType& queryPoint, float dist, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists,
+                   std::vector<QueryNode>& mNodeStack);
+
+    // the indices of the queries sorted by the Morton code of their cell in a 1024^3 grid over the tree box
+    void mortonOrder(const ConstDataWrapper<VectorType>& queries, std::vector<unsigned int>& order) const;
+
     // used to build the tree: split the subset [start..end[ according to dim and splitValue,
     // and returns the index of the first element of the second subset
     unsigned int split(int start, int end, unsigned int dim, float splitValue);
 
-    int createTree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level);
+    // with deferred, the subtrees of at most deferSize points are not built but listed there
+    int createTree(NodeList& nodes, unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level,
+                   std::vector<Subtree>* deferred = 0, unsigned int deferSize = 0);
+
+    int createTreeParallel(unsigned int threads);
 
   protected:
 
@@ -178,7 +214,13 @@ namespace vcg {
     //first node inserted (no leaf). The others are made by the createTree function (recursively)
     mNodes.resize(1);
     mNodes.back().leaf = 0;
-    numLevel = createTree(0, 0, mPoints.size(), 1);
+#ifdef _OPENMP
+    const unsigned int threads = omp_get_max_threads();
+    if (threads > 1 && mPoints.size() > 64 * threads * targetCellSize)
+      numLevel = createTreeParallel(threads);
+    else
+#endif
+      numLevel = createTree(mNodes, 0, 0, mPoints.size(), 1);
   }
 
   template<typename Scalar>
@@ -205,11 +247,17 @@ namespace vcg {
   */
   template<typename Scalar>
   void KdTree<Scalar>::doQueryK(const VectorType& queryPoint, int k, PriorityQueue& mNeighborQueue)
+  {
+    std::vector<QueryNode> mNodeStack(numLevel + 1);
+    queryK(queryPoint, k, mNeighborQueue, mNodeStack);
+  }
+
+  template<typename Scalar>
+  void KdTree<Scalar>::queryK(const VectorType& queryPoint, int k, PriorityQueue& mNeighborQueue, std::vector<QueryNode>& mNodeStack)
   {
     mNeighborQueue.setMaxSize(k);
     mNeighborQueue.init();
 
-    std::vector<QueryNode> mNodeStack(numLevel + 1);
     mNodeStack[0].nodeId = 0;
     mNodeStack[0].sq = 0.f;
     unsigned int count = 1;
@@ -282,6 +330,13 @@ namespace vcg {
   void KdTree<Scalar>::doQueryDist(const VectorType& queryPoint, float dist, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists)
   {
     std::vector<QueryNode> mNodeStack(numLevel + 1);
+    queryDist(queryPoint, dist, points, sqrareDists, mNodeStack);
+  }
+
+  template<typename Scalar>
+  void KdTree<Scalar>::queryDist(const VectorType& queryPoint, float dist, std::vector<unsigned int>& points, std::vector<Scalar>& sqrareDists,
+                                 std::vector<QueryNode>& mNodeStack)
+  {
     mNodeStack[0].nodeId = 0;
     mNodeStack[0].sq = 0.f;
     unsigned int count = 1;
@@ -405,6 +460,157 @@ namespace vcg {
 
 
 
+  template<typename Scalar>
+  void KdTree<Scalar>::mortonOrder(const ConstDataWrapper<VectorType>& queries, std::vector<unsigned int>& order) const
+  {
+    const int n = int(queries.size());
+    VectorType scale;
+    for (int a = 0; a < 3; ++a)
+    {
+      const Scalar extent = mAABB.max[a] - mAABB.min[a];
+      scale[a] = extent > 0 ? Scalar(1023) / extent : Scalar(0);
+    }
+
+    std::vector<uint32_t> keys(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i)
+    {
+      uint32_t code = 0;
+      for (int a = 0; a < 3; ++a)
+      {
+        // clamped, the queries may be out of the box
+        const Scalar c = (queries[i][a] - mAABB.min[a]) * scale[a];
+        uint32_t v = c > 0 ? uint32_t(std::min(c, Scalar(1023))) : 0;
+        // the 10 bits of v three bits apart
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        code |= v << a;
+      }
+      keys[i] = code;
+    }
+
+    // radix sort of the 30 bit codes, 15 bits a pass, stable so equal codes keep the query order
+    std::vector<unsigned int> tmp(n);
+    order.resize(n);
+    for (int i = 0; i < n; ++i)
+      tmp[i] = i;
+    std::vector<unsigned int> count(1 << 15);
+    for (int shift = 0; shift < 30; shift += 15)
+    {
+      std::fill(count.begin(), count.end(), 0);
+      for (int i = 0; i < n; ++i)
+        ++count[(keys[tmp[i]] >> shift) & 0x7fff];
+      unsigned int sum = 0;
+      for (size_t b = 0; b < count.size(); ++b)
+      {
+        const unsigned int c = count[b];
+        count[b] = sum;
+        sum += c;
+      }
+      for (int i = 0; i < n; ++i)
+        order[count[(keys[tmp[i]] >> shift) & 0x7fff]++] = tmp[i];
+      tmp.swap(order);
+    }
+    order.swap(tmp);
+  }
+
+  /** Performs the kNN query of every point of queries.
+  *
+  * Each thread keeps its own queue and stack. Every query gets min(k, number of points) neighbours,
+  * so the rows all have the same length.
+  */
+  template<typename Scalar>
+  void KdTree<Scalar>::doQueryKBatch(const ConstDataWrapper<VectorType>& queries, int k,
+                                     std::vector<size_t>& offsets, std::vector<unsigned int>& indices, std::vector<Scalar>& squareDists)
+  {
+    const int n = int(queries.size());
+    const size_t row = std::min<size_t>(k, mPoints.size());
+    offsets.resize(n + 1);
+    for (int i = 0; i <= n; ++i)
+      offsets[i] = i * row;
+    indices.resize(n * row);
+    squareDists.resize(n * row);
+
+    std::vector<unsigned int> order;
+    mortonOrder(queries, order);
+
+#pragma omp parallel
+    {
+      PriorityQueue queue;
+      std::vector<QueryNode> stack(numLevel + 1);
+#pragma omp for schedule(dynamic, 256)
+      for (int j = 0; j < n; ++j)
+      {
+        const unsigned int i = order[j];
+        queryK(queries[i], k, queue, stack);
+        queue.sort();
+        for (int e = 0; e < queue.getNofElements(); ++e)
+        {
+          indices[offsets[i] + e] = queue.getIndex(e);
+          squareDists[offsets[i] + e] = queue.getWeight(e);
+        }
+      }
+    }
+  }
+
+  /** Performs the distance query of every point of queries.
+  *
+  * The queries are taken in chunks of consecutive ones in Morton order, each chunk collects its
+  * neighbours, then the rows are laid out in the order of the queries and the chunks copied there.
+  */
+  template<typename Scalar>
+  void KdTree<Scalar>::doQueryDistBatch(const ConstDataWrapper<VectorType>& queries, float dist,
+                                        std::vector<size_t>& offsets, std::vector<unsigned int>& indices, std::vector<Scalar>& squareDists)
+  {
+    const int n = int(queries.size());
+    const int chunk = 256;
+    const int nChunks = (n + chunk - 1) / chunk;
+
+    std::vector<unsigned int> order;
+    mortonOrder(queries, order);
+
+    std::vector<size_t> counts(n);
+    std::vector<std::vector<unsigned int> > chunkIndices(nChunks);
+    std::vector<std::vector<Scalar> > chunkDists(nChunks);
+#pragma omp parallel
+    {
+      std::vector<QueryNode> stack(numLevel + 1);
+#pragma omp for schedule(dynamic, 1)
+      for (int c = 0; c < nChunks; ++c)
+        for (int j = c * chunk; j < std::min(n, (c + 1) * chunk); ++j)
+        {
+          const size_t before = chunkIndices[c].size();
+          queryDist(queries[order[j]], dist, chunkIndices[c], chunkDists[c], stack);
+          counts[order[j]] = chunkIndices[c].size() - before;
+        }
+    }
+
+    offsets.resize(n + 1);
+    offsets[0] = 0;
+    for (int i = 0; i < n; ++i)
+      offsets[i + 1] = offsets[i] + counts[i];
+    indices.resize(offsets[n]);
+    squareDists.resize(offsets[n]);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < nChunks; ++c)
+    {
+      size_t from = 0;
+      for (int j = c * chunk; j < std::min(n, (c + 1) * chunk); ++j)
+      {
+        const unsigned int i = order[j];
+        std::copy(chunkIndices[c].begin() + from, chunkIndices[c].begin() + from + counts[i], indices.begin() + offsets[i]);
+        std::copy(chunkDists[c].begin() + from, chunkDists[c].begin() + from + counts[i], squareDists.begin() + offsets[i]);
+        from += counts[i];
+      }
+      std::vector<unsigned int>().swap(chunkIndices[c]);
+      std::vector<Scalar>().swap(chunkDists[c]);
+    }
+  }
+
+
   /**
   * Split the subarray between start and end in two part, one with the elements less than splitValue,
   * the other with the elements greater or equal than splitValue. The elements are compared
@@ -447,10 +653,11 @@ namespace vcg {
   *  is more expensive than the gain it provides and the memory consumption is x4 higher !
   */
   template<typename Scalar>
-  int KdTree<Scalar>::createTree(unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level)
+  int KdTree<Scalar>::createTree(NodeList& nodes, unsigned int nodeId, unsigned int start, unsigned int end, unsigned int level,
+                                 std::vector<Subtree>* deferred, unsigned int deferSize)
   {
     //select the first node
-    Node& node = mNodes[nodeId];
+    Node& node = nodes[nodeId];
     AxisAlignedBoxType aabb;
 
     //putting all the points in the bounding box
@@ -483,14 +690,14 @@ namespace vcg {
     //midId is the index of the first element in the second partition
     unsigned int midId = split(start, end, dim, node.splitValue);
 
-    node.firstChildId = mNodes.size();
-    mNodes.resize(mNodes.size() + 2);
+    node.firstChildId = nodes.size();
+    nodes.resize(nodes.size() + 2);
     bool flag = (midId == start) || (midId == end);
     int leftLevel, rightLevel;
     {
       // left child
-      unsigned int childId = mNodes[nodeId].firstChildId;
-      Node& child = mNodes[childId];
+      unsigned int childId = nodes[nodeId].firstChildId;
+      Node& child = nodes[childId];
       if (flag || (midId - start) <= targetCellSize || level >= targetMaxDepth)
       {
         child.leaf = 1;
@@ -498,17 +705,24 @@ namespace vcg {
         child.size = midId - start;
         leftLevel = level;
       }
+      else if (deferred && midId - start <= deferSize)
+      {
+        child.leaf = 0;
+        Subtree subtree = { childId, start, midId, level + 1 };
+        deferred->push_back(subtree);
+        leftLevel = level + 1;
+      }
       else
       {
         child.leaf = 0;
-        leftLevel = createTree(childId, start, midId, level + 1);
+        leftLevel = createTree(nodes, childId, start, midId, level + 1, deferred, deferSize);
       }
     }
 
     {
       // right child
-      unsigned int childId = mNodes[nodeId].firstChildId + 1;
-      Node& child = mNodes[childId];
+      unsigned int childId = nodes[nodeId].firstChildId + 1;
+      Node& child = nodes[childId];
       if (flag || (end - midId) <= targetCellSize || level >= targetMaxDepth)
       {
         child.leaf = 1;
@@ -516,10 +730,17 @@ namespace vcg {
         child.size = end - midId;
         rightLevel = level;
       }
+      else if (deferred && end - midId <= deferSize)
+      {
+        child.leaf = 0;
+        Subtree subtree = { childId, midId, end, level + 1 };
+        deferred->push_back(subtree);
+        rightLevel = level + 1;
+      }
       else
       {
         child.leaf = 0;
-        rightLevel = createTree(childId, midId, end, level + 1);
+        rightLevel = createTree(nodes, childId, midId, end, level + 1, deferred, deferSize);
       }
     }
     if (leftLevel > rightLevel)
@@ -527,6 +748,46 @@ namespace vcg {
     return rightLevel;
   }
 
+
+  /** builds the tree on all the threads
+  *
+  *  The top of the tree is built serially down to subtrees of about an eighth of the points per thread,
+  *  these are then built each in its own node list on any thread and appended in order. The tree is the
+  *  one createTree() builds, the same splits on the same points, only its nodes are laid out differently.
+  */
+  template<typename Scalar>
+  int KdTree<Scalar>::createTreeParallel(unsigned int threads)
+  {
+    std::vector<Subtree> deferred;
+    const unsigned int deferSize = std::max<unsigned int>(mPoints.size() / (8 * threads), targetCellSize);
+    int level = createTree(mNodes, 0, 0, mPoints.size(), 1, &deferred, deferSize);
+
+    std::vector<NodeList> subtrees(deferred.size());
+    std::vector<int> levels(deferred.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < int(deferred.size()); ++s)
+    {
+      subtrees[s].resize(1);
+      subtrees[s][0].leaf = 0;
+      levels[s] = createTree(subtrees[s], 0, deferred[s].start, deferred[s].end, deferred[s].level);
+    }
+
+    for (size_t s = 0; s < deferred.size(); ++s)
+    {
+      // the root takes the place left for it, node j > 0 goes to base + j
+      NodeList& sub = subtrees[s];
+      const unsigned int base = mNodes.size() - 1;
+      for (size_t j = 0; j < sub.size(); ++j)
+        if (!sub[j].leaf)
+          sub[j].firstChildId += base;
+      mNodes[deferred[s].nodeId] = sub[0];
+      mNodes.insert(mNodes.end(), sub.begin() + 1, sub.end());
+      NodeList().swap(sub);
+      level = std::max(level, levels[s]);
+    }
+    return level;
+  }
+
 }
 
 #endif
@@ -0,0 +1,452 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCGLIB_INTERSECTIONTRITRI3_ROBUST
+#define __VCGLIB_INTERSECTIONTRITRI3_ROBUST
+
+#include <vcg/space/point3.h>
+#include <algorithm>
+#include <initializer_list>
+#include <cmath>
+
+namespace vcg {
+
+/** \addtogroup space */
+/*@{*/
+/**
+    Exact orientation predicates and the triangle/triangle intersection test built on them.
+
+    Every predicate first evaluates its determinant in double and compares it with a bound on the
+    rounding error of that evaluation (the semi-static filters of J. R. Shewchuk, "Adaptive
+    Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates", 1997). Only when the
+    value is within the bound, that is for nearly degenerate configurations, the sign is recomputed
+    exactly with floating point expansions. The answers are therefore exact for any double input,
+    the same on every compiler and platform, and independent of FMA contraction.
+
+    The triangle test is the one of O. Devillers and P. Guigue, "Faster Triangle-Triangle
+    Intersection Tests", INRIA RR-4488, 2002, which only needs the sign of orientations.
+*/
+namespace predicates {
+
+// expansions are arrays of doubles of increasing magnitude without zeros, summing to the value
+
+inline void TwoSum(double a, double b, double &x, double &y)
+{
+  x = a + b;
+  const double bv = x - a;
+  const double av = x - bv;
+  y = (a - av) + (b - bv);
+}
+
+inline void TwoDiff(double a, double b, double &x, double &y)
+{
+  x = a - b;
+  const double bv = a - x;
+  const double av = x + bv;
+  y = (a - av) + (bv - b);
+}
+
+// Dekker's product, every partial product is exact so it does not depend on fma either
+inline void Split(double a, double &hi, double &lo)
+{
+  const double c = 134217729.0 * a; // 2^27 + 1
+  const double big = c - a;
+  hi = c - big;
+  lo = a - hi;
+}
+
+inline void TwoProduct(double a, double b, double &x, double &y)
+{
+  x = a * b;
+  double ahi, alo, bhi, blo;
+  Split(a, ahi, alo);
+  Split(b, bhi, blo);
+  const double err1 = x - ahi * bhi;
+  const double err2 = err1 - alo * bhi;
+  const double err3 = err2 - ahi * blo;
+  y = alo * blo - err3;
+}
+
+// h = e + b, h may be e
+inline int GrowExpansion(int elen, const double *e, double b, double *h)
+{
+  int hlen = 0;
+  double q = b;
+  for (int i = 0; i < elen; ++i) {
+    double sum, err;
+    TwoSum(q, e[i], sum, err);
+    q = sum;
+    if (err != 0) h[hlen++] = err;
+  }
+  if (q != 0 || hlen == 0) h[hlen++] = q;
+  return hlen;
+}
+
+// h = e + f, h may be e and needs room for elen + flen terms
+inline int SumExpansion(int elen, const double *e, int flen, const double *f, double *h)
+{
+  int hlen = elen;
+  if (h != e)
+    for (int i = 0; i < elen; ++i) h[i] = e[i];
+  for (int j = 0; j < flen; ++j)
+    hlen = GrowExpansion(hlen, h, f[j], h);
+  return hlen;
+}
+
+// h = e * b, h needs room for 2 * elen terms
+inline int ScaleExpansion(int elen, const double *e, double b, double *h)
+{
+  int hlen = 0;
+  double q, err;
+  TwoProduct(e[0], b, q, err);
+  if (err != 0) h[hlen++] = err;
+  for (int i = 1; i < elen; ++i) {
+    double p1, p0, sum;
+    TwoProduct(e[i], b, p1, p0);
+    TwoSum(q, p0, sum, err);
+    if (err != 0) h[hlen++] = err;
+    TwoSum(p1, sum, q, err);
+    if (err != 0) h[hlen++] = err;
+  }
+  if (q != 0 || hlen == 0) h[hlen++] = q;
+  return hlen;
+}
+
+// h = e * f, at most 16 terms in f, h needs room for 2 * elen * flen terms
+inline int MulExpansion(int elen, const double *e, int flen, const double *f, double *h)
+{
+  int hlen = 0;
+  double t[32];
+  for (int j = 0; j < flen; ++j) {
+    const int tlen = ScaleExpansion(elen, e, f[j], t);
+    hlen = SumExpansion(hlen, h, tlen, t, h);
+  }
+  return hlen;
+}
+
+inline int Negate(int elen, double *e)
+{
+  for (int i = 0; i < elen; ++i) e[i] = -e[i];
+  return elen;
+}
+
+inline int SignOf(double v) { return (v > 0) - (v < 0); }
+
+// the sign of det[b - a, c - a, d - a] in exact arithmetic
+inline int Orient3DExact(const double *a, const double *b, const double *c, const double *d)
+{
+  double u[3][2], v[3][2], w[3][2];
+  for (int k = 0; k < 3; ++k) {
+    TwoDiff(b[k], a[k], u[k][1], u[k][0]);
+    TwoDiff(c[k], a[k], v[k][1], v[k][0]);
+    TwoDiff(d[k], a[k], w[k][1], w[k][0]);
+  }
+  double det[192];
+  int dlen = 0;
+  for (int k = 0; k < 3; ++k) {
+    const int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+    double l[8], r[8], cross[16], term[64];
+    const int llen = MulExpansion(2, u[k1], 2, v[k2], l);
+    const int rlen = Negate(MulExpansion(2, u[k2], 2, v[k1], r), r);
+    const int clen = SumExpansion(llen, l, rlen, r, cross);
+    const int tlen = MulExpansion(2, w[k], clen, cross, term);
+    dlen = SumExpansion(dlen, det, tlen, term, det);
+  }
+  return SignOf(det[dlen - 1]);
+}
+
+// the sign of det[b - a, c - a] of the coordinates i and j in exact arithmetic
+inline int Orient2DExact(const double *a, const double *b, const double *c, int i, int j)
+{
+  double ui[2], uj[2], vi[2], vj[2];
+  TwoDiff(b[i], a[i], ui[1], ui[0]);
+  TwoDiff(b[j], a[j], uj[1], uj[0]);
+  TwoDiff(c[i], a[i], vi[1], vi[0]);
+  TwoDiff(c[j], a[j], vj[1], vj[0]);
+  double l[16], r[8];
+  const int llen = MulExpansion(2, ui, 2, vj, l);
+  const int rlen = Negate(MulExpansion(2, uj, 2, vi, r), r);
+  const int dlen = SumExpansion(llen, l, rlen, r, l);
+  return SignOf(l[dlen - 1]);
+}
+
+// bounds on the rounding error of the double evaluation relative to its permanent, epsilon is 2^-53
+inline double Orient3DBound() { const double e = 1.1102230246251565e-16; return (7.0 + 56.0 * e) * e; }
+inline double Orient2DBound() { const double e = 1.1102230246251565e-16; return (3.0 + 16.0 * e) * e; }
+
+/// The sign of det[b - a, c - a, d - a]: positive when d is on the side of the plane abc that
+/// the normal (b - a) ^ (c - a) points to.
+inline int Orient3D(const double *a, const double *b, const double *c, const double *d)
+{
+  const double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+  const double vx = c[0] - a[0], vy = c[1] - a[1], vz = c[2] - a[2];
+  const double wx = d[0] - a[0], wy = d[1] - a[1], wz = d[2] - a[2];
+  const double uyvz = uy * vz, uzvy = uz * vy;
+  const double uzvx = uz * vx, uxvz = ux * vz;
+  const double uxvy = ux * vy, uyvx = uy * vx;
+  const double det = wx * (uyvz - uzvy) + wy * (uzvx - uxvz) + wz * (uxvy - uyvx);
+  const double permanent = std::fabs(wx) * (std::fabs(uyvz) + std::fabs(uzvy))
+                         + std::fabs(wy) * (std::fabs(uzvx) + std::fabs(uxvz))
+                         + std::fabs(wz) * (std::fabs(uxvy) + std::fabs(uyvx));
+  const double bound = Orient3DBound() * permanent;
+  if (det > bound || -det > bound)
+    return SignOf(det);
+  return Orient3DExact(a, b, c, d);
+}
+
+/// The sign of det[b - a, c - a] on the coordinates i and j, positive when abc turns counterclockwise.
+inline int Orient2D(const double *a, const double *b, const double *c, int i, int j)
+{
+  const double left = (b[i] - a[i]) * (c[j] - a[j]);
+  const double right = (b[j] - a[j]) * (c[i] - a[i]);
+  const double det = left - right;
+  const double bound = Orient2DBound() * (std::fabs(left) + std::fabs(right));
+  if (det > bound || -det > bound)
+    return SignOf(det);
+  return Orient2DExact(a, b, c, i, j);
+}
+
+/// Orient3D(a, b, c, d) of a fixed plane abc against many points d: the normal and its error
+/// terms are computed once, so the side of a point costs three products.
+class OrientPlane
+{
+public:
+  OrientPlane(const double *a, const double *b, const double *c) : a(a), b(b), c(c)
+  {
+    const double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+    const double vx = c[0] - a[0], vy = c[1] - a[1], vz = c[2] - a[2];
+    const double uyvz = uy * vz, uzvy = uz * vy;
+    const double uzvx = uz * vx, uxvz = ux * vz;
+    const double uxvy = ux * vy, uyvx = uy * vx;
+    n[0] = uyvz - uzvy; n[1] = uzvx - uxvz; n[2] = uxvy - uyvx;
+    m[0] = std::fabs(uyvz) + std::fabs(uzvy);
+    m[1] = std::fabs(uzvx) + std::fabs(uxvz);
+    m[2] = std::fabs(uxvy) + std::fabs(uyvx);
+  }
+
+  int Side(const double *d) const
+  {
+    const double wx = d[0] - a[0], wy = d[1] - a[1], wz = d[2] - a[2];
+    const double det = wx * n[0] + wy * n[1] + wz * n[2];
+    const double bound = Orient3DBound() * (std::fabs(wx) * m[0] + std::fabs(wy) * m[1] + std::fabs(wz) * m[2]);
+    if (det > bound || -det > bound)
+      return SignOf(det);
+    return Orient3DExact(a, b, c, d);
+  }
+
+  /// the axis along which the normal is the largest, a guess for Orient2D projections
+  int DominantAxis() const
+  {
+    const double x = std::fabs(n[0]), y = std::fabs(n[1]), z = std::fabs(n[2]);
+    return x >= y ? (x >= z ? 0 : 2) : (y >= z ? 1 : 2);
+  }
+
+private:
+  const double *a, *b, *c;
+  double n[3];
+  double m[3];
+};
+
+/// closed segments ab and cd on the coordinates i and j, the four points on a line or not
+inline bool SegmentSegment2D(const double *a, const double *b, const double *c, const double *d, int i, int j)
+{
+  const int o1 = Orient2D(a, b, c, i, j), o2 = Orient2D(a, b, d, i, j);
+  if (o1 * o2 > 0) return false;
+  const int o3 = Orient2D(c, d, a, i, j), o4 = Orient2D(c, d, b, i, j);
+  if (o3 * o4 > 0) return false;
+  if (o1 != 0 || o2 != 0 || o3 != 0 || o4 != 0) return true;
+  // on a line, the comparisons are exact
+  for (int k : {i, j}) {
+    if (std::max(a[k], b[k]) < std::min(c[k], d[k]) || std::max(c[k], d[k]) < std::min(a[k], b[k]))
+      return false;
+  }
+  return true;
+}
+
+/// p in the closed triangle abc on the coordinates i and j, false when abc is flat there
+inline bool PointTriangle2D(const double *p, const double *a, const double *b, const double *c, int i, int j)
+{
+  const int o = Orient2D(a, b, c, i, j);
+  if (o == 0) return false;
+  return Orient2D(a, b, p, i, j) * o >= 0 && Orient2D(b, c, p, i, j) * o >= 0 && Orient2D(c, a, p, i, j) * o >= 0;
+}
+
+/// two closed coplanar triangles, the plane is not parallel to the axis k
+inline bool CoplanarTriangleTriangle(const double *const t1[3], const double *const t2[3], int k)
+{
+  const int i = (k + 1) % 3, j = (k + 2) % 3;
+  for (int e1 = 0; e1 < 3; ++e1)
+    for (int e2 = 0; e2 < 3; ++e2)
+      if (SegmentSegment2D(t1[e1], t1[(e1 + 1) % 3], t2[e2], t2[(e2 + 1) % 3], i, j))
+        return true;
+  return PointTriangle2D(t1[0], t2[0], t2[1], t2[2], i, j) || PointTriangle2D(t2[0], t1[0], t1[1], t1[2], i, j);
+}
+
+/// the axis to drop to project the plane of abc without making it flat, -1 when abc is degenerate
+inline int ProjectionAxis(const OrientPlane &plane, const double *a, const double *b, const double *c)
+{
+  const int k0 = plane.DominantAxis();
+  for (int d = 0; d < 3; ++d) {
+    const int k = (k0 + d) % 3;
+    if (Orient2D(a, b, c, (k + 1) % 3, (k + 2) % 3) != 0)
+      return k;
+  }
+  return -1;
+}
+
+// Devillers and Guigue, once p1 is alone on its side of the plane of the second triangle and p2
+// alone on its side of the plane of the first one, both facing the same way. The two triangles
+// cut the line where the planes meet along two intervals, the orientations compare their ends
+// and are zero when two ends are the same point: the intervals overlap by more than a point
+inline bool CheckMinMax(const double *p1, const double *q1, const double *r1,
+                        const double *p2, const double *q2, const double *r2)
+{
+  if (Orient3D(q1, p2, p1, q2) >= 0) return false;
+  if (Orient3D(p1, p2, r1, r2) >= 0) return false;
+  return true;
+}
+
+inline bool TriTri3D(const double *p1, const double *q1, const double *r1,
+                     const double *p2, const double *q2, const double *r2,
+                     int dp2, int dq2, int dr2, bool &coplanar)
+{
+  if (dp2 > 0) {
+    if (dq2 > 0) return CheckMinMax(p1, r1, q1, r2, p2, q2);
+    if (dr2 > 0) return CheckMinMax(p1, r1, q1, q2, r2, p2);
+    return CheckMinMax(p1, q1, r1, p2, q2, r2);
+  }
+  if (dp2 < 0) {
+    if (dq2 < 0) return CheckMinMax(p1, q1, r1, r2, p2, q2);
+    if (dr2 < 0) return CheckMinMax(p1, q1, r1, q2, r2, p2);
+    return CheckMinMax(p1, r1, q1, p2, q2, r2);
+  }
+  if (dq2 < 0) {
+    if (dr2 >= 0) return CheckMinMax(p1, r1, q1, q2, r2, p2);
+    return CheckMinMax(p1, q1, r1, p2, q2, r2);
+  }
+  if (dq2 > 0) {
+    if (dr2 > 0) return CheckMinMax(p1, r1, q1, p2, q2, r2);
+    return CheckMinMax(p1, q1, r1, q2, r2, p2);
+  }
+  if (dr2 > 0) return CheckMinMax(p1, q1, r1, r2, p2, q2);
+  if (dr2 < 0) return CheckMinMax(p1, r1, q1, r2, p2, q2);
+  coplanar = true;
+  return false;
+}
+
+// the triangle touches the plane with a single vertex, the other two on the same side
+inline bool TouchesWithVertex(int dp, int dq, int dr)
+{
+  return (dp == 0 && dq * dr > 0) || (dq == 0 && dp * dr > 0) || (dr == 0 && dp * dq > 0);
+}
+
+/// Two non degenerate triangles cross: in different planes they meet along a segment, a single
+/// point of contact does not count; in the same plane the closed triangles share a point.
+/// Most pairs that do not are separated by the plane of one of them and cost two planes and
+/// six filtered sides.
+inline bool TriangleTriangle(const double *p1, const double *q1, const double *r1,
+                             const double *p2, const double *q2, const double *r2)
+{
+  const OrientPlane plane2(p2, q2, r2);
+  const int dp1 = plane2.Side(p1), dq1 = plane2.Side(q1), dr1 = plane2.Side(r1);
+  if (dp1 * dq1 > 0 && dp1 * dr1 > 0) return false;
+  if (TouchesWithVertex(dp1, dq1, dr1)) return false;
+
+  const OrientPlane plane1(p1, q1, r1);
+  const int dp2 = plane1.Side(p2), dq2 = plane1.Side(q2), dr2 = plane1.Side(r2);
+  if (dp2 * dq2 > 0 && dp2 * dr2 > 0) return false;
+  if (TouchesWithVertex(dp2, dq2, dr2)) return false;
+
+  bool coplanar = false, hit = false;
+  if (dp1 > 0) {
+    if (dq1 > 0) hit = TriTri3D(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2, coplanar);
+    else if (dr1 > 0) hit = TriTri3D(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2, coplanar);
+    else hit = TriTri3D(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2, coplanar);
+  } else if (dp1 < 0) {
+    if (dq1 < 0) hit = TriTri3D(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2, coplanar);
+    else if (dr1 < 0) hit = TriTri3D(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2, coplanar);
+    else hit = TriTri3D(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2, coplanar);
+  } else if (dq1 < 0) {
+    if (dr1 >= 0) hit = TriTri3D(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2, coplanar);
+    else hit = TriTri3D(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2, coplanar);
+  } else if (dq1 > 0) {
+    if (dr1 > 0) hit = TriTri3D(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2, coplanar);
+    else hit = TriTri3D(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2, coplanar);
+  } else {
+    if (dr1 > 0) hit = TriTri3D(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2, coplanar);
+    else if (dr1 < 0) hit = TriTri3D(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2, coplanar);
+    else coplanar = true;
+  }
+  if (!coplanar) return hit;
+
+  const int k = ProjectionAxis(plane1, p1, q1, r1);
+  if (k < 0) return false;
+  const double *const t1[3] = {p1, q1, r1};
+  const double *const t2[3] = {p2, q2, r2};
+  return CoplanarTriangleTriangle(t1, t2, k);
+}
+
+/// The closed segment ab crosses the open triangle pqr at a single point: it is not in the plane
+/// of the triangle and the point is neither on an edge nor on a vertex.
+inline bool SegmentCrossesTriangleInterior(const double *a, const double *b,
+                                           const double *p, const double *q, const double *r)
+{
+  const OrientPlane plane(p, q, r);
+  const int sa = plane.Side(a), sb = plane.Side(b);
+  if ((sa == 0 && sb == 0) || sa * sb > 0) return false;
+  const int s1 = Orient3D(a, b, p, q);
+  if (s1 == 0) return false;
+  return Orient3D(a, b, q, r) == s1 && Orient3D(a, b, r, p) == s1;
+}
+
+} // end namespace predicates
+
+/// Exact and reproducible counterpart of IntersectionTriangleTriangle(): the triangles p1 q1 r1
+/// and p2 q2 r2 cross, see predicates::TriangleTriangle(). Float coordinates are converted to
+/// double without error.
+template<class ScalarType>
+bool IntersectionTriangleTriangleRobust(const Point3<ScalarType> &p1, const Point3<ScalarType> &q1, const Point3<ScalarType> &r1,
+                                        const Point3<ScalarType> &p2, const Point3<ScalarType> &q2, const Point3<ScalarType> &r2)
+{
+  const double t[6][3] = {
+    {double(p1[0]), double(p1[1]), double(p1[2])}, {double(q1[0]), double(q1[1]), double(q1[2])},
+    {double(r1[0]), double(r1[1]), double(r1[2])}, {double(p2[0]), double(p2[1]), double(p2[2])},
+    {double(q2[0]), double(q2[1]), double(q2[2])}, {double(r2[0]), double(r2[1]), double(r2[2])}};
+  return predicates::TriangleTriangle(t[0], t[1], t[2], t[3], t[4], t[5]);
+}
+
+/// The segment ab crosses the inside of the triangle pqr, see predicates::SegmentCrossesTriangleInterior()
+template<class ScalarType>
+bool IntersectionSegmentTriangleInteriorRobust(const Point3<ScalarType> &a, const Point3<ScalarType> &b,
+                                               const Point3<ScalarType> &p, const Point3<ScalarType> &q, const Point3<ScalarType> &r)
+{
+  const double t[5][3] = {
+    {double(a[0]), double(a[1]), double(a[2])}, {double(b[0]), double(b[1]), double(b[2])},
+    {double(p[0]), double(p[1]), double(p[2])}, {double(q[0]), double(q[1]), double(q[2])},
+    {double(r[0]), double(r[1]), double(r[2])}};
+  return predicates::SegmentCrossesTriangleInterior(t[0], t[1], t[2], t[3], t[4]);
+}
+
+/*@}*/
+
+} // end namespace vcg
+#endif
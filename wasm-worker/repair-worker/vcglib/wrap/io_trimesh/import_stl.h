@@ -24,8 +24,17 @@
 #ifndef __VCGLIB_IMPORT_STL
 #define __VCGLIB_IMPORT_STL
 #include <stdio.h>
+#include <string.h>
 #include <wrap/io_trimesh/io_mask.h>
 
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define __VCGLIB_IMPORT_STL_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace vcg {
 namespace tri {
 namespace io {
@@ -50,6 +59,8 @@ typedef typename OpenMeshType::FaceIterator FaceIterator;
 // if it is binary there are 80 char of comment, the number fn of faces and then exactly fn*4*3 bytes.
 
 enum {STL_LABEL_SIZE=80};
+// normal, three vertices and the attribute short
+enum {STL_FACET_SIZE=50};
 
 class STLFacet
 {
@@ -79,6 +90,90 @@ static const char *ErrorMsg(int error)
   else return stl_error_msg[error];
 };
 
+/**
+A read only view of the whole file, memory mapped where possible.
+It lets the format be sniffed once and the binary facets be decoded in place, in parallel.
+*/
+class STLFile
+{
+public:
+  STLFile(const char * filename) : data(0), size(0), opened(false)
+  {
+#ifdef __VCGLIB_IMPORT_STL_MMAP
+    map=0;
+    int fd = ::open(filename, O_RDONLY);
+    if(fd<0) return;
+    struct stat st;
+    if(fstat(fd,&st)==0)
+    {
+      opened=true;
+      size=size_t(st.st_size);
+      if(size>0)
+      {
+        map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map==MAP_FAILED) { map=0; size=0; opened=false; }
+        else
+        {
+          data=(const unsigned char *)map;
+          madvise(map, size, MADV_WILLNEED);
+        }
+      }
+    }
+    ::close(fd);
+#else
+    FILE *fp = fopen(filename, "rb");
+    if(fp == NULL) return;
+    opened=true;
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if(len>0)
+    {
+      buf.resize(size_t(len));
+      size=fread(&buf[0],1,buf.size(),fp);
+      data=&buf[0];
+    }
+    fclose(fp);
+#endif
+  }
+
+  ~STLFile()
+  {
+#ifdef __VCGLIB_IMPORT_STL_MMAP
+    if(map) munmap(map,size);
+#endif
+  }
+
+  bool IsOpen() const { return opened; }
+  const unsigned char *Data() const { return data; }
+  size_t Size() const { return size; }
+
+  /// number of facets declared in the binary header, -1 if the file is too short to have one
+  int FaceNum() const
+  {
+    if(size < STL_LABEL_SIZE+sizeof(int)) return -1;
+    int facenum;
+    memcpy(&facenum, data+STL_LABEL_SIZE, sizeof(int));
+    return facenum;
+  }
+
+  /// the normal, the three coords and the attribute short of the i-th binary facet
+  const unsigned char *Facet(size_t i) const { return data + STL_LABEL_SIZE + sizeof(int) + i*STL_FACET_SIZE; }
+
+private:
+  STLFile(const STLFile &);
+  STLFile &operator=(const STLFile &);
+
+  const unsigned char *data;
+  size_t size;
+  bool opened;
+#ifdef __VCGLIB_IMPORT_STL_MMAP
+  void *map;
+#else
+  std::vector<unsigned char> buf;
+#endif
+};
+
 static bool LoadMask(const char * filename, int &mask)
 {
   bool magicMode;
@@ -97,29 +192,32 @@ static bool LoadMask(const char * filename, int &mask)
  */
 static bool IsSTLColored(const char * filename, bool &magicsMode)
 {
-  if(IsSTLBinary(filename)==false)
+  STLFile file(filename);
+  magicsMode = false;
+  if(!file.IsOpen()) return false;
+  return IsSTLColored(file,magicsMode);
+}
+
+static bool IsSTLColored(const STLFile &file, bool &magicsMode)
+{
+  magicsMode = false;
+  if(IsSTLBinary(file)==false)
     return false;
-   FILE *fp = fopen(filename, "rb");
-   char buf[STL_LABEL_SIZE+1];
-   fread(buf,sizeof(char),STL_LABEL_SIZE,fp);
-   std::string strInput(buf);
+   std::string strInput((const char *)file.Data(), STL_LABEL_SIZE);
+   strInput = strInput.substr(0, strInput.find('\0'));
    size_t cInd = strInput.rfind("COLOR=");
    size_t mInd = strInput.rfind("MATERIAL=");
    if(cInd!=std::string::npos && mInd!=std::string::npos)
      magicsMode = true;
    else
      magicsMode = false;
-   int facenum;
-   fread(&facenum, sizeof(int), 1, fp);
+   int facenum = file.FaceNum();
+   size_t available = (file.Size()-STL_LABEL_SIZE-sizeof(int))/STL_FACET_SIZE;
 
-   for(int i=0;i<std::min(facenum,1000);++i)
+   for(size_t i=0;i<std::min<size_t>(std::max(facenum,0),std::min<size_t>(available,1000));++i)
    {
      unsigned short attr;
-     Point3f norm;
-     Point3f tri[3];
-     fread(&norm,sizeof(Point3f),1,fp);
-     fread(&tri,sizeof(Point3f),3,fp);
-     fread(&attr,sizeof(unsigned short),1,fp);
+     memcpy(&attr, file.Facet(i)+sizeof(STLFacet), sizeof(unsigned short));
      if(attr!=0)
      {
       if(Color4b::FromUnsignedR5G5B5(attr) != Color4b(Color4b::White))
@@ -131,91 +229,99 @@ static bool IsSTLColored(const char * filename, bool &magicsMode)
 }
 
 static bool IsSTLBinary(const char * filename)
+{
+  STLFile file(filename);
+  return file.IsOpen() && IsSTLBinary(file);
+}
+
+static bool IsSTLBinary(const STLFile &file)
 {
   bool binary=false;
-  FILE *fp = fopen(filename, "r");
-  /* Find size of file */
-  fseek(fp, 0, SEEK_END);
-  int file_size = ftell(fp);
-  int facenum;
+  int facenum = file.FaceNum();
+  if(facenum<0) return false;
   /* Check for binary or ASCII file */
-  fseek(fp, STL_LABEL_SIZE, SEEK_SET);
-  fread(&facenum, sizeof(int), 1, fp);
-  int expected_file_size=STL_LABEL_SIZE + 4 + (sizeof(short)+sizeof(STLFacet) )*facenum ;
-  if(file_size ==  expected_file_size) binary = true;
-  unsigned char tmpbuf[128];
-  fread(tmpbuf,sizeof(tmpbuf),1,fp);
-  for(unsigned int i = 0; i < sizeof(tmpbuf); i++)
+  size_t expected_file_size=STL_LABEL_SIZE + 4 + size_t(STL_FACET_SIZE)*(unsigned int)(facenum);
+  if(file.Size() ==  expected_file_size) binary = true;
+  const size_t start = STL_LABEL_SIZE + sizeof(int);
+  const size_t end = std::min<size_t>(file.Size(), start+128);
+  for(size_t i = start; i < end; i++)
     {
-      if(tmpbuf[i] > 127)
+      if(file.Data()[i] > 127)
           {
             binary=true;
             break;
           }
     }
   // Now we know if the stl file is ascii or binary.
-  fclose(fp);
   return binary;
 }
 
 static int Open( OpenMeshType &m, const char * filename, int &loadMask, CallBackPos *cb=0)
 {
-  FILE *fp = fopen(filename, "r");
-  if(fp == NULL)
+  STLFile file(filename);
+  if(!file.IsOpen())
       return E_CANTOPEN;
-  fclose(fp);
   loadMask |= Mask::IOM_VERTCOORD | Mask::IOM_FACEINDEX;
 
-  if(IsSTLBinary(filename)) return OpenBinary(m,filename,loadMask,cb);
+  if(IsSTLBinary(file)) return OpenBinary(m,file,loadMask,cb);
   else return OpenAscii(m,filename,cb);
 }
 
 static int OpenBinary( OpenMeshType &m, const char * filename, int &loadMask, CallBackPos *cb=0)
 {
-  FILE *fp;
-  fp = fopen(filename, "rb");
-  if(fp == NULL)
-  {
+  STLFile file(filename);
+  if(!file.IsOpen())
     return E_CANTOPEN;
-  }
+  return OpenBinary(m,file,loadMask,cb);
+}
 
+/// Decode the facets straight from the file view into the pre-sized vertex and face vectors.
+/// Facets are independent so they are decoded in parallel, in blocks to report the progress.
+static int OpenBinary( OpenMeshType &m, const STLFile &file, int &loadMask, CallBackPos *cb=0)
+{
   bool magicsMode;
-  if(!IsSTLColored(filename,magicsMode))
+  if(!IsSTLColored(file,magicsMode))
     loadMask = loadMask & (~Mask::IOM_FACECOLOR);
 
-  int facenum;
-  fseek(fp, STL_LABEL_SIZE, SEEK_SET);
-  fread(&facenum, sizeof(int), 1, fp);
+  int facenum = file.FaceNum();
+  if(facenum<0 || size_t(facenum) > (file.Size()-STL_LABEL_SIZE-sizeof(int))/STL_FACET_SIZE)
+    return E_UNESPECTEDEOF;
 
   m.Clear();
-  FaceIterator fi=Allocator<OpenMeshType>::AddFaces(m,facenum);
-  VertexIterator vi=Allocator<OpenMeshType>::AddVertices(m,facenum*3);
-  // For each triangle read the normal, the three coords and a short set to zero
-    for(int i=0;i<facenum;++i)
+  if(facenum==0) return E_NOERROR;
+  Allocator<OpenMeshType>::AddFaces(m,facenum);
+  Allocator<OpenMeshType>::AddVertices(m,size_t(facenum)*3);
+
+  const bool loadColor = tri::HasPerFaceColor(m) && (loadMask & Mask::IOM_FACECOLOR);
+  const int blockSize = 1<<16;
+  for(int start=0;start<facenum;start+=blockSize)
+  {
+    const int end = std::min(facenum,start+blockSize);
+#pragma omp parallel for schedule(static)
+    for(int i=start;i<end;++i)
     {
-      unsigned short attr;
-      Point3f norm;
-      Point3f tri[3];
-      fread(&norm,sizeof(Point3f),1,fp);
-      fread(&tri,sizeof(Point3f),3,fp);
-      fread(&attr,sizeof(unsigned short),1,fp);
-      if(tri::HasPerFaceColor(m) && (loadMask & Mask::IOM_FACECOLOR) )
+      const unsigned char *facet = file.Facet(i);
+      float coord[9];
+      memcpy(coord, facet+sizeof(Point3f), sizeof(coord));
+      FaceType &f = m.face[i];
+      for(int k=0;k<3;++k)
       {
-        if(magicsMode) (*fi).C()= Color4b::FromUnsignedR5G5B5(attr);
-                  else (*fi).C()= Color4b::FromUnsignedB5G5R5(attr);
+        VertexType &v = m.vert[size_t(i)*3+k];
+        v.P().Import(Point3f(coord[k*3],coord[k*3+1],coord[k*3+2]));
+        f.V(k)=&v;
       }
-      for(int k=0;k<3;++k)
+      if(loadColor)
       {
-        (*vi).P().Import(tri[k]);
-        (*fi).V(k)=&*vi;
-        ++vi;
+        unsigned short attr;
+        memcpy(&attr, facet+sizeof(STLFacet), sizeof(unsigned short));
+        if(magicsMode) f.C()= Color4b::FromUnsignedR5G5B5(attr);
+                  else f.C()= Color4b::FromUnsignedB5G5R5(attr);
       }
-      ++fi;
-      if(cb && (i%1000)==0) cb((i*100)/facenum,"STL Mesh Loading");
     }
-    fclose(fp);
-    return E_NOERROR;
+    if(cb) cb(int((long long)(end)*100/facenum),"STL Mesh Loading");
   }
+  return E_NOERROR;
+}
 
 
   static int OpenAscii( OpenMeshType &m, const char * filename, CallBackPos *cb=0)